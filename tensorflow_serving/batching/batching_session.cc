@@ -26,10 +26,12 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/request_timing.h"
 #include "tensorflow_serving/servables/tensorflow/serving_session.h"
 #include "tensorflow_serving/util/cleanup.h"
 #include "tensorflow_serving/util/hash.h"
 #include "tensorflow_serving/batching/batching_util.h"
+#include "tensorflow_serving/batching/open_batch_watcher.h"
 #include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
@@ -109,6 +111,17 @@ bool AreShapesEqualExceptZeroDim(const TensorShape& shape1,
   return true;
 }
 
+// Returns true iff one of 'inputs' is a scalar, which has no 0th dimension to
+// batch along.
+bool HasScalarInput(const std::vector<std::pair<string, Tensor>>& inputs) {
+  for (const auto& entry : inputs) {
+    if (entry.second.dims() == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 TensorSignature TensorSignatureFromSignatureDef(
@@ -170,6 +183,15 @@ class BatchingSession : public ServingSession {
              const std::vector<string>& target_node_names,
              std::vector<Tensor>* outputs, RunMetadata* run_metadata) override;
 
+  // Enqueues the call and returns; 'done' is called from the batch thread once
+  // the batch the call ends up in is processed. Calls which don't match a
+  // batching signature run in-line, like in Run().
+  void RunAsync(const RunOptions& run_options,
+                const std::vector<std::pair<string, Tensor>>& inputs,
+                const std::vector<string>& output_tensor_names,
+                std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                std::function<void(const Status&)> done) override;
+
   Status ListDevices(std::vector<DeviceAttributes>* response) override;
 
  private:
@@ -196,6 +218,18 @@ class BatchingSession : public ServingSession {
       const TensorSignature& signature, const Batch<BatchingSessionTask>& batch,
       std::vector<std::pair<string, Tensor>>* merged_inputs);
 
+  // Adds the input tensors of the tasks of 'batch' to 'merger' as the tasks
+  // are added to the batch, until the batch is closed. Blocks on 'watcher'
+  // while there is nothing to merge. Returns the first error encountered,
+  // after waiting for the batch to close anyway.
+  Status MergeInputTensorsUntilClosed(
+      const Batch<BatchingSessionTask>& batch,
+      OpenBatchWatcher<BatchingSessionTask>* watcher,
+      IncrementalTensorMerger* merger);
+
+  // Returns the maximum size of the batches of 'signature', including padding.
+  int64 MaxBatchSize(const TensorSignature& signature) const;
+
   // Splits the output of a batched call to 'wrapped_->Run()' into individual
   // task outputs. Assumes the output tensor order matches the signature.
   Status SplitOutputTensors(const TensorSignature& signature,
@@ -210,6 +244,15 @@ class BatchingSession : public ServingSession {
   const BatchingSessionOptions options_;
 
   std::unique_ptr<Session> wrapped_;
+
+  // The watchers of the open batches of each batch scheduler, if
+  // 'options_.merge_inputs_incrementally' is set. Declared before
+  // 'batch_schedulers_' so as to outlive them.
+  std::unordered_map<TensorSignature,
+                     std::unique_ptr<OpenBatchWatcher<BatchingSessionTask>>,
+                     HashTensorSignature, EqTensorSignature>
+      open_batch_watchers_;
+
   std::unordered_map<TensorSignature,
                      std::unique_ptr<BatchScheduler<BatchingSessionTask>>,
                      HashTensorSignature, EqTensorSignature>
@@ -223,6 +266,12 @@ Status BatchingSession::Create(
     const std::vector<SignatureWithBatchingSessionSchedulerCreator>&
         signatures_with_scheduler_creators,
     std::unique_ptr<BatchingSession>* result) {
+  if (options.merge_inputs_incrementally &&
+      options.pad_variable_length_inputs) {
+    return errors::InvalidArgument(
+        "merge_inputs_incrementally cannot be combined with "
+        "pad_variable_length_inputs");
+  }
   auto batching_session =
       std::unique_ptr<BatchingSession>(new BatchingSession(options));
   BatchingSession* raw_batching_session = batching_session.get();
@@ -233,6 +282,10 @@ Status BatchingSession::Create(
     const BatchingSessionSchedulerCreator& scheduler_creator =
         entry.scheduler_creator;
 
+    if (options.merge_inputs_incrementally) {
+      batching_session->open_batch_watchers_[signature].reset(
+          new OpenBatchWatcher<BatchingSessionTask>);
+    }
     std::unique_ptr<BatchScheduler<BatchingSessionTask>> batch_scheduler;
     TF_RETURN_IF_ERROR(scheduler_creator(
         [signature, raw_batching_session](
@@ -268,6 +321,23 @@ Status BatchingSession::Run(
         "BatchingSession does not support target nodes");
   }
 
+  Notification done;
+  Status status;
+  RunAsync(run_options, inputs, output_tensor_names, outputs, run_metadata,
+           [&done, &status](const Status& run_status) {
+             status = run_status;
+             done.Notify();
+           });
+  done.WaitForNotification();
+  return status;
+}
+
+void BatchingSession::RunAsync(
+    const RunOptions& run_options,
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const std::vector<string>& output_tensor_names,
+    std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+    std::function<void(const Status&)> done) {
   const TensorSignature signature =
       TensorSignatureFromRunArgs(inputs, output_tensor_names);
   auto batch_scheduler_it = batch_schedulers_.find(signature);
@@ -283,30 +353,48 @@ Status BatchingSession::Run(
                    << TensorSignatureDebugString(signature);
       last_log_message_secs = now_secs;
     }
-    return wrapped_->Run(run_options, inputs, output_tensor_names,
-                         target_node_names, outputs, run_metadata);
+    done(wrapped_->Run(run_options, inputs, output_tensor_names,
+                       {} /* target node names */, outputs, run_metadata));
+    return;
+  }
+  if (HasScalarInput(inputs)) {
+    // A call with a scalar input, e.g. the shared context of a Classify
+    // request, can't be merged with other calls, whose scalars may differ. Run
+    // it in-line.
+    done(wrapped_->Run(run_options, inputs, output_tensor_names,
+                       {} /* target node names */, outputs, run_metadata));
+    return;
   }
   BatchScheduler<BatchingSessionTask>* batch_scheduler =
       batch_scheduler_it->second.get();
 
   outputs->clear();
 
-  Notification done;
-  Status status;
   auto task = std::unique_ptr<BatchingSessionTask>(new BatchingSessionTask);
   task->enqueue_time_micros = Env::Default()->NowMicros();
   task->run_options = run_options;
-  TF_RETURN_IF_ERROR(ComputeInputSize(inputs, &task->zeroth_dim_size));
+  const Status input_size_status =
+      ComputeInputSize(inputs, &task->zeroth_dim_size);
+  if (!input_size_status.ok()) {
+    done(input_size_status);
+    return;
+  }
   task->inputs = &inputs;
   task->output_tensor_names = &output_tensor_names;
-  task->done = &done;
-  task->status = &status;
+  task->timing = RequestTiming::Current();
   task->outputs = outputs;
   task->run_metadata = run_metadata;
+  task->done = std::move(done);
 
-  TF_RETURN_IF_ERROR(batch_scheduler->Schedule(&task));
-  done.WaitForNotification();
-  return status;
+  const Status schedule_status = batch_scheduler->Schedule(&task);
+  if (!schedule_status.ok()) {
+    // The scheduler leaves the task with us when it rejects it.
+    task->done(schedule_status);
+    return;
+  }
+  if (options_.merge_inputs_incrementally) {
+    open_batch_watchers_.at(signature)->TaskScheduled();
+  }
 }
 
 Status BatchingSession::ListDevices(std::vector<DeviceAttributes>* response) {
@@ -458,6 +546,25 @@ Status BatchingSession::MergeInputTensors(
   return Status::OK();
 }
 
+Status BatchingSession::MergeInputTensorsUntilClosed(
+    const Batch<BatchingSessionTask>& batch,
+    OpenBatchWatcher<BatchingSessionTask>* watcher,
+    IncrementalTensorMerger* merger) {
+  return watcher->VisitTasksUntilClosed(
+      batch, [merger](const BatchingSessionTask& task) {
+        return merger->Add(*task.inputs, task.zeroth_dim_size);
+      });
+}
+
+int64 BatchingSession::MaxBatchSize(const TensorSignature& signature) const {
+  int64 max_batch_size = batch_schedulers_.at(signature)->max_task_size();
+  if (!options_.allowed_batch_sizes.empty() &&
+      options_.allowed_batch_sizes.back() > max_batch_size) {
+    max_batch_size = options_.allowed_batch_sizes.back();
+  }
+  return max_batch_size;
+}
+
 Status BatchingSession::SplitOutputTensors(
     const TensorSignature& signature,
     const std::vector<Tensor>& combined_outputs,
@@ -540,16 +647,29 @@ Status BatchingSession::SplitOutputTensors(
 void BatchingSession::ProcessBatch(
     const TensorSignature& signature,
     std::unique_ptr<Batch<BatchingSessionTask>> batch) {
-  // As a possible performance optimization, consider overlapping the tensor
-  // concatenation with waiting for the batch to close (i.e. do the
-  // concatenation incrementally as tasks stream into the batch).
-  batch->WaitUntilClosed();
+  optional<IncrementalTensorMerger> merger;
+  Status merge_status;
+  if (options_.merge_inputs_incrementally) {
+    merger.emplace(MaxBatchSize(signature));
+    merge_status = MergeInputTensorsUntilClosed(
+        *batch, open_batch_watchers_.at(signature).get(), &*merger);
+  } else {
+    batch->WaitUntilClosed();
+  }
 
   if (batch->empty()) {
     return;
   }
 
   const uint64 dequeue_time_micros = Env::Default()->NowMicros();
+  for (int i = 0; i < batch->num_tasks(); ++i) {
+    const BatchingSessionTask& task = batch->task(i);
+    if (task.timing != nullptr &&
+        dequeue_time_micros > task.enqueue_time_micros) {
+      task.timing->Add(RequestPhase::kBatchingQueueWait,
+                       dequeue_time_micros - task.enqueue_time_micros);
+    }
+  }
 
   // Regardless of the outcome, we need to propagate the status to the
   // individual tasks and signal that they are done. We use MakeCleanup() to
@@ -557,8 +677,7 @@ void BatchingSession::ProcessBatch(
   Status status;
   auto finally = MakeCleanup([&status, &batch] {
     for (int i = 0; i < batch->num_tasks(); ++i) {
-      *batch->mutable_task(i)->status = status;
-      batch->mutable_task(i)->done->Notify();
+      batch->mutable_task(i)->done(status);
     }
   });
 
@@ -599,7 +718,16 @@ void BatchingSession::ProcessBatch(
   }
 
   std::vector<std::pair<string, Tensor>> merged_inputs;
-  status = MergeInputTensors(signature, *batch, &merged_inputs);
+  if (merger) {
+    status = merge_status;
+    if (status.ok()) {
+      status = merger->Finish(signature.input_tensors,
+                              RoundToLowestAllowedBatchSize(batch->size()),
+                              &merged_inputs);
+    }
+  } else {
+    status = MergeInputTensors(signature, *batch, &merged_inputs);
+  }
   if (!status.ok()) {
     return;
   }
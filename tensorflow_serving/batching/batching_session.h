@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/contrib/batching/batch_scheduler.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
+#include "tensorflow_serving/core/request_timing.h"
 
 namespace tensorflow {
 namespace serving {
@@ -130,6 +131,20 @@ struct BatchingSessionOptions {
   // (modulo zeroth dimension) and this option is set to false,
   // then error Status will be returned.
   bool pad_variable_length_inputs = false;
+
+  // If set to true, the input tensors of a batch are merged while the batch is
+  // still open, rather than concatenated once it is closed: each merged input
+  // tensor is preallocated for the maximum batch size, and the rows of each
+  // task are copied into it as soon as the task is scheduled. With a batch
+  // scheduler which hands batches over to the batch thread while they are
+  // still filling up (StreamingBatchScheduler), the batch is then ready to run
+  // as soon as it closes. The batch thread blocks between tasks; the batch
+  // scheduler must have at most one open batch at a time (see
+  // OpenBatchWatcher).
+  //
+  // Cannot be combined with 'pad_variable_length_inputs', as the padding of
+  // each task depends on the whole batch.
+  bool merge_inputs_incrementally = false;
 };
 
 // Wraps a session in a new session that automatically batches Run() calls.
@@ -146,13 +161,23 @@ struct BatchingSessionOptions {
 // For batched calls, it is assumed that the outermost (0th) dimension of each
 // input and output tensor is the batch-size dimension. All input tensors must
 // have the same 0th-dimension size B; the produced output tensors are also
-// assumed to have 0th-dimension size B.
+// assumed to have 0th-dimension size B. Calls with a scalar input (such as the
+// shared context of Classify and Regress requests, see kSharedContextInputs)
+// have no batch dimension to merge that input along, so they are executed
+// in-line without batching too.
 //
 // IMPORTANT: Each call to Session::Run() is synchronous, and blocks waiting for
 // other Run() calls with the same signature to merge with to form a large
 // batch. Consequently, to achieve good throughput we recommend setting the
 // number of client threads that call Session::Run() equal to about twice the
-// sum over all signatures of the maximum batch size.
+// sum over all signatures of the maximum batch size. Alternatively, callers may
+// use BatchingSession::RunAsync() to avoid blocking a thread while their call
+// is queued: it returns as soon as the call is enqueued, and calls back from
+// the batch thread once the batch is processed, so the number of client
+// threads doesn't need to grow with the batch size. The callbacks of a batch
+// run one after another on the batch thread, so they should hand any real work
+// off to another thread (see ContinueOnExecutor() in
+// servables/tensorflow/util.h).
 //
 // Example usage, for the common case of a single signature:
 //
@@ -204,11 +229,15 @@ struct BatchingSessionTask : public BatchTask {
   const std::vector<std::pair<string, Tensor>>* inputs;
   const std::vector<string>* output_tensor_names;
 
+  // The RequestTiming current when the task was received, if any, to which
+  // the time spent in the batching queue is added.
+  RequestTiming* timing = nullptr;
+
   // Fields populated when a task is processed (as part of a batch).
-  Notification* done;
-  Status* status;
   std::vector<Tensor>* outputs;
   RunMetadata* run_metadata;
+  // Called with the outcome of the task once it is processed.
+  std::function<void(const Status&)> done;
 };
 
 }  // namespace serving
@@ -23,12 +23,15 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow_serving/batching/streaming_batch_scheduler.h"
+#include "tensorflow_serving/core/request_timing.h"
 #include "tensorflow_serving/servables/tensorflow/serving_session.h"
 #include "tensorflow_serving/test_util/test_util.h"
 
@@ -204,6 +207,80 @@ TEST(BatchingSessionTest, Basic) {
       }));
 }
 
+TEST(BatchingSessionTest, RunAsync) {
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;  // fits two 2-unit tasks
+  schedule_options.batch_timeout_micros = 1 * 1000 * 1000;  // won't trigger
+  schedule_options.num_batch_threads = 1;
+  std::unique_ptr<Session> batching_session;
+  BatchingSessionOptions batching_session_options;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options, {{"x"}, {"y"}},
+      CreateHalfPlusTwoSession(), &batching_session));
+  ServingSession* serving_session =
+      static_cast<ServingSession*>(batching_session.get());
+
+  // Issue two requests from the same thread: neither call blocks, and together
+  // they fill a batch.
+  const std::vector<std::pair<string, Tensor>> first_inputs = {
+      {"x", test::AsTensor<float>({100.0f, 42.0f}, {2})}};
+  const std::vector<std::pair<string, Tensor>> second_inputs = {
+      {"x", test::AsTensor<float>({71.5f, 18.3f}, {2})}};
+  const std::vector<string> output_tensor_names = {"y"};
+  std::vector<Tensor> first_outputs;
+  std::vector<Tensor> second_outputs;
+  RunMetadata first_run_metadata;
+  RunMetadata second_run_metadata;
+  Notification first_done;
+  Notification second_done;
+  Status first_status;
+  Status second_status;
+  serving_session->RunAsync(RunOptions(), first_inputs, output_tensor_names,
+                            &first_outputs, &first_run_metadata,
+                            [&](const Status& status) {
+                              first_status = status;
+                              first_done.Notify();
+                            });
+  EXPECT_FALSE(first_done.HasBeenNotified());
+  serving_session->RunAsync(RunOptions(), second_inputs, output_tensor_names,
+                            &second_outputs, &second_run_metadata,
+                            [&](const Status& status) {
+                              second_status = status;
+                              second_done.Notify();
+                            });
+  first_done.WaitForNotification();
+  second_done.WaitForNotification();
+
+  TF_ASSERT_OK(first_status);
+  TF_ASSERT_OK(second_status);
+  ASSERT_EQ(1, first_outputs.size());
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({52.0f, 23.0f}, {2}),
+                                 first_outputs[0]);
+  ASSERT_EQ(1, second_outputs.size());
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({71.5f / 2 + 2, 18.3f / 2 + 2}, {2}),
+      second_outputs[0]);
+}
+
+TEST(BatchingSessionTest, RecordsBatchingQueueWait) {
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;  // never fills up
+  schedule_options.batch_timeout_micros = 10 * 1000;
+  schedule_options.num_batch_threads = 1;
+  std::unique_ptr<Session> batching_session;
+  BatchingSessionOptions batching_session_options;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options, {{"x"}, {"y"}},
+      CreateHalfPlusTwoSession(), &batching_session));
+
+  // The single request waits for the batch timeout in the queue.
+  RequestTiming timing;
+  RequestTiming::ScopedCurrent scoped_timing(&timing);
+  TestSingleRequest(100.0f, 42.0f, batching_session.get());
+  EXPECT_GE(timing.micros(RequestPhase::kBatchingQueueWait),
+            schedule_options.batch_timeout_micros);
+}
+
 TEST(BatchingSessionTest, BatchingWithPadding) {
   BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
   schedule_options.max_batch_size = 2;
@@ -294,6 +371,24 @@ TEST(BatchingSessionTest, RequestThatDoesntMatchSignatureGetsRunAnyway) {
   TestSingleRequest(100.0f, 42.0f, batching_session.get());
 }
 
+TEST(BatchingSessionTest, RequestWithScalarInputGetsRunAnyway) {
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  // Set the batching parameters s.t. if the request is batched the test will
+  // timeout.
+  schedule_options.max_batch_size = 100;
+  schedule_options.batch_timeout_micros = INT_MAX;
+  std::unique_ptr<Session> batching_session;
+  BatchingSessionOptions batching_session_options;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options, {{"x"}, {"y"}},
+      CreateHalfPlusTwoSession(), &batching_session));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(batching_session->Run({{"x", test::AsScalar<float>(100.0f)}},
+                                     {"y"}, {} /* target nodes */, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(52.0f), outputs[0]);
+}
+
 TEST(BatchingSessionTest, RequestWithIncompatibleInputTensorSizes) {
   BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
   std::unique_ptr<Session> batching_session;
@@ -355,6 +450,82 @@ TEST(BatchingSessionTest, AllowedBatchSizesRequirePadding) {
   EXPECT_EQ(3, batch_size_capturing_session_raw->latest_batch_size());
 }
 
+TEST(BatchingSessionTest, MergeInputsIncrementally) {
+  StreamingBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;  // fits two 2-unit tasks
+  schedule_options.batch_timeout_micros = 1 * 1000 * 1000;  // won't trigger
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.merge_inputs_incrementally = true;
+  auto scheduler_creator =
+      [schedule_options](
+          std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
+              process_batch_callback,
+          std::unique_ptr<BatchScheduler<BatchingSessionTask>>*
+              batch_scheduler) {
+        std::unique_ptr<StreamingBatchScheduler<BatchingSessionTask>>
+            streaming_batch_scheduler;
+        TF_RETURN_IF_ERROR(StreamingBatchScheduler<BatchingSessionTask>::Create(
+            schedule_options, process_batch_callback,
+            &streaming_batch_scheduler));
+        *batch_scheduler = std::move(streaming_batch_scheduler);
+        return Status::OK();
+      };
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBatchingSession(batching_session_options,
+                                     {{{{"x"}, {"y"}}, scheduler_creator}},
+                                     CreateHalfPlusTwoSession(),
+                                     &batching_session));
+
+  // The first request is merged while the batch waits for the second one,
+  // which fills it up. (OpenBatchWatcherTest.VisitsTasksBeforeClose checks
+  // that each task is handed to the merger before the batch closes.)
+  std::unique_ptr<Thread> first_request_thread(Env::Default()->StartThread(
+      ThreadOptions(), "first_request_thread", [&batching_session] {
+        TestSingleRequest(100.0f, 42.0f, batching_session.get());
+      }));
+  std::unique_ptr<Thread> second_request_thread(Env::Default()->StartThread(
+      ThreadOptions(), "second_request_thread", [&batching_session] {
+        TestSingleRequest(71.5f, 18.3f, batching_session.get());
+      }));
+}
+
+TEST(BatchingSessionTest, MergeInputsIncrementallyWithAllowedBatchSizes) {
+  // Arrange to capture the batch size.
+  std::unique_ptr<BatchSizeCapturingSession> batch_size_capturing_session(
+      new BatchSizeCapturingSession(CreateHalfPlusTwoSession()));
+  auto batch_size_capturing_session_raw = batch_size_capturing_session.get();
+
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;
+  schedule_options.batch_timeout_micros = 0;
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.allowed_batch_sizes = {1, 3, 4};
+  batching_session_options.merge_inputs_incrementally = true;
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options, {{"x"}, {"y"}},
+      std::move(batch_size_capturing_session), &batching_session));
+  TestSingleRequest(100.0f, 42.0f, batching_session.get());
+
+  // It should pad the batch size from 2 to 3.
+  EXPECT_EQ(3, batch_size_capturing_session_raw->latest_batch_size());
+}
+
+TEST(BatchingSessionTest, MergeInputsIncrementallyWithPaddingRejected) {
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.pad_variable_length_inputs = true;
+  batching_session_options.merge_inputs_incrementally = true;
+  std::unique_ptr<Session> batching_session;
+  EXPECT_FALSE(CreateBasicBatchingSession(
+                   schedule_options, batching_session_options, {{"x"}, {"y"}},
+                   CreateHalfPlusTwoSession(), &batching_session)
+                   .ok());
+}
+
 TEST(BatchingSessionTest, UnsortedAllowedBatchSizesRejected) {
   BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
   schedule_options.max_batch_size = 4;
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow_serving/batching/batching_util.h"
 
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/tensor.h"
@@ -205,5 +206,139 @@ Status AddPadding(const Tensor& tensor,
 #undef CASE
   return padding_status;
 }
+
+namespace {
+
+// Copies 'num_rows' rows of 'source', starting with 'source_row', into
+// 'destination' from 'destination_row' on. Both tensors must have the same
+// type and the same shape except for the 0th dimension.
+template <typename T>
+void CopyRowsOfSpecificType(const Tensor& source, const int64 source_row,
+                            const int64 num_rows, const int64 destination_row,
+                            Tensor* destination) {
+  const int64 row_size = source.NumElements() / source.dim_size(0);
+  const T* const source_data = source.flat<T>().data();
+  T* const destination_data = destination->flat<T>().data();
+  std::copy_n(source_data + source_row * row_size, num_rows * row_size,
+              destination_data + destination_row * row_size);
+}
+
+Status CopyRows(const Tensor& source, const int64 source_row,
+                const int64 num_rows, const int64 destination_row,
+                Tensor* destination) {
+  if (num_rows == 0 || source.NumElements() == 0) {
+    return Status::OK();
+  }
+  Status copy_status;
+#define CASE(type) \
+        case DataTypeToEnum<type>::value: { \
+          CopyRowsOfSpecificType<type>(source, source_row, num_rows, \
+                                       destination_row, destination); \
+          break; \
+        }
+       switch (source.dtype()) {
+         TF_CALL_ALL_TYPES(CASE);
+         TF_CALL_QUANTIZED_TYPES(CASE);
+         // quantized types macro doesn't include these types
+         TF_CALL_quint16(CASE);
+         TF_CALL_qint16(CASE);
+         default:
+           copy_status = errors::InvalidArgument("Unsupported type");
+       }
+#undef CASE
+  return copy_status;
+}
+
+}  // namespace
+
+Status IncrementalTensorMerger::Add(
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const int64 num_rows) {
+  if (num_rows_ + num_rows > max_rows_) {
+    return errors::Internal("Batch exceeds its maximum size of ", max_rows_,
+                            " rows");
+  }
+  const bool first_task = merged_tensors_.empty();
+  if (!first_task && inputs.size() != merged_tensors_.size()) {
+    return errors::Internal(
+        "One or more tasks does not conform to batch signature");
+  }
+  for (const auto& entry : inputs) {
+    const string& tensor_name = entry.first;
+    const Tensor& tensor = entry.second;
+    if (tensor.dims() == 0 || tensor.dim_size(0) != num_rows) {
+      return errors::Internal("Tensor '", tensor_name, "' doesn't have ",
+                              num_rows, " rows");
+    }
+    Tensor* merged_tensor;
+    if (first_task) {
+      TensorShape merged_shape = tensor.shape();
+      merged_shape.set_dim(0, max_rows_);
+      merged_tensor = &merged_tensors_[tensor_name];
+      *merged_tensor = Tensor(tensor.dtype(), merged_shape);
+    } else {
+      auto it = merged_tensors_.find(tensor_name);
+      if (it == merged_tensors_.end()) {
+        return errors::Internal(
+            "One or more tasks does not conform to batch signature");
+      }
+      merged_tensor = &it->second;
+      if (tensor.dtype() != merged_tensor->dtype() ||
+          tensor.dims() != merged_tensor->dims()) {
+        return errors::FailedPrecondition(
+            "Tensors with name '", tensor_name,
+            "' from different tasks have different types or ranks.");
+      }
+      for (int i = 1; i < tensor.dims(); ++i) {
+        if (tensor.dim_size(i) != merged_tensor->dim_size(i)) {
+          return errors::FailedPrecondition(
+              "Tensors with name '" + tensor_name + "' from different tasks" +
+              " have different shapes and padding is turned off." +
+              "Set pad_variable_length_inputs to true, or ensure that " +
+              "all tensors with the same name" +
+              "have equal dimensions starting with the first dim.");
+        }
+      }
+    }
+    TF_RETURN_IF_ERROR(CopyRows(tensor, 0, num_rows, num_rows_, merged_tensor));
+  }
+  last_task_first_row_ = num_rows_;
+  num_rows_ += num_rows;
+  return Status::OK();
+}
+
+Status IncrementalTensorMerger::Finish(
+    const std::set<string>& tensor_names, const int64 num_rows,
+    std::vector<std::pair<string, Tensor>>* merged_inputs) {
+  if (num_rows_ == 0) {
+    return errors::Internal("Batch size expected to be positive; was 0");
+  }
+  if (num_rows < num_rows_ || num_rows > max_rows_) {
+    return errors::Internal("Cannot pad a batch of ", num_rows_, " rows to ",
+                            num_rows, " rows");
+  }
+  if (tensor_names.size() != merged_tensors_.size()) {
+    return errors::Internal(
+        "One or more tasks does not conform to batch signature");
+  }
+  for (const string& tensor_name : tensor_names) {
+    auto it = merged_tensors_.find(tensor_name);
+    if (it == merged_tensors_.end()) {
+      return errors::Internal(
+          "One or more tasks does not conform to batch signature");
+    }
+    Tensor* merged_tensor = &it->second;
+    // Use the first row of the last task as the padding data, like
+    // BatchingSession does when concatenating complete batches.
+    for (int64 row = num_rows_; row < num_rows; ++row) {
+      TF_RETURN_IF_ERROR(CopyRows(*merged_tensor, last_task_first_row_, 1,
+                                  row, merged_tensor));
+    }
+    // Slice() on the 0th dimension avoids a deep copy.
+    merged_inputs->push_back({tensor_name, merged_tensor->Slice(0, num_rows)});
+  }
+  return Status::OK();
+}
+
 }  // namespace serving
 }  // namespace tensorflow
@@ -16,7 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_BATCHING_BATCHING_UTIL_H_
 #define TENSORFLOW_SERVING_BATCHING_BATCHING_UTIL_H_
 
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -63,6 +66,47 @@ std::map<string, std::vector<int>> CalculateMaxDimSizes(
 
 Status AddPadding(const Tensor& tensor,
     const std::vector<int>& max_dim_sizes, Tensor* padded_tensor);
+
+// Merges the input tensors of the tasks of a batch, one task at a time, by
+// copying each task's rows into tensors preallocated for the largest possible
+// batch. Unlike concatenating all the tensors of a complete batch, this lets
+// a batch be merged while it is still filling up.
+//
+// This class is not thread-safe.
+class IncrementalTensorMerger {
+ public:
+  // 'max_rows' is the maximum number of rows (0th dimension size) of the
+  // merged tensors, including padding.
+  explicit IncrementalTensorMerger(int64 max_rows) : max_rows_(max_rows) {}
+
+  // Appends the rows of the input tensors of one task, which all have
+  // 'num_rows' rows. The first call determines the names, types and shapes
+  // (except for the 0th dimension) of the merged tensors; later calls must
+  // conform to them.
+  Status Add(const std::vector<std::pair<string, Tensor>>& inputs,
+             int64 num_rows);
+
+  // Pads the merged tensors to 'num_rows' rows by repeating the first row of
+  // the last task, and returns them in the order of 'tensor_names', which
+  // must be the names of the merged tensors. Must be called once, after at
+  // least one call to Add().
+  Status Finish(const std::set<string>& tensor_names, int64 num_rows,
+                std::vector<std::pair<string, Tensor>>* merged_inputs);
+
+  // The number of rows merged so far.
+  int64 num_rows() const { return num_rows_; }
+
+ private:
+  const int64 max_rows_;
+
+  // The number of rows merged so far, and the first row of the last task.
+  int64 num_rows_ = 0;
+  int64 last_task_first_row_ = 0;
+
+  // The merged tensors, by name, each with 'max_rows_' rows.
+  std::unordered_map<string, Tensor> merged_tensors_;
+};
+
 }  // namespace serving
 }  // namespace tensorflow
 #endif  // TENSORFLOW_SERVING_BATCHING_BATCHING_UTIL_H_
@@ -20,7 +20,9 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -83,6 +85,46 @@ TEST(BatchingUtilTest, AddPaddingTensorWithUnsupportedRank) {
             "Only tensors with rank from 1 to 6 can be padded."),
             AddPadding(tensor, max_dim_sizes, &padded_tensor));
 }
+
+TEST(BatchingUtilTest, IncrementalTensorMergerMergesAndPads) {
+  IncrementalTensorMerger merger(8);
+  TF_ASSERT_OK(merger.Add(
+      {{"x", test::AsTensor<float>({1, 2, 3, 4}, {2, 2})},
+       {"s", test::AsTensor<string>({"a", "b"}, {2})}},
+      2));
+  TF_ASSERT_OK(merger.Add({{"x", test::AsTensor<float>({5, 6}, {1, 2})},
+                           {"s", test::AsTensor<string>({"c"}, {1})}},
+                          1));
+  EXPECT_EQ(3, merger.num_rows());
+
+  std::vector<std::pair<string, Tensor>> merged_inputs;
+  TF_ASSERT_OK(merger.Finish({"s", "x"}, 4, &merged_inputs));
+  ASSERT_EQ(2, merged_inputs.size());
+  EXPECT_EQ("s", merged_inputs[0].first);
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"a", "b", "c", "c"}, {4}),
+      merged_inputs[0].second);
+  EXPECT_EQ("x", merged_inputs[1].first);
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 2, 3, 4, 5, 6, 5, 6}, {4, 2}),
+      merged_inputs[1].second);
+}
+
+TEST(BatchingUtilTest, IncrementalTensorMergerRejectsUnequalShapes) {
+  IncrementalTensorMerger merger(8);
+  TF_ASSERT_OK(
+      merger.Add({{"x", test::AsTensor<float>({1, 2, 3, 4}, {2, 2})}}, 2));
+  EXPECT_EQ(error::FAILED_PRECONDITION,
+            merger.Add({{"x", test::AsTensor<float>({1, 2, 3}, {1, 3})}}, 1)
+                .code());
+}
+
+TEST(BatchingUtilTest, IncrementalTensorMergerRejectsTooManyRows) {
+  IncrementalTensorMerger merger(2);
+  TF_ASSERT_OK(merger.Add({{"x", test::AsTensor<float>({1, 2}, {2})}}, 2));
+  EXPECT_FALSE(merger.Add({{"x", test::AsTensor<float>({3}, {1})}}, 1).ok());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
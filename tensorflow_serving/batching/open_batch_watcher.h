@@ -0,0 +1,207 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_BATCHING_OPEN_BATCH_WATCHER_H_
+#define TENSORFLOW_SERVING_BATCHING_OPEN_BATCH_WATCHER_H_
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+
+#include "tensorflow/contrib/batching/batch_scheduler.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Lets a batch thread which is handed a batch while the batch is still open
+// (see StreamingBatchScheduler) block until a task is added to the batch or
+// the batch is closed, instead of polling it.
+//
+// Batch offers no way to wait for new tasks, so whoever schedules tasks calls
+// TaskScheduled() after each successful BatchScheduler::Schedule(). Nor can a
+// thread wait for either of two Batch events, so a watcher thread waits for
+// the batches passed to WaitForTasksOrClose() to close, one at a time in the
+// order they were first passed, and wakes up the waiting batch threads. That
+// order is the order in which they close, provided the batch scheduler has at
+// most one open batch at a time, as StreamingBatchScheduler does.
+//
+// An OpenBatchWatcher serves the batches of a single batch scheduler, and must
+// outlive it.
+template <typename TaskType>
+class OpenBatchWatcher {
+ public:
+  OpenBatchWatcher();
+
+  // Waits for the watched batches to close. Must not be called while a thread
+  // is blocked in WaitForTasksOrClose().
+  ~OpenBatchWatcher();
+
+  // Wakes up the threads blocked in WaitForTasksOrClose(), to check whether a
+  // task has been added to their batch.
+  void TaskScheduled();
+
+  // Blocks until 'batch' has more than 'num_tasks' tasks, or is closed.
+  // Returns true if it is closed, after which the watcher no longer refers to
+  // 'batch' and it may be destroyed. Otherwise 'batch' must not be destroyed
+  // before a later call returns true.
+  bool WaitForTasksOrClose(const Batch<TaskType>& batch, int num_tasks);
+
+  // Calls 'visit' on each task of 'batch', in order, as soon as it is added,
+  // until 'batch' is closed and all its tasks are visited. If 'visit' fails,
+  // stops visiting tasks and returns the error once 'batch' is closed.
+  Status VisitTasksUntilClosed(
+      const Batch<TaskType>& batch,
+      const std::function<Status(const TaskType& task)>& visit);
+
+ private:
+  // The body of 'watcher_thread_'.
+  void WatchBatches();
+
+  // Returns whether 'batch' is in 'watched_batches_'.
+  bool IsWatched(const Batch<TaskType>& batch) const
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutex mu_;
+
+  // Notified when a task is scheduled, or a watched batch is closed.
+  condition_variable tasks_or_close_;
+
+  // Notified when a batch is added to 'watched_batches_', or on destruction.
+  condition_variable batch_to_watch_;
+
+  // The batches which 'watcher_thread_' waits to be closed, in order.
+  std::deque<const Batch<TaskType>*> watched_batches_ GUARDED_BY(mu_);
+
+  bool stopping_ GUARDED_BY(mu_) = false;
+
+  std::unique_ptr<Thread> watcher_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpenBatchWatcher);
+};
+
+//////////
+// Implementation details follow. API users need not read.
+
+template <typename TaskType>
+OpenBatchWatcher<TaskType>::OpenBatchWatcher()
+    : watcher_thread_(Env::Default()->StartThread(
+          ThreadOptions(), "open_batch_watcher",
+          [this] { WatchBatches(); })) {}
+
+template <typename TaskType>
+OpenBatchWatcher<TaskType>::~OpenBatchWatcher() {
+  {
+    mutex_lock l(mu_);
+    stopping_ = true;
+  }
+  batch_to_watch_.notify_all();
+  // Joins the watcher thread.
+  watcher_thread_.reset();
+}
+
+template <typename TaskType>
+void OpenBatchWatcher<TaskType>::TaskScheduled() {
+  // Taking the lock orders the new task before a waiter's check for it.
+  { mutex_lock l(mu_); }
+  tasks_or_close_.notify_all();
+}
+
+template <typename TaskType>
+bool OpenBatchWatcher<TaskType>::WaitForTasksOrClose(
+    const Batch<TaskType>& batch, const int num_tasks) {
+  mutex_lock l(mu_);
+  for (;;) {
+    const bool watched = IsWatched(batch);
+    if (batch.IsClosed()) {
+      if (!watched) {
+        return true;
+      }
+    } else if (!watched) {
+      watched_batches_.push_back(&batch);
+      batch_to_watch_.notify_all();
+    }
+    if (batch.num_tasks() > num_tasks) {
+      return false;
+    }
+    tasks_or_close_.wait(l);
+  }
+}
+
+template <typename TaskType>
+Status OpenBatchWatcher<TaskType>::VisitTasksUntilClosed(
+    const Batch<TaskType>& batch,
+    const std::function<Status(const TaskType& task)>& visit) {
+  int num_visited_tasks = 0;
+  bool closed = false;
+  for (;;) {
+    // Once the batch is closed, the tasks seen afterwards are all of them.
+    const int num_tasks = batch.num_tasks();
+    for (; num_visited_tasks < num_tasks; ++num_visited_tasks) {
+      const Status status = visit(batch.task(num_visited_tasks));
+      if (!status.ok()) {
+        while (!closed) {
+          closed =
+              WaitForTasksOrClose(batch, std::numeric_limits<int>::max());
+        }
+        return status;
+      }
+    }
+    if (closed) {
+      return Status::OK();
+    }
+    closed = WaitForTasksOrClose(batch, num_visited_tasks);
+  }
+}
+
+template <typename TaskType>
+void OpenBatchWatcher<TaskType>::WatchBatches() {
+  for (;;) {
+    const Batch<TaskType>* batch;
+    {
+      mutex_lock l(mu_);
+      while (!stopping_ && watched_batches_.empty()) {
+        batch_to_watch_.wait(l);
+      }
+      if (watched_batches_.empty()) {
+        return;
+      }
+      batch = watched_batches_.front();
+    }
+    batch->WaitUntilClosed();
+    {
+      mutex_lock l(mu_);
+      watched_batches_.pop_front();
+    }
+    tasks_or_close_.notify_all();
+  }
+}
+
+template <typename TaskType>
+bool OpenBatchWatcher<TaskType>::IsWatched(const Batch<TaskType>& batch) const {
+  return std::find(watched_batches_.begin(), watched_batches_.end(), &batch) !=
+         watched_batches_.end();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_BATCHING_OPEN_BATCH_WATCHER_H_
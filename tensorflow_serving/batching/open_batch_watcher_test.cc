@@ -0,0 +1,175 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/open_batch_watcher.h"
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+class FakeTask : public BatchTask {
+ public:
+  FakeTask() = default;
+  ~FakeTask() override = default;
+
+  size_t size() const override { return 1; }
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(FakeTask);
+};
+
+TEST(OpenBatchWatcherTest, WakesUpOnScheduledTask) {
+  OpenBatchWatcher<FakeTask> watcher;
+  Batch<FakeTask> batch;
+  Notification woken_up;
+  bool closed = true;
+  std::unique_ptr<Thread> batch_thread(Env::Default()->StartThread(
+      ThreadOptions(), "batch_thread", [&] {
+        closed = watcher.WaitForTasksOrClose(batch, 0);
+        woken_up.Notify();
+      }));
+
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  watcher.TaskScheduled();
+  woken_up.WaitForNotification();
+  EXPECT_FALSE(closed);
+  EXPECT_FALSE(batch.IsClosed());
+
+  batch.Close();
+  EXPECT_TRUE(watcher.WaitForTasksOrClose(batch, 1));
+}
+
+TEST(OpenBatchWatcherTest, WakesUpOnClose) {
+  OpenBatchWatcher<FakeTask> watcher;
+  Batch<FakeTask> batch;
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  Notification woken_up;
+  bool closed = false;
+  std::unique_ptr<Thread> batch_thread(Env::Default()->StartThread(
+      ThreadOptions(), "batch_thread", [&] {
+        closed = watcher.WaitForTasksOrClose(batch, 1);
+        woken_up.Notify();
+      }));
+
+  // Closing the batch is the only signal; no task is scheduled.
+  batch.Close();
+  woken_up.WaitForNotification();
+  EXPECT_TRUE(closed);
+}
+
+TEST(OpenBatchWatcherTest, ReturnsAtOnceForClosedBatch) {
+  OpenBatchWatcher<FakeTask> watcher;
+  Batch<FakeTask> batch;
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  batch.Close();
+  EXPECT_TRUE(watcher.WaitForTasksOrClose(batch, 0));
+  EXPECT_TRUE(watcher.WaitForTasksOrClose(batch, 1));
+}
+
+TEST(OpenBatchWatcherTest, WatchesSuccessiveBatches) {
+  OpenBatchWatcher<FakeTask> watcher;
+  for (int i = 0; i < 3; ++i) {
+    Batch<FakeTask> batch;
+    Notification woken_up;
+    std::unique_ptr<Thread> batch_thread(Env::Default()->StartThread(
+        ThreadOptions(), "batch_thread", [&] {
+          while (!watcher.WaitForTasksOrClose(batch, batch.num_tasks())) {
+          }
+          woken_up.Notify();
+        }));
+    batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+    watcher.TaskScheduled();
+    batch.Close();
+    woken_up.WaitForNotification();
+  }
+}
+
+TEST(OpenBatchWatcherTest, VisitsTasksBeforeClose) {
+  OpenBatchWatcher<FakeTask> watcher;
+  Batch<FakeTask> batch;
+  Notification first_task_visited;
+  Notification second_task_visited;
+  int num_visited_tasks = 0;
+  Status visit_status;
+  std::unique_ptr<Thread> batch_thread(Env::Default()->StartThread(
+      ThreadOptions(), "batch_thread", [&] {
+        visit_status = watcher.VisitTasksUntilClosed(
+            batch, [&](const FakeTask& task) {
+              if (++num_visited_tasks == 1) {
+                first_task_visited.Notify();
+              } else {
+                second_task_visited.Notify();
+              }
+              return Status::OK();
+            });
+      }));
+
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  watcher.TaskScheduled();
+  first_task_visited.WaitForNotification();
+  EXPECT_FALSE(batch.IsClosed());
+
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  watcher.TaskScheduled();
+  second_task_visited.WaitForNotification();
+  EXPECT_FALSE(batch.IsClosed());
+
+  batch.Close();
+  batch_thread.reset();
+  TF_EXPECT_OK(visit_status);
+  EXPECT_EQ(2, num_visited_tasks);
+}
+
+TEST(OpenBatchWatcherTest, VisitErrorWaitsForClose) {
+  OpenBatchWatcher<FakeTask> watcher;
+  Batch<FakeTask> batch;
+  Notification task_visited;
+  Notification visiting_done;
+  int num_visited_tasks = 0;
+  Status visit_status;
+  std::unique_ptr<Thread> batch_thread(Env::Default()->StartThread(
+      ThreadOptions(), "batch_thread", [&] {
+        visit_status = watcher.VisitTasksUntilClosed(
+            batch, [&](const FakeTask& task) {
+              ++num_visited_tasks;
+              task_visited.Notify();
+              return errors::InvalidArgument("bad task");
+            });
+        visiting_done.Notify();
+      }));
+
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  watcher.TaskScheduled();
+  task_visited.WaitForNotification();
+  // Later tasks are not visited.
+  batch.AddTask(std::unique_ptr<FakeTask>(new FakeTask));
+  watcher.TaskScheduled();
+  EXPECT_FALSE(visiting_done.HasBeenNotified());
+
+  batch.Close();
+  visiting_done.WaitForNotification();
+  EXPECT_EQ(error::INVALID_ARGUMENT, visit_status.code());
+  EXPECT_EQ(1, num_visited_tasks);
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -158,6 +158,8 @@ Status AspiredVersionsManager::Create(
       options.load_retry_interval_micros;
   basic_manager_options.flush_filesystem_caches =
       options.flush_filesystem_caches;
+  basic_manager_options.cache_serving_map_per_thread =
+      options.cache_serving_map_per_thread;
   basic_manager_options.servable_event_bus = options.servable_event_bus;
   basic_manager_options.pre_load_hook = std::move(options.pre_load_hook);
   std::unique_ptr<BasicManager> basic_manager;
@@ -129,6 +129,11 @@ class AspiredVersionsManager : public Manager,
     // concurrent load on another thread.)
     bool flush_filesystem_caches = false;
 
+    /// If true, each thread which gets servable handles caches a snapshot of
+    /// the servables which are ready to be served, and refreshes it only once
+    /// they change. See BasicManager::Options::cache_serving_map_per_thread.
+    bool cache_serving_map_per_thread = false;
+
     /// The environment to use for starting threads in the thread-pool or for
     /// sleeping.
     Env* env = Env::Default();
@@ -69,12 +69,14 @@ constexpr char kServableName[] = "kServableName";
 //    state.RunBenchmark(42 /* iters */, 5 /* num_threads */);
 class BenchmarkState {
  public:
-  BenchmarkState(const int interval_micros, const bool do_work)
+  BenchmarkState(const int interval_micros, const bool do_work,
+                 const bool cache_serving_map_per_thread)
       : interval_micros_(interval_micros), do_work_(do_work) {
     AspiredVersionsManager::Options options;
     // Do policy thread won't be run automatically.
     options.manage_state_interval_micros = -1;
     options.aspired_version_policy.reset(new AvailabilityPreservingPolicy());
+    options.cache_serving_map_per_thread = cache_serving_map_per_thread;
     TF_CHECK_OK(AspiredVersionsManager::Create(std::move(options), &manager_));
   }
 
@@ -231,29 +233,40 @@ void BenchmarkState::RunBenchmark(int iters, int num_threads) {
 }
 
 static void BenchmarkReadsAndUpdates(int iters, int num_threads,
-                                     int interval_micros, bool do_work) {
-  BenchmarkState state(interval_micros, do_work);
+                                     int interval_micros, bool do_work,
+                                     bool cache_serving_map_per_thread) {
+  BenchmarkState state(interval_micros, do_work, cache_serving_map_per_thread);
   state.RunBenchmark(iters, num_threads);
 }
 
 static void BM_Work_NoUpdates_Reads(int iters, int num_threads) {
   // No updates. 0 interval_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(iters, num_threads, 0, true);
+  BenchmarkReadsAndUpdates(iters, num_threads, 0, true, false);
 }
 
 static void BM_Work_FrequentUpdates_Reads(int iters, int num_threads) {
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(iters, num_threads, 1000, true);
+  BenchmarkReadsAndUpdates(iters, num_threads, 1000, true, false);
 }
 
 static void BM_NoWork_NoUpdates_Reads(int iters, int num_threads) {
   // No updates. 0 interval_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(iters, num_threads, 0, false);
+  BenchmarkReadsAndUpdates(iters, num_threads, 0, false, false);
 }
 
 static void BM_NoWork_FrequentUpdates_Reads(int iters, int num_threads) {
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(iters, num_threads, 1000, false);
+  BenchmarkReadsAndUpdates(iters, num_threads, 1000, false, false);
+}
+
+static void BM_NoWork_NoUpdates_CachedReads(int iters, int num_threads) {
+  // Reads from the serving map snapshot cached by each thread.
+  BenchmarkReadsAndUpdates(iters, num_threads, 0, false, true);
+}
+
+static void BM_NoWork_FrequentUpdates_CachedReads(int iters, int num_threads) {
+  // Each update makes every thread refresh its cached snapshot.
+  BenchmarkReadsAndUpdates(iters, num_threads, 1000, false, true);
 }
 
 BENCHMARK(BM_Work_NoUpdates_Reads)
@@ -292,6 +305,24 @@ BENCHMARK(BM_NoWork_FrequentUpdates_Reads)
     ->Arg(32)
     ->Arg(64);
 
+BENCHMARK(BM_NoWork_NoUpdates_CachedReads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
+BENCHMARK(BM_NoWork_FrequentUpdates_CachedReads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
 static void BM_GetServableHandle(const int iters) {
   testing::StopTiming();
 
@@ -368,6 +399,49 @@ static void BM_GetServableHandle(const int iters) {
 }
 BENCHMARK(BM_GetServableHandle);
 
+// Benchmarks loading 'num_servable_streams' servable streams, of one version
+// each, into an empty manager, as happens at startup. Each load updates the
+// serving map.
+static void BM_LoadServableStreams(const int iters,
+                                   const int num_servable_streams) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_servable_streams);
+  for (int i = 0; i < iters; ++i) {
+    AspiredVersionsManager::Options options;
+    // Do policy thread won't be run automatically.
+    options.manage_state_interval_micros = -1;
+    options.aspired_version_policy.reset(new AvailabilityPreservingPolicy());
+    std::unique_ptr<AspiredVersionsManager> manager;
+    TF_CHECK_OK(AspiredVersionsManager::Create(std::move(options), &manager));
+    auto aspired_versions_callback = manager->GetAspiredVersionsCallback();
+    for (int j = 0; j < num_servable_streams; ++j) {
+      std::unique_ptr<Loader> loader(new SimpleLoader<int64>(
+          [j](std::unique_ptr<int64>* const servable) {
+            servable->reset(new int64);
+            **servable = j;
+            return Status::OK();
+          },
+          SimpleLoader<int64>::EstimateNoResources()));
+      const string servable_name = strings::StrCat(kServableName, j);
+      std::vector<ServableData<std::unique_ptr<Loader>>> versions;
+      versions.push_back({{servable_name, 0}, std::move(loader)});
+      aspired_versions_callback(servable_name, std::move(versions));
+    }
+    test_util::AspiredVersionsManagerTestAccess manager_test_access(
+        manager.get());
+    manager_test_access.HandlePendingAspiredVersionsRequests();
+
+    testing::StartTiming();
+    for (int j = 0; j < num_servable_streams; ++j) {
+      manager_test_access.InvokePolicyAndExecuteAction();
+    }
+    testing::StopTiming();
+
+    CHECK_EQ(num_servable_streams, manager->ListAvailableServableIds().size());
+  }
+}
+BENCHMARK(BM_LoadServableStreams)->Arg(100)->Arg(1000)->Arg(4000);
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -0,0 +1,122 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/async_metric_collector.h"
+
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+
+AsyncMetricCollector::AsyncMetricCollector(
+    const Options& options, std::unique_ptr<MetricCollector> wrapped_collector)
+    : options_(options),
+      wrapped_collector_(std::move(wrapped_collector)),
+      queue_(options.queue_capacity) {
+  flush_thread_.reset(options_.env->StartThread(
+      {}, "AsyncMetricCollector_flush_thread", [this]() { FlushLoop(); }));
+}
+
+AsyncMetricCollector::~AsyncMetricCollector() {
+  stop_.Notify();
+  // Destroying the thread joins it.
+  flush_thread_ = nullptr;
+  while (FlushBatch() > 0) {
+  }
+}
+
+Status AsyncMetricCollector::PublishMetric(Metric* const metric) {
+  std::unique_ptr<Metric> copy = metric->Clone();
+  if (queue_.TryPush(std::move(copy))) {
+    return Status::OK();
+  }
+  if (options_.overflow_policy == OverflowPolicy::kDrop) {
+    num_dropped_metrics_.fetch_add(1, std::memory_order_relaxed);
+    return errors::ResourceExhausted("Metric queue is full; dropped metric");
+  }
+  mutex_lock l(queue_not_full_mu_);
+  num_waiting_callers_.fetch_add(1);
+  // Pairs with the fence in FlushBatch(): either the background thread sees
+  // this caller waiting, or the retry below sees the room it made.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!queue_.TryPush(std::move(copy))) {
+    queue_not_full_.wait(l);
+  }
+  num_waiting_callers_.fetch_sub(1);
+  return Status::OK();
+}
+
+int64 AsyncMetricCollector::FlushBatch() {
+  std::vector<std::unique_ptr<Metric>> batch;
+  std::unique_ptr<Metric> metric;
+  while (static_cast<int64>(batch.size()) < options_.max_batch_size &&
+         queue_.TryPop(&metric)) {
+    batch.push_back(std::move(metric));
+  }
+  if (batch.empty()) {
+    return 0;
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_waiting_callers_.load() > 0) {
+    mutex_lock l(queue_not_full_mu_);
+    queue_not_full_.notify_all();
+  }
+  std::vector<Metric*> batch_ptrs;
+  batch_ptrs.reserve(batch.size());
+  for (const std::unique_ptr<Metric>& batch_metric : batch) {
+    batch_ptrs.push_back(batch_metric.get());
+  }
+  const Status status = wrapped_collector_->PublishMetrics(batch_ptrs);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to publish metrics: " << status;
+  }
+  return batch.size();
+}
+
+void AsyncMetricCollector::ReportDroppedMetrics() {
+  const uint64 num_dropped_metrics = this->num_dropped_metrics();
+  if (num_dropped_metrics == num_reported_dropped_metrics_) {
+    return;
+  }
+  const uint64 now_micros = options_.env->NowMicros();
+  if (now_micros - last_drop_report_micros_ <
+      static_cast<uint64>(options_.flush_interval_micros)) {
+    return;
+  }
+  LOG(WARNING) << "Dropped "
+               << num_dropped_metrics - num_reported_dropped_metrics_
+               << " metrics because the metric queue was full.";
+  num_reported_dropped_metrics_ = num_dropped_metrics;
+  last_drop_report_micros_ = now_micros;
+}
+
+void AsyncMetricCollector::FlushLoop() {
+  while (!stop_.HasBeenNotified()) {
+    const int64 num_published = FlushBatch();
+    // Drops are reported even if the queue never drains, which is when they
+    // keep happening.
+    ReportDroppedMetrics();
+    if (num_published == 0) {
+      WaitForNotificationWithTimeout(&stop_, options_.flush_interval_micros);
+    }
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,125 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_ASYNC_METRIC_COLLECTOR_H_
+#define TENSORFLOW_SERVING_CORE_ASYNC_METRIC_COLLECTOR_H_
+
+#include <atomic>
+#include <memory>
+
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/metrics_collector.h"
+#include "tensorflow_serving/util/mpsc_ring_buffer.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A MetricCollector decorator which takes publishing off the calling thread:
+// PublishMetric() only copies the metric into a bounded lock-free queue, and a
+// background thread hands the queued metrics over to the wrapped collector in
+// batches (see MetricCollector::PublishMetrics()).
+//
+// Slow publishing (e.g. syslog back-pressure) thus no longer adds to request
+// latency. If the wrapped collector can't keep up and the queue fills up,
+// metrics are either dropped (and counted) or the callers wait for room, as
+// per the overflow policy.
+class AsyncMetricCollector : public MetricCollector {
+ public:
+  // What PublishMetric() does when the queue is full.
+  enum class OverflowPolicy {
+    // Drop the metric, and count it in num_dropped_metrics().
+    kDrop,
+    // Wait until the background thread makes room.
+    kBlock,
+  };
+
+  struct Options {
+    // Maximum number of queued metrics. Must be a power of two.
+    int64 queue_capacity = 4096;
+
+    // Maximum number of metrics handed over to the wrapped collector at once.
+    int64 max_batch_size = 256;
+
+    // How long the background thread sleeps when there is nothing to publish.
+    // Also the minimum interval between two warnings about dropped metrics.
+    int64 flush_interval_micros = 100 * 1000 /* 100 milliseconds */;
+
+    OverflowPolicy overflow_policy = OverflowPolicy::kBlock;
+
+    // The environment used to run the background thread.
+    Env* env = Env::Default();
+  };
+
+  AsyncMetricCollector(const Options& options,
+                       std::unique_ptr<MetricCollector> wrapped_collector);
+
+  // Stops the background thread after publishing the metrics still queued.
+  ~AsyncMetricCollector() override;
+
+  // Queues a copy of 'metric'. Returns an error iff the metric was dropped.
+  Status PublishMetric(Metric* metric) override;
+
+  // Total number of metrics dropped because the queue was full.
+  uint64 num_dropped_metrics() const {
+    return num_dropped_metrics_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Runs on the background thread until 'stop_' is notified.
+  void FlushLoop();
+
+  // Publishes up to 'max_batch_size' queued metrics with the wrapped collector.
+  // Returns the number of metrics published. Must only be called by one thread
+  // at a time.
+  int64 FlushBatch();
+
+  // Logs the number of metrics dropped since the last call which logged any,
+  // unless that call was less than 'flush_interval_micros' ago.
+  void ReportDroppedMetrics();
+
+  const Options options_;
+  const std::unique_ptr<MetricCollector> wrapped_collector_;
+
+  MpscRingBuffer<std::unique_ptr<Metric>> queue_;
+
+  std::atomic<uint64> num_dropped_metrics_{0};
+  // The value of 'num_dropped_metrics_' when the background thread last
+  // reported it, and when it did.
+  uint64 num_reported_dropped_metrics_ = 0;
+  uint64 last_drop_report_micros_ = 0;
+
+  // The callers of PublishMetric() waiting for room in the queue, as per
+  // OverflowPolicy::kBlock, wait on 'queue_not_full_'. 'num_waiting_callers_'
+  // spares the background thread the lock when there are none.
+  mutex queue_not_full_mu_;
+  condition_variable queue_not_full_;
+  std::atomic<int64> num_waiting_callers_{0};
+
+  Notification stop_;
+  std::unique_ptr<Thread> flush_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncMetricCollector);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_ASYNC_METRIC_COLLECTOR_H_
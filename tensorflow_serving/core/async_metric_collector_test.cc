@@ -0,0 +1,171 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/async_metric_collector.h"
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// The model names of the metrics published to a FakeMetricCollector, which
+// outlive the collector.
+class PublishedModelNames {
+ public:
+  void Add(const string& model_name) {
+    mutex_lock l(mu_);
+    model_names_.push_back(model_name);
+  }
+
+  std::vector<string> Get() const {
+    mutex_lock l(mu_);
+    return model_names_;
+  }
+
+ private:
+  mutable mutex mu_;
+  std::vector<string> model_names_ GUARDED_BY(mu_);
+};
+
+// Records the model names of the published metrics, optionally blocking until
+// 'unblock' is notified.
+class FakeMetricCollector : public MetricCollector {
+ public:
+  explicit FakeMetricCollector(PublishedModelNames* published,
+                               Notification* unblock = nullptr)
+      : published_(published), unblock_(unblock) {}
+
+  Status PublishMetric(Metric* metric) override {
+    if (unblock_ != nullptr) {
+      unblock_->WaitForNotification();
+    }
+    published_->Add(metric->model_name_);
+    return Status::OK();
+  }
+
+ private:
+  PublishedModelNames* const published_;
+  Notification* const unblock_;
+};
+
+MetricCollector::PredictMetric CreateMetric(const string& model_name) {
+  return {"PredictMetric", 0, 10, model_name, 1, true};
+}
+
+TEST(AsyncMetricCollectorTest, PublishesInOrder) {
+  PublishedModelNames published;
+  AsyncMetricCollector::Options options;
+  options.max_batch_size = 2;
+  options.flush_interval_micros = 1000;
+  AsyncMetricCollector collector(
+      options, std::unique_ptr<MetricCollector>(
+                   new FakeMetricCollector(&published)));
+  for (const char* model_name : {"a", "b", "c", "d", "e"}) {
+    MetricCollector::PredictMetric metric = CreateMetric(model_name);
+    TF_EXPECT_OK(collector.PublishMetric(&metric));
+  }
+  while (published.Get().size() < 5) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_EQ((std::vector<string>{"a", "b", "c", "d", "e"}), published.Get());
+  EXPECT_EQ(0, collector.num_dropped_metrics());
+}
+
+TEST(AsyncMetricCollectorTest, FlushesOnDestruction) {
+  PublishedModelNames published;
+  {
+    AsyncMetricCollector::Options options;
+    // Long enough for the background thread not to pick up the metrics.
+    options.flush_interval_micros = 60 * 1000 * 1000;
+    AsyncMetricCollector collector(
+        options, std::unique_ptr<MetricCollector>(
+                     new FakeMetricCollector(&published)));
+    for (const char* model_name : {"a", "b"}) {
+      MetricCollector::PredictMetric metric = CreateMetric(model_name);
+      TF_EXPECT_OK(collector.PublishMetric(&metric));
+    }
+  }
+  EXPECT_EQ((std::vector<string>{"a", "b"}), published.Get());
+}
+
+TEST(AsyncMetricCollectorTest, DropsOnOverflow) {
+  PublishedModelNames published;
+  Notification unblock;
+  AsyncMetricCollector::Options options;
+  options.queue_capacity = 2;
+  options.max_batch_size = 1;
+  options.flush_interval_micros = 1000;
+  options.overflow_policy = AsyncMetricCollector::OverflowPolicy::kDrop;
+  AsyncMetricCollector collector(
+      options, std::unique_ptr<MetricCollector>(
+                   new FakeMetricCollector(&published, &unblock)));
+
+  // The background thread takes at most one metric and blocks publishing it,
+  // so with two slots in the queue, at most three metrics fit.
+  uint64 num_dropped = 0;
+  for (int i = 0; i < 10; ++i) {
+    MetricCollector::PredictMetric metric = CreateMetric("a");
+    if (!collector.PublishMetric(&metric).ok()) {
+      ++num_dropped;
+    }
+  }
+  EXPECT_GE(num_dropped, 7);
+  EXPECT_EQ(num_dropped, collector.num_dropped_metrics());
+
+  unblock.Notify();
+}
+
+TEST(AsyncMetricCollectorTest, BlocksOnOverflow) {
+  PublishedModelNames published;
+  Notification unblock;
+  AsyncMetricCollector::Options options;
+  options.queue_capacity = 2;
+  options.max_batch_size = 1;
+  options.flush_interval_micros = 1000;
+  options.overflow_policy = AsyncMetricCollector::OverflowPolicy::kBlock;
+  AsyncMetricCollector collector(
+      options, std::unique_ptr<MetricCollector>(
+                   new FakeMetricCollector(&published, &unblock)));
+
+  // At most three metrics fit while the background thread is blocked, so the
+  // publishing thread waits until it is unblocked.
+  constexpr int kNumMetrics = 10;
+  Notification all_published;
+  std::unique_ptr<Thread> publish_thread(
+      Env::Default()->StartThread({}, "PublishThread", [&]() {
+        for (int i = 0; i < kNumMetrics; ++i) {
+          MetricCollector::PredictMetric metric = CreateMetric("a");
+          TF_EXPECT_OK(collector.PublishMetric(&metric));
+        }
+        all_published.Notify();
+      }));
+  EXPECT_FALSE(WaitForNotificationWithTimeout(&all_published,
+                                              10 * 1000 /* 10 ms */));
+  unblock.Notify();
+  all_published.WaitForNotification();
+  while (published.Get().size() < kNumMetrics) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_EQ(0, collector.num_dropped_metrics());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
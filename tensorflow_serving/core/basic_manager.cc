@@ -16,21 +16,24 @@ limitations under the License.
 #include "tensorflow_serving/core/basic_manager.h"
 
 #include <algorithm>
+#include <atomic>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <set>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow_serving/core/servable_handle.h"
 #include "tensorflow_serving/core/source.h"
 #include "tensorflow_serving/util/cleanup.h"
-#include "tensorflow_serving/util/hash.h"
 #include "tensorflow_serving/util/inline_executor.h"
 #include "tensorflow_serving/util/retrier.h"
 #include "tensorflow_serving/util/threadpool_executor.h"
@@ -52,63 +55,129 @@ std::unique_ptr<Executor> CreateExecutor(Env* const env,
   return executor;
 }
 
-}  // namespace
+// Tracks the servables which the BasicManagers of the process removed from
+// their serving maps but are still referenced, and exports the age of the
+// oldest. Each retirement time is kept along with the Env of its manager,
+// whose clock it is measured against.
+class RetiredServables {
+ public:
+  static RetiredServables* Get() {
+    static RetiredServables* const retired_servables = new RetiredServables();
+    return retired_servables;
+  }
 
-struct BasicManager::ServingMap::EqRequest {
-  bool operator()(const ServableRequest& lhs,
-                  const ServableRequest& rhs) const {
-    if (lhs.version != rhs.version) {
-      return false;
-    }
-    // Even if there is a small probability that version checking can eliminate
-    // string checking, we should do that since O(string_equality) >>
-    // O(version_equality)
-    if (lhs.name != rhs.name) {
-      return false;
-    }
-    return true;
+  void Add(Env* const env, const uint64 retired_micros) {
+    mutex_lock l(mu_);
+    retired_micros_.insert({env, retired_micros});
+  }
+
+  void Remove(Env* const env, const uint64 retired_micros) {
+    mutex_lock l(mu_);
+    retired_micros_.erase(retired_micros_.find({env, retired_micros}));
   }
-};
 
-struct BasicManager::ServingMap::HashRequest {
-  uint64 operator()(const ServableRequest& request) const {
-    // Hash codes for many common types are remarkably bad, often clustering
-    // around the same values of the low and/or high bits for linear
-    // sequences of inputs such as 1, 2, 3; or addresses of consecutively
-    // allocated objects.  For these cases the default hash function is the
-    // identity function on the bit patterns.
-    //
-    // So we apply a one-to-one mapping to the resulting bit patterns to
-    // make the high bits contain more entropy from the entire hash code.
-    // It's based on Fibonacci hashing from Knuth's Art of Computer
-    // Programming volume 3, section 6.4.
-    const uint64 version_hash = [&]() -> uint64 {
-      if (request.version) {
-        return std::hash<int64>()(request.version.value()) *
-               0x9E3779B97F4A7C13;  // (sqrt(5) - 1)/2 as a binary fraction.
-      } else {
-        return 0xDECAFCAFFE;
+ private:
+  RetiredServables()
+      : metric_def_("/tensorflow/serving/oldest_retired_servable_age_micros",
+                    "The age of the oldest servable which was removed from a "
+                    "serving map but is still referenced by servable handles, "
+                    "or 0."),
+        registration_(monitoring::CollectionRegistry::Default()->Register(
+            &metric_def_, [this](monitoring::MetricCollectorGetter getter) {
+              auto collector = getter.Get(&metric_def_);
+              collector.CollectValue({}, OldestAgeMicros());
+            })) {}
+
+  int64 OldestAgeMicros() {
+    mutex_lock l(mu_);
+    // The first entry of each Env is the oldest measured against its clock.
+    uint64 oldest_age_micros = 0;
+    for (auto it = retired_micros_.begin(); it != retired_micros_.end();
+         it = retired_micros_.upper_bound(
+             {it->first, std::numeric_limits<uint64>::max()})) {
+      const uint64 now_micros = it->first->NowMicros();
+      if (now_micros > it->second) {
+        oldest_age_micros =
+            std::max(oldest_age_micros, now_micros - it->second);
       }
-    }();
-    // Using version_hash as the seed here to combine the hashes.
-    return HashCombine(version_hash, std::hash<string>()(request.name));
+    }
+    return oldest_age_micros;
   }
+
+  mutex mu_;
+  std::multiset<std::pair<Env*, uint64>> retired_micros_ GUARDED_BY(mu_);
+
+  const monitoring::MetricDef<monitoring::MetricKind::kGauge, int64, 0>
+      metric_def_;
+  std::unique_ptr<monitoring::CollectionRegistry::RegistrationHandle>
+      registration_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RetiredServables);
 };
 
-BasicManager::ServingMap::ServingMap()
-    : handles_map_(std::unique_ptr<HandlesMap>(new HandlesMap())) {}
+}  // namespace
+
+BasicManager::ServingMap::ServingMap(Env* const env,
+                                     const bool cache_per_thread)
+    : env_(env), cache_per_thread_(cache_per_thread), instance_id_([]() {
+        static std::atomic<uint64> next_instance_id{0};
+        return next_instance_id++;
+      }()) {
+  Publish(std::unique_ptr<HandlesMap>(new HandlesMap()), {});
+}
+
+BasicManager::ServingMap::~ServingMap() {
+  DropThreadSnapshots();
+  {
+    mutex_lock l(thread_caches_mu_);
+    for (const auto& thread_cache : thread_caches_) {
+      thread_cache->orphaned = true;
+    }
+  }
+  std::shared_ptr<const HandlesMap> handles_map;
+  {
+    mutex_lock l(mu_);
+    handles_map.swap(handles_map_);
+  }
+  // Releasing the current map may release its entries, which takes the lock.
+  handles_map.reset();
+  mutex_lock l(mu_);
+  while (!unreleased_servables_.empty()) {
+    servable_released_.wait(l);
+  }
+}
+
+int BasicManager::ServingMap::GetShardIndex(const string& servable_name) {
+  return std::hash<string>()(servable_name) % kNumHandlesShards;
+}
+
+const BasicManager::ServingMap::StreamHandles*
+BasicManager::ServingMap::FindStream(const HandlesMap& handles_map,
+                                     const string& servable_name) {
+  const HandlesShard* const shard =
+      handles_map.shards[GetShardIndex(servable_name)].get();
+  if (shard == nullptr) {
+    return nullptr;
+  }
+  const auto found_it = shard->find(servable_name);
+  return found_it == shard->end() ? nullptr : found_it->second.get();
+}
 
 std::vector<ServableId> BasicManager::ServingMap::ListAvailableServableIds()
     const {
   std::vector<ServableId> ids;
-  std::shared_ptr<const HandlesMap> handles_map = handles_map_.get();
-  for (auto iter = handles_map->begin(); iter != handles_map->end();) {
-    // We get the iterator where all the values for a particular key ends.
-    const auto key_end = handles_map->equal_range(iter->first).second;
-
-    for (; iter != key_end; ++iter) {
-      if (iter->first.version) {
-        ids.push_back(iter->second->id());
+  std::shared_ptr<const HandlesMap> handles_map;
+  {
+    mutex_lock l(mu_);
+    handles_map = handles_map_;
+  }
+  for (const auto& shard : handles_map->shards) {
+    if (shard == nullptr) {
+      continue;
+    }
+    for (const auto& stream : *shard) {
+      for (const auto& entry : *stream.second) {
+        ids.push_back(entry->harness->id());
       }
     }
   }
@@ -118,86 +187,347 @@ std::vector<ServableId> BasicManager::ServingMap::ListAvailableServableIds()
 Status BasicManager::ServingMap::GetUntypedServableHandle(
     const ServableRequest& request,
     std::unique_ptr<UntypedServableHandle>* const untyped_handle) {
-  std::shared_ptr<const HandlesMap> handles_map = handles_map_.get();
-  const auto found_it = handles_map->find(request);
-  if (found_it == handles_map->end()) {
+  // The map is only held while looking the servable up, either through the
+  // snapshot of the calling thread, if it caches one, or directly.
+  std::shared_ptr<const Snapshot> snapshot;
+  std::shared_ptr<const HandlesMap> handles_map;
+  if (cache_per_thread_) {
+    snapshot = GetThreadSnapshot();
+    handles_map = snapshot->handles_map;
+  } else {
+    mutex_lock l(mu_);
+    handles_map = handles_map_;
+  }
+  const std::shared_ptr<const ServableEntry>* found_entry = nullptr;
+  const StreamHandles* const stream = FindStream(*handles_map, request.name);
+  if (stream != nullptr) {
+    if (!request.version) {
+      found_entry = &stream->back();
+    } else {
+      const int64 version = request.version.value();
+      const auto found_it = std::lower_bound(
+          stream->begin(), stream->end(), version,
+          [](const std::shared_ptr<const ServableEntry>& entry,
+             const int64 version) {
+            return entry->harness->id().version < version;
+          });
+      if (found_it != stream->end() &&
+          (*found_it)->harness->id().version == version) {
+        found_entry = &*found_it;
+      }
+    }
+  }
+  if (found_entry == nullptr) {
     return errors::NotFound("Servable not found for request: ",
                             request.DebugString());
   }
 
-  const LoaderHarness& harness = *found_it->second;
+  // The handle is counted on the entry, through a reference only the snapshot
+  // hands out if the calling thread caches one.
+  std::shared_ptr<const ServableEntry> entry_ref = *found_entry;
+  if (snapshot != nullptr) {
+    std::shared_ptr<const ServableEntry>& snapshot_entry_ref =
+        snapshot->entry_refs[entry_ref.get()];
+    if (snapshot_entry_ref == nullptr) {
+      snapshot_entry_ref = std::shared_ptr<const ServableEntry>(
+          std::make_shared<std::shared_ptr<const ServableEntry>>(entry_ref),
+          entry_ref.get());
+    }
+    entry_ref = snapshot_entry_ref;
+  }
+  const LoaderHarness& harness = *entry_ref->harness;
   // We use the aliasing constructor of shared_ptr here. So even though we are
   // returning a shared_ptr to servable, the ref-counting is happening on the
-  // handles_map. This delays the map destruction till the last handle from the
-  // previous map is freed, when we are doing handles_map updates.
+  // entry of the servable. This delays its release, which its unload waits
+  // for, till the last handle to it is freed.
   untyped_handle->reset(new SharedPtrHandle(
-      harness.id(), std::shared_ptr<Loader>(handles_map, harness.loader())));
+      harness.id(), std::shared_ptr<Loader>(entry_ref, harness.loader())));
   return Status::OK();
 }
 
 std::map<ServableId, std::unique_ptr<UntypedServableHandle>>
 BasicManager::ServingMap::GetAvailableUntypedServableHandles() const {
   std::map<ServableId, std::unique_ptr<UntypedServableHandle>> result;
-  std::shared_ptr<const HandlesMap> handles_map = handles_map_.get();
-  for (const auto& handle : *handles_map) {
-    const ServableRequest& request = handle.first;
-    // If the entry is the one for the latest request, skip it. We would already
-    // get it from the entry which has the specific request.
-    if (!request.version) {
+  std::shared_ptr<const HandlesMap> handles_map;
+  {
+    mutex_lock l(mu_);
+    handles_map = handles_map_;
+  }
+  for (const auto& shard : handles_map->shards) {
+    if (shard == nullptr) {
       continue;
     }
-    const LoaderHarness& harness = *handle.second;
-    result.emplace(harness.id(),
-                   std::unique_ptr<UntypedServableHandle>(new SharedPtrHandle(
-                       harness.id(), std::shared_ptr<Loader>(
-                                         handles_map, harness.loader()))));
+    for (const auto& stream : *shard) {
+      for (const auto& entry : *stream.second) {
+        result.emplace(
+            entry->harness->id(),
+            std::unique_ptr<UntypedServableHandle>(new SharedPtrHandle(
+                entry->harness->id(),
+                std::shared_ptr<Loader>(entry, entry->harness->loader()))));
+      }
+    }
   }
   return result;
 }
 
-void BasicManager::ServingMap::Update(const ManagedMap& managed_map) {
-  struct CompareRequests {
-    bool operator()(const ServableRequest& lhs,
-                    const ServableRequest& rhs) const {
-      const int strcmp_result = lhs.name.compare(rhs.name);
-      if (strcmp_result != 0) {
-        return strcmp_result < 0;
+void BasicManager::ServingMap::Update(const ManagedMap& managed_map,
+                                      const string& servable_name) {
+  std::vector<std::shared_ptr<const LoaderHarness>> ready_harnesses;
+  const auto range = managed_map.equal_range(servable_name);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (iter->second->state() == LoaderHarness::State::kReady) {
+      ready_harnesses.push_back(iter->second);
+    }
+  }
+  std::sort(ready_harnesses.begin(), ready_harnesses.end(),
+            [](const std::shared_ptr<const LoaderHarness>& lhs,
+               const std::shared_ptr<const LoaderHarness>& rhs) {
+              return lhs->id().version < rhs->id().version;
+            });
+
+  mutex_lock update_lock(update_mu_);
+  std::shared_ptr<const HandlesMap> handles_map;
+  {
+    mutex_lock l(mu_);
+    handles_map = handles_map_;
+  }
+
+  // Keep the entries of the servables of the stream which stay, so that their
+  // handles keep being counted on the same entries, and find out which
+  // servables come and go.
+  const StreamHandles* const old_stream =
+      FindStream(*handles_map, servable_name);
+  const auto find_entry = [old_stream](const LoaderHarness* harness) {
+    if (old_stream == nullptr) {
+      return std::shared_ptr<const ServableEntry>();
+    }
+    const auto found_it = std::find_if(
+        old_stream->begin(), old_stream->end(),
+        [harness](const std::shared_ptr<const ServableEntry>& entry) {
+          return entry->harness.get() == harness;
+        });
+    return found_it == old_stream->end() ? nullptr : *found_it;
+  };
+  std::unique_ptr<StreamHandles> new_stream(new StreamHandles());
+  bool added_any = false;
+  for (auto& harness : ready_harnesses) {
+    std::shared_ptr<const ServableEntry> entry = find_entry(harness.get());
+    if (entry == nullptr) {
+      entry = CreateEntry(std::move(harness));
+      added_any = true;
+    }
+    new_stream->push_back(std::move(entry));
+  }
+  std::vector<ServableId> removed_ids;
+  if (old_stream != nullptr) {
+    for (const auto& entry : *old_stream) {
+      if (std::find(new_stream->begin(), new_stream->end(), entry) ==
+          new_stream->end()) {
+        removed_ids.push_back(entry->harness->id());
       }
-      DCHECK(lhs.version);
-      DCHECK(rhs.version);
-      return lhs.version.value() < rhs.version.value();
     }
+  }
+  if (!added_any && removed_ids.empty()) {
+    return;
+  }
+
+  // Copy the shard of the stream only, and share everything else.
+  std::unique_ptr<HandlesMap> new_handles_map(new HandlesMap(*handles_map));
+  std::shared_ptr<const HandlesShard>& shard =
+      new_handles_map->shards[GetShardIndex(servable_name)];
+  std::unique_ptr<HandlesShard> new_shard(
+      shard == nullptr ? new HandlesShard() : new HandlesShard(*shard));
+  if (new_stream->empty()) {
+    new_shard->erase(servable_name);
+  } else {
+    (*new_shard)[servable_name] = std::move(new_stream);
+  }
+  if (new_shard->empty()) {
+    shard.reset();
+  } else {
+    shard = std::move(new_shard);
+  }
+
+  Publish(std::move(new_handles_map), removed_ids);
+}
+
+std::shared_ptr<const BasicManager::ServingMap::ServableEntry>
+BasicManager::ServingMap::CreateEntry(
+    std::shared_ptr<const LoaderHarness> harness) {
+  const ServableId id = harness->id();
+  {
+    mutex_lock l(mu_);
+    const bool inserted = unreleased_servables_.emplace(id, nullopt).second;
+    DCHECK(inserted) << "Servable " << id << " was not released yet";
+  }
+  return std::shared_ptr<const ServableEntry>(
+      new ServableEntry{std::move(harness)},
+      [this, id](const ServableEntry* entry) {
+        delete entry;
+        Release(id);
+      });
+}
+
+void BasicManager::ServingMap::Release(const ServableId& id) {
+  mutex_lock l(mu_);
+  const auto it = unreleased_servables_.find(id);
+  DCHECK(it != unreleased_servables_.end());
+  if (it->second) {
+    RetiredServables::Get()->Remove(env_, *it->second);
+  }
+  unreleased_servables_.erase(it);
+  servable_released_.notify_all();
+}
+
+void BasicManager::ServingMap::Publish(
+    std::unique_ptr<HandlesMap> handles_map,
+    const std::vector<ServableId>& removed_ids) {
+  std::shared_ptr<const HandlesMap> old_handles_map;
+  {
+    mutex_lock l(mu_);
+    // The entries of the removed servables are still alive, since the old map
+    // holds them.
+    const uint64 retired_micros = env_->NowMicros();
+    for (const ServableId& id : removed_ids) {
+      const auto found_it = unreleased_servables_.find(id);
+      DCHECK(found_it != unreleased_servables_.end());
+      found_it->second = retired_micros;
+      RetiredServables::Get()->Add(env_, retired_micros);
+    }
+    old_handles_map = std::move(handles_map_);
+    handles_map_ = std::move(handles_map);
+    current_generation_ = next_generation_++;
+  }
+  // Releasing the old map may release the entries of the removed servables,
+  // which takes the lock.
+  old_handles_map.reset();
+  // Snapshots of the old map mustn't hold up their release either.
+  DropThreadSnapshots();
+}
+
+std::unordered_map<
+    uint64, std::shared_ptr<BasicManager::ServingMap::ThreadCache>>*
+BasicManager::ServingMap::GetThreadCaches() {
+  // Gives up the caches of the thread when it exits.
+  struct ThreadCaches {
+    ~ThreadCaches() {
+      for (const auto& entry : caches) {
+        delete entry.second->snapshot.exchange(nullptr);
+        entry.second->in_use = false;
+      }
+    }
+
+    std::unordered_map<uint64, std::shared_ptr<ThreadCache>> caches;
   };
-  std::multimap<ServableRequest, std::shared_ptr<const LoaderHarness>,
-                CompareRequests>
-      sorted_available_map;
-  for (const auto& elem : managed_map) {
-    std::shared_ptr<const LoaderHarness> harness = elem.second;
-    if (harness->state() == LoaderHarness::State::kReady) {
-      sorted_available_map.emplace(ServableRequest::FromId(harness->id()),
-                                   harness);
+  static thread_local ThreadCaches thread_caches;
+  return &thread_caches.caches;
+}
+
+BasicManager::ServingMap::ThreadCache*
+BasicManager::ServingMap::GetThreadCache() {
+  std::unordered_map<uint64, std::shared_ptr<ThreadCache>>* const
+      thread_caches = GetThreadCaches();
+  const auto found_it = thread_caches->find(instance_id_);
+  if (found_it != thread_caches->end()) {
+    return found_it->second.get();
+  }
+
+  // Forget the caches of the ServingMaps which are gone.
+  for (auto it = thread_caches->begin(); it != thread_caches->end();) {
+    if (it->second->orphaned) {
+      it = thread_caches->erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  std::shared_ptr<ThreadCache> thread_cache;
+  {
+    mutex_lock l(thread_caches_mu_);
+    // Reuse the cache of a thread which has exited, if any.
+    for (const auto& unused_cache : thread_caches_) {
+      if (!unused_cache->in_use) {
+        thread_cache = unused_cache;
+        break;
+      }
+    }
+    if (thread_cache == nullptr) {
+      thread_cache = std::make_shared<ThreadCache>();
+      thread_caches_.push_back(thread_cache);
+    }
+    thread_cache->in_use = true;
+  }
+  thread_caches->emplace(instance_id_, thread_cache);
+  return thread_cache.get();
+}
+
+std::shared_ptr<const BasicManager::ServingMap::Snapshot>
+BasicManager::ServingMap::GetThreadSnapshot() {
+  ThreadCache* const thread_cache = GetThreadCache();
+  // Take the snapshot out of the cache while using it, so that
+  // DropThreadSnapshots() can't release it from under us.
+  std::unique_ptr<std::shared_ptr<const Snapshot>> cached_snapshot(
+      thread_cache->snapshot.exchange(nullptr));
+  if (cached_snapshot == nullptr ||
+      (*cached_snapshot)->generation != current_generation_) {
+    // Releasing a stale snapshot may reclaim its map, which takes the lock.
+    cached_snapshot.reset();
+    std::unique_ptr<Snapshot> snapshot(new Snapshot());
+    {
+      mutex_lock l(mu_);
+      snapshot->generation = current_generation_;
+      snapshot->handles_map = handles_map_;
     }
+    cached_snapshot.reset(
+        new std::shared_ptr<const Snapshot>(std::move(snapshot)));
   }
+  std::shared_ptr<const Snapshot> snapshot = *cached_snapshot;
+  thread_cache->snapshot = cached_snapshot.release();
+  // A map published since the snapshot was taken out may have missed it, in
+  // which case it is dropped here instead. Either this load or the one in
+  // DropThreadSnapshots() sees the other's store.
+  if (current_generation_ != snapshot->generation) {
+    delete thread_cache->snapshot.exchange(nullptr);
+  }
+  return snapshot;
+}
 
-  std::unique_ptr<HandlesMap> new_handles_map(new HandlesMap());
-  for (auto iter = sorted_available_map.begin();
-       iter != sorted_available_map.end(); ++iter) {
-    std::shared_ptr<const LoaderHarness> harness = iter->second;
-    new_handles_map->emplace(ServableRequest::FromId(harness->id()), harness);
-    // If this is the last harness in the stream, add it again to the
-    // handles_map, marking it as the latest for that stream.
-    const auto next_iter = std::next(iter);
-    if (next_iter == sorted_available_map.end() ||
-        next_iter->second->id().name != harness->id().name) {
-      const ServableRequest latest_request =
-          ServableRequest::Latest(harness->id().name);
-      new_handles_map->emplace(latest_request, harness);
+void BasicManager::ServingMap::DropThreadSnapshots() {
+  if (!cache_per_thread_) {
+    return;
+  }
+  std::vector<std::unique_ptr<std::shared_ptr<const Snapshot>>> snapshots;
+  {
+    mutex_lock l(thread_caches_mu_);
+    for (const auto& thread_cache : thread_caches_) {
+      snapshots.emplace_back(thread_cache->snapshot.exchange(nullptr));
     }
   }
+  // Releasing the snapshots may reclaim their maps, which takes the lock.
+  snapshots.clear();
+}
+
+void BasicManager::ServingMap::WaitUntilReleased(const ServableId& id) {
+  mutex_lock l(mu_);
+  while (unreleased_servables_.count(id) != 0) {
+    servable_released_.wait(l);
+  }
+}
 
-  // This blocks until the last handle given out by the old handles map is
-  // freed.
-  handles_map_.Update(std::move(new_handles_map));
+int64 BasicManager::ServingMap::OldestRetiredServableAgeMicros() const {
+  mutex_lock l(mu_);
+  optional<uint64> oldest_micros;
+  for (const auto& servable : unreleased_servables_) {
+    if (servable.second &&
+        (!oldest_micros || *servable.second < *oldest_micros)) {
+      oldest_micros = servable.second;
+    }
+  }
+  if (!oldest_micros) {
+    return 0;
+  }
+  const uint64 now_micros = env_->NowMicros();
+  return now_micros > *oldest_micros ? now_micros - *oldest_micros : 0;
 }
 
 Status BasicManager::Create(Options options,
@@ -205,7 +535,8 @@ Status BasicManager::Create(Options options,
   manager->reset(new BasicManager(
       options.env, options.num_load_threads, options.num_unload_threads,
       options.max_num_load_retries, options.load_retry_interval_micros,
-      options.flush_filesystem_caches, std::move(options.resource_tracker),
+      options.flush_filesystem_caches, options.cache_serving_map_per_thread,
+      std::move(options.resource_tracker),
       options.servable_event_bus, std::move(options.pre_load_hook)));
   return Status::OK();
 }
@@ -215,10 +546,12 @@ BasicManager::BasicManager(Env* const env, const uint32 num_load_threads,
                            uint32 max_num_load_retries,
                            int64 load_retry_interval_micros,
                            bool flush_filesystem_caches,
+                           bool cache_serving_map_per_thread,
                            std::unique_ptr<ResourceTracker> resource_tracker,
                            EventBus<ServableState>* servable_event_bus,
                            std::function<void(const ServableId&)> pre_load_hook)
     : servable_event_bus_(servable_event_bus),
+      serving_map_(env, cache_serving_map_per_thread),
       env_(env),
       num_load_threads_(num_load_threads),
       flush_filesystem_caches_(flush_filesystem_caches),
@@ -292,10 +625,9 @@ BasicManager::GetAvailableUntypedServableHandles() const {
   return serving_map_.GetAvailableUntypedServableHandles();
 }
 
-void BasicManager::UpdateServingMap() {
-  // This blocks until the last handle given out by the old serving map is
-  // freed.
-  serving_map_.Update(managed_map_);
+void BasicManager::UpdateServingMap(const string& servable_name) {
+  // This doesn't wait for the handles given out by the old serving map.
+  serving_map_.Update(managed_map_, servable_name);
 }
 
 BasicManager::ManagedMap::iterator BasicManager::FindHarnessInMap(
@@ -479,7 +811,7 @@ Status BasicManager::ExecuteLoad(LoaderHarness* harness) {
 
   {
     mutex_lock l(mu_);
-    UpdateServingMap();
+    UpdateServingMap(id.name);
   }
 
   PublishOnEventBus(
@@ -517,7 +849,15 @@ Status BasicManager::ExecuteUnload(LoaderHarness* harness) {
     mutex_lock l(mu_);
     PublishOnEventBus(
         {id, ServableState::ManagerState::kUnloading, harness->status()});
-    UpdateServingMap();
+    UpdateServingMap(id.name);
+  }
+
+  // We don't hold the lock while waiting for the handles to the servable to be
+  // released, as a slow request would hold up the loads and unloads of other
+  // servables.
+  serving_map_.WaitUntilReleased(id);
+  {
+    mutex_lock l(mu_);
     TF_RETURN_IF_ERROR(harness->DoneQuiescing());
   }
 
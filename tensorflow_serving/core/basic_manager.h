@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_CORE_BASIC_MANAGER_H_
 #define TENSORFLOW_SERVING_CORE_BASIC_MANAGER_H_
 
+#include <array>
 #include <atomic>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "tensorflow/core/lib/core/status.h"
@@ -39,7 +42,6 @@ limitations under the License.
 #include "tensorflow_serving/resources/resource_tracker.h"
 #include "tensorflow_serving/util/event_bus.h"
 #include "tensorflow_serving/util/executor.h"
-#include "tensorflow_serving/util/fast_read_dynamic_ptr.h"
 #include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
@@ -146,6 +148,13 @@ class BasicManager : public Manager {
     // concurrent load on another thread.)
     bool flush_filesystem_caches = false;
 
+    // If true, each thread which gets servable handles caches a snapshot of
+    // the servables which are ready to be served, and refreshes it only once
+    // they change. Handles are then got without taking any lock or touching
+    // any reference count shared with other threads, at the cost of one
+    // cached snapshot per thread.
+    bool cache_serving_map_per_thread = false;
+
     // The environment to use for starting threads in the thread-pool.
     Env* env = Env::Default();
 
@@ -270,7 +279,7 @@ class BasicManager : public Manager {
 
   BasicManager(Env* env, uint32 num_load_threads, uint32 num_unload_threads,
                uint32 max_num_load_retries, int64 load_retry_interval_micros,
-               bool flush_filesystem_caches,
+               bool flush_filesystem_caches, bool cache_serving_map_per_thread,
                std::unique_ptr<ResourceTracker> resource_tracker,
                EventBus<ServableState>* servable_event_bus,
                PreLoadHook pre_load_hook);
@@ -377,9 +386,10 @@ class BasicManager : public Manager {
   // Unloads all the managed servables.
   void UnloadAllServables() LOCKS_EXCLUDED(mu_);
 
-  // Updates the serving map by copying servables from the managed map, which
-  // are ready to be served.
-  void UpdateServingMap() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Updates the serving map by copying the servables of the stream
+  // 'servable_name' from the managed map, which are ready to be served.
+  void UpdateServingMap(const string& servable_name)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
   // Sets the number of load threads.
   //
@@ -425,10 +435,23 @@ class BasicManager : public Manager {
   // This map is updated occasionally from the main manager loop thread while
   // being accessed from multiple threads to get ServableHandles.
   //
+  // An update publishes a new map without waiting for the handles given out by
+  // the previous one. Handles are counted on the servable they refer to rather
+  // than on the map, and unloading a servable waits for the handles to it only
+  // (see WaitUntilReleased()), so that a slow request doesn't hold up the loads
+  // and unloads of other servables.
+  //
   // This class is thread-safe.
   class ServingMap {
    public:
-    ServingMap();
+    // Retired servables are timed with the clock of 'env'. If
+    // 'cache_per_thread' is true, GetUntypedServableHandle() gets handles
+    // from a snapshot of the current map cached by the calling thread (see
+    // ThreadCache).
+    ServingMap(Env* env, bool cache_per_thread);
+
+    // Blocks until all the handles it gave out have been released.
+    ~ServingMap();
 
     // Gets a list of all servable ids.
     std::vector<ServableId> ListAvailableServableIds() const;
@@ -445,25 +468,145 @@ class BasicManager : public Manager {
     std::map<ServableId, std::unique_ptr<UntypedServableHandle>>
     GetAvailableUntypedServableHandles() const;
 
-    // Updates the serving map by copying servables from the managed map, which
-    // are ready to be served.
-    void Update(const ManagedMap& managed_map);
+    // Updates the serving map by copying the servables of the stream
+    // 'servable_name' which are ready to be served from the managed map. Only
+    // the entries of that stream are rebuilt; the rest of the map is shared
+    // with the previous one. Doesn't block on the handles given out by the
+    // previous map.
+    void Update(const ManagedMap& managed_map, const string& servable_name);
+
+    // Blocks until the handles to 'id' have all been released, and no map
+    // which a handle to 'id' could still be got from is in use. The current
+    // map must not contain 'id'.
+    void WaitUntilReleased(const ServableId& id);
+
+    // Returns the number of microseconds since the servable which was removed
+    // from the map the longest ago, among the ones which are still referenced,
+    // was removed, or 0 if there is no such servable.
+    int64 OldestRetiredServableAgeMicros() const;
 
    private:
-    struct EqRequest;
-    // Hash and equality functors for ServableRequest.
-    // Forward-declared here and defined in the cc file.
-    struct HashRequest;
-
-    // Map from ServableRequest to corresponding harness. For the latest version
-    // of a servable stream, we add an extra entry for it, where key is the
-    // ServableRequest without the version set, so that requests for the latest,
-    // can be directly queried on this map.
-    using HandlesMap =
-        std::unordered_multimap<ServableRequest,
-                                std::shared_ptr<const LoaderHarness>,
-                                HashRequest, EqRequest>;
-    FastReadDynamicPtr<HandlesMap> handles_map_;
+    // A servable in the map. Shared by all the maps the servable is in, and by
+    // the handles to it, which are counted on it. Reported released by its
+    // deleter (see Release()).
+    struct ServableEntry {
+      std::shared_ptr<const LoaderHarness> harness;
+    };
+
+    // The servables of a servable stream which are ready to be served, by
+    // increasing version.
+    using StreamHandles = std::vector<std::shared_ptr<const ServableEntry>>;
+
+    // Map from servable stream name to its handles, sharded by the hash of the
+    // name. Maps are never modified once published: an update copies the
+    // shard of the stream it changes, and shares the other shards, as well as
+    // the handles of the other streams of that shard, with the previous map.
+    static constexpr int kNumHandlesShards = 64;
+    using HandlesShard =
+        std::unordered_map<string, std::shared_ptr<const StreamHandles>>;
+    struct HandlesMap {
+      // Null for shards without any stream.
+      std::array<std::shared_ptr<const HandlesShard>, kNumHandlesShards> shards;
+    };
+
+    // Returns the index of the shard 'servable_name' belongs in.
+    static int GetShardIndex(const string& servable_name);
+
+    // Returns the handles of the stream 'servable_name' in 'handles_map', or
+    // null if it has none.
+    static const StreamHandles* FindStream(const HandlesMap& handles_map,
+                                           const string& servable_name);
+
+    // Returns a new entry for 'harness', which is reported released once it is
+    // destroyed.
+    std::shared_ptr<const ServableEntry> CreateEntry(
+        std::shared_ptr<const LoaderHarness> harness);
+
+    // Called once the entry of 'id' has been destroyed.
+    void Release(const ServableId& id);
+
+    // Makes 'handles_map' the current map, which 'removed_ids' have been
+    // removed from.
+    void Publish(std::unique_ptr<HandlesMap> handles_map,
+                 const std::vector<ServableId>& removed_ids);
+
+    // A reference to a map cached by a thread. The handles given out from it
+    // are counted on references to the entries which only this snapshot hands
+    // out, so that threads don't contend on the counts of the entries.
+    struct Snapshot {
+      uint64 generation;
+      std::shared_ptr<const HandlesMap> handles_map;
+
+      // Only accessed by the thread which caches the snapshot.
+      mutable std::unordered_map<const ServableEntry*,
+                                 std::shared_ptr<const ServableEntry>>
+          entry_refs;
+    };
+
+    // The snapshot cached by a thread. It is only ever replaced by that
+    // thread, and dropped by Publish() once it is stale, so that a thread
+    // which stops getting handles doesn't keep a retired map from being
+    // reclaimed. Shared with the thread, which may outlive this ServingMap.
+    struct alignas(64) ThreadCache {
+      // Owned. Null while the thread uses the snapshot, or once it's dropped.
+      std::atomic<std::shared_ptr<const Snapshot>*> snapshot{nullptr};
+
+      // Whether a live thread caches its snapshot here.
+      std::atomic<bool> in_use{false};
+
+      // Set once the ServingMap is destroyed.
+      std::atomic<bool> orphaned{false};
+    };
+
+    // Returns the caches of the calling thread, by ServingMap instance id.
+    static std::unordered_map<uint64, std::shared_ptr<ThreadCache>>*
+    GetThreadCaches();
+
+    // Returns the cache of the calling thread, and sets it up on first use.
+    ThreadCache* GetThreadCache();
+
+    // Returns the snapshot of the current map cached by the calling thread,
+    // which is refreshed first if the map has changed since.
+    std::shared_ptr<const Snapshot> GetThreadSnapshot();
+
+    // Drops the snapshots cached by all threads.
+    void DropThreadSnapshots();
+
+    Env* const env_;
+
+    const bool cache_per_thread_;
+
+    // Unique among the ServingMaps of the process, unlike their addresses.
+    const uint64 instance_id_;
+
+    // The generation of the current map, which tells threads whether their
+    // cached snapshot is stale.
+    std::atomic<uint64> current_generation_{0};
+
+    mutex thread_caches_mu_;
+
+    // The caches of the threads which have got handles from this map.
+    std::vector<std::shared_ptr<ThreadCache>> thread_caches_
+        GUARDED_BY(thread_caches_mu_);
+
+    // Serializes updates.
+    mutex update_mu_;
+
+    mutable mutex mu_;
+
+    // The current map.
+    std::shared_ptr<const HandlesMap> handles_map_ GUARDED_BY(mu_);
+
+    // The generation of the next map to be published.
+    uint64 next_generation_ GUARDED_BY(mu_) = 0;
+
+    // The servables whose entries haven't been released yet, mapped to when
+    // they were removed from the map, or nullopt for the ones still in it.
+    std::unordered_map<ServableId, optional<uint64>, HashServableId>
+        unreleased_servables_ GUARDED_BY(mu_);
+
+    // Notified whenever an entry is released.
+    condition_variable servable_released_;
   };
   ServingMap serving_map_;
 
@@ -16,10 +16,12 @@ limitations under the License.
 #include "tensorflow_serving/core/basic_manager.h"
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "tensorflow/contrib/batching/test_util/fake_clock_env.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -554,6 +556,122 @@ TEST_P(BasicManagerTest, DestructOnNonServingThread) {
   ASSERT_FALSE(FakeLoader::was_deleted_in_this_thread());
 }
 
+// Tests that an outstanding handle holds up neither the load of another
+// servable nor the serving map update that comes with it.
+TEST_P(BasicManagerTest, UpdateServingMapDoesNotWaitForOldHandles) {
+  ServableHandle<int64> latest_handle;
+  TF_ASSERT_OK(basic_manager_->GetServableHandle(
+      ServableRequest::Latest(kServableName), &latest_handle));
+
+  const ServableId id = {kServableName3, 0};
+  TF_CHECK_OK(basic_manager_->ManageServable(CreateServable(id)));
+  basic_manager_->LoadServable(
+      id, [](const Status& status) { TF_ASSERT_OK(status); });
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor_, id, {ServableState::ManagerState::kAvailable});
+  EXPECT_EQ(kNumVersionsPerServable, *latest_handle);
+}
+
+// Tests that servables stay reachable as the streams around them, of which
+// there are more than serving map shards, are loaded and unloaded.
+// Tests that a handle to one servable doesn't hold up unloading another, while
+// unloading a servable still waits for the handles to it.
+TEST_P(BasicManagerTest, UnloadOnlyWaitsForHandlesOfTheUnloadedServable) {
+  const ServableId other_id = {kServableName2, 1};
+  ServableHandle<int64> other_handle;
+  TF_ASSERT_OK(basic_manager_->GetServableHandle(
+      ServableRequest::FromId(other_id), &other_handle));
+
+  const ServableId id0 = {kServableName, 1};
+  basic_manager_->UnloadServable(
+      id0, [](const Status& status) { TF_ASSERT_OK(status); });
+  WaitUntilServableManagerStateIsOneOf(servable_state_monitor_, id0,
+                                       {ServableState::ManagerState::kEnd});
+
+  test_util::MockLoader* loader = new NiceMock<test_util::MockLoader>;
+  int64 servable = 7;
+  ON_CALL(*loader, servable()).WillByDefault(Return(AnyPtr(&servable)));
+  ON_CALL(*loader, EstimateResources(_)).WillByDefault(Return(Status::OK()));
+  ON_CALL(*loader, Load()).WillByDefault(Return(Status::OK()));
+  const ServableId id1 = {kServableName3, 1};
+  TF_CHECK_OK(basic_manager_->ManageServable(
+      {id1, std::unique_ptr<Loader>(loader)}));
+  basic_manager_->LoadServable(
+      id1, [](const Status& status) { TF_ASSERT_OK(status); });
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor_, id1, {ServableState::ManagerState::kAvailable});
+
+  std::unique_ptr<ServableHandle<int64>> handle(new ServableHandle<int64>());
+  TF_ASSERT_OK(basic_manager_->GetServableHandle(ServableRequest::FromId(id1),
+                                                 handle.get()));
+  std::atomic<bool> handle_released{false};
+  EXPECT_CALL(*loader, Unload()).WillOnce(InvokeWithoutArgs([&]() {
+    EXPECT_TRUE(handle_released);
+  }));
+  Notification unload_finished;
+  std::unique_ptr<Thread> unload_servable(
+      Env::Default()->StartThread({}, "UnloadServable", [&]() {
+        basic_manager_->UnloadServable(id1, [&](const Status& status) {
+          TF_EXPECT_OK(status);
+          unload_finished.Notify();
+        });
+      }));
+
+  // The unload gets as far as taking the servable out of the serving map, and
+  // then waits for the handle to it before calling Unload().
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor_, id1, {ServableState::ManagerState::kUnloading});
+  test_util::BasicManagerTestAccess manager_test_access(basic_manager_.get());
+  Env::Default()->SleepForMicroseconds(1000);
+  EXPECT_GT(manager_test_access.OldestRetiredServableAgeMicros(), 0);
+  EXPECT_EQ(7, **handle);
+  handle_released = true;
+  handle.reset();
+  unload_finished.WaitForNotification();
+  WaitUntilServableManagerStateIsOneOf(servable_state_monitor_, id1,
+                                       {ServableState::ManagerState::kEnd});
+  EXPECT_EQ(0, manager_test_access.OldestRetiredServableAgeMicros());
+  EXPECT_EQ(1, *other_handle);
+}
+
+TEST_P(BasicManagerTest, ManyServableStreams) {
+  constexpr int kNumServableStreams = 100;
+  for (int i = 0; i < kNumServableStreams; ++i) {
+    const ServableId id = {strings::StrCat(kServableName3, i), i};
+    TF_CHECK_OK(basic_manager_->ManageServable(CreateServable(id)));
+    basic_manager_->LoadServable(
+        id, [](const Status& status) { TF_ASSERT_OK(status); });
+    WaitUntilServableManagerStateIsOneOf(
+        servable_state_monitor_, id, {ServableState::ManagerState::kAvailable});
+  }
+  // Unload every other stream.
+  for (int i = 0; i < kNumServableStreams; i += 2) {
+    const ServableId id = {strings::StrCat(kServableName3, i), i};
+    basic_manager_->UnloadServable(
+        id, [](const Status& status) { TF_ASSERT_OK(status); });
+    WaitUntilServableManagerStateIsOneOf(servable_state_monitor_, id,
+                                         {ServableState::ManagerState::kEnd});
+  }
+
+  EXPECT_EQ(2 * kNumVersionsPerServable + kNumServableStreams / 2,
+            basic_manager_->ListAvailableServableIds().size());
+  for (int i = 0; i < kNumServableStreams; ++i) {
+    const string name = strings::StrCat(kServableName3, i);
+    ServableHandle<int64> handle;
+    const Status status = basic_manager_->GetServableHandle(
+        ServableRequest::Latest(name), &handle);
+    if (i % 2 == 0) {
+      EXPECT_EQ(error::NOT_FOUND, status.code());
+    } else {
+      TF_ASSERT_OK(status);
+      EXPECT_EQ(i, *handle);
+      TF_ASSERT_OK(basic_manager_->GetServableHandle(
+          ServableRequest::Specific(name, i), &handle));
+      EXPECT_EQ(i, *handle);
+    }
+  }
+}
+
 TEST_P(BasicManagerTest, AdditionalState) {
   const ServableId id = {kServableName, 3};
   std::unique_ptr<int> state(new int(1));
@@ -1205,6 +1323,114 @@ TEST(NonParameterizedBasicManagerTest, PreLoadHook) {
                           [](const Status& status) { TF_ASSERT_OK(status); });
 }
 
+// Tests that the servables retired from the serving map are timed with the
+// manager's Env.
+TEST(NonParameterizedBasicManagerTest, RetiredServableAgeUsesManagerEnv) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::shared_ptr<EventBus<ServableState>> servable_event_bus =
+      EventBus<ServableState>::CreateEventBus();
+  ServableStateMonitor servable_state_monitor(servable_event_bus.get());
+  BasicManager::Options options;
+  options.env = &env;
+  options.servable_event_bus = servable_event_bus.get();
+  std::unique_ptr<BasicManager> manager;
+  TF_ASSERT_OK(BasicManager::Create(std::move(options), &manager));
+  test_util::BasicManagerTestAccess manager_test_access(manager.get());
+
+  const ServableId id = {kServableName, 1};
+  TF_CHECK_OK(manager->ManageServable(CreateServable(id)));
+  manager->LoadServable(id, [](const Status& status) { TF_ASSERT_OK(status); });
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor, id, {ServableState::ManagerState::kAvailable});
+  std::unique_ptr<ServableHandle<int64>> handle(new ServableHandle<int64>());
+  TF_ASSERT_OK(manager->GetServableHandle(ServableRequest::FromId(id),
+                                          handle.get()));
+
+  Notification unload_finished;
+  std::unique_ptr<Thread> unload_servable(
+      Env::Default()->StartThread({}, "UnloadServable", [&]() {
+        manager->UnloadServable(id, [&](const Status& status) {
+          TF_EXPECT_OK(status);
+          unload_finished.Notify();
+        });
+      }));
+  // Wait for the servable to be taken out of the serving map.
+  ServableHandle<int64> other_handle;
+  while (manager->GetServableHandle(ServableRequest::FromId(id), &other_handle)
+             .ok()) {
+    other_handle = ServableHandle<int64>();
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_EQ(0, manager_test_access.OldestRetiredServableAgeMicros());
+  env.AdvanceByMicroseconds(1234);
+  EXPECT_EQ(1234, manager_test_access.OldestRetiredServableAgeMicros());
+
+  handle.reset();
+  unload_finished.WaitForNotification();
+  EXPECT_EQ(0, manager_test_access.OldestRetiredServableAgeMicros());
+}
+
+// Tests that the serving map snapshots cached by threads are refreshed as
+// servables are loaded and unloaded, and don't hold up the unloads.
+TEST(NonParameterizedBasicManagerTest, CacheServingMapPerThread) {
+  std::shared_ptr<EventBus<ServableState>> servable_event_bus =
+      EventBus<ServableState>::CreateEventBus();
+  ServableStateMonitor servable_state_monitor(servable_event_bus.get());
+  BasicManager::Options options;
+  options.servable_event_bus = servable_event_bus.get();
+  options.cache_serving_map_per_thread = true;
+  std::unique_ptr<BasicManager> manager;
+  TF_ASSERT_OK(BasicManager::Create(std::move(options), &manager));
+  test_util::BasicManagerTestAccess manager_test_access(manager.get());
+
+  const auto load_servable = [&](const ServableId& id) {
+    TF_CHECK_OK(manager->ManageServable(CreateServable(id)));
+    manager->LoadServable(id,
+                          [](const Status& status) { TF_ASSERT_OK(status); });
+    WaitUntilServableManagerStateIsOneOf(
+        servable_state_monitor, id, {ServableState::ManagerState::kAvailable});
+  };
+  const auto expect_latest_version = [&](const int64 version) {
+    ServableHandle<int64> handle;
+    TF_ASSERT_OK(manager->GetServableHandle(
+        ServableRequest::Latest(kServableName), &handle));
+    EXPECT_EQ(version, *handle);
+  };
+
+  load_servable({kServableName, 1});
+  // Another thread caches a snapshot of the map, and stays around without
+  // getting any more handles till the end of the test.
+  Notification snapshot_cached;
+  Notification done;
+  std::unique_ptr<Thread> idle_thread(
+      Env::Default()->StartThread({}, "IdleThread", [&]() {
+        expect_latest_version(1);
+        snapshot_cached.Notify();
+        done.WaitForNotification();
+        expect_latest_version(2);
+      }));
+  snapshot_cached.WaitForNotification();
+  expect_latest_version(1);
+
+  load_servable({kServableName, 2});
+  expect_latest_version(2);
+
+  // Neither snapshot of the map version 1 was in keeps it from being released.
+  const ServableId id = {kServableName, 1};
+  manager->UnloadServable(id,
+                          [](const Status& status) { TF_ASSERT_OK(status); });
+  WaitUntilServableManagerStateIsOneOf(servable_state_monitor, id,
+                                       {ServableState::ManagerState::kEnd});
+  EXPECT_EQ(0, manager_test_access.OldestRetiredServableAgeMicros());
+  ServableHandle<int64> handle;
+  EXPECT_EQ(error::NOT_FOUND,
+            manager
+                ->GetServableHandle(ServableRequest::Specific(kServableName, 1),
+                                    &handle)
+                .code());
+  done.Notify();
+}
+
 // Creates a ResourceAllocation proto with 'quantity' units of RAM.
 ResourceAllocation CreateResourceQuantity(const int quantity) {
   ResourceAllocation allocation;
@@ -0,0 +1,50 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/inference_request_key.h"
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Serializes 'message' with its map entries in a deterministic order, so that
+// equal requests always serialize the same.
+string SerializeDeterministically(const google::protobuf::Message& message) {
+  string serialized;
+  // Also caches the sizes for SerializeWithCachedSizes().
+  serialized.reserve(message.ByteSizeLong());
+  {
+    google::protobuf::io::StringOutputStream string_stream(&serialized);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    message.SerializeWithCachedSizes(&coded_stream);
+  }
+  return serialized;
+}
+
+}  // namespace
+
+InferenceRequestKey InferenceRequestKey::Create(
+    const string& method_name, const ServableId& servable_id,
+    const google::protobuf::Message& request) {
+  return {method_name, servable_id,
+          Fingerprint128(SerializeDeterministically(request))};
+}
+
+}  // namespace serving
+}  // namespace tensorflow
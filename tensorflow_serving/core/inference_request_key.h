@@ -0,0 +1,72 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_INFERENCE_REQUEST_KEY_H_
+#define TENSORFLOW_SERVING_CORE_INFERENCE_REQUEST_KEY_H_
+
+#include <string>
+
+#include "google/protobuf/message.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/servable_id.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Identifies an inference request by what determines its response: the method
+// called, the servable version its handle resolved to, and the request as
+// sent. Two requests with equal keys get the same response from a
+// deterministic model.
+struct InferenceRequestKey {
+  // Creates the key of a 'method_name' (e.g. "Predict") 'request' served by
+  // 'servable_id'. Costs a serialization of 'request'.
+  static InferenceRequestKey Create(const string& method_name,
+                                    const ServableId& servable_id,
+                                    const google::protobuf::Message& request);
+
+  string method_name;
+  ServableId servable_id;
+  // The fingerprint of the deterministically serialized request, which covers
+  // its model spec (e.g. signature name) and inputs.
+  Fprint128 request_fingerprint;
+};
+
+struct HashInferenceRequestKey {
+  uint64 operator()(const InferenceRequestKey& key) const {
+    return HashCombine(
+        HashCombine(HashServableId()(key.servable_id),
+                    key.request_fingerprint.low64 ^
+                        key.request_fingerprint.high64),
+        std::hash<string>()(key.method_name));
+  }
+};
+
+inline bool operator==(const InferenceRequestKey& a,
+                       const InferenceRequestKey& b) {
+  return a.request_fingerprint.low64 == b.request_fingerprint.low64 &&
+         a.request_fingerprint.high64 == b.request_fingerprint.high64 &&
+         a.servable_id == b.servable_id && a.method_name == b.method_name;
+}
+
+inline bool operator!=(const InferenceRequestKey& a,
+                       const InferenceRequestKey& b) {
+  return !(a == b);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_INFERENCE_REQUEST_KEY_H_
@@ -0,0 +1,59 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/inference_request_key.h"
+
+#include <gtest/gtest.h>
+#include "google/protobuf/struct.pb.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(InferenceRequestKeyTest, EqualRequestsHaveEqualKeys) {
+  google::protobuf::Struct request;
+  (*request.mutable_fields())["a"].set_number_value(1);
+  (*request.mutable_fields())["b"].set_number_value(2);
+  google::protobuf::Struct same_request;
+  (*same_request.mutable_fields())["b"].set_number_value(2);
+  (*same_request.mutable_fields())["a"].set_number_value(1);
+
+  const InferenceRequestKey key =
+      InferenceRequestKey::Create("Predict", {"model", 1}, request);
+  const InferenceRequestKey same_key =
+      InferenceRequestKey::Create("Predict", {"model", 1}, same_request);
+  EXPECT_EQ(key, same_key);
+  EXPECT_EQ(HashInferenceRequestKey()(key),
+            HashInferenceRequestKey()(same_key));
+}
+
+TEST(InferenceRequestKeyTest, KeysDifferInEveryPart) {
+  google::protobuf::Struct request;
+  (*request.mutable_fields())["a"].set_number_value(1);
+  google::protobuf::Struct other_request;
+  (*other_request.mutable_fields())["a"].set_number_value(2);
+
+  const InferenceRequestKey key =
+      InferenceRequestKey::Create("Predict", {"model", 1}, request);
+  EXPECT_NE(key,
+            InferenceRequestKey::Create("Predict", {"model", 1}, other_request));
+  EXPECT_NE(key, InferenceRequestKey::Create("Predict", {"model", 2}, request));
+  EXPECT_NE(key, InferenceRequestKey::Create("Predict", {"other", 1}, request));
+  EXPECT_NE(key, InferenceRequestKey::Create("Classify", {"model", 1}, request));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
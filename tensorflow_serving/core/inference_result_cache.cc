@@ -0,0 +1,179 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/inference_result_cache.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/monitoring/counter.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+auto* result_cache_lookups = monitoring::Counter<2>::New(
+    "/tensorflow/serving/inference_result_cache_lookups",
+    "The total number of lookups in the inference result cache sliced down by "
+    "model_name and outcome (hit or miss).",
+    "model_name", "outcome");
+
+// The approximate bookkeeping overhead of an entry, beyond its key and result.
+constexpr int64 kEntryOverheadBytes = 128;
+
+}  // namespace
+
+InferenceResultCache::InferenceResultCache(const Options& options)
+    : shard_capacity_bytes_(options.capacity_bytes /
+                            std::max(options.num_shards, 1)) {
+  for (int i = 0; i < std::max(options.num_shards, 1); ++i) {
+    shards_.emplace_back(new Shard);
+  }
+}
+
+void InferenceResultCache::UpdateModelConfigs(
+    const std::map<string, ResultCacheConfig>& model_configs) {
+  std::unique_ptr<std::unordered_set<string>> enabled_models(
+      new std::unordered_set<string>);
+  for (const auto& entry : model_configs) {
+    if (entry.second.enabled()) {
+      enabled_models->insert(entry.first);
+    }
+  }
+  const std::unordered_set<string> still_enabled = *enabled_models;
+  enabled_models_.Update(std::move(enabled_models));
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    EraseIf(
+        [&still_enabled](const Key& key) {
+          return still_enabled.count(key.servable_id.name) == 0;
+        },
+        shard.get());
+  }
+}
+
+bool InferenceResultCache::Lookup(const string& method_name,
+                                  const ServableId& servable_id,
+                                  const google::protobuf::Message& request,
+                                  google::protobuf::Message* response,
+                                  optional<Key>* key) {
+  {
+    auto enabled_models = enabled_models_.get();
+    if (enabled_models == nullptr ||
+        enabled_models->count(servable_id.name) == 0) {
+      return false;
+    }
+  }
+
+  *key = InferenceRequestKey::Create(method_name, servable_id, request);
+  std::shared_ptr<const string> serialized_response;
+  {
+    Shard* const shard = GetShard(**key);
+    mutex_lock l(shard->mu);
+    auto it = shard->index.find(**key);
+    if (it != shard->index.end()) {
+      // Make it the most recently used entry.
+      shard->entries.splice(shard->entries.begin(), shard->entries,
+                            it->second);
+      serialized_response = it->second->serialized_response;
+    }
+  }
+  if (serialized_response == nullptr ||
+      !response->ParseFromString(*serialized_response)) {
+    response->Clear();
+    result_cache_lookups->GetCell(servable_id.name, "miss")->IncrementBy(1);
+    return false;
+  }
+  result_cache_lookups->GetCell(servable_id.name, "hit")->IncrementBy(1);
+  return true;
+}
+
+void InferenceResultCache::Insert(const Key& key,
+                                  const google::protobuf::Message& response) {
+  std::shared_ptr<const string> serialized_response(
+      new string(response.SerializeAsString()));
+  const int64 size_bytes = serialized_response->size() +
+                           key.method_name.size() +
+                           key.servable_id.name.size() + kEntryOverheadBytes;
+  if (size_bytes > shard_capacity_bytes_) {
+    return;
+  }
+
+  Shard* const shard = GetShard(key);
+  mutex_lock l(shard->mu);
+  auto it = shard->index.find(key);
+  if (it != shard->index.end()) {
+    // A concurrent request computed the same result first; keep the newer.
+    shard->size_bytes -= it->second->size_bytes;
+    shard->entries.erase(it->second);
+    shard->index.erase(it);
+  }
+  shard->entries.push_front({key, std::move(serialized_response), size_bytes});
+  shard->index[key] = shard->entries.begin();
+  shard->size_bytes += size_bytes;
+  while (shard->size_bytes > shard_capacity_bytes_) {
+    const Entry& lru = shard->entries.back();
+    shard->size_bytes -= lru.size_bytes;
+    shard->index.erase(lru.key);
+    shard->entries.pop_back();
+  }
+}
+
+void InferenceResultCache::InvalidateVersion(const ServableId& servable_id) {
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    EraseIf(
+        [&servable_id](const Key& key) {
+          return key.servable_id == servable_id;
+        },
+        shard.get());
+  }
+}
+
+int64 InferenceResultCache::size_bytes() const {
+  int64 size_bytes = 0;
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    mutex_lock l(shard->mu);
+    size_bytes += shard->size_bytes;
+  }
+  return size_bytes;
+}
+
+int64 InferenceResultCache::num_entries() const {
+  int64 num_entries = 0;
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    mutex_lock l(shard->mu);
+    num_entries += shard->entries.size();
+  }
+  return num_entries;
+}
+
+InferenceResultCache::Shard* InferenceResultCache::GetShard(const Key& key) {
+  return shards_[HashInferenceRequestKey()(key) % shards_.size()].get();
+}
+
+void InferenceResultCache::EraseIf(
+    const std::function<bool(const Key&)>& predicate, Shard* shard) {
+  mutex_lock l(shard->mu);
+  for (auto it = shard->entries.begin(); it != shard->entries.end();) {
+    if (predicate(it->key)) {
+      shard->size_bytes -= it->size_bytes;
+      shard->index.erase(it->key);
+      it = shard->entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,142 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_INFERENCE_RESULT_CACHE_H_
+#define TENSORFLOW_SERVING_CORE_INFERENCE_RESULT_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "google/protobuf/message.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/config/result_cache_config.pb.h"
+#include "tensorflow_serving/core/inference_request_key.h"
+#include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/util/fast_read_dynamic_ptr.h"
+#include "tensorflow_serving/util/optional.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Caches the responses of idempotent inference requests, so that a request
+// repeated while the same model version is serving needn't run the model
+// again.
+//
+// A result is keyed by the InferenceRequestKey of its request. Results are
+// kept, as serialized responses, within a total byte budget, evicting the
+// least recently used ones first. The cache is split into shards with their
+// own locks, so that concurrent requests rarely contend.
+//
+// Only the models enabled with UpdateModelConfigs() have their results
+// cached. The results of a version should be dropped with InvalidateVersion()
+// once it stops serving, lest the same version be loaded again with different
+// contents.
+//
+// Typical use, once the request's servable handle is acquired:
+//
+//   optional<InferenceResultCache::Key> cache_key;
+//   if (cache->Lookup("Predict", handle.id(), request, &response,
+//                     &cache_key)) {
+//     return Status::OK();
+//   }
+//   ... compute 'response' ...
+//   if (cache_key) cache->Insert(*cache_key, response);
+//
+// This class is thread-safe.
+class InferenceResultCache {
+ public:
+  struct Options {
+    // The total size of the cached results, in bytes.
+    int64 capacity_bytes = 64 << 20;
+
+    // The number of independently locked shards the cache is split into, each
+    // with an equal share of the capacity.
+    int num_shards = 16;
+  };
+
+  // The key of a cached result.
+  using Key = InferenceRequestKey;
+
+  explicit InferenceResultCache(const Options& options);
+  ~InferenceResultCache() = default;
+
+  // Sets which models have their results cached, by model name. The results
+  // of the models which are no longer enabled are dropped.
+  void UpdateModelConfigs(
+      const std::map<string, ResultCacheConfig>& model_configs);
+
+  // Looks up the result of a 'method_name' request served by the servable
+  // 'servable_id'. On a hit, parses the result into 'response' and returns
+  // true. On a miss, returns false, and sets 'key' to the key to Insert() the
+  // result with once it is computed, unless the model's results aren't cached.
+  bool Lookup(const string& method_name, const ServableId& servable_id,
+              const google::protobuf::Message& request,
+              google::protobuf::Message* response, optional<Key>* key);
+
+  // Caches 'response' as the result of the request 'key' was looked up for.
+  void Insert(const Key& key, const google::protobuf::Message& response);
+
+  // Drops the results of the servable 'servable_id'.
+  void InvalidateVersion(const ServableId& servable_id);
+
+  // The total size and number of the cached results.
+  int64 size_bytes() const;
+  int64 num_entries() const;
+
+ private:
+  struct Entry {
+    Key key;
+    // Shared, so that hits can parse it without holding the shard's lock.
+    std::shared_ptr<const string> serialized_response;
+    int64 size_bytes;
+  };
+
+  struct Shard {
+    mutable mutex mu;
+    // The entries, from the most to the least recently used.
+    std::list<Entry> entries GUARDED_BY(mu);
+    std::unordered_map<Key, std::list<Entry>::iterator,
+                       HashInferenceRequestKey>
+        index GUARDED_BY(mu);
+    int64 size_bytes GUARDED_BY(mu) = 0;
+  };
+
+  Shard* GetShard(const Key& key);
+
+  // Drops the entries of 'shard' which match 'predicate'.
+  static void EraseIf(const std::function<bool(const Key&)>& predicate,
+                      Shard* shard);
+
+  const int64 shard_capacity_bytes_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // The names of the models whose results are cached.
+  FastReadDynamicPtr<std::unordered_set<string>> enabled_models_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(InferenceResultCache);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_INFERENCE_RESULT_CACHE_H_
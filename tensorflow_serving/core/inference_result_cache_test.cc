@@ -0,0 +1,145 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/inference_result_cache.h"
+
+#include <gtest/gtest.h>
+#include "google/protobuf/wrappers.pb.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using google::protobuf::StringValue;
+
+StringValue CreateMessage(const string& value) {
+  StringValue message;
+  message.set_value(value);
+  return message;
+}
+
+// Returns a cache with 'model' enabled.
+std::unique_ptr<InferenceResultCache> CreateCache(
+    const InferenceResultCache::Options& options, const string& model) {
+  std::unique_ptr<InferenceResultCache> cache(
+      new InferenceResultCache(options));
+  ResultCacheConfig config;
+  config.set_enabled(true);
+  cache->UpdateModelConfigs({{model, config}});
+  return cache;
+}
+
+// Looks up 'request' and, on a miss, inserts 'response' for it. Returns
+// whether the lookup hit.
+bool LookupOrInsert(const ServableId& id, const string& request,
+                    const string& response, InferenceResultCache* cache) {
+  StringValue cached_response;
+  optional<InferenceResultCache::Key> key;
+  if (cache->Lookup("Predict", id, CreateMessage(request), &cached_response,
+                    &key)) {
+    EXPECT_EQ(response, cached_response.value());
+    return true;
+  }
+  EXPECT_TRUE(key);
+  cache->Insert(*key, CreateMessage(response));
+  return false;
+}
+
+TEST(InferenceResultCacheTest, ModelNotEnabled) {
+  InferenceResultCache cache((InferenceResultCache::Options()));
+  StringValue response;
+  optional<InferenceResultCache::Key> key;
+  EXPECT_FALSE(cache.Lookup("Predict", {"model", 1}, CreateMessage("request"),
+                            &response, &key));
+  EXPECT_FALSE(key);
+}
+
+TEST(InferenceResultCacheTest, HitsOnlyTheSameRequestToTheSameVersion) {
+  auto cache = CreateCache(InferenceResultCache::Options(), "model");
+  EXPECT_FALSE(LookupOrInsert({"model", 1}, "a", "result a", cache.get()));
+  EXPECT_TRUE(LookupOrInsert({"model", 1}, "a", "result a", cache.get()));
+  EXPECT_FALSE(LookupOrInsert({"model", 1}, "b", "result b", cache.get()));
+  EXPECT_FALSE(LookupOrInsert({"model", 2}, "a", "result a2", cache.get()));
+  EXPECT_TRUE(LookupOrInsert({"model", 2}, "a", "result a2", cache.get()));
+  EXPECT_EQ(3, cache->num_entries());
+
+  // Other methods have their own results.
+  StringValue response;
+  optional<InferenceResultCache::Key> key;
+  EXPECT_FALSE(cache->Lookup("Classify", {"model", 1}, CreateMessage("a"),
+                             &response, &key));
+}
+
+TEST(InferenceResultCacheTest, InvalidateVersion) {
+  auto cache = CreateCache(InferenceResultCache::Options(), "model");
+  LookupOrInsert({"model", 1}, "a", "result a", cache.get());
+  LookupOrInsert({"model", 2}, "a", "result a2", cache.get());
+
+  cache->InvalidateVersion({"model", 1});
+  EXPECT_EQ(1, cache->num_entries());
+  EXPECT_FALSE(LookupOrInsert({"model", 1}, "a", "result a", cache.get()));
+  EXPECT_TRUE(LookupOrInsert({"model", 2}, "a", "result a2", cache.get()));
+}
+
+TEST(InferenceResultCacheTest, DisablingAModelDropsItsResults) {
+  auto cache = CreateCache(InferenceResultCache::Options(), "model");
+  LookupOrInsert({"model", 1}, "a", "result a", cache.get());
+  EXPECT_EQ(1, cache->num_entries());
+
+  cache->UpdateModelConfigs({});
+  EXPECT_EQ(0, cache->num_entries());
+  EXPECT_EQ(0, cache->size_bytes());
+  StringValue response;
+  optional<InferenceResultCache::Key> key;
+  EXPECT_FALSE(cache->Lookup("Predict", {"model", 1}, CreateMessage("a"),
+                             &response, &key));
+  EXPECT_FALSE(key);
+}
+
+TEST(InferenceResultCacheTest, EvictsLeastRecentlyUsed) {
+  InferenceResultCache::Options options;
+  options.num_shards = 1;
+  auto cache = CreateCache(options, "model");
+  LookupOrInsert({"model", 1}, "a", "result a", cache.get());
+  const int64 entry_size_bytes = cache->size_bytes();
+
+  // Leave room for two entries of the same size.
+  options.capacity_bytes = 2 * entry_size_bytes;
+  cache = CreateCache(options, "model");
+  LookupOrInsert({"model", 1}, "a", "result a", cache.get());
+  LookupOrInsert({"model", 1}, "b", "result b", cache.get());
+  // Use "a", so that "b" is the least recently used.
+  EXPECT_TRUE(LookupOrInsert({"model", 1}, "a", "result a", cache.get()));
+  LookupOrInsert({"model", 1}, "c", "result c", cache.get());
+
+  EXPECT_EQ(2, cache->num_entries());
+  EXPECT_LE(cache->size_bytes(), options.capacity_bytes);
+  EXPECT_TRUE(LookupOrInsert({"model", 1}, "a", "result a", cache.get()));
+  EXPECT_TRUE(LookupOrInsert({"model", 1}, "c", "result c", cache.get()));
+  EXPECT_FALSE(LookupOrInsert({"model", 1}, "b", "result b", cache.get()));
+}
+
+TEST(InferenceResultCacheTest, ResultsLargerThanAShardAreNotCached) {
+  InferenceResultCache::Options options;
+  options.capacity_bytes = 1024;
+  options.num_shards = 2;
+  auto cache = CreateCache(options, "model");
+  LookupOrInsert({"model", 1}, "a", string(600, 'x'), cache.get());
+  EXPECT_EQ(0, cache->num_entries());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,101 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/core/lib/core/bits.h"
+
+namespace tensorflow {
+namespace serving {
+
+constexpr int LatencyHistogram::kSubBucketBits;
+constexpr int LatencyHistogram::kMaxValueBits;
+constexpr int LatencyHistogram::kNumBuckets;
+
+namespace {
+
+constexpr int kSubBucketCount = 1 << LatencyHistogram::kSubBucketBits;
+
+}  // namespace
+
+int LatencyHistogram::BucketIndex(const uint64 micros) {
+  if (micros < kSubBucketCount) {
+    return static_cast<int>(micros);
+  }
+  const int exponent = Log2Floor64(micros);
+  if (exponent >= kMaxValueBits) {
+    return kNumBuckets - 1;
+  }
+  const int shift = exponent - kSubBucketBits;
+  const int sub_bucket = static_cast<int>(micros >> shift) - kSubBucketCount;
+  return (shift + 1) * kSubBucketCount + sub_bucket;
+}
+
+uint64 LatencyHistogram::BucketUpperBound(const int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  const int shift = index / kSubBucketCount - 1;
+  const uint64 sub_bucket = index % kSubBucketCount;
+  const uint64 lower_bound = (kSubBucketCount + sub_bucket) << shift;
+  return lower_bound + (uint64{1} << shift) - 1;
+}
+
+void LatencyHistogram::Add(const uint64 micros) {
+  ++buckets_[BucketIndex(micros)];
+  ++count_;
+  sum_ += micros;
+  max_ = std::max(max_, micros);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::Clear() {
+  buckets_.fill(0);
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
+uint64 LatencyHistogram::Percentile(const double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // The rank (1-based) of the latency we are looking for.
+  const double clamped_percentile = std::min(100.0, std::max(0.0, percentile));
+  const uint64 rank = std::max<uint64>(
+      1, static_cast<uint64>(std::ceil(clamped_percentile / 100.0 * count_)));
+  uint64 seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return std::min(BucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,81 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_LATENCY_HISTOGRAM_H_
+#define TENSORFLOW_SERVING_CORE_LATENCY_HISTOGRAM_H_
+
+#include <array>
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A fixed-memory, mergeable histogram of latencies in microseconds, from which
+// percentiles can be estimated.
+//
+// Buckets are log-linear (as in HDR histograms): values below
+// 2^kSubBucketBits have a bucket each, and every further power of two is split
+// in 2^kSubBucketBits equal buckets. A percentile is thus reported with a
+// relative error of at most 1/2^kSubBucketBits (12.5%), whatever the order of
+// magnitude of the latencies. Values beyond the last bucket (about 19 hours)
+// are counted in the last bucket.
+//
+// This class is not thread-safe.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kMaxValueBits = 36;
+  static constexpr int kNumBuckets =
+      (1 << kSubBucketBits) * (kMaxValueBits - kSubBucketBits + 1);
+
+  LatencyHistogram() { Clear(); }
+
+  // Records one latency.
+  void Add(uint64 micros);
+
+  // Adds all the latencies recorded in 'other' to this histogram.
+  void Merge(const LatencyHistogram& other);
+
+  // Forgets all the recorded latencies.
+  void Clear();
+
+  // Returns an estimate of the latency under which 'percentile' percents (in
+  // [0, 100]) of the recorded latencies are. The estimate never exceeds
+  // max(). Returns 0 if the histogram is empty.
+  uint64 Percentile(double percentile) const;
+
+  uint64 count() const { return count_; }
+  uint64 sum() const { return sum_; }
+  uint64 max() const { return max_; }
+
+  // Returns the bucket 'micros' belongs to. Exposed for testing.
+  static int BucketIndex(uint64 micros);
+
+  // Returns the largest latency which belongs to bucket 'index'. Exposed for
+  // testing.
+  static uint64 BucketUpperBound(int index);
+
+ private:
+  std::array<uint64, kNumBuckets> buckets_;
+  uint64 count_;
+  uint64 sum_;
+  uint64 max_;
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_LATENCY_HISTOGRAM_H_
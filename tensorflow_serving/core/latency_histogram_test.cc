@@ -0,0 +1,89 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/latency_histogram.h"
+
+#include <gtest/gtest.h>
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(LatencyHistogramTest, Buckets) {
+  for (uint64 micros = 0; micros < (1 << 20); ++micros) {
+    const int index = LatencyHistogram::BucketIndex(micros);
+    ASSERT_GE(index, 0);
+    ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+    ASSERT_LE(micros, LatencyHistogram::BucketUpperBound(index));
+    if (index > 0) {
+      ASSERT_GT(micros, LatencyHistogram::BucketUpperBound(index - 1));
+    }
+  }
+  // Values beyond the range of the buckets go to the last one.
+  EXPECT_EQ(LatencyHistogram::kNumBuckets - 1,
+            LatencyHistogram::BucketIndex(uint64{1} << 50));
+}
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.sum());
+  EXPECT_EQ(0, histogram.max());
+  EXPECT_EQ(0, histogram.Percentile(50));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  for (uint64 micros = 1; micros <= 1000; ++micros) {
+    histogram.Add(micros);
+  }
+  EXPECT_EQ(1000, histogram.count());
+  EXPECT_EQ(500500, histogram.sum());
+  EXPECT_EQ(1000, histogram.max());
+  EXPECT_EQ(1000, histogram.Percentile(100));
+
+  // Percentiles are reported with a bounded relative error.
+  const double max_relative_error =
+      1.0 / (1 << LatencyHistogram::kSubBucketBits);
+  for (const double percentile : {50.0, 90.0, 99.0, 99.9}) {
+    const double expected = percentile * 10;
+    EXPECT_GE(histogram.Percentile(percentile), expected);
+    EXPECT_LE(histogram.Percentile(percentile),
+              expected * (1 + max_relative_error));
+  }
+}
+
+TEST(LatencyHistogramTest, MergeAndClear) {
+  LatencyHistogram histogram_a;
+  histogram_a.Add(10);
+  histogram_a.Add(20);
+  LatencyHistogram histogram_b;
+  histogram_b.Add(5000);
+
+  histogram_a.Merge(histogram_b);
+  EXPECT_EQ(3, histogram_a.count());
+  EXPECT_EQ(5030, histogram_a.sum());
+  EXPECT_EQ(5000, histogram_a.max());
+  EXPECT_EQ(5000, histogram_a.Percentile(99));
+  EXPECT_EQ(1, histogram_b.count());
+
+  histogram_a.Clear();
+  EXPECT_EQ(0, histogram_a.count());
+  EXPECT_EQ(0, histogram_a.Percentile(99));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
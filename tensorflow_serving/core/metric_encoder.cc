@@ -0,0 +1,126 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/metric_encoder.h"
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Appends 'value' to 'output', escaping the characters which are special in
+// line protocol tags and measurements.
+void AppendEscaped(const StringPiece value, string* const output) {
+  for (const char c : value) {
+    if (c == ',' || c == ' ' || c == '=') {
+      output->push_back('\\');
+    }
+    output->push_back(c);
+  }
+}
+
+class LineProtocolFieldVisitor : public MetricFieldVisitor {
+ public:
+  LineProtocolFieldVisitor(string* const tags, string* const fields)
+      : tags_(tags), fields_(fields) {}
+
+  void VisitString(const StringPiece name, const StringPiece value) override {
+    tags_->push_back(',');
+    tags_->append(name.data(), name.size());
+    tags_->push_back('=');
+    AppendEscaped(value, tags_);
+  }
+
+  void VisitInt(const StringPiece name, const int64 value) override {
+    StartField(name);
+    // AlphaNum formats the integer on the stack, without allocating.
+    strings::StrAppend(fields_, value, "i");
+  }
+
+  void VisitBool(const StringPiece name, const bool value) override {
+    StartField(name);
+    fields_->append(value ? "true" : "false");
+  }
+
+ private:
+  void StartField(const StringPiece name) {
+    if (!fields_->empty()) {
+      fields_->push_back(',');
+    }
+    fields_->append(name.data(), name.size());
+    fields_->push_back('=');
+  }
+
+  string* const tags_;
+  string* const fields_;
+};
+
+void PutString(const StringPiece value, string* const output) {
+  core::PutVarint32(output, value.size());
+  output->append(value.data(), value.size());
+}
+
+class BinaryFieldVisitor : public MetricFieldVisitor {
+ public:
+  explicit BinaryFieldVisitor(string* const output) : output_(output) {}
+
+  void VisitString(const StringPiece name, const StringPiece value) override {
+    output_->push_back(BinaryMetricEncoder::kString);
+    PutString(value, output_);
+  }
+
+  void VisitInt(const StringPiece name, const int64 value) override {
+    output_->push_back(BinaryMetricEncoder::kInt);
+    // Zigzag encoding, so that small negative values stay short.
+    core::PutVarint64(output_, (static_cast<uint64>(value) << 1) ^
+                                   static_cast<uint64>(value >> 63));
+  }
+
+  void VisitBool(const StringPiece name, const bool value) override {
+    output_->push_back(BinaryMetricEncoder::kBool);
+    output_->push_back(value ? 1 : 0);
+  }
+
+ private:
+  string* const output_;
+};
+
+}  // namespace
+
+void LineProtocolMetricEncoder::Encode(const MetricCollector::Metric& metric,
+                                       string* const output) {
+  AppendEscaped(metric.metric_name_, output);
+  fields_.clear();
+  LineProtocolFieldVisitor visitor(output, &fields_);
+  metric.VisitFields(&visitor);
+  output->push_back(' ');
+  output->append(fields_);
+  output->push_back('\n');
+}
+
+void BinaryMetricEncoder::Encode(const MetricCollector::Metric& metric,
+                                 string* const output) {
+  record_.clear();
+  PutString(metric.metric_name_, &record_);
+  BinaryFieldVisitor visitor(&record_);
+  metric.VisitFields(&visitor);
+  core::PutVarint32(output, record_.size());
+  output->append(record_);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
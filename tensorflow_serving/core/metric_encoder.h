@@ -0,0 +1,91 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_METRIC_ENCODER_H_
+#define TENSORFLOW_SERVING_CORE_METRIC_ENCODER_H_
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/metrics_collector.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Encodes metrics from their fields (see MetricCollector::Metric::VisitFields())
+// rather than from their DebugString(), appending to a caller-provided buffer
+// so that the buffer can be reused across metrics without allocating.
+//
+// Implementations need not be thread-safe.
+class MetricEncoder {
+ public:
+  virtual ~MetricEncoder() = default;
+
+  // Appends the encoding of 'metric' to 'output'.
+  virtual void Encode(const MetricCollector::Metric& metric,
+                      string* output) = 0;
+
+ protected:
+  MetricEncoder() = default;
+};
+
+// Encodes metrics in the InfluxDB line protocol, also understood by Telegraf
+// and most StatsD-compatible agents, one line per metric:
+//   PredictMetric,model_name=inception metric_version=3i,model_version=1i,...
+// String fields become tags, and the other fields become fields. No timestamp
+// is written: the agent stamps the metrics on reception.
+class LineProtocolMetricEncoder : public MetricEncoder {
+ public:
+  LineProtocolMetricEncoder() = default;
+  ~LineProtocolMetricEncoder() override = default;
+
+  void Encode(const MetricCollector::Metric& metric, string* output) override;
+
+ private:
+  // Holds the fields of the metric being encoded, which go after all the tags.
+  // Kept across calls to reuse its storage.
+  string fields_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LineProtocolMetricEncoder);
+};
+
+// Encodes metrics as compact binary records:
+//   record := varint32(length of the rest) metric_name field*
+//   field  := 0x00 zigzag-varint64   (int)
+//           | 0x01 byte              (bool)
+//           | 0x02 string            (string)
+//   string := varint32(length) bytes
+// Field names are not written: the fields of a metric type always come in the
+// same order, the one of its VisitFields().
+class BinaryMetricEncoder : public MetricEncoder {
+ public:
+  enum FieldType : char { kInt = 0, kBool = 1, kString = 2 };
+
+  BinaryMetricEncoder() = default;
+  ~BinaryMetricEncoder() override = default;
+
+  void Encode(const MetricCollector::Metric& metric, string* output) override;
+
+ private:
+  // Holds the record being encoded, until its length is known. Kept across
+  // calls to reuse its storage.
+  string record_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BinaryMetricEncoder);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_METRIC_ENCODER_H_
@@ -0,0 +1,85 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/metric_encoder.h"
+
+#include <gtest/gtest.h>
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+MetricCollector::PredictMetric CreatePredictMetric() {
+  MetricCollector::PredictMetric metric = {"PredictMetric", 3, 10,
+                                           "incep tion",    1, true};
+  metric.predict_time_micros_ = 10500;
+  return metric;
+}
+
+TEST(LineProtocolMetricEncoderTest, Encode) {
+  LineProtocolMetricEncoder encoder;
+  MetricCollector::PredictMetric metric = CreatePredictMetric();
+  string output = "previous\n";
+  encoder.Encode(metric, &output);
+  EXPECT_EQ(
+      "previous\n"
+      "PredictMetric,model_name=incep\\ tion metric_version=3i,"
+      "model_version=1i,is_success=true,predict_time_ms=10i,"
+      "predict_time_micros=10500i\n",
+      output);
+}
+
+TEST(LineProtocolMetricEncoderTest, EncodeSummary) {
+  LineProtocolMetricEncoder encoder;
+  MetricCollector::PredictMetricSummary metric = {
+      "PredictSummary", 7, 2, "inception", 1, false, 30};
+  metric.p50_predict_time_micros_ = 1900;
+  string output;
+  encoder.Encode(metric, &output);
+  EXPECT_EQ(
+      "PredictSummary,model_name=inception metric_version=0i,"
+      "model_version=1i,is_success=false,prediction_count=7i,"
+      "average_predict_time_ms=2i,summary_period=30i,"
+      "p50_predict_time_micros=1900i,p90_predict_time_micros=0i,"
+      "p99_predict_time_micros=0i,p999_predict_time_micros=0i,"
+      "max_predict_time_micros=0i\n",
+      output);
+}
+
+TEST(BinaryMetricEncoderTest, Encode) {
+  BinaryMetricEncoder encoder;
+  MetricCollector::PredictMetric metric = {"P", 1, 2, "m", -1, true};
+  metric.predict_time_micros_ = 300;
+  string output;
+  encoder.Encode(metric, &output);
+  const string expected = {
+      16,                     // Record length.
+      1,    'P',              // metric_name
+      0,    2,                // metric_version, zigzag-encoded.
+      2,    1,    'm',        // model_name
+      0,    1,                // model_version (-1), zigzag-encoded.
+      1,    1,                // is_success
+      0,    4,                // predict_time_ms, zigzag-encoded.
+      0,    '\xd8', '\x04'};  // predict_time_micros, zigzag-encoded.
+  EXPECT_EQ(expected, output);
+
+  // Records are appended.
+  encoder.Encode(metric, &output);
+  EXPECT_EQ(expected + expected, output);
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,86 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/metrics_collector.h"
+
+#include <unordered_map>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// This class is thread-safe.
+class Registry {
+ public:
+  Status Register(const string& type, const MetricCollector::Factory& factory)
+      LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    const auto found_it = factory_map_.find(type);
+    if (found_it != factory_map_.end()) {
+      return errors::AlreadyExists("Type ", type, " already registered.");
+    }
+    factory_map_.insert({type, factory});
+    return Status::OK();
+  }
+
+  const MetricCollector::Factory* Lookup(const string& type) const
+      LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    const auto found_it = factory_map_.find(type);
+    if (found_it == factory_map_.end()) {
+      return nullptr;
+    }
+    return &(found_it->second);
+  }
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<string, MetricCollector::Factory> factory_map_
+      GUARDED_BY(mu_);
+};
+
+Registry* GetRegistry() {
+  static auto* registry = new Registry();
+  return registry;
+}
+
+}  // namespace
+
+Status MetricCollector::RegisterFactory(const string& type,
+                                        const Factory& factory) {
+  return GetRegistry()->Register(type, factory);
+}
+
+Status MetricCollector::Create(
+    const string& target,
+    std::unique_ptr<MetricCollector>* const metric_collector) {
+  const size_t separator = target.find(':');
+  const string type = target.substr(0, separator);
+  const string argument =
+      separator == string::npos ? "" : target.substr(separator + 1);
+  auto* factory = GetRegistry()->Lookup(type);
+  if (factory == nullptr) {
+    return errors::NotFound("Cannot find MetricCollector::Factory for type: ",
+                            type);
+  }
+  return (*factory)(argument, metric_collector);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
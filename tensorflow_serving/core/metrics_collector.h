@@ -16,13 +16,34 @@
 #ifndef TENSORFLOW_SERVING_CORE_METRICS_COLLECTOR_H_
 #define TENSORFLOW_SERVING_CORE_METRICS_COLLECTOR_H_
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
 namespace serving {
 
+// Receives the fields of a metric, in a fixed order for a given metric type.
+// See MetricCollector::Metric::VisitFields().
+class MetricFieldVisitor {
+ public:
+  virtual ~MetricFieldVisitor() = default;
+
+  virtual void VisitString(StringPiece name, StringPiece value) = 0;
+  virtual void VisitInt(StringPiece name, int64 value) = 0;
+  virtual void VisitBool(StringPiece name, bool value) = 0;
+};
+
 // MetricCollector defines an abstract interface to use for publishing metrics.
+//
+// Each MetricCollector implementation is registered along with a 'type' (see
+// REGISTER_METRIC_COLLECTOR below), and Create() instantiates the collector
+// registered for a given type.
 class MetricCollector {
  public:
   // Abstract structure for metric.
@@ -38,6 +59,16 @@ class MetricCollector {
 
     // Returns a string representation of this object. Useful in logging.
     virtual string DebugString() = 0;
+    // Returns a copy of this object, e.g. to publish it asynchronously.
+    virtual std::unique_ptr<Metric> Clone() const = 0;
+    // Passes the fields of this object to 'visitor', without formatting them.
+    // Subclasses extend it with their own fields, after the ones of Metric
+    // (which doesn't include 'metric_name_', see MetricEncoder).
+    virtual void VisitFields(MetricFieldVisitor* visitor) const {
+      visitor->VisitInt("metric_version", metric_version_);
+      visitor->VisitString("model_name", model_name_);
+      visitor->VisitInt("model_version", model_version_);
+    }
     virtual ~Metric() {}
     string metric_name_;
     int64 metric_version_ = 0;
@@ -67,11 +98,24 @@ class MetricCollector {
                              std::to_string(model_version_), "\"",
                              " is_success=\"", std::to_string(is_success_),
                              "\"", " predict_time_ms=\"",
-                             std::to_string(predict_time_ms_), "\"");
+                             std::to_string(predict_time_ms_), "\"",
+                             " predict_time_micros=\"",
+                             std::to_string(predict_time_micros_), "\"");
+    }
+    std::unique_ptr<Metric> Clone() const override {
+      return std::unique_ptr<Metric>(new PredictMetric(*this));
+    }
+    void VisitFields(MetricFieldVisitor* visitor) const override {
+      Metric::VisitFields(visitor);
+      visitor->VisitBool("is_success", is_success_);
+      visitor->VisitInt("predict_time_ms", predict_time_ms_);
+      visitor->VisitInt("predict_time_micros", predict_time_micros_);
     }
     virtual ~PredictMetric(){}
     uint64 predict_time_ms_ = 0;
     bool is_success_ = false;
+    // Same as predict_time_ms_, at microsecond resolution.
+    uint64 predict_time_micros_ = 0;
   };
 
   // Structure for summary predict metric
@@ -100,7 +144,34 @@ class MetricCollector {
                              "\"", " average_predict_time_ms=\"",
                              std::to_string(average_predict_time_ms_), "\"",
                              " summary_period=\"",
-                             std::to_string(summary_period_), "\"");
+                             std::to_string(summary_period_), "\"",
+                             " p50_predict_time_micros=\"",
+                             std::to_string(p50_predict_time_micros_), "\"",
+                             " p90_predict_time_micros=\"",
+                             std::to_string(p90_predict_time_micros_), "\"",
+                             " p99_predict_time_micros=\"",
+                             std::to_string(p99_predict_time_micros_), "\"",
+                             " p999_predict_time_micros=\"",
+                             std::to_string(p999_predict_time_micros_), "\"",
+                             " max_predict_time_micros=\"",
+                             std::to_string(max_predict_time_micros_), "\"");
+    }
+
+    std::unique_ptr<Metric> Clone() const override {
+      return std::unique_ptr<Metric>(new PredictMetricSummary(*this));
+    }
+
+    void VisitFields(MetricFieldVisitor* visitor) const override {
+      Metric::VisitFields(visitor);
+      visitor->VisitBool("is_success", is_success_);
+      visitor->VisitInt("prediction_count", prediction_count_);
+      visitor->VisitInt("average_predict_time_ms", average_predict_time_ms_);
+      visitor->VisitInt("summary_period", summary_period_);
+      visitor->VisitInt("p50_predict_time_micros", p50_predict_time_micros_);
+      visitor->VisitInt("p90_predict_time_micros", p90_predict_time_micros_);
+      visitor->VisitInt("p99_predict_time_micros", p99_predict_time_micros_);
+      visitor->VisitInt("p999_predict_time_micros", p999_predict_time_micros_);
+      visitor->VisitInt("max_predict_time_micros", max_predict_time_micros_);
     }
 
     uint64 prediction_count_ = 0;
@@ -108,14 +179,137 @@ class MetricCollector {
     uint64 average_predict_time_ms_ = 0;
     bool is_success_ = false;
 
+    // Latency distribution over the summary period, at microsecond
+    // resolution. Percentiles are estimates, see LatencyHistogram.
+    uint64 p50_predict_time_micros_ = 0;
+    uint64 p90_predict_time_micros_ = 0;
+    uint64 p99_predict_time_micros_ = 0;
+    uint64 p999_predict_time_micros_ = 0;
+    uint64 max_predict_time_micros_ = 0;
+
+  };
+
+  // Structure for the time spent in each phase of one request (see
+  // RequestTiming).
+  struct RequestPhasesMetric : public Metric {
+    RequestPhasesMetric() = default;
+    RequestPhasesMetric(const string metric_name, const int64 metric_version,
+                        const string method_name, const string model_name,
+                        const int64 model_version, const bool is_success)
+        : Metric(metric_name, metric_version, model_name, model_version),
+          method_name_(method_name),
+          is_success_(is_success) {
+    }
+
+    // Returns a string representation of this object. Useful in logging.
+    string DebugString() {
+      return strings::StrCat("metric_name=\"", metric_name_, "\"",
+                             " metric_version=\"",
+                             std::to_string(metric_version_), "\"",
+                             " method_name=\"", method_name_, "\"",
+                             " model_name=\"", model_name_, "\"",
+                             " model_version=\"",
+                             std::to_string(model_version_), "\"",
+                             " is_success=\"", std::to_string(is_success_),
+                             "\"", " total_micros=\"",
+                             std::to_string(total_micros_), "\"",
+                             " handle_acquisition_micros=\"",
+                             std::to_string(handle_acquisition_micros_), "\"",
+                             " request_decoding_micros=\"",
+                             std::to_string(request_decoding_micros_), "\"",
+                             " batching_queue_wait_micros=\"",
+                             std::to_string(batching_queue_wait_micros_), "\"",
+                             " session_run_micros=\"",
+                             std::to_string(session_run_micros_), "\"",
+                             " response_encoding_micros=\"",
+                             std::to_string(response_encoding_micros_), "\"");
+    }
+    std::unique_ptr<Metric> Clone() const override {
+      return std::unique_ptr<Metric>(new RequestPhasesMetric(*this));
+    }
+    void VisitFields(MetricFieldVisitor* visitor) const override {
+      Metric::VisitFields(visitor);
+      visitor->VisitString("method_name", method_name_);
+      visitor->VisitBool("is_success", is_success_);
+      visitor->VisitInt("total_micros", total_micros_);
+      visitor->VisitInt("handle_acquisition_micros",
+                        handle_acquisition_micros_);
+      visitor->VisitInt("request_decoding_micros", request_decoding_micros_);
+      visitor->VisitInt("batching_queue_wait_micros",
+                        batching_queue_wait_micros_);
+      visitor->VisitInt("session_run_micros", session_run_micros_);
+      visitor->VisitInt("response_encoding_micros", response_encoding_micros_);
+    }
+
+    // "Predict", "Classify", "Regress" or "MultiInference".
+    string method_name_;
+    bool is_success_ = false;
+    // Wall time of the whole request.
+    uint64 total_micros_ = 0;
+    uint64 handle_acquisition_micros_ = 0;
+    uint64 request_decoding_micros_ = 0;
+    // Part of session_run_micros_.
+    uint64 batching_queue_wait_micros_ = 0;
+    uint64 session_run_micros_ = 0;
+    uint64 response_encoding_micros_ = 0;
   };
   virtual ~MetricCollector() = default;
+
+  // Creates the metric collector registered for 'type'. 'target' has the form
+  // "<type>" or "<type>:<argument>", e.g. "line_protocol:/run/agent.sock";
+  // the argument, if any, is passed to the factory of the type.
+  static Status Create(const string& target,
+                       std::unique_ptr<MetricCollector>* metric_collector);
+
+  using Factory = std::function<Status(
+      const string& argument, std::unique_ptr<MetricCollector>*)>;
+  // Registers a factory for creating metric collectors of a particular 'type'.
+  // Returns an error status if a factory is already registered for the
+  // particular 'type'.
+  static Status RegisterFactory(const string& type, const Factory& factory);
+
   virtual Status PublishMetric(Metric* metric) = 0;
 
+  // Publishes a batch of metrics. Collectors which can write a batch more
+  // efficiently than one metric at a time should override this. Returns the
+  // first error encountered, if any.
+  virtual Status PublishMetrics(const std::vector<Metric*>& metrics) {
+    Status status;
+    for (Metric* metric : metrics) {
+      status.Update(PublishMetric(metric));
+    }
+    return status;
+  }
+
  protected:
   MetricCollector() = default;
 };
+
+namespace register_metric_collector {
+
+struct RegisterFactory {
+  RegisterFactory(const string& type, const MetricCollector::Factory& factory) {
+    // This check happens during global object construction time, even before
+    // control reaches main(), so we are ok with the crash.
+    TF_CHECK_OK(MetricCollector::RegisterFactory(type, factory));  // Crash ok.
+  }
+};
+
+}  // namespace register_metric_collector
+
 }  // namespace serving
 }  // namespace tensorflow
 
+#define REGISTER_METRIC_COLLECTOR_UNIQ_HELPER(ctr, type, factory) \
+  REGISTER_METRIC_COLLECTOR_UNIQ(ctr, type, factory)
+#define REGISTER_METRIC_COLLECTOR_UNIQ(ctr, type, factory)                   \
+  static ::tensorflow::serving::register_metric_collector::RegisterFactory   \
+      register_mc##ctr TF_ATTRIBUTE_UNUSED =                                 \
+          ::tensorflow::serving::register_metric_collector::RegisterFactory( \
+              type, factory)
+
+// Registers a MetricCollector factory implementation for a type.
+#define REGISTER_METRIC_COLLECTOR(type, factory) \
+  REGISTER_METRIC_COLLECTOR_UNIQ_HELPER(__COUNTER__, type, factory)
+
 #endif  // TENSORFLOW_SERVING_CORE_METRICS_COLLECTOR_H_
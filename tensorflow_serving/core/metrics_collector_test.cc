@@ -23,6 +23,7 @@
 #include "tensorflow_serving/core/metrics_collector.h"
 
 #include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/error_codes.pb.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 namespace tensorflow {
 namespace serving {
@@ -85,6 +86,43 @@ TEST(MetricsCollectorTest, PublishPredictMetricSummary) {
 
 }
 
+class FakeMetricCollector : public MetricCollector {
+ public:
+  explicit FakeMetricCollector(const string& argument) : argument_(argument) {}
+  Status PublishMetric(Metric* metric) override { return Status::OK(); }
+  const string argument_;
+};
+
+auto fake_factory = [](const string& argument,
+                       std::unique_ptr<MetricCollector>* metric_collector) {
+  metric_collector->reset(new FakeMetricCollector(argument));
+  return Status::OK();
+};
+REGISTER_METRIC_COLLECTOR("fake", fake_factory);
+
+TEST(MetricsCollectorTest, NotRegistered) {
+  std::unique_ptr<MetricCollector> metric_collector;
+  const Status status =
+      MetricCollector::Create("notregistered", &metric_collector);
+  EXPECT_EQ(status.code(), error::NOT_FOUND);
+}
+
+TEST(MetricsCollectorTest, DuplicateRegistration) {
+  const Status status = MetricCollector::RegisterFactory("fake", fake_factory);
+  EXPECT_EQ(status.code(), error::ALREADY_EXISTS);
+}
+
+TEST(MetricsCollectorTest, CreateWithArgument) {
+  std::unique_ptr<MetricCollector> metric_collector;
+  TF_ASSERT_OK(MetricCollector::Create("fake", &metric_collector));
+  EXPECT_EQ("", static_cast<FakeMetricCollector*>(metric_collector.get())
+                    ->argument_);
+
+  TF_ASSERT_OK(MetricCollector::Create("fake:/run/a:b", &metric_collector));
+  EXPECT_EQ("/run/a:b", static_cast<FakeMetricCollector*>(
+                            metric_collector.get())->argument_);
+}
+
 }// namespace
 }// namespace serving
 }// namespace tensorflow
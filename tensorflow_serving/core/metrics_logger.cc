@@ -15,6 +15,9 @@
 
 #include "metrics_logger.h"
 
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
 
 namespace tensorflow {
 namespace serving {
@@ -24,5 +27,29 @@ Status MetricLogger::PublishMetric(Metric* metric) {
   return Status::OK();
 }
 
+Status MetricLogger::PublishMetrics(const std::vector<Metric*>& metrics) {
+  if (metrics.empty()) {
+    return Status::OK();
+  }
+  string lines;
+  for (Metric* metric : metrics) {
+    strings::StrAppend(&lines, lines.empty() ? "" : "\n",
+                       metric->DebugString());
+  }
+  LOG(INFO) << lines;
+  return Status::OK();
+}
+
+namespace {
+
+auto logger_factory = [](const string& argument,
+                         std::unique_ptr<MetricCollector>* metric_collector) {
+  metric_collector->reset(new MetricLogger());
+  return Status::OK();
+};
+REGISTER_METRIC_COLLECTOR("logger", logger_factory);
+
+}  // namespace
+
 }  // namespace serving
 }  // namespace tensorflow
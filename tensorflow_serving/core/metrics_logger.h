@@ -30,6 +30,8 @@ class MetricLogger : public MetricCollector {
 
   Status PublishMetric(Metric* metric);
 
+  // Writes the whole batch as a single log entry, one metric per line.
+  Status PublishMetrics(const std::vector<Metric*>& metrics) override;
 
 };
 }  // namespace serving
@@ -15,30 +15,55 @@
 #ifndef TENSORFLOW_SERVING_CORE_METRICS_MANAGER_H_
 #define TENSORFLOW_SERVING_CORE_METRICS_MANAGER_H_
 
-#include <atomic>
+#include <memory>
+
 #include "tensorflow/core/lib/core/status.h"
-#include "servable_state.h"
-#include "servable_state_monitor.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/request_timing.h"
 
 namespace tensorflow {
 namespace serving {
 
+// MetricsManager receives the metrics recorded on the request path and hands
+// them over to a MetricCollector, optionally together with periodic summaries.
+//
+// Implementations must be thread-safe: the recording methods are called
+// concurrently from every request thread.
 class MetricsManager {
-
  public:
+  virtual ~MetricsManager() = default;
 
   // Create metrics publisher and instantiate the metrics manager.
+  //
+  // If 'metric_queue_capacity' is positive, metrics are published
+  // asynchronously through a queue of that capacity (see
+  // AsyncMetricCollector), and are dropped when the queue is full if
+  // 'drop_metrics_on_overflow' is true. Otherwise they are published on the
+  // request threads.
   static Status Create(const string target, const bool enable_metric_summary,
                        const int32 metric_summary_wait_seconds,
+                       const int64 metric_queue_capacity,
+                       const bool drop_metrics_on_overflow,
                        std::unique_ptr<MetricsManager>* metrics_manager);
 
-  // Create a notifier to handle metrics end event.
-  ServableStateMonitor::ServableStateNotifierFn CreateNotifier(
-      const uint64& elapsed_predict_time, const Status& result_status,
-      const string& model_name, const int64& model_version);
+  // Records the outcome of a single predict call on 'model_name' at
+  // 'model_version', which took 'elapsed_predict_time_micros'.
+  virtual void RecordPredict(const string& model_name, int64 model_version,
+                             uint64 elapsed_predict_time_micros,
+                             const Status& result_status) = 0;
 
-  Status KillSummaryThread();
+  // Records the time spent in each phase of a single 'method_name' request
+  // (e.g. "Classify") on 'model_name' at 'model_version', which took
+  // 'elapsed_time_micros' overall.
+  virtual void RecordRequestPhases(const string& method_name,
+                                   const string& model_name,
+                                   int64 model_version,
+                                   uint64 elapsed_time_micros,
+                                   const RequestTiming& timing,
+                                   const Status& result_status) = 0;
 
+  // Stops publishing summary metrics, if they were enabled.
+  virtual Status KillSummaryThread() = 0;
 };
 }  // namespace serving
 }  // namespace tensorflow
@@ -24,5 +24,16 @@ Status MetricSyslog::PublishMetric(Metric* metric) {
   return Status::OK();
 }
 
+namespace {
+
+auto syslog_factory = [](const string& argument,
+                         std::unique_ptr<MetricCollector>* metric_collector) {
+  metric_collector->reset(new MetricSyslog());
+  return Status::OK();
+};
+REGISTER_METRIC_COLLECTOR("syslog", syslog_factory);
+
+}  // namespace
+
 }  // namespace serving
 }  // namespace tensorflow
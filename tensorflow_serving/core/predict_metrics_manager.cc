@@ -12,143 +12,165 @@
  See the License for the specific language governing permissions and
  limitations under the License.
  ==============================================================================*/
-#include <chrono>
-#include <thread>
-#include <future>
+#include "tensorflow_serving/core/predict_metrics_manager.h"
 
-#include "predict_metrics_manager.h"
-#include "metrics_logger.h"
-#include "metrics_syslog.h"
+#include <utility>
 
-using ServableStateAndTime = tensorflow::serving::ServableStateMonitor::ServableStateAndTime;
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow_serving/core/async_metric_collector.h"
 
 namespace tensorflow {
 namespace serving {
 
-std::map<ServableId, MetricCollector::PredictMetric> metrics_map_;
-std::map<string, MetricCollector::PredictMetricSummary> summary_metrics_;
-uint32 metric_summary_wait_seconds_;
-MetricCollector* metric_collector_;
-std::future<void> summary_async_;
-std::atomic<bool> summary_thread_running_ { true };
-
 PredictMetricsManager::PredictMetricsManager(MetricCollector& metric_collector,
-                                             bool enable_metric_summary,
-                                             int metric_summary_wait_seconds) {
-  metric_collector_ = &metric_collector;
-  metric_summary_wait_seconds_ = metric_summary_wait_seconds;
-  if (enable_metric_summary) {
-    // Start an async task for publishing summary metrics every $metric_summary_wait_seconds seconds.
-    summary_async_ = std::async(std::launch::async, [this] {
-      while(summary_thread_running_)
-      {
-        this->CreateSummaryMetric(metrics_map_, summary_metrics_);
-        for (auto &metric : summary_metrics_) {
-          metric_collector_->PublishMetric(&metric.second);
-        }
-
-        metrics_map_.clear();
-        summary_metrics_.clear();
-        std::this_thread::sleep_for(
-            std::chrono::seconds(metric_summary_wait_seconds_));
-      }
-    });
+                                             const bool enable_metric_summary,
+                                             const int metric_summary_wait_seconds)
+    : metric_collector_(&metric_collector),
+      enable_metric_summary_(enable_metric_summary),
+      metric_summary_wait_seconds_(metric_summary_wait_seconds) {
+  if (enable_metric_summary_) {
+    // Publish summary metrics every 'metric_summary_wait_seconds' seconds.
+    PeriodicFunction::Options pf_options;
+    pf_options.thread_name_prefix = "PredictMetricsManager_summary_thread";
+    summary_thread_.reset(new PeriodicFunction(
+        [this] { this->PublishSummaryMetrics(); },
+        static_cast<int64>(metric_summary_wait_seconds_) * 1000000,
+        pf_options));
   }
 }
 
-void PredictMetricsManager::CreateSummaryMetric(
-    std::map<ServableId, MetricCollector::PredictMetric>& metrics_map,
-    std::map<string, MetricCollector::PredictMetricSummary>& summary_metrics) {
-
-  uint64 success_predict_count = 0;
-  uint64 failed_predict_count = 0;
-  uint64 predict_count = 0;
-  for (auto &metrics : metrics_map) {
-    string success_summary_key = metrics.second.model_name_
-        + std::to_string(metrics.second.model_version_) + "_success";
-    string failed_summary_key = metrics.second.model_name_
-        + std::to_string(metrics.second.model_version_) + "_failed";
-    string summary_key;
-    if (metrics.second.is_success_) {
-      summary_key = success_summary_key;
-      predict_count = ++success_predict_count;
-    } else {
-      summary_key = failed_summary_key;
-      predict_count = ++failed_predict_count;
-    }
-
-    if (summary_metrics.find(summary_key) != summary_metrics.end()) {
-      MetricCollector::PredictMetricSummary& metric =
-          summary_metrics[summary_key];
-      uint64 average_predict_time_ms = (metric.average_predict_time_ms_
-          + metrics.second.predict_time_ms_) / predict_count;
-      summary_metrics[summary_key] = {"PredictSummary", predict_count, average_predict_time_ms, metrics.second.model_name_, metrics.second.model_version_, metrics.second.is_success_, metric_summary_wait_seconds_};
-    } else {
-      summary_metrics[summary_key] = {"PredictSummary", 1, metrics.second.predict_time_ms_, metrics.second.model_name_, metrics.second.model_version_, metrics.second.is_success_, metric_summary_wait_seconds_};
-    }
-  }
-
+PredictMetricsManager::PredictMetricsManager(
+    std::unique_ptr<MetricCollector> metric_collector,
+    const bool enable_metric_summary, const int metric_summary_wait_seconds)
+    : PredictMetricsManager(*metric_collector, enable_metric_summary,
+                            metric_summary_wait_seconds) {
+  owned_metric_collector_ = std::move(metric_collector);
 }
 
 PredictMetricsManager::~PredictMetricsManager() {
+  // Stop the summary thread before tearing down the recorder and collector it
+  // uses.
   KillSummaryThread();
 }
 
-ServableStateMonitor::ServableStateNotifierFn MetricsManager::CreateNotifier(
-    const uint64& elapsed_predict_time, const Status& result_status,
-    const string& model_name, const int64& model_version) {
-
-  const ServableStateMonitor::ServableStateNotifierFn& notifier_fn =
-      [&](const bool reached,
-          std::map<ServableId, ServableState::ManagerState> states_reached) {
-        for(auto state_reached : states_reached) {
-          switch(state_reached.second) {
-            case ServableState::ManagerState::kStart :
-            case ServableState::ManagerState::kUnloading :
-            case ServableState::ManagerState::kAvailable :
-            case ServableState::ManagerState::kLoading :
-            break;
-            // We listen only end event for metrics.
-            case ServableState::ManagerState::kEnd :
-            auto elapsed_predict_time_ms = elapsed_predict_time / 1000;
-
-            // Build a predict metric.
-            MetricCollector::PredictMetric metric = {state_reached.first.name, state_reached.first.version, elapsed_predict_time_ms, model_name, model_version, result_status.ok()};
-
-            // Store the metric on a map needed for the summary.
-            metrics_map_[state_reached.first] = metric;
-
-            // Publish metric.
-            metric_collector_->PublishMetric(&metric);
-            break;
-          }
-        }
-      };
-  return notifier_fn;
+void PredictMetricsManager::RecordPredict(
+    const string& model_name, const int64 model_version,
+    const uint64 elapsed_predict_time_micros, const Status& result_status) {
+  MetricCollector::PredictMetric metric = {
+      "PredictMetric",
+      next_predict_metric_version_.fetch_add(1, std::memory_order_relaxed),
+      elapsed_predict_time_micros / 1000,
+      model_name,
+      model_version,
+      result_status.ok()};
+  metric.predict_time_micros_ = elapsed_predict_time_micros;
+  metric_collector_->PublishMetric(&metric);
+
+  if (enable_metric_summary_) {
+    recorder_.Record(model_name, model_version, result_status.ok(),
+                     elapsed_predict_time_micros);
+  }
 }
 
-Status MetricsManager::KillSummaryThread() {
-  summary_thread_running_ = false;
+void PredictMetricsManager::RecordRequestPhases(
+    const string& method_name, const string& model_name,
+    const int64 model_version, const uint64 elapsed_time_micros,
+    const RequestTiming& timing, const Status& result_status) {
+  MetricCollector::RequestPhasesMetric metric = {
+      "RequestPhases",
+      next_request_phases_metric_version_.fetch_add(1,
+                                                    std::memory_order_relaxed),
+      method_name,
+      model_name,
+      model_version,
+      result_status.ok()};
+  metric.total_micros_ = elapsed_time_micros;
+  metric.handle_acquisition_micros_ =
+      timing.micros(RequestPhase::kHandleAcquisition);
+  metric.request_decoding_micros_ =
+      timing.micros(RequestPhase::kRequestDecoding);
+  metric.batching_queue_wait_micros_ =
+      timing.micros(RequestPhase::kBatchingQueueWait);
+  metric.session_run_micros_ = timing.micros(RequestPhase::kSessionRun);
+  metric.response_encoding_micros_ =
+      timing.micros(RequestPhase::kResponseEncoding);
+  metric_collector_->PublishMetric(&metric);
+}
+
+Status PredictMetricsManager::KillSummaryThread() {
+  // Destroying the PeriodicFunction joins the thread.
+  summary_thread_ = nullptr;
   return Status::OK();
 }
 
+void PredictMetricsManager::PublishSummaryMetrics() {
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder_.Drain(&histograms);
+  std::map<string, MetricCollector::PredictMetricSummary> summary_metrics;
+  CreateSummaryMetric(histograms, &summary_metrics);
+  for (auto& metric : summary_metrics) {
+    metric_collector_->PublishMetric(&metric.second);
+  }
+}
+
+void PredictMetricsManager::CreateSummaryMetric(
+    const PredictMetricsRecorder::HistogramMap& histograms,
+    std::map<string, MetricCollector::PredictMetricSummary>* const
+        summary_metrics) {
+  for (const auto& entry : histograms) {
+    const PredictMetricsRecorder::Key& key = entry.first;
+    const LatencyHistogram& histogram = entry.second;
+    if (histogram.count() == 0) {
+      continue;
+    }
+    const string summary_key =
+        strings::StrCat(key.model_name, key.model_version,
+                        key.is_success ? "_success" : "_failed");
+    const uint64 average_predict_time_ms =
+        histogram.sum() / histogram.count() / 1000;
+    MetricCollector::PredictMetricSummary summary = {
+        "PredictSummary",        histogram.count(),
+        average_predict_time_ms, key.model_name,
+        key.model_version,       key.is_success,
+        metric_summary_wait_seconds_};
+    summary.p50_predict_time_micros_ = histogram.Percentile(50);
+    summary.p90_predict_time_micros_ = histogram.Percentile(90);
+    summary.p99_predict_time_micros_ = histogram.Percentile(99);
+    summary.p999_predict_time_micros_ = histogram.Percentile(99.9);
+    summary.max_predict_time_micros_ = histogram.max();
+    (*summary_metrics)[summary_key] = summary;
+  }
+}
+
 // Create metrics publisher and instantiate the metrics manager.
 Status MetricsManager::Create(
     const string target, const bool enable_metric_summary,
-    const int32 metric_summary_wait_seconds,
+    const int32 metric_summary_wait_seconds, const int64 metric_queue_capacity,
+    const bool drop_metrics_on_overflow,
     std::unique_ptr<MetricsManager>* metrics_manager) {
-  MetricCollector* metric_collector;
-  if (target == "logger") {
-    metric_collector = new MetricLogger();
-  } else if (target == "syslog") {
-    metric_collector = new MetricSyslog();
+  std::unique_ptr<MetricCollector> metric_collector;
+  TF_RETURN_IF_ERROR(MetricCollector::Create(target, &metric_collector));
+  if (metric_queue_capacity < 0 ||
+      (metric_queue_capacity & (metric_queue_capacity - 1)) != 0) {
+    return errors::InvalidArgument(
+        "Metric queue capacity must be 0 or a power of two; got ",
+        metric_queue_capacity);
+  }
+  if (metric_queue_capacity > 0) {
+    AsyncMetricCollector::Options options;
+    options.queue_capacity = metric_queue_capacity;
+    options.overflow_policy = drop_metrics_on_overflow
+                                  ? AsyncMetricCollector::OverflowPolicy::kDrop
+                                  : AsyncMetricCollector::OverflowPolicy::kBlock;
+    metric_collector.reset(
+        new AsyncMetricCollector(options, std::move(metric_collector)));
   }
-  metrics_manager->reset(
-      new PredictMetricsManager(*metric_collector, enable_metric_summary,
-                                metric_summary_wait_seconds));
+  metrics_manager->reset(new PredictMetricsManager(
+      std::move(metric_collector), enable_metric_summary,
+      metric_summary_wait_seconds));
   return Status::OK();
 }
 
-}
-}
-
+}  // namespace serving
+}  // namespace tensorflow
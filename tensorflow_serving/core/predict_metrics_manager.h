@@ -15,25 +15,84 @@
 #ifndef TENSORFLOW_SERVING_CORE_PREDICT_METRICS_MANAGER_H_
 #define TENSORFLOW_SERVING_CORE_PREDICT_METRICS_MANAGER_H_
 
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "tensorflow/contrib/batching/util/periodic_function.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "metrics_manager.h"
-#include "metrics_collector.h"
-#include "servable_state.h"
-#include "servable_state_monitor.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow_serving/core/metrics_collector.h"
+#include "tensorflow_serving/core/metrics_manager.h"
+#include "tensorflow_serving/core/predict_metrics_recorder.h"
 
 namespace tensorflow {
 namespace serving {
 
+// MetricsManager for predict calls. Every call is published right away to the
+// MetricCollector as a PredictMetric and, if summaries are enabled, is also
+// accumulated in a PredictMetricsRecorder which a background thread drains
+// every 'metric_summary_wait_seconds' to publish one PredictMetricSummary per
+// (model name, model version, success) triple, with latency percentiles.
 class PredictMetricsManager : public MetricsManager {
  public:
-  virtual ~PredictMetricsManager();
+  // Does not take ownership of 'metric_collector', which must outlive this
+  // object.
   PredictMetricsManager(MetricCollector& metric_collector,
                         bool enable_metric_summary,
                         int metric_summary_wait_seconds);
-  virtual void CreateSummaryMetric(std::map<ServableId, MetricCollector::PredictMetric>& metrics_map, std::map<string, MetricCollector::PredictMetricSummary>& summary_metrics);
+  // Same as above, but takes ownership of 'metric_collector'.
+  PredictMetricsManager(std::unique_ptr<MetricCollector> metric_collector,
+                        bool enable_metric_summary,
+                        int metric_summary_wait_seconds);
+  ~PredictMetricsManager() override;
+
+  void RecordPredict(const string& model_name, int64 model_version,
+                     uint64 elapsed_predict_time_micros,
+                     const Status& result_status) override;
+
+  // Publishes a RequestPhasesMetric right away.
+  void RecordRequestPhases(const string& method_name, const string& model_name,
+                           int64 model_version, uint64 elapsed_time_micros,
+                           const RequestTiming& timing,
+                           const Status& result_status) override;
+
+  Status KillSummaryThread() override;
+
+  // Drains the recorder and publishes the resulting summaries. Called
+  // periodically by the summary thread; exposed for testing.
+  void PublishSummaryMetrics();
 
+  // Builds one summary per (model name, model version, success) triple out of
+  // 'histograms'. The summaries are keyed by
+  // "<model_name><model_version>_success" or
+  // "<model_name><model_version>_failed".
+  virtual void CreateSummaryMetric(
+      const PredictMetricsRecorder::HistogramMap& histograms,
+      std::map<string, MetricCollector::PredictMetricSummary>*
+          summary_metrics);
+
+ private:
+  std::unique_ptr<MetricCollector> owned_metric_collector_;
+  MetricCollector* const metric_collector_;
+
+  const bool enable_metric_summary_;
+  const uint32 metric_summary_wait_seconds_;
+
+  // Sequence number of the per-request PredictMetrics.
+  std::atomic<int64> next_predict_metric_version_{0};
+  // Sequence number of the RequestPhasesMetrics.
+  std::atomic<int64> next_request_phases_metric_version_{0};
+
+  PredictMetricsRecorder recorder_;
+
+  // Periodically calls PublishSummaryMetrics(), if summaries are enabled.
+  std::unique_ptr<PeriodicFunction> summary_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictMetricsManager);
 };
-}
-}
+
+}  // namespace serving
+}  // namespace tensorflow
 
 #endif /* TENSORFLOW_SERVING_CORE_PREDICT_METRICS_MANAGER_H_ */
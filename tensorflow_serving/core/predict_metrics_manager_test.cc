@@ -14,103 +14,115 @@
  ==============================================================================*/
 
 #include "tensorflow_serving/core/predict_metrics_manager.h"
-#include <gtest/gtest.h>
+
 #include <gmock/gmock.h>
-#include "tensorflow/contrib/batching/test_util/fake_clock_env.h"
-#include "metrics_logger.h"
-#include "metrics_collector.h"
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow_serving/core/metrics_collector.h"
 
 namespace tensorflow {
 namespace serving {
 namespace {
+
 using ::testing::_;
-using ::testing::HasSubstr;
 using ::testing::Invoke;
-using ::testing::NiceMock;
-using ::testing::Return;
-using ::testing::KilledBySignal;
 
 class MockMetricCollector : public MetricCollector {
  public:
   MOCK_METHOD1(PublishMetric, Status(MetricCollector::Metric* metric));
 };
 
-using ServableStateMonitorCreator =
-std::function<Status(EventBus<ServableState>* event_bus,
-    std::unique_ptr<ServableStateMonitor>* monitor)>;
-
-TEST(PredictMetricsManagerTest, CreateNotifier) {
-  uint64 event_start_time = 10;
-  string model_name = "inception";
-  int64 model_version = 1;
-  Status result_status = Status::OK();
-  string predict_metric_name = "PredictMetric";
-  int64 predict_metric_version = 1;
-  ServableState::ManagerState manager_state = ServableState::ManagerState::kEnd;
-
-  test_util::FakeClockEnv env(Env::Default());
-  EventBus<ServableState>::Options bus_options;
-  bus_options.env = &env;
-  auto bus = EventBus<ServableState>::CreateEventBus(bus_options);
-
-  ServableStateMonitor::Options monitor_options;
-  monitor_options.max_count_log_events = 4;
-
-  ServableStateMonitor monitor(bus.get(), monitor_options);
-
-  MockMetricCollector* metric_collector_ = new MockMetricCollector();
-  PredictMetricsManager* manager = new PredictMetricsManager(*metric_collector_,
-                                                             false, 1);
-  ServableStateMonitor::ServableStateNotifierFn notifier_fn = manager
-      ->CreateNotifier(event_start_time, result_status, model_name,
-                       model_version);
-
-  std::vector<ServableRequest> servables;
-  const ServableId specific_goal_state_id = { predict_metric_name,
-      predict_metric_version };
-  servables.push_back(ServableRequest::FromId(specific_goal_state_id));
-  monitor.NotifyWhenServablesReachState(servables, manager_state, notifier_fn);
-
-  ServableState event = { ServableId { predict_metric_name,
-      predict_metric_version }, manager_state, Status::OK() };
-
-  EXPECT_CALL(*metric_collector_, PublishMetric(_)).WillOnce(
-      Return(Status::OK()));
-  EXPECT_NE(nullptr, notifier_fn);
+TEST(PredictMetricsManagerTest, RecordPredictPublishesMetric) {
+  MockMetricCollector metric_collector;
+  PredictMetricsManager manager(metric_collector, false, 1);
+
+  EXPECT_CALL(metric_collector, PublishMetric(_))
+      .WillOnce(Invoke([](MetricCollector::Metric* metric) {
+        auto* predict_metric =
+            dynamic_cast<MetricCollector::PredictMetric*>(metric);
+        EXPECT_NE(nullptr, predict_metric);
+        EXPECT_EQ("PredictMetric", predict_metric->metric_name_);
+        EXPECT_EQ(0, predict_metric->metric_version_);
+        EXPECT_EQ("inception", predict_metric->model_name_);
+        EXPECT_EQ(1, predict_metric->model_version_);
+        EXPECT_EQ(10, predict_metric->predict_time_ms_);
+        EXPECT_EQ(10123, predict_metric->predict_time_micros_);
+        EXPECT_FALSE(predict_metric->is_success_);
+        return Status::OK();
+      }));
+  manager.RecordPredict("inception", 1, 10123, errors::Internal("error"));
+}
 
-  bus.get()->Publish(event);
-  metric_collector_->~MockMetricCollector();
+TEST(PredictMetricsManagerTest, RecordRequestPhasesPublishesMetric) {
+  MockMetricCollector metric_collector;
+  PredictMetricsManager manager(metric_collector, false, 1);
+
+  EXPECT_CALL(metric_collector, PublishMetric(_))
+      .WillOnce(Invoke([](MetricCollector::Metric* metric) {
+        auto* phases_metric =
+            dynamic_cast<MetricCollector::RequestPhasesMetric*>(metric);
+        EXPECT_NE(nullptr, phases_metric);
+        EXPECT_EQ("RequestPhases", phases_metric->metric_name_);
+        EXPECT_EQ("Classify", phases_metric->method_name_);
+        EXPECT_EQ("inception", phases_metric->model_name_);
+        EXPECT_EQ(2, phases_metric->model_version_);
+        EXPECT_TRUE(phases_metric->is_success_);
+        EXPECT_EQ(100, phases_metric->total_micros_);
+        EXPECT_EQ(1, phases_metric->handle_acquisition_micros_);
+        EXPECT_EQ(2, phases_metric->request_decoding_micros_);
+        EXPECT_EQ(3, phases_metric->batching_queue_wait_micros_);
+        EXPECT_EQ(90, phases_metric->session_run_micros_);
+        EXPECT_EQ(4, phases_metric->response_encoding_micros_);
+        return Status::OK();
+      }));
+  RequestTiming timing;
+  timing.Add(RequestPhase::kHandleAcquisition, 1);
+  timing.Add(RequestPhase::kRequestDecoding, 2);
+  timing.Add(RequestPhase::kBatchingQueueWait, 3);
+  timing.Add(RequestPhase::kSessionRun, 90);
+  timing.Add(RequestPhase::kResponseEncoding, 4);
+  manager.RecordRequestPhases("Classify", "inception", 2, 100, timing,
+                              Status::OK());
+}
 
+TEST(PredictMetricsManagerTest, NoSummaryWhenDisabled) {
+  MockMetricCollector metric_collector;
+  PredictMetricsManager manager(metric_collector, false, 1);
+
+  std::map<string, MetricCollector::PredictMetricSummary> published;
+  EXPECT_CALL(metric_collector, PublishMetric(_))
+      .WillRepeatedly(Invoke([&](MetricCollector::Metric* metric) {
+        auto* summary =
+            dynamic_cast<MetricCollector::PredictMetricSummary*>(metric);
+        if (summary != nullptr) {
+          published[strings::StrCat(summary->model_name_,
+                                    summary->model_version_)] = *summary;
+        }
+        return Status::OK();
+      }));
+
+  // Summaries are disabled, so nothing is recorded for them.
+  manager.RecordPredict("inception", 1, 10000, Status::OK());
+  manager.PublishSummaryMetrics();
+  EXPECT_TRUE(published.empty());
 }
 
 TEST(PredictMetricsManagerTest, CreateSummaryMetric) {
-  MockMetricCollector* metric_collector_ = new MockMetricCollector();
-  PredictMetricsManager* manager = new PredictMetricsManager(*metric_collector_,
-                                                             false, 1);
-  string predict_metric_name = "PredictMetric";
-
-  MetricCollector::PredictMetric metric = { predict_metric_name, 1, 10,
-      "inception", 1, true };
-  MetricCollector::PredictMetric metric2 = { predict_metric_name, 2, 20,
-      "inception", 1, true };
-  MetricCollector::PredictMetric metric3 = { predict_metric_name, 3, 5,
-      "inception", 2, true };
-  MetricCollector::PredictMetric metric4 = { predict_metric_name, 4, 5,
-      "resnet", 1, true };
-  MetricCollector::PredictMetric metric5 = { predict_metric_name, 4, 5,
-      "resnet", 1, false };
-  const ServableId specific_goal_state_id = { predict_metric_name, 1 };
-  const ServableId specific_goal_state_id2 = { predict_metric_name, 2 };
-  const ServableId specific_goal_state_id3 = { predict_metric_name, 3 };
-  const ServableId specific_goal_state_id4 = { predict_metric_name, 4 };
-  const ServableId specific_goal_state_id5 = { predict_metric_name, 5 };
-
-  std::map<ServableId, MetricCollector::PredictMetric> metrics_map = { {
-      specific_goal_state_id, metric }, { specific_goal_state_id2, metric2 }, {
-      specific_goal_state_id3, metric3 }, { specific_goal_state_id4, metric4 },
-      { specific_goal_state_id5, metric5 } };
+  MockMetricCollector metric_collector;
+  PredictMetricsManager manager(metric_collector, false, 1);
+
+  PredictMetricsRecorder recorder;
+  recorder.Record("inception", 1, true, 10000);
+  recorder.Record("inception", 1, true, 20000);
+  recorder.Record("inception", 2, true, 5000);
+  recorder.Record("resnet", 1, true, 5000);
+  recorder.Record("resnet", 1, false, 5000);
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder.Drain(&histograms);
+
   std::map<string, MetricCollector::PredictMetricSummary> summary_metrics;
-  manager->CreateSummaryMetric(metrics_map, summary_metrics);
+  manager.CreateSummaryMetric(histograms, &summary_metrics);
 
   EXPECT_EQ(4, summary_metrics.size());
   EXPECT_EQ(true, summary_metrics["inception1_success"].is_success_);
@@ -122,6 +134,10 @@ TEST(PredictMetricsManagerTest, CreateSummaryMetric) {
   EXPECT_EQ(1, summary_metrics["inception1_success"].model_version_);
   EXPECT_EQ(2, summary_metrics["inception1_success"].prediction_count_);
   EXPECT_EQ(1, summary_metrics["inception1_success"].summary_period_);
+  EXPECT_EQ(20000,
+            summary_metrics["inception1_success"].max_predict_time_micros_);
+  EXPECT_EQ(20000,
+            summary_metrics["inception1_success"].p99_predict_time_micros_);
 
   EXPECT_EQ(true, summary_metrics["inception2_success"].is_success_);
   EXPECT_EQ(5, summary_metrics["inception2_success"].average_predict_time_ms_);
@@ -150,25 +166,39 @@ TEST(PredictMetricsManagerTest, CreateSummaryMetric) {
   EXPECT_EQ(1, summary_metrics["resnet1_failed"].model_version_);
   EXPECT_EQ(1, summary_metrics["resnet1_failed"].prediction_count_);
   EXPECT_EQ(1, summary_metrics["resnet1_failed"].summary_period_);
-
-  metric_collector_->~MockMetricCollector();
-
 }
 
 TEST(MetricsFactoryTest, CreateWithLogger) {
   std::unique_ptr<MetricsManager> metrics_manager;
-  Status status = MetricsManager::Create("logger", false, 30, &metrics_manager);
+  Status status =
+      MetricsManager::Create("logger", false, 30, 0, true, &metrics_manager);
   EXPECT_TRUE(status.ok());
   EXPECT_NE(nullptr, metrics_manager.get());
-
 }
 
 TEST(MetricsFactoryTest, CreateWithSyslog) {
   std::unique_ptr<MetricsManager> metrics_manager;
-  Status status = MetricsManager::Create("syslog", false, 30, &metrics_manager);
+  Status status =
+      MetricsManager::Create("syslog", false, 30, 0, true, &metrics_manager);
   EXPECT_TRUE(status.ok());
   EXPECT_NE(nullptr, metrics_manager.get());
+}
+
+TEST(MetricsFactoryTest, CreateAsync) {
+  std::unique_ptr<MetricsManager> metrics_manager;
+  Status status = MetricsManager::Create("logger", false, 30, 16, true,
+                                         &metrics_manager);
+  EXPECT_TRUE(status.ok());
+  ASSERT_NE(nullptr, metrics_manager.get());
+  metrics_manager->RecordPredict("inception", 1, 1000, Status::OK());
+}
 
+TEST(MetricsFactoryTest, CreateWithUnknownImplementation) {
+  std::unique_ptr<MetricsManager> metrics_manager;
+  Status status =
+      MetricsManager::Create("unknown", false, 30, 0, true, &metrics_manager);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(nullptr, metrics_manager.get());
 }
 
 }  // namespace
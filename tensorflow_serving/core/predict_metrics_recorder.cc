@@ -0,0 +1,128 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/predict_metrics_recorder.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <unordered_set>
+
+#include "tensorflow_serving/util/hash.h"
+
+namespace tensorflow {
+namespace serving {
+
+size_t PredictMetricsRecorder::KeyHash::operator()(const Key& key) const {
+  uint64 hash = std::hash<string>()(key.model_name);
+  hash = HashCombine(hash, std::hash<int64>()(key.model_version));
+  return HashCombine(hash, key.is_success ? 1 : 0);
+}
+
+constexpr uint64 PredictMetricsRecorder::kNotWriting;
+
+namespace {
+
+std::atomic<int64> next_recorder_id{0};
+
+}  // namespace
+
+PredictMetricsRecorder::PredictMetricsRecorder()
+    : id_(next_recorder_id.fetch_add(1)) {}
+
+PredictMetricsRecorder::ThreadSlot*
+PredictMetricsRecorder::SlotForCurrentThread() {
+  // The slots of the calling thread, keyed by recorder id. The slots are shared
+  // with the recorders, which notice that a thread has exited when they become
+  // the sole owners of its slot.
+  thread_local std::unordered_map<int64, std::shared_ptr<ThreadSlot>>
+      thread_slots;
+  std::shared_ptr<ThreadSlot>& slot = thread_slots[id_];
+  if (slot == nullptr) {
+    slot = std::make_shared<ThreadSlot>();
+    mutex_lock l(slots_mu_);
+    slots_.push_back(slot);
+  }
+  return slot.get();
+}
+
+void PredictMetricsRecorder::Record(const string& model_name,
+                                    const int64 model_version,
+                                    const bool is_success,
+                                    const uint64 predict_time_micros) {
+  ThreadSlot* const slot = SlotForCurrentThread();
+  // Announce the epoch we are about to write into, and make sure it is still
+  // the current one: either Drain() sees the announcement and waits for us, or
+  // we see that Drain() advanced the epoch and retry with the new one.
+  uint64 epoch;
+  do {
+    epoch = epoch_.load();
+    slot->writing_epoch.store(epoch);
+  } while (epoch_.load() != epoch);
+
+  slot->buffers[epoch % 2][{model_name, model_version, is_success}].Add(
+      predict_time_micros);
+
+  slot->writing_epoch.store(kNotWriting, std::memory_order_release);
+}
+
+void PredictMetricsRecorder::Drain(HistogramMap* const histograms) {
+  mutex_lock drain_lock(drain_mu_);
+  const uint64 previous_epoch = epoch_.fetch_add(1);
+
+  std::vector<std::shared_ptr<ThreadSlot>> slots;
+  {
+    mutex_lock l(slots_mu_);
+    slots = slots_;
+  }
+
+  const auto merge_and_clear = [histograms](HistogramHashMap* buffer) {
+    for (const auto& entry : *buffer) {
+      (*histograms)[entry.first].Merge(entry.second);
+    }
+    buffer->clear();
+  };
+  for (const std::shared_ptr<ThreadSlot>& slot : slots) {
+    while (slot->writing_epoch.load() == previous_epoch) {
+      std::this_thread::yield();
+    }
+    merge_and_clear(&slot->buffers[previous_epoch % 2]);
+  }
+
+  // Drop the slots of the threads which have exited (the only owners left are
+  // 'slots_' and our copy), after collecting what they recorded in the current
+  // epoch too. Only the slots of our copy are considered: a slot registered
+  // since then is also owned by just 'slots_' and its live thread.
+  std::unordered_set<const ThreadSlot*> exited_slots;
+  mutex_lock l(slots_mu_);
+  for (const std::shared_ptr<ThreadSlot>& slot : slots) {
+    if (slot.use_count() == 2) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      merge_and_clear(&slot->buffers[(previous_epoch + 1) % 2]);
+      exited_slots.insert(slot.get());
+    }
+  }
+  if (!exited_slots.empty()) {
+    slots_.erase(
+        std::remove_if(slots_.begin(), slots_.end(),
+                       [&exited_slots](const std::shared_ptr<ThreadSlot>& s) {
+                         return exited_slots.count(s.get()) > 0;
+                       }),
+        slots_.end());
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
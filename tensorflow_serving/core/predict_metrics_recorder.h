@@ -0,0 +1,132 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_PREDICT_METRICS_RECORDER_H_
+#define TENSORFLOW_SERVING_CORE_PREDICT_METRICS_RECORDER_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/latency_histogram.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Accumulates per-model predict latency histograms on the request path,
+// independently of the servable state machinery (EventBus,
+// ServableStateMonitor), so that recording a metric never contends with real
+// servable load/unload events.
+//
+// Each recording thread owns its accumulators, which are double-buffered by
+// epoch: threads record into the buffer of the current epoch without taking
+// any lock, while Drain() (typically called by the summary thread of
+// PredictMetricsManager) advances the epoch, waits for the threads which may
+// still be writing into the previous epoch's buffers to be done, and then
+// collects and resets those buffers.
+//
+// This class is thread-safe.
+class PredictMetricsRecorder {
+ public:
+  // Identifies one accumulator.
+  struct Key {
+    string model_name;
+    int64 model_version;
+    bool is_success;
+  };
+
+  struct KeyLess {
+    bool operator()(const Key& a, const Key& b) const {
+      return std::tie(a.model_name, a.model_version, a.is_success) <
+             std::tie(b.model_name, b.model_version, b.is_success);
+    }
+  };
+  // The latencies recorded for each key since the previous Drain().
+  using HistogramMap = std::map<Key, LatencyHistogram, KeyLess>;
+
+  PredictMetricsRecorder();
+  ~PredictMetricsRecorder() = default;
+
+  // Records the outcome of a single predict call. Lock-free, except for the
+  // very first call from each thread.
+  void Record(const string& model_name, int64 model_version, bool is_success,
+              uint64 predict_time_micros);
+
+  // Merges everything recorded since the previous call into 'histograms', and
+  // resets the accumulators. Waits for in-flight Record() calls of the
+  // previous epoch, which are short and bounded.
+  void Drain(HistogramMap* histograms) LOCKS_EXCLUDED(drain_mu_, slots_mu_);
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+  struct KeyEq {
+    bool operator()(const Key& a, const Key& b) const {
+      return a.model_version == b.model_version &&
+             a.is_success == b.is_success && a.model_name == b.model_name;
+    }
+  };
+
+  using HistogramHashMap =
+      std::unordered_map<Key, LatencyHistogram, KeyHash, KeyEq>;
+
+  // Value of ThreadSlot::writing_epoch when the thread isn't recording.
+  static constexpr uint64 kNotWriting = ~uint64{0};
+
+  // The accumulators of one recording thread.
+  struct ThreadSlot {
+    // The epoch whose buffer the owning thread is currently writing into, or
+    // kNotWriting.
+    std::atomic<uint64> writing_epoch{kNotWriting};
+    // Buffers for even and odd epochs. The buffer of the current epoch is only
+    // accessed by the owning thread; the one of the previous epoch only by
+    // Drain().
+    HistogramHashMap buffers[2];
+  };
+
+  // Returns the slot of the calling thread, registering it on first use.
+  ThreadSlot* SlotForCurrentThread() LOCKS_EXCLUDED(slots_mu_);
+
+  // Unique among all the recorders ever created in the process, used to key
+  // the per-thread slot caches.
+  const int64 id_;
+
+  // The current epoch. Only ever incremented, by Drain().
+  std::atomic<uint64> epoch_{0};
+
+  // Serializes Drain() calls.
+  mutex drain_mu_;
+
+  mutable mutex slots_mu_;
+  // The slots of all the threads which have recorded so far. Slots of exited
+  // threads are dropped once drained.
+  std::vector<std::shared_ptr<ThreadSlot>> slots_ GUARDED_BY(slots_mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictMetricsRecorder);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_PREDICT_METRICS_RECORDER_H_
@@ -0,0 +1,165 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/predict_metrics_recorder.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(PredictMetricsRecorderTest, DrainEmpty) {
+  PredictMetricsRecorder recorder;
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder.Drain(&histograms);
+  EXPECT_TRUE(histograms.empty());
+}
+
+TEST(PredictMetricsRecorderTest, RecordAndDrain) {
+  PredictMetricsRecorder recorder;
+  recorder.Record("inception", 1, true, 10);
+  recorder.Record("inception", 1, true, 30);
+  recorder.Record("inception", 1, false, 5);
+  recorder.Record("inception", 2, true, 7);
+
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder.Drain(&histograms);
+  ASSERT_EQ(3, histograms.size());
+
+  const LatencyHistogram& success_1 = histograms[{"inception", 1, true}];
+  EXPECT_EQ(2, success_1.count());
+  EXPECT_EQ(40, success_1.sum());
+  EXPECT_EQ(30, success_1.max());
+
+  const LatencyHistogram& failed_1 = histograms[{"inception", 1, false}];
+  EXPECT_EQ(1, failed_1.count());
+  EXPECT_EQ(5, failed_1.sum());
+
+  const LatencyHistogram& success_2 = histograms[{"inception", 2, true}];
+  EXPECT_EQ(1, success_2.count());
+  EXPECT_EQ(7, success_2.max());
+
+  // Draining resets the accumulators.
+  PredictMetricsRecorder::HistogramMap empty_histograms;
+  recorder.Drain(&empty_histograms);
+  EXPECT_TRUE(empty_histograms.empty());
+}
+
+TEST(PredictMetricsRecorderTest, ConcurrentRecords) {
+  const int kNumThreads = 8;
+  const int kNumRecordsPerThread = 1000;
+  PredictMetricsRecorder recorder;
+  {
+    thread::ThreadPool pool(Env::Default(), "recorders", kNumThreads);
+    for (int i = 0; i < kNumThreads; ++i) {
+      pool.Schedule([&recorder]() {
+        for (int j = 0; j < kNumRecordsPerThread; ++j) {
+          recorder.Record("inception", 1, true, 1);
+        }
+      });
+    }
+  }
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder.Drain(&histograms);
+  ASSERT_EQ(1, histograms.size());
+  EXPECT_EQ(kNumThreads * kNumRecordsPerThread,
+            histograms.begin()->second.count());
+  EXPECT_EQ(kNumThreads * kNumRecordsPerThread,
+            histograms.begin()->second.sum());
+}
+
+TEST(PredictMetricsRecorderTest, DrainWhileRecording) {
+  const int kNumThreads = 8;
+  const int kNumRecordsPerThread = 10000;
+  PredictMetricsRecorder recorder;
+  PredictMetricsRecorder::HistogramMap histograms;
+  {
+    thread::ThreadPool pool(Env::Default(), "recorders", kNumThreads);
+    for (int i = 0; i < kNumThreads; ++i) {
+      pool.Schedule([&recorder]() {
+        for (int j = 0; j < kNumRecordsPerThread; ++j) {
+          recorder.Record("inception", 1, true, 1);
+        }
+      });
+    }
+    for (int i = 0; i < 100; ++i) {
+      recorder.Drain(&histograms);
+    }
+  }
+  // Nothing is lost nor counted twice, whichever epoch it was recorded in.
+  recorder.Drain(&histograms);
+  ASSERT_EQ(1, histograms.size());
+  EXPECT_EQ(kNumThreads * kNumRecordsPerThread,
+            histograms.begin()->second.count());
+}
+
+TEST(PredictMetricsRecorderTest, RecordsOfExitedThreadsAreDrained) {
+  PredictMetricsRecorder recorder;
+  {
+    std::unique_ptr<Thread> thread(
+        Env::Default()->StartThread({}, "recorder", [&recorder]() {
+          recorder.Record("inception", 1, true, 1);
+        }));
+  }
+  PredictMetricsRecorder::HistogramMap histograms;
+  recorder.Drain(&histograms);
+  ASSERT_EQ(1, histograms.size());
+  EXPECT_EQ(1, histograms.begin()->second.count());
+
+  PredictMetricsRecorder::HistogramMap empty_histograms;
+  recorder.Drain(&empty_histograms);
+  EXPECT_TRUE(empty_histograms.empty());
+}
+
+TEST(PredictMetricsRecorderTest, DrainWhileThreadsRegister) {
+  const int kNumThreads = 200;
+  PredictMetricsRecorder recorder;
+  PredictMetricsRecorder::HistogramMap histograms;
+  {
+    // Threads keep registering slots while Drain() runs, whose slots must not
+    // be mistaken for those of exited threads.
+    std::atomic<bool> done{false};
+    std::unique_ptr<Thread> drainer(
+        Env::Default()->StartThread({}, "drainer", [&]() {
+          while (!done.load()) {
+            recorder.Drain(&histograms);
+          }
+        }));
+    for (int i = 0; i < kNumThreads; ++i) {
+      std::unique_ptr<Thread> thread(
+          Env::Default()->StartThread({}, "recorder", [&recorder]() {
+            for (int j = 0; j < 10; ++j) {
+              recorder.Record("inception", 1, true, 1);
+              std::this_thread::yield();
+            }
+          }));
+    }
+    done.store(true);
+  }
+  recorder.Drain(&histograms);
+  ASSERT_EQ(1, histograms.size());
+  EXPECT_EQ(kNumThreads * 10, histograms.begin()->second.count());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
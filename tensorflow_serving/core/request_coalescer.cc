@@ -0,0 +1,154 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/request_coalescer.h"
+
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+auto* coalesced_requests = monitoring::Counter<2>::New(
+    "/tensorflow/serving/coalesced_requests",
+    "The total number of requests which shared the computation of an "
+    "identical request in flight, sliced down by model_name and method_name.",
+    "model_name", "method_name");
+
+}  // namespace
+
+void RequestCoalescer::RunAsync(const InferenceRequestKey& key,
+                                google::protobuf::Message* response,
+                                const Computation& compute,
+                                DoneCallback done) {
+  {
+    mutex_lock l(mu_);
+    auto it = in_flight_.find(key);
+    if (it != in_flight_.end()) {
+      it->second.push_back({response, compute, std::move(done)});
+      coalesced_requests
+          ->GetCell(key.servable_id.name, key.method_name)
+          ->IncrementBy(1);
+      return;
+    }
+    in_flight_.emplace(key, std::vector<Request>());
+  }
+  Compute(key, {response, compute, std::move(done)});
+}
+
+Status RequestCoalescer::Run(const InferenceRequestKey& key,
+                             google::protobuf::Message* response,
+                             const std::function<Status()>& compute) {
+  // The computation is handed to this thread rather than run by whichever
+  // thread starts it, which is another one if this request has to compute
+  // after waiting for an identical one.
+  mutex mu;
+  condition_variable cv;
+  DoneCallback computed;
+  bool done = false;
+  Status status;
+  RunAsync(key, response,
+           [&](DoneCallback computed_callback) {
+             mutex_lock l(mu);
+             computed = std::move(computed_callback);
+             cv.notify_all();
+           },
+           [&](const Status& run_status) {
+             mutex_lock l(mu);
+             status = run_status;
+             done = true;
+             cv.notify_all();
+           });
+  for (;;) {
+    DoneCallback computed_callback;
+    {
+      mutex_lock l(mu);
+      while (!done && computed == nullptr) {
+        cv.wait(l);
+      }
+      if (done) {
+        return status;
+      }
+      computed_callback = std::move(computed);
+      computed = nullptr;
+    }
+    computed_callback(compute());
+  }
+}
+
+int64 RequestCoalescer::num_in_flight() const {
+  mutex_lock l(mu_);
+  return in_flight_.size();
+}
+
+void RequestCoalescer::Compute(const InferenceRequestKey& key,
+                               Request request) {
+  google::protobuf::Message* const response = request.response;
+  DoneCallback done = std::move(request.done);
+  request.compute([this, key, response, done](const Status& status) {
+    Finish(key, *response, status);
+    done(status);
+  });
+}
+
+void RequestCoalescer::Finish(const InferenceRequestKey& key,
+                              const google::protobuf::Message& response,
+                              const Status& status) {
+  // Whether the requests which waited compute in turn rather than share
+  // 'status', which only holds for the request which computed.
+  const bool recompute = status.code() == error::DEADLINE_EXCEEDED ||
+                         status.code() == error::CANCELLED;
+  std::vector<Request> followers;
+  {
+    mutex_lock l(mu_);
+    auto it = in_flight_.find(key);
+    if (recompute && !it->second.empty()) {
+      // The key stays in flight, for the first follower to compute.
+      followers.push_back(std::move(it->second.front()));
+      it->second.erase(it->second.begin());
+    } else {
+      followers = std::move(it->second);
+      in_flight_.erase(it);
+    }
+  }
+  if (followers.empty()) {
+    return;
+  }
+  if (recompute) {
+    Compute(key, std::move(followers.front()));
+    return;
+  }
+
+  // Serialize once, rather than copying the message for each follower.
+  string serialized_response;
+  if (status.ok()) {
+    response.SerializeToString(&serialized_response);
+  }
+  for (Request& follower : followers) {
+    Status follower_status = status;
+    if (status.ok() &&
+        !follower.response->ParseFromString(serialized_response)) {
+      follower_status = errors::Internal(
+          "Failed to copy the response of an identical request");
+    }
+    follower.done(follower_status);
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
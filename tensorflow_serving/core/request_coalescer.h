@@ -0,0 +1,108 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_REQUEST_COALESCER_H_
+#define TENSORFLOW_SERVING_CORE_REQUEST_COALESCER_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "google/protobuf/message.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/inference_request_key.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Lets concurrent identical inference requests share a single computation:
+// while a request is being computed, requests with the same
+// InferenceRequestKey don't run the model (nor take batch slots) themselves,
+// but wait for it and get a copy of its response and status.
+//
+// Only requests in flight at the same time are coalesced; once a computation
+// completes, the next identical request computes again. (See
+// InferenceResultCache for reusing completed results.)
+//
+// A computation which fails with DEADLINE_EXCEEDED or CANCELLED failed for
+// reasons of its own request rather than of the request contents, so the
+// requests which waited for it don't share that outcome: the first of them
+// computes in turn, for itself and the others.
+//
+// This class is thread-safe.
+class RequestCoalescer {
+ public:
+  using DoneCallback = std::function<void(const Status&)>;
+
+  // Computes a response, and then calls the given callback with its status.
+  using Computation = std::function<void(DoneCallback)>;
+
+  RequestCoalescer() = default;
+  ~RequestCoalescer() = default;
+
+  // Fills 'response' to the request 'key' by running 'compute', unless an
+  // identical request is already being computed, in which case 'response'
+  // becomes a copy of that request's response once it completes (or
+  // 'compute' runs after all, see above). Either way, calls 'done' with the
+  // outcome, possibly on the thread which completes the other request's
+  // computation. 'response' must stay valid until then.
+  void RunAsync(const InferenceRequestKey& key,
+                google::protobuf::Message* response,
+                const Computation& compute, DoneCallback done);
+
+  // Like RunAsync(), but runs 'compute' on the calling thread, or blocks until
+  // the identical request in flight completes.
+  Status Run(const InferenceRequestKey& key,
+             google::protobuf::Message* response,
+             const std::function<Status()>& compute);
+
+  // The number of distinct requests being computed.
+  int64 num_in_flight() const;
+
+ private:
+  // A request which computes, or waits for the computation of an identical
+  // one.
+  struct Request {
+    google::protobuf::Message* response;
+    Computation compute;
+    DoneCallback done;
+  };
+
+  // Runs the computation of 'request', whose key 'key' is in 'in_flight_'.
+  void Compute(const InferenceRequestKey& key, Request request);
+
+  // Ends the computation of 'key', and hands its outcome to the requests
+  // which waited for it, or has the first of them compute in turn.
+  void Finish(const InferenceRequestKey& key,
+              const google::protobuf::Message& response, const Status& status);
+
+  mutable mutex mu_;
+
+  // The requests being computed, and the identical requests waiting for each.
+  std::unordered_map<InferenceRequestKey, std::vector<Request>,
+                     HashInferenceRequestKey>
+      in_flight_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RequestCoalescer);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_REQUEST_COALESCER_H_
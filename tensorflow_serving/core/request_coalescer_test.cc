@@ -0,0 +1,240 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/request_coalescer.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+#include "google/protobuf/wrappers.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using google::protobuf::StringValue;
+
+InferenceRequestKey CreateKey(const string& request) {
+  StringValue message;
+  message.set_value(request);
+  return InferenceRequestKey::Create("Predict", {"model", 1}, message);
+}
+
+// Records the outcome a request completes with.
+struct Outcome {
+  bool done = false;
+  Status status;
+};
+
+RequestCoalescer::DoneCallback RecordOutcome(Outcome* outcome) {
+  return [outcome](const Status& status) {
+    outcome->done = true;
+    outcome->status = status;
+  };
+}
+
+TEST(RequestCoalescerTest, SequentialRequestsComputeEachTime) {
+  RequestCoalescer coalescer;
+  int num_computations = 0;
+  for (int i = 0; i < 2; ++i) {
+    StringValue response;
+    TF_ASSERT_OK(coalescer.Run(CreateKey("a"), &response, [&]() {
+      ++num_computations;
+      response.set_value("result");
+      return Status::OK();
+    }));
+    EXPECT_EQ("result", response.value());
+  }
+  EXPECT_EQ(2, num_computations);
+  EXPECT_EQ(0, coalescer.num_in_flight());
+}
+
+TEST(RequestCoalescerTest, IdenticalRequestsShareAComputation) {
+  RequestCoalescer coalescer;
+  StringValue leader_response;
+  RequestCoalescer::DoneCallback computed;
+  Outcome leader_outcome;
+  coalescer.RunAsync(CreateKey("a"), &leader_response,
+                     [&](RequestCoalescer::DoneCallback done) {
+                       computed = std::move(done);
+                     },
+                     RecordOutcome(&leader_outcome));
+  ASSERT_TRUE(computed != nullptr);
+
+  StringValue follower_response;
+  Outcome follower_outcome;
+  coalescer.RunAsync(
+      CreateKey("a"), &follower_response,
+      [](RequestCoalescer::DoneCallback done) {
+        ADD_FAILURE() << "An identical request is in flight";
+      },
+      RecordOutcome(&follower_outcome));
+  EXPECT_EQ(1, coalescer.num_in_flight());
+  EXPECT_FALSE(follower_outcome.done);
+
+  leader_response.set_value("result");
+  computed(Status::OK());
+  EXPECT_TRUE(leader_outcome.done);
+  TF_EXPECT_OK(leader_outcome.status);
+  EXPECT_TRUE(follower_outcome.done);
+  TF_EXPECT_OK(follower_outcome.status);
+  EXPECT_EQ("result", follower_response.value());
+  EXPECT_EQ(0, coalescer.num_in_flight());
+}
+
+TEST(RequestCoalescerTest, DifferentRequestsComputeSeparately) {
+  RequestCoalescer coalescer;
+  std::vector<RequestCoalescer::DoneCallback> computations;
+  StringValue response_a, response_b;
+  Outcome outcome_a, outcome_b;
+  auto compute = [&](RequestCoalescer::DoneCallback done) {
+    computations.push_back(std::move(done));
+  };
+  coalescer.RunAsync(CreateKey("a"), &response_a, compute,
+                     RecordOutcome(&outcome_a));
+  coalescer.RunAsync(CreateKey("b"), &response_b, compute,
+                     RecordOutcome(&outcome_b));
+  ASSERT_EQ(2, computations.size());
+  EXPECT_EQ(2, coalescer.num_in_flight());
+
+  computations[1](Status::OK());
+  EXPECT_FALSE(outcome_a.done);
+  EXPECT_TRUE(outcome_b.done);
+  computations[0](Status::OK());
+  EXPECT_TRUE(outcome_a.done);
+}
+
+TEST(RequestCoalescerTest, ErrorsAreShared) {
+  RequestCoalescer coalescer;
+  RequestCoalescer::DoneCallback computed;
+  StringValue leader_response, follower_response;
+  Outcome leader_outcome, follower_outcome;
+  auto compute = [&](RequestCoalescer::DoneCallback done) {
+    computed = std::move(done);
+  };
+  coalescer.RunAsync(CreateKey("a"), &leader_response, compute,
+                     RecordOutcome(&leader_outcome));
+  coalescer.RunAsync(CreateKey("a"), &follower_response, compute,
+                     RecordOutcome(&follower_outcome));
+
+  computed(errors::InvalidArgument("bad input"));
+  EXPECT_EQ(error::INVALID_ARGUMENT, leader_outcome.status.code());
+  EXPECT_EQ(error::INVALID_ARGUMENT, follower_outcome.status.code());
+}
+
+TEST(RequestCoalescerTest, DeadlineExceededIsNotShared) {
+  RequestCoalescer coalescer;
+  std::vector<RequestCoalescer::DoneCallback> computations;
+  auto compute = [&](RequestCoalescer::DoneCallback done) {
+    computations.push_back(std::move(done));
+  };
+  StringValue responses[3];
+  Outcome outcomes[3];
+  for (int i = 0; i < 3; ++i) {
+    coalescer.RunAsync(CreateKey("a"), &responses[i], compute,
+                       RecordOutcome(&outcomes[i]));
+  }
+  ASSERT_EQ(1, computations.size());
+
+  // The first follower computes in turn, for the other one.
+  computations[0](errors::DeadlineExceeded("too slow"));
+  EXPECT_EQ(error::DEADLINE_EXCEEDED, outcomes[0].status.code());
+  EXPECT_FALSE(outcomes[1].done);
+  EXPECT_FALSE(outcomes[2].done);
+  ASSERT_EQ(2, computations.size());
+  EXPECT_EQ(1, coalescer.num_in_flight());
+
+  responses[1].set_value("result");
+  computations[1](Status::OK());
+  TF_EXPECT_OK(outcomes[1].status);
+  TF_EXPECT_OK(outcomes[2].status);
+  EXPECT_EQ("result", responses[2].value());
+  EXPECT_EQ(0, coalescer.num_in_flight());
+}
+
+TEST(RequestCoalescerTest, RunComputesOnItsThreadAfterCancellation) {
+  RequestCoalescer coalescer;
+  RequestCoalescer::DoneCallback computed;
+  StringValue leader_response;
+  Outcome leader_outcome;
+  coalescer.RunAsync(CreateKey("a"), &leader_response,
+                     [&](RequestCoalescer::DoneCallback done) {
+                       computed = std::move(done);
+                     },
+                     RecordOutcome(&leader_outcome));
+
+  std::thread::id follower_thread;
+  std::thread::id computing_thread;
+  StringValue follower_response;
+  std::unique_ptr<Thread> follower(
+      Env::Default()->StartThread({}, "Follower", [&]() {
+        follower_thread = std::this_thread::get_id();
+        TF_ASSERT_OK(coalescer.Run(CreateKey("a"), &follower_response, [&]() {
+          computing_thread = std::this_thread::get_id();
+          follower_response.set_value("result");
+          return Status::OK();
+        }));
+      }));
+  // Give the follower time to wait for the leader. If it hasn't by then, it
+  // computes on its own thread all the same.
+  Env::Default()->SleepForMicroseconds(50 * 1000);
+  computed(errors::Cancelled("client went away"));
+  follower.reset();
+
+  EXPECT_EQ(error::CANCELLED, leader_outcome.status.code());
+  EXPECT_EQ(follower_thread, computing_thread);
+  EXPECT_EQ("result", follower_response.value());
+  EXPECT_EQ(0, coalescer.num_in_flight());
+}
+
+TEST(RequestCoalescerTest, RunBlocksFollowers) {
+  RequestCoalescer coalescer;
+  Notification computation_started;
+  Notification release_computation;
+  StringValue leader_response;
+  std::unique_ptr<Thread> leader(
+      Env::Default()->StartThread({}, "Leader", [&]() {
+        TF_ASSERT_OK(coalescer.Run(CreateKey("a"), &leader_response, [&]() {
+          computation_started.Notify();
+          release_computation.WaitForNotification();
+          leader_response.set_value("result");
+          return Status::OK();
+        }));
+      }));
+  computation_started.WaitForNotification();
+
+  StringValue follower_response;
+  Outcome follower_outcome;
+  coalescer.RunAsync(
+      CreateKey("a"), &follower_response,
+      [](RequestCoalescer::DoneCallback done) {
+        ADD_FAILURE() << "An identical request is in flight";
+      },
+      RecordOutcome(&follower_outcome));
+  EXPECT_FALSE(follower_outcome.done);
+
+  release_computation.Notify();
+  leader.reset();
+  EXPECT_TRUE(follower_outcome.done);
+  EXPECT_EQ("result", follower_response.value());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
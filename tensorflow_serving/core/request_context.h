@@ -0,0 +1,62 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_REQUEST_CONTEXT_H_
+#define TENSORFLOW_SERVING_CORE_REQUEST_CONTEXT_H_
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/request_timing.h"
+#include "tensorflow_serving/util/optional.h"
+
+namespace tensorflow {
+namespace serving {
+
+// What is learned about one inference request along its serving path, which is
+// reported once the request is done (metrics, logging) without having to be
+// worked out again.
+//
+// This class is not thread-safe.
+class RequestContext {
+ public:
+  RequestContext() = default;
+
+  // Records the version of the servable serving the request, typically from
+  // its handle right after acquiring it. When the request doesn't specify a
+  // version, this is the one it resolved to.
+  void set_model_version(int64 model_version) {
+    model_version_ = model_version;
+  }
+
+  // The version recorded with set_model_version(), if any. Requests which fail
+  // before acquiring a servable handle don't have one.
+  const optional<int64>& model_version() const { return model_version_; }
+
+  // The time spent in each phase of the request. To be made current (see
+  // RequestTiming::ScopedCurrent) while serving the request.
+  RequestTiming* mutable_timing() { return &timing_; }
+  const RequestTiming& timing() const { return timing_; }
+
+ private:
+  optional<int64> model_version_;
+  RequestTiming timing_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RequestContext);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_REQUEST_CONTEXT_H_
@@ -0,0 +1,44 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/request_context.h"
+
+#include <gtest/gtest.h>
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(RequestContextTest, ModelVersionIsUnknownUntilSet) {
+  RequestContext context;
+  EXPECT_FALSE(context.model_version());
+  context.set_model_version(42);
+  ASSERT_TRUE(context.model_version());
+  EXPECT_EQ(42, *context.model_version());
+}
+
+TEST(RequestContextTest, TimingIsCurrentWhileScoped) {
+  RequestContext context;
+  {
+    RequestTiming::ScopedCurrent scoped_timing(context.mutable_timing());
+    RequestTiming::AddToCurrent(RequestPhase::kSessionRun, 7);
+  }
+  RequestTiming::AddToCurrent(RequestPhase::kSessionRun, 100);
+  EXPECT_EQ(7, context.timing().micros(RequestPhase::kSessionRun));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
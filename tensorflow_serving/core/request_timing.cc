@@ -0,0 +1,88 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/request_timing.h"
+
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+thread_local RequestTiming* current_request_timing = nullptr;
+
+// The RequestTiming which the outermost ScopedPhase on the calling thread
+// adds to, if any.
+thread_local RequestTiming* timing_in_phase = nullptr;
+
+}  // namespace
+
+const char* RequestPhaseName(const RequestPhase phase) {
+  switch (phase) {
+    case RequestPhase::kHandleAcquisition:
+      return "handle_acquisition";
+    case RequestPhase::kRequestDecoding:
+      return "request_decoding";
+    case RequestPhase::kBatchingQueueWait:
+      return "batching_queue_wait";
+    case RequestPhase::kSessionRun:
+      return "session_run";
+    case RequestPhase::kResponseEncoding:
+      return "response_encoding";
+  }
+  return "unknown";
+}
+
+RequestTiming* RequestTiming::Current() { return current_request_timing; }
+
+void RequestTiming::AddToCurrent(const RequestPhase phase,
+                                 const uint64 micros) {
+  if (current_request_timing != nullptr) {
+    current_request_timing->Add(phase, micros);
+  }
+}
+
+RequestTiming::ScopedCurrent::ScopedCurrent(RequestTiming* const timing)
+    : previous_(current_request_timing) {
+  current_request_timing = timing;
+}
+
+RequestTiming::ScopedCurrent::~ScopedCurrent() {
+  current_request_timing = previous_;
+}
+
+RequestTiming::ScopedPhase::ScopedPhase(const RequestPhase phase)
+    : timing_(current_request_timing == timing_in_phase
+                  ? nullptr
+                  : current_request_timing),
+      phase_(phase),
+      start_micros_(timing_ == nullptr ? 0 : Env::Default()->NowMicros()) {
+  if (timing_ != nullptr) {
+    timing_in_phase = timing_;
+  }
+}
+
+RequestTiming::ScopedPhase::~ScopedPhase() {
+  if (timing_ == nullptr) {
+    return;
+  }
+  timing_in_phase = nullptr;
+  const uint64 end_micros = Env::Default()->NowMicros();
+  timing_->Add(phase_, end_micros > start_micros_ ? end_micros - start_micros_
+                                                  : 0);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,116 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_REQUEST_TIMING_H_
+#define TENSORFLOW_SERVING_CORE_REQUEST_TIMING_H_
+
+#include <array>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// The phases of serving one inference request, which are timed separately to
+// tell where the latency of the request goes.
+enum class RequestPhase {
+  // Getting the servable handle from the manager.
+  kHandleAcquisition = 0,
+  // Converting the request protos into input tensors.
+  kRequestDecoding,
+  // Waiting in the batching queue, if batching is enabled. This is part of
+  // kSessionRun.
+  kBatchingQueueWait,
+  // Session::Run(), including kBatchingQueueWait.
+  kSessionRun,
+  // Converting the output tensors into the response protos.
+  kResponseEncoding,
+};
+
+constexpr int kNumRequestPhases = 5;
+
+// Returns a short name for 'phase', e.g. "session_run".
+const char* RequestPhaseName(RequestPhase phase);
+
+// Accumulates the time spent in each phase of one request.
+//
+// The serving code doesn't get a RequestTiming passed around explicitly:
+// instead, the request handler makes its RequestTiming current for the calling
+// thread (see ScopedCurrent), and the code which implements a phase, at
+// whatever depth, times it with a ScopedPhase. When no RequestTiming is
+// current, timing a phase costs nothing but a thread-local read.
+//
+// This class is not thread-safe.
+class RequestTiming {
+ public:
+  RequestTiming() { micros_.fill(0); }
+
+  // Adds 'micros' to the time spent in 'phase'.
+  void Add(RequestPhase phase, uint64 micros) {
+    micros_[static_cast<int>(phase)] += micros;
+  }
+
+  // Returns the time spent in 'phase' so far.
+  uint64 micros(RequestPhase phase) const {
+    return micros_[static_cast<int>(phase)];
+  }
+
+  // Returns the RequestTiming current for the calling thread, or nullptr.
+  static RequestTiming* Current();
+
+  // Calls Add() on the current RequestTiming, if any.
+  static void AddToCurrent(RequestPhase phase, uint64 micros);
+
+  // Makes a RequestTiming current for the calling thread during its lifetime.
+  class ScopedCurrent {
+   public:
+    explicit ScopedCurrent(RequestTiming* timing);
+    ~ScopedCurrent();
+
+   private:
+    RequestTiming* const previous_;
+
+    TF_DISALLOW_COPY_AND_ASSIGN(ScopedCurrent);
+  };
+
+  // Adds its lifetime to a phase of the current RequestTiming, if any.
+  //
+  // Phases don't overlap: a ScopedPhase within another one for the same
+  // RequestTiming on the calling thread records nothing, so that e.g. a helper
+  // which times its decoding doesn't count it twice when its caller times the
+  // decoding too.
+  class ScopedPhase {
+   public:
+    explicit ScopedPhase(RequestPhase phase);
+    ~ScopedPhase();
+
+   private:
+    // Null if there is no current RequestTiming, or if this phase is nested.
+    RequestTiming* const timing_;
+    const RequestPhase phase_;
+    const uint64 start_micros_;
+
+    TF_DISALLOW_COPY_AND_ASSIGN(ScopedPhase);
+  };
+
+ private:
+  std::array<uint64, kNumRequestPhases> micros_;
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_REQUEST_TIMING_H_
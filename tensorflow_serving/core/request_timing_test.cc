@@ -0,0 +1,101 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/request_timing.h"
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(RequestTimingTest, Add) {
+  RequestTiming timing;
+  timing.Add(RequestPhase::kSessionRun, 10);
+  timing.Add(RequestPhase::kSessionRun, 5);
+  timing.Add(RequestPhase::kRequestDecoding, 1);
+  EXPECT_EQ(15, timing.micros(RequestPhase::kSessionRun));
+  EXPECT_EQ(1, timing.micros(RequestPhase::kRequestDecoding));
+  EXPECT_EQ(0, timing.micros(RequestPhase::kResponseEncoding));
+}
+
+TEST(RequestTimingTest, NoCurrentTiming) {
+  EXPECT_EQ(nullptr, RequestTiming::Current());
+  // Both are no-ops.
+  RequestTiming::AddToCurrent(RequestPhase::kSessionRun, 10);
+  RequestTiming::ScopedPhase phase(RequestPhase::kSessionRun);
+}
+
+TEST(RequestTimingTest, ScopedCurrentNests) {
+  RequestTiming outer;
+  RequestTiming inner;
+  {
+    RequestTiming::ScopedCurrent scoped_outer(&outer);
+    EXPECT_EQ(&outer, RequestTiming::Current());
+    {
+      RequestTiming::ScopedCurrent scoped_inner(&inner);
+      EXPECT_EQ(&inner, RequestTiming::Current());
+      RequestTiming::AddToCurrent(RequestPhase::kBatchingQueueWait, 3);
+    }
+    EXPECT_EQ(&outer, RequestTiming::Current());
+  }
+  EXPECT_EQ(nullptr, RequestTiming::Current());
+  EXPECT_EQ(0, outer.micros(RequestPhase::kBatchingQueueWait));
+  EXPECT_EQ(3, inner.micros(RequestPhase::kBatchingQueueWait));
+}
+
+TEST(RequestTimingTest, ScopedPhase) {
+  RequestTiming timing;
+  RequestTiming::ScopedCurrent scoped_timing(&timing);
+  {
+    RequestTiming::ScopedPhase phase(RequestPhase::kSessionRun);
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_GE(timing.micros(RequestPhase::kSessionRun), 1000);
+  EXPECT_EQ(0, timing.micros(RequestPhase::kHandleAcquisition));
+}
+
+TEST(RequestTimingTest, NestedScopedPhaseRecordsNothing) {
+  RequestTiming timing;
+  RequestTiming::ScopedCurrent scoped_timing(&timing);
+  {
+    RequestTiming::ScopedPhase outer_phase(RequestPhase::kRequestDecoding);
+    {
+      RequestTiming::ScopedPhase inner_phase(RequestPhase::kResponseEncoding);
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+  }
+  EXPECT_GE(timing.micros(RequestPhase::kRequestDecoding), 1000);
+  EXPECT_EQ(0, timing.micros(RequestPhase::kResponseEncoding));
+
+  // Phases after the outer one has ended are recorded again.
+  {
+    RequestTiming::ScopedPhase phase(RequestPhase::kResponseEncoding);
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_GE(timing.micros(RequestPhase::kResponseEncoding), 1000);
+}
+
+TEST(RequestTimingTest, PhaseNames) {
+  EXPECT_STREQ("handle_acquisition",
+               RequestPhaseName(RequestPhase::kHandleAcquisition));
+  EXPECT_STREQ("response_encoding",
+               RequestPhaseName(RequestPhase::kResponseEncoding));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -95,6 +95,20 @@ optional<ServableId> HasAnyServableInStreamReachedState(
   return {};
 }
 
+// Removes the entry for 'servable_id' from 'states', along with its stream if
+// that was the last tracked version.
+void EraseStatesEntry(const ServableId& servable_id,
+                      ServableStateMonitor::ServableMap* const states) {
+  auto servable_map_it = states->find(servable_id.name);
+  if (servable_map_it == states->end()) {
+    return;
+  }
+  servable_map_it->second.erase(servable_id.version);
+  if (servable_map_it->second.empty()) {
+    states->erase(servable_map_it);
+  }
+}
+
 }  // namespace
 
 string ServableStateMonitor::ServableStateAndTime::DebugString() const {
@@ -182,10 +196,15 @@ void ServableStateMonitor::NotifyWhenServablesReachState(
     const std::vector<ServableRequest>& servables,
     const ServableState::ManagerState goal_state,
     const ServableStateNotifierFn& notifier_fn) {
-  mutex_lock l(mu_);
-  servable_state_notification_requests_.push_back(
-      {servables, goal_state, notifier_fn});
-  MaybeSendStateReachedNotifications();
+  std::vector<ReadyNotification> ready_notifications;
+  {
+    mutex_lock l(mu_);
+    const NotificationRequestId id =
+        AddNotificationRequest({servables, goal_state, notifier_fn});
+    MaybeSendStateReachedNotifications(std::set<NotificationRequestId>{id},
+                                       &ready_notifications);
+  }
+  SendStateReachedNotifications(ready_notifications);
 }
 
 void ServableStateMonitor::Notify(const NotifyFn& notify_fn) {
@@ -217,12 +236,77 @@ bool ServableStateMonitor::WaitUntilServablesReachState(
 void ServableStateMonitor::PreHandleEvent(
     const EventBus<ServableState>::EventAndTime& state_and_time) {}
 
+bool ServableStateMonitor::IsUntracked(const string& servable_name) const {
+  for (const string& prefix : options_.untracked_servable_name_prefixes) {
+    if (servable_name.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ServableStateMonitor::EnforceRetentionPolicy(
+    const ServableId& latest_servable_id, const uint64 now_micros) {
+  if (options_.max_end_state_retention_micros > 0) {
+    while (!end_states_.empty() &&
+           end_states_.front().event_time_micros +
+                   options_.max_end_state_retention_micros <=
+               now_micros) {
+      // Only forget the version if it is still in the very state recorded in
+      // 'end_states_'.
+      const optional<ServableStateAndTime> current =
+          GetStateAndTimeInternal(end_states_.front().state.id);
+      if (current && *current == end_states_.front()) {
+        EraseStatesEntry(current->state.id, &states_);
+      }
+      end_states_.pop_front();
+    }
+  }
+
+  if (options_.max_count_versions_per_servable > 0) {
+    auto servable_map_it = states_.find(latest_servable_id.name);
+    if (servable_map_it == states_.end()) {
+      return;
+    }
+    VersionMap& version_map = servable_map_it->second;
+    // The versions which aren't in kEnd are exactly the live ones, so the
+    // count of kEnd versions tells whether there is anything to forget
+    // without walking the versions.
+    const auto live_map_it = live_states_.find(latest_servable_id.name);
+    size_t num_end_versions =
+        version_map.size() -
+        (live_map_it == live_states_.end() ? 0 : live_map_it->second.size());
+    // Versions are in descending order, so walk backwards to visit the lowest
+    // versions first.
+    auto version_it = version_map.end();
+    while (version_map.size() > options_.max_count_versions_per_servable &&
+           num_end_versions > 0) {
+      --version_it;
+      if (version_it->second.state.manager_state ==
+          ServableState::ManagerState::kEnd) {
+        version_it = version_map.erase(version_it);
+        --num_end_versions;
+      }
+    }
+    if (version_map.empty()) {
+      states_.erase(servable_map_it);
+    }
+  }
+}
+
 void ServableStateMonitor::HandleEvent(
     const EventBus<ServableState>::EventAndTime& event_and_time) {
   PreHandleEvent(event_and_time);
 
-  auto cleanup =
-      gtl::MakeCleanup([&]() { SendNotifications(event_and_time.event); });
+  std::vector<ReadyNotification> ready_notifications;
+  auto cleanup = gtl::MakeCleanup([&]() {
+    SendStateReachedNotifications(ready_notifications);
+    SendNotifications(event_and_time.event);
+  });
+
+  if (IsUntracked(event_and_time.event.id.name)) {
+    return;
+  }
 
   mutex_lock l(mu_);
   const ServableStateAndTime state_and_time = {
@@ -230,7 +314,17 @@ void ServableStateMonitor::HandleEvent(
   states_[state_and_time.state.id.name][state_and_time.state.id.version] =
       state_and_time;
   UpdateLiveStates(state_and_time, &live_states_);
-  MaybeSendStateReachedNotifications();
+  MaybeSendStateReachedNotifications(state_and_time.state.id,
+                                     &ready_notifications);
+
+  if (options_.max_end_state_retention_micros > 0 &&
+      state_and_time.state.manager_state == ServableState::ManagerState::kEnd) {
+    end_states_.push_back(state_and_time);
+  }
+  // Done after sending the notifications, so that requests waiting on the
+  // versions being forgotten still get to observe their final state.
+  EnforceRetentionPolicy(state_and_time.state.id,
+                         state_and_time.event_time_micros);
 
   if (options_.max_count_log_events == 0) {
     return;
@@ -279,24 +373,101 @@ ServableStateMonitor::ShouldSendStateReachedNotification(
   return {{reached_goal_state, states_reached}};
 }
 
-void ServableStateMonitor::MaybeSendStateReachedNotifications() {
-  for (auto iter = servable_state_notification_requests_.begin();
-       iter != servable_state_notification_requests_.end();) {
-    const ServableStateNotificationRequest& notification_request = *iter;
-    const optional<
-        std::pair<bool, std::map<ServableId, ServableState::ManagerState>>>
+ServableStateMonitor::NotificationRequestId
+ServableStateMonitor::AddNotificationRequest(
+    ServableStateNotificationRequest notification_request) {
+  const NotificationRequestId id = next_notification_request_id_++;
+  for (const ServableRequest& servable_request :
+       notification_request.servables) {
+    if (servable_request.version) {
+      specific_notification_requests_[{servable_request.name,
+                                       *servable_request.version}]
+          .insert(id);
+    } else {
+      latest_notification_requests_[servable_request.name].insert(id);
+    }
+  }
+  servable_state_notification_requests_.emplace(
+      id, std::move(notification_request));
+  return id;
+}
+
+void ServableStateMonitor::RemoveNotificationRequest(
+    const NotificationRequestId id) {
+  auto request_it = servable_state_notification_requests_.find(id);
+  if (request_it == servable_state_notification_requests_.end()) {
+    return;
+  }
+  for (const ServableRequest& servable_request : request_it->second.servables) {
+    if (servable_request.version) {
+      const ServableId servable_id = {servable_request.name,
+                                      *servable_request.version};
+      auto index_it = specific_notification_requests_.find(servable_id);
+      if (index_it != specific_notification_requests_.end()) {
+        index_it->second.erase(id);
+        if (index_it->second.empty()) {
+          specific_notification_requests_.erase(index_it);
+        }
+      }
+    } else {
+      auto index_it = latest_notification_requests_.find(servable_request.name);
+      if (index_it != latest_notification_requests_.end()) {
+        index_it->second.erase(id);
+        if (index_it->second.empty()) {
+          latest_notification_requests_.erase(index_it);
+        }
+      }
+    }
+  }
+  servable_state_notification_requests_.erase(request_it);
+}
+
+void ServableStateMonitor::MaybeSendStateReachedNotifications(
+    const std::set<NotificationRequestId>& ids,
+    std::vector<ReadyNotification>* const ready_notifications) {
+  for (const NotificationRequestId id : ids) {
+    auto request_it = servable_state_notification_requests_.find(id);
+    if (request_it == servable_state_notification_requests_.end()) {
+      continue;
+    }
+    optional<std::pair<bool, std::map<ServableId, ServableState::ManagerState>>>
         opt_state_and_states_reached =
-            ShouldSendStateReachedNotification(notification_request);
+            ShouldSendStateReachedNotification(request_it->second);
     if (opt_state_and_states_reached) {
-      notification_request.notifier_fn(opt_state_and_states_reached->first,
-                                       opt_state_and_states_reached->second);
-      iter = servable_state_notification_requests_.erase(iter);
-    } else {
-      ++iter;
+      ready_notifications->push_back(
+          {std::move(request_it->second.notifier_fn),
+           opt_state_and_states_reached->first,
+           std::move(opt_state_and_states_reached->second)});
+      RemoveNotificationRequest(id);
     }
   }
 }
 
+void ServableStateMonitor::MaybeSendStateReachedNotifications(
+    const ServableId& servable_id,
+    std::vector<ReadyNotification>* const ready_notifications) {
+  // Merge the candidates from both indices, so that they are checked (and
+  // notified) in the order in which they were registered.
+  std::set<NotificationRequestId> ids;
+  auto specific_it = specific_notification_requests_.find(servable_id);
+  if (specific_it != specific_notification_requests_.end()) {
+    ids.insert(specific_it->second.begin(), specific_it->second.end());
+  }
+  auto latest_it = latest_notification_requests_.find(servable_id.name);
+  if (latest_it != latest_notification_requests_.end()) {
+    ids.insert(latest_it->second.begin(), latest_it->second.end());
+  }
+  MaybeSendStateReachedNotifications(ids, ready_notifications);
+}
+
+void ServableStateMonitor::SendStateReachedNotifications(
+    const std::vector<ReadyNotification>& ready_notifications) {
+  for (const ReadyNotification& ready_notification : ready_notifications) {
+    ready_notification.notifier_fn(ready_notification.reached_goal_state,
+                                   ready_notification.states_reached);
+  }
+}
+
 void ServableStateMonitor::SendNotifications(
     const ServableState& servable_state) {
   mutex_lock l(notify_mu_);
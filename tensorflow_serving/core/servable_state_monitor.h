@@ -19,6 +19,10 @@ limitations under the License.
 #include <deque>
 #include <functional>
 #include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
@@ -73,6 +77,28 @@ class ServableStateMonitor {
     /// Upper bound for the number of events captured in the bounded log. If set
     /// to 0, logging is disabled.
     uint64 max_count_log_events = 0;
+
+    /// Retention policy for the tracked servable states. By default every
+    /// version that ever appeared on the bus is remembered forever.
+    ///
+    /// IMPORTANT: Once a version has been forgotten, GetState() and friends
+    /// no longer report it, and a notification request registered afterwards
+    /// for that specific version is never satisfied by its past state.
+
+    /// Upper bound for the number of versions tracked per servable stream.
+    /// When exceeded, versions in state kEnd are forgotten, lowest version
+    /// first. Versions which have not reached kEnd are never forgotten, so the
+    /// bound may be exceeded by live versions. If set to 0, there is no bound.
+    uint64 max_count_versions_per_servable = 0;
+
+    /// If non-zero, versions which reached state kEnd are forgotten this many
+    /// microseconds (as measured by the event bus clock) after reaching it.
+    uint64 max_end_state_retention_micros = 0;
+
+    /// Events for servable streams whose name starts with any of these
+    /// prefixes are not tracked (nor logged) at all; they are only forwarded
+    /// to the Notify() subscribers.
+    std::vector<string> untracked_servable_name_prefixes;
   };
   // END_SKIP_DOXYGEN
 
@@ -120,7 +146,10 @@ class ServableStateMonitor {
   ///   'goal_state' or kEnd.
   ///   2. All of the latest servable requests have reached 'goal_state' or
   ///   kEnd.
-  /// The 'notifier_fn' will be called only once, and not repeatedly.
+  /// The 'notifier_fn' will be called only once, and not repeatedly. It is
+  /// called without holding any lock of the monitor, either from this call (if
+  /// the servables have already reached their states) or from the thread
+  /// publishing the event which makes them do so.
   ///
   /// The 'reached_goal_state' argument is set as true iff all of the specific
   /// servables have reached 'goal_state'.  So callers should verify that
@@ -167,6 +196,18 @@ class ServableStateMonitor {
     ServableStateNotifierFn notifier_fn;
   };
 
+  // Identifies a pending notification request. Ids are handed out in
+  // increasing order, so they also reflect the order of registration.
+  using NotificationRequestId = int64;
+
+  // A notification whose request has been satisfied, and which is ready to be
+  // sent once 'mu_' is released.
+  struct ReadyNotification {
+    ServableStateNotifierFn notifier_fn;
+    bool reached_goal_state;
+    std::map<ServableId, ServableState::ManagerState> states_reached;
+  };
+
   // Checks whether the notification request is satisfied and we cand send it.
   // If so, returns the 'reached_goal_state' bool and the 'states_reached' by
   // each servable.  Oterwise returns nullopt.
@@ -175,9 +216,37 @@ class ServableStateMonitor {
       const ServableStateNotificationRequest& notification_request)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
-  // Goes through the notification requests and tries to see if any of them can
-  // be sent. If a notification is sent, the corresponding request is removed.
-  void MaybeSendStateReachedNotifications() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Adds 'notification_request' to the pending requests and indexes it by the
+  // servables it mentions.
+  NotificationRequestId AddNotificationRequest(
+      ServableStateNotificationRequest notification_request)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Removes the pending request 'id' along with its index entries.
+  void RemoveNotificationRequest(NotificationRequestId id)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Checks whether the pending requests 'ids' can be sent. Those which can are
+  // removed, and their notifications are appended to 'ready_notifications' in
+  // the order of the ids.
+  void MaybeSendStateReachedNotifications(
+      const std::set<NotificationRequestId>& ids,
+      std::vector<ReadyNotification>* ready_notifications)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Same as above, for the pending requests which may be affected by a state
+  // change of 'servable_id', i.e. the ones mentioning that specific servable
+  // or the latest version of its stream.
+  void MaybeSendStateReachedNotifications(
+      const ServableId& servable_id,
+      std::vector<ReadyNotification>* ready_notifications)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Calls the notifier fns of 'ready_notifications'. Must be called without
+  // holding 'mu_', so that the notifier fns may call back into the monitor.
+  static void SendStateReachedNotifications(
+      const std::vector<ReadyNotification>& ready_notifications)
+      LOCKS_EXCLUDED(mu_);
 
   // Goes through the notify_fns list and calls each one with the currently
   // received ServableState.
@@ -191,6 +260,15 @@ class ServableStateMonitor {
   virtual void PreHandleEvent(
       const EventBus<ServableState>::EventAndTime& state_and_time);
 
+  // Returns true iff 'servable_name' matches one of the
+  // 'untracked_servable_name_prefixes' in the options.
+  bool IsUntracked(const string& servable_name) const;
+
+  // Forgets the kEnd versions which are beyond the retention limits of the
+  // options, given the event time of the most recent event.
+  void EnforceRetentionPolicy(const ServableId& latest_servable_id,
+                              uint64 now_micros) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Handles a bus event.
   void HandleEvent(const EventBus<ServableState>::EventAndTime& state_and_time)
       LOCKS_EXCLUDED(mu_, notify_mu_);
@@ -202,9 +280,16 @@ class ServableStateMonitor {
   mutable mutex mu_;
 
   // The current state of each servable version that has appeared on the bus.
-  // (Entries are never removed, even when they enter state kEnd.)
+  // (Entries are never removed, even when they enter state kEnd, unless a
+  // retention policy is set in the options.)
   ServableMap states_ GUARDED_BY(mu_);
 
+  // The versions which entered state kEnd, in the order in which they did so.
+  // Only populated if 'max_end_state_retention_micros' is set in the options.
+  // Entries may be stale, i.e. refer to versions which have since been
+  // forgotten or have left kEnd; they are skipped upon expiry.
+  std::deque<ServableStateAndTime> end_states_ GUARDED_BY(mu_);
+
   // The current state of each servable version that has not transitioned to
   // state ServableState::ManagerState::kEnd.
   ServableMap live_states_ GUARDED_BY(mu_);
@@ -214,8 +299,21 @@ class ServableStateMonitor {
   // is upper bounded by max_count_log_events in Options.
   BoundedLog log_ GUARDED_BY(mu_);
 
-  std::vector<ServableStateNotificationRequest>
+  // The pending notification requests, setup using
+  // NotifyWhenServablesReachState(...).
+  std::map<NotificationRequestId, ServableStateNotificationRequest>
       servable_state_notification_requests_ GUARDED_BY(mu_);
+  NotificationRequestId next_notification_request_id_ GUARDED_BY(mu_) = 0;
+
+  // Indices of 'servable_state_notification_requests_', so that an event only
+  // causes the requests it may satisfy to be checked: the requests mentioning
+  // a specific servable, and the ones mentioning the latest version of a
+  // servable stream.
+  std::unordered_map<ServableId, std::set<NotificationRequestId>,
+                     HashServableId>
+      specific_notification_requests_ GUARDED_BY(mu_);
+  std::unordered_map<ServableName, std::set<NotificationRequestId>>
+      latest_notification_requests_ GUARDED_BY(mu_);
 
   // Separate mutex to protect the notify_fns_ so that they can be updated
   // independently. This also allows these notify_fns_ to call other methods
@@ -0,0 +1,101 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Run with:
+// bazel run -c opt --dynamic_mode=off \
+// tensorflow_serving/core:servable_state_monitor_benchmark --
+// --benchmarks=.
+//
+// Publishes a long sequence of short-lived servable versions, which is the
+// pattern which used to make the monitor grow without bound, and checks that
+// with a retention policy the monitor's memory (the number of tracked states)
+// stays flat however many events are handled.
+
+#include <memory>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/core/servable_state.h"
+#include "tensorflow_serving/core/servable_state_monitor.h"
+#include "tensorflow_serving/util/event_bus.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr char kServableName[] = "kServableName";
+
+// Upper bound on the number of versions tracked with a retention policy.
+constexpr int kMaxCountVersions = 16;
+
+// Returns the total number of versions tracked by 'monitor'.
+int64 CountTrackedStates(const ServableStateMonitor& monitor) {
+  int64 count = 0;
+  for (const auto& servable_and_versions : monitor.GetAllServableStates()) {
+    count += servable_and_versions.second.size();
+  }
+  return count;
+}
+
+void BenchmarkShortLivedVersions(const int iters,
+                                 const bool with_retention_policy) {
+  testing::StopTiming();
+  auto bus = EventBus<ServableState>::CreateEventBus();
+  ServableStateMonitor::Options options;
+  if (with_retention_policy) {
+    options.max_count_versions_per_servable = kMaxCountVersions;
+  }
+  ServableStateMonitor monitor(bus.get(), options);
+
+  testing::ItemsProcessed(iters);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    bus->Publish({ServableId{kServableName, i},
+                  ServableState::ManagerState::kEnd, Status::OK()});
+  }
+  testing::StopTiming();
+
+  const int64 num_tracked_states = CountTrackedStates(monitor);
+  if (with_retention_policy) {
+    CHECK_LE(num_tracked_states, kMaxCountVersions);
+  } else {
+    CHECK_EQ(num_tracked_states, iters);
+  }
+}
+
+static void BM_ShortLivedVersions_NoRetention(const int iters) {
+  BenchmarkShortLivedVersions(iters, false);
+}
+BENCHMARK(BM_ShortLivedVersions_NoRetention);
+
+static void BM_ShortLivedVersions_MaxCountVersions(const int iters) {
+  BenchmarkShortLivedVersions(iters, true);
+}
+BENCHMARK(BM_ShortLivedVersions_MaxCountVersions);
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
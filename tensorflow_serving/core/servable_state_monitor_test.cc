@@ -278,6 +278,101 @@ TEST(ServableStateMonitorTest, VersionMapDescendingOrder) {
                                                   Pair(7, state_1_and_time)))));
 }
 
+TEST(ServableStateMonitorTest, MaxCountVersionsPerServable) {
+  test_util::FakeClockEnv env(Env::Default());
+  EventBus<ServableState>::Options bus_options;
+  bus_options.env = &env;
+  auto bus = EventBus<ServableState>::CreateEventBus(bus_options);
+  ServableStateMonitor::Options monitor_options;
+  monitor_options.max_count_versions_per_servable = 2;
+  ServableStateMonitor monitor(bus.get(), monitor_options);
+
+  // Live versions are never forgotten, even beyond the bound.
+  for (int64 version = 1; version <= 3; ++version) {
+    bus->Publish({ServableId{"foo", version},
+                  ServableState::ManagerState::kAvailable, Status::OK()});
+  }
+  EXPECT_EQ(3, monitor.GetVersionStates("foo").size());
+
+  // Versions reaching kEnd are forgotten, lowest version first.
+  bus->Publish({ServableId{"foo", 2}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  EXPECT_EQ(2, monitor.GetVersionStates("foo").size());
+  EXPECT_FALSE(monitor.GetState(ServableId{"foo", 2}));
+  bus->Publish({ServableId{"foo", 3}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  bus->Publish({ServableId{"foo", 4}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  EXPECT_THAT(monitor.GetVersionStates("foo"),
+              ElementsAre(Pair(4, ::testing::_), Pair(1, ::testing::_)));
+
+  // Other streams are not affected.
+  bus->Publish({ServableId{"bar", 1}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  EXPECT_TRUE(monitor.GetState(ServableId{"bar", 1}));
+}
+
+TEST(ServableStateMonitorTest, MaxEndStateRetention) {
+  test_util::FakeClockEnv env(Env::Default());
+  EventBus<ServableState>::Options bus_options;
+  bus_options.env = &env;
+  auto bus = EventBus<ServableState>::CreateEventBus(bus_options);
+  ServableStateMonitor::Options monitor_options;
+  monitor_options.max_end_state_retention_micros = 10;
+  ServableStateMonitor monitor(bus.get(), monitor_options);
+
+  bus->Publish({ServableId{"foo", 1}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  env.AdvanceByMicroseconds(5);
+  bus->Publish({ServableId{"foo", 2}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  bus->Publish({ServableId{"bar", 1}, ServableState::ManagerState::kAvailable,
+                Status::OK()});
+  EXPECT_TRUE(monitor.GetState(ServableId{"foo", 1}));
+  EXPECT_TRUE(monitor.GetState(ServableId{"foo", 2}));
+
+  // Expiry is driven by the time of the incoming events.
+  env.AdvanceByMicroseconds(5);
+  bus->Publish({ServableId{"bar", 2}, ServableState::ManagerState::kStart,
+                Status::OK()});
+  EXPECT_FALSE(monitor.GetState(ServableId{"foo", 1}));
+  EXPECT_TRUE(monitor.GetState(ServableId{"foo", 2}));
+
+  env.AdvanceByMicroseconds(5);
+  bus->Publish({ServableId{"bar", 2}, ServableState::ManagerState::kLoading,
+                Status::OK()});
+  EXPECT_TRUE(monitor.GetVersionStates("foo").empty());
+  // Live versions are never forgotten.
+  EXPECT_TRUE(monitor.GetState(ServableId{"bar", 1}));
+}
+
+TEST(ServableStateMonitorTest, UntrackedServableNamePrefixes) {
+  test_util::FakeClockEnv env(Env::Default());
+  EventBus<ServableState>::Options bus_options;
+  bus_options.env = &env;
+  auto bus = EventBus<ServableState>::CreateEventBus(bus_options);
+  ServableStateMonitor::Options monitor_options;
+  monitor_options.max_count_log_events = 4;
+  monitor_options.untracked_servable_name_prefixes = {"internal_"};
+  ServableStateMonitor monitor(bus.get(), monitor_options);
+  ServableState notified_state;
+  monitor.Notify([&](const ServableState& servable_state) {
+    notified_state = servable_state;
+  });
+
+  const ServableState untracked_state = {ServableId{"internal_foo", 1},
+                                         ServableState::ManagerState::kEnd,
+                                         Status::OK()};
+  bus->Publish(untracked_state);
+  EXPECT_EQ(untracked_state, notified_state);
+  EXPECT_TRUE(monitor.GetAllServableStates().empty());
+  EXPECT_TRUE(monitor.GetBoundedLog().empty());
+
+  bus->Publish({ServableId{"foo", 1}, ServableState::ManagerState::kEnd,
+                Status::OK()});
+  EXPECT_TRUE(monitor.GetState(ServableId{"foo", 1}));
+}
+
 TEST(ServableStateMonitorTest, NotifyWhenServablesReachStateZeroServables) {
   auto bus = EventBus<ServableState>::CreateEventBus({});
   ServableStateMonitor monitor(bus.get());
@@ -475,6 +570,44 @@ TEST(ServableStateMonitorTest, NotifyWhenServablesReachStateOnlyNotifiedOnce) {
   bus->Publish(specific_goal_state);
 }
 
+TEST(ServableStateMonitorTest, NotifierFnMayCallIntoMonitor) {
+  test_util::FakeClockEnv env(Env::Default());
+  EventBus<ServableState>::Options bus_options;
+  bus_options.env = &env;
+  auto bus = EventBus<ServableState>::CreateEventBus(bus_options);
+  ServableStateMonitor monitor(bus.get());
+
+  const ServableId specific_goal_state_id = {"specific_goal_state", 42};
+  std::vector<ServableRequest> servables;
+  servables.push_back(ServableRequest::FromId(specific_goal_state_id));
+  servables.push_back(ServableRequest::Latest("servable_stream"));
+
+  bool notified = false;
+  monitor.NotifyWhenServablesReachState(
+      servables, ServableState::ManagerState::kAvailable,
+      [&](const bool reached,
+          const std::map<ServableId, ServableState::ManagerState>&
+              states_reached) {
+        EXPECT_TRUE(reached);
+        // The notifier fn is called without holding the monitor's lock.
+        EXPECT_TRUE(monitor.GetState(specific_goal_state_id));
+        notified = true;
+      });
+
+  // Events for unrelated servables don't satisfy the request.
+  bus->Publish({ServableId{"specific_goal_state", 7},
+                ServableState::ManagerState::kAvailable, Status::OK()});
+  bus->Publish({ServableId{"other_stream", 1},
+                ServableState::ManagerState::kAvailable, Status::OK()});
+  bus->Publish({specific_goal_state_id, ServableState::ManagerState::kAvailable,
+                Status::OK()});
+  EXPECT_FALSE(notified);
+
+  bus->Publish({ServableId{"servable_stream", 3},
+                ServableState::ManagerState::kAvailable, Status::OK()});
+  EXPECT_TRUE(notified);
+}
+
 TEST(ServableStateMonitorTest, WaitUntilServablesReachStateFullFunctionality) {
   using ManagerState = ServableState::ManagerState;
 
@@ -0,0 +1,116 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/socket_metric_collector.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace serving {
+
+Status SocketMetricCollector::Create(
+    std::unique_ptr<MetricEncoder> encoder, const string& socket_path,
+    std::unique_ptr<MetricCollector>* const metric_collector) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return errors::InvalidArgument("Invalid metric socket path: '",
+                                   socket_path, "'");
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+  const int socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+  if (socket_fd < 0) {
+    return errors::Internal("Failed to create metric socket: ",
+                            strerror(errno));
+  }
+  if (connect(socket_fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    const Status status = errors::Unavailable(
+        "Failed to connect to metric socket ", socket_path, ": ",
+        strerror(errno));
+    close(socket_fd);
+    return status;
+  }
+  metric_collector->reset(
+      new SocketMetricCollector(std::move(encoder), socket_fd));
+  return Status::OK();
+}
+
+SocketMetricCollector::SocketMetricCollector(
+    std::unique_ptr<MetricEncoder> encoder, const int socket_fd)
+    : socket_fd_(socket_fd), encoder_(std::move(encoder)) {}
+
+SocketMetricCollector::~SocketMetricCollector() { close(socket_fd_); }
+
+Status SocketMetricCollector::PublishMetric(Metric* const metric) {
+  mutex_lock l(mu_);
+  buffer_.clear();
+  encoder_->Encode(*metric, &buffer_);
+  return Send();
+}
+
+Status SocketMetricCollector::PublishMetrics(
+    const std::vector<Metric*>& metrics) {
+  if (metrics.empty()) {
+    return Status::OK();
+  }
+  mutex_lock l(mu_);
+  buffer_.clear();
+  for (const Metric* metric : metrics) {
+    encoder_->Encode(*metric, &buffer_);
+  }
+  return Send();
+}
+
+Status SocketMetricCollector::Send() {
+  if (send(socket_fd_, buffer_.data(), buffer_.size(), MSG_DONTWAIT) < 0) {
+    return errors::Unavailable("Failed to send metrics: ", strerror(errno));
+  }
+  return Status::OK();
+}
+
+namespace {
+
+auto line_protocol_factory =
+    [](const string& argument,
+       std::unique_ptr<MetricCollector>* metric_collector) {
+      return SocketMetricCollector::Create(
+          std::unique_ptr<MetricEncoder>(new LineProtocolMetricEncoder()),
+          argument, metric_collector);
+    };
+REGISTER_METRIC_COLLECTOR("line_protocol", line_protocol_factory);
+
+auto binary_factory = [](const string& argument,
+                         std::unique_ptr<MetricCollector>* metric_collector) {
+  return SocketMetricCollector::Create(
+      std::unique_ptr<MetricEncoder>(new BinaryMetricEncoder()), argument,
+      metric_collector);
+};
+REGISTER_METRIC_COLLECTOR("binary", binary_factory);
+
+}  // namespace
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,71 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_SOCKET_METRIC_COLLECTOR_H_
+#define TENSORFLOW_SERVING_CORE_SOCKET_METRIC_COLLECTOR_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow_serving/core/metric_encoder.h"
+#include "tensorflow_serving/core/metrics_collector.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Publishes metrics to a local agent listening on a Unix datagram socket, each
+// metric (or batch of metrics, see PublishMetrics()) in one datagram, encoded
+// by a MetricEncoder into a buffer reused across calls.
+//
+// Registered as "line_protocol:<socket path>" (LineProtocolMetricEncoder) and
+// "binary:<socket path>" (BinaryMetricEncoder).
+//
+// Sending never blocks: if the agent doesn't keep up and the socket buffer is
+// full, the metrics are dropped and an error is returned.
+class SocketMetricCollector : public MetricCollector {
+ public:
+  // Creates a collector sending to the socket bound to 'socket_path'.
+  static Status Create(std::unique_ptr<MetricEncoder> encoder,
+                       const string& socket_path,
+                       std::unique_ptr<MetricCollector>* metric_collector);
+
+  // Takes ownership of 'socket_fd', which must be a connected datagram socket.
+  SocketMetricCollector(std::unique_ptr<MetricEncoder> encoder, int socket_fd);
+  ~SocketMetricCollector() override;
+
+  Status PublishMetric(Metric* metric) override;
+  Status PublishMetrics(const std::vector<Metric*>& metrics) override;
+
+ private:
+  // Sends 'buffer_' as one datagram.
+  Status Send() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int socket_fd_;
+
+  mutex mu_;
+  const std::unique_ptr<MetricEncoder> encoder_ GUARDED_BY(mu_);
+  string buffer_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SocketMetricCollector);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_SOCKET_METRIC_COLLECTOR_H_
@@ -0,0 +1,88 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/socket_metric_collector.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/error_codes.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+class SocketMetricCollectorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+    collector_.reset(new SocketMetricCollector(
+        std::unique_ptr<MetricEncoder>(new LineProtocolMetricEncoder()),
+        fds[0]));
+    agent_fd_ = fds[1];
+  }
+
+  void TearDown() override { close(agent_fd_); }
+
+  // Returns the next datagram received by the agent.
+  string Receive() {
+    char buffer[4096];
+    const ssize_t size = recv(agent_fd_, buffer, sizeof(buffer), 0);
+    return size < 0 ? "" : string(buffer, size);
+  }
+
+  std::unique_ptr<SocketMetricCollector> collector_;
+  int agent_fd_;
+};
+
+TEST_F(SocketMetricCollectorTest, PublishMetric) {
+  MetricCollector::PredictMetric metric = {"PredictMetric", 0, 1, "a", 1, true};
+  TF_ASSERT_OK(collector_->PublishMetric(&metric));
+  EXPECT_EQ(
+      "PredictMetric,model_name=a metric_version=0i,model_version=1i,"
+      "is_success=true,predict_time_ms=1i,predict_time_micros=0i\n",
+      Receive());
+}
+
+TEST_F(SocketMetricCollectorTest, PublishMetricsInOneDatagram) {
+  MetricCollector::PredictMetric metric_a = {"PredictMetric", 0, 1, "a", 1,
+                                             true};
+  MetricCollector::PredictMetric metric_b = {"PredictMetric", 1, 1, "b", 1,
+                                             true};
+  TF_ASSERT_OK(collector_->PublishMetrics({&metric_a, &metric_b}));
+  EXPECT_EQ(
+      "PredictMetric,model_name=a metric_version=0i,model_version=1i,"
+      "is_success=true,predict_time_ms=1i,predict_time_micros=0i\n"
+      "PredictMetric,model_name=b metric_version=1i,model_version=1i,"
+      "is_success=true,predict_time_ms=1i,predict_time_micros=0i\n",
+      Receive());
+}
+
+TEST(SocketMetricCollectorCreateTest, CreateFromRegistry) {
+  std::unique_ptr<MetricCollector> metric_collector;
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            MetricCollector::Create("line_protocol", &metric_collector).code());
+  EXPECT_EQ(error::UNAVAILABLE,
+            MetricCollector::Create("binary:/nonexistent/agent.sock",
+                                    &metric_collector)
+                .code());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
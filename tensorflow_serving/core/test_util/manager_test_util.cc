@@ -55,6 +55,10 @@ uint32 BasicManagerTestAccess::num_load_threads() const {
   return manager_->num_load_threads();
 }
 
+int64 BasicManagerTestAccess::OldestRetiredServableAgeMicros() const {
+  return manager_->serving_map_.OldestRetiredServableAgeMicros();
+}
+
 CachingManagerTestAccess::CachingManagerTestAccess(CachingManager* manager)
     : manager_(manager) {}
 
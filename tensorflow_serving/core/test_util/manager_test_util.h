@@ -57,6 +57,10 @@ class BasicManagerTestAccess {
 
   uint32 num_load_threads() const;
 
+  // Returns the age of the oldest servable which was removed from the serving
+  // map but is still referenced, or 0.
+  int64 OldestRetiredServableAgeMicros() const;
+
  private:
   BasicManager* const manager_;
 
@@ -0,0 +1,204 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_MODEL_SERVERS_ASYNC_UNARY_CALL_H_
+#define TENSORFLOW_SERVING_MODEL_SERVERS_ASYNC_UNARY_CALL_H_
+
+#include <functional>
+#include <utility>
+
+#include "grpc++/completion_queue.h"
+#include "grpc++/server_context.h"
+#include "grpc++/support/async_unary_call.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow_serving/model_servers/grpc_status_util.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A call served from a completion queue, which is the tag of its pending
+// operation on the queue.
+class AsyncCall {
+ public:
+  virtual ~AsyncCall() = default;
+
+  // Advances the call once its pending operation completes; 'ok' is false if
+  // the operation failed, e.g. because the server is shutting down.
+  virtual void Proceed(bool ok) = 0;
+};
+
+// Counts the AsyncUnaryCalls which have arrived but whose response has not
+// been sent yet, so that a server can wait for them before shutting down the
+// completion queues their responses are sent through.
+class InFlightCallCounter {
+ public:
+  InFlightCallCounter() = default;
+
+  void Increment();
+  void Decrement();
+
+  // Blocks until no call is in flight.
+  void WaitUntilNoCallsInFlight();
+
+ private:
+  mutex mu_;
+  condition_variable no_calls_in_flight_;
+  int num_calls_in_flight_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(InFlightCallCounter);
+};
+
+// A unary call whose handler reports its outcome through a callback, possibly
+// from another thread, so that no thread is held while the request waits for
+// its session run (e.g. in a batching queue). Each call requests the next one
+// as soon as it arrives, and deletes itself once its response is sent.
+//
+// To shut down, shut down the server, wait for the in-flight calls on the
+// InFlightCallCounter, and only then shut down the completion queues, since
+// handlers may still send responses until the counter drops to zero.
+template <typename Request, typename Response>
+class AsyncUnaryCall : public AsyncCall {
+ public:
+  // Requests the next call of the method from the server, e.g.
+  // PredictionService::AsyncService::RequestPredict().
+  using RequestMethod = std::function<void(
+      ::grpc::ServerContext*, Request*,
+      ::grpc::ServerAsyncResponseWriter<Response>*,
+      ::grpc::ServerCompletionQueue*, void*)>;
+  using Handler = std::function<void(const RunOptions&, const Request&,
+                                     Response*,
+                                     std::function<void(const Status&)>)>;
+
+  // Waits for the next call of the method on 'queue'. 'in_flight_calls' must
+  // outlive the calls.
+  static void Spawn(const string& name, RequestMethod request_method,
+                    Handler handler, ::grpc::ServerCompletionQueue* queue,
+                    InFlightCallCounter* in_flight_calls);
+
+  ~AsyncUnaryCall() override;
+
+  void Proceed(bool ok) override;
+
+ private:
+  AsyncUnaryCall(const string& name, RequestMethod request_method,
+                 Handler handler, ::grpc::ServerCompletionQueue* queue,
+                 InFlightCallCounter* in_flight_calls);
+
+  const string name_;
+  const RequestMethod request_method_;
+  const Handler handler_;
+  ::grpc::ServerCompletionQueue* const queue_;
+  InFlightCallCounter* const in_flight_calls_;
+  ::grpc::ServerContext context_;
+  Request request_;
+  Response response_;
+  ::grpc::ServerAsyncResponseWriter<Response> responder_;
+  // Whether the call has arrived, and is counted in 'in_flight_calls_'.
+  bool arrived_ = false;
+  // Whether the response has been sent.
+  bool finished_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncUnaryCall);
+};
+
+//////////
+// Implementation details follow. API users need not read.
+
+inline void InFlightCallCounter::Increment() {
+  mutex_lock l(mu_);
+  ++num_calls_in_flight_;
+}
+
+inline void InFlightCallCounter::Decrement() {
+  mutex_lock l(mu_);
+  DCHECK_GT(num_calls_in_flight_, 0);
+  if (--num_calls_in_flight_ == 0) {
+    no_calls_in_flight_.notify_all();
+  }
+}
+
+inline void InFlightCallCounter::WaitUntilNoCallsInFlight() {
+  mutex_lock l(mu_);
+  while (num_calls_in_flight_ > 0) {
+    no_calls_in_flight_.wait(l);
+  }
+}
+
+template <typename Request, typename Response>
+void AsyncUnaryCall<Request, Response>::Spawn(
+    const string& name, RequestMethod request_method, Handler handler,
+    ::grpc::ServerCompletionQueue* queue,
+    InFlightCallCounter* in_flight_calls) {
+  new AsyncUnaryCall(name, std::move(request_method), std::move(handler),
+                     queue, in_flight_calls);
+}
+
+template <typename Request, typename Response>
+AsyncUnaryCall<Request, Response>::AsyncUnaryCall(
+    const string& name, RequestMethod request_method, Handler handler,
+    ::grpc::ServerCompletionQueue* queue, InFlightCallCounter* in_flight_calls)
+    : name_(name),
+      request_method_(std::move(request_method)),
+      handler_(std::move(handler)),
+      queue_(queue),
+      in_flight_calls_(in_flight_calls),
+      responder_(&context_) {
+  request_method_(&context_, &request_, &responder_, queue_, this);
+}
+
+template <typename Request, typename Response>
+AsyncUnaryCall<Request, Response>::~AsyncUnaryCall() {
+  if (arrived_) {
+    in_flight_calls_->Decrement();
+  }
+}
+
+template <typename Request, typename Response>
+void AsyncUnaryCall<Request, Response>::Proceed(const bool ok) {
+  if (!ok || finished_) {
+    delete this;
+    return;
+  }
+  arrived_ = true;
+  in_flight_calls_->Increment();
+  Spawn(name_, request_method_, handler_, queue_, in_flight_calls_);
+
+  RunOptions run_options = RunOptions();
+  // By default, this is infinite which is the same default as RunOptions.
+  run_options.set_timeout_in_ms(
+      DeadlineToTimeoutMillis(context_.raw_deadline()));
+  // The call may be deleted by another polling thread as soon as it is
+  // finished, possibly before the handler returns, so the handler must not
+  // be invoked in place.
+  const Handler handler = handler_;
+  handler(run_options, request_, &response_, [this](const Status& status) {
+    if (!status.ok()) {
+      VLOG(1) << name_ << " request failed: " << status.error_message();
+    }
+    finished_ = true;
+    responder_.Finish(response_, ToGRPCStatus(status), this);
+  });
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_MODEL_SERVERS_ASYNC_UNARY_CALL_H_
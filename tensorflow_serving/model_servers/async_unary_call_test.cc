@@ -0,0 +1,221 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/model_servers/async_unary_call.h"
+
+#include <chrono>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include "grpc++/client_context.h"
+#include "grpc++/create_channel.h"
+#include "grpc++/security/credentials.h"
+#include "grpc++/security/server_credentials.h"
+#include "grpc++/server.h"
+#include "grpc++/server_builder.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow_serving/apis/prediction_service.grpc.pb.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using PredictCall = AsyncUnaryCall<PredictRequest, PredictResponse>;
+
+// Serves Predict calls from a completion queue with 'handler_'.
+class AsyncUnaryCallTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ::grpc::ServerBuilder builder;
+    int port = 0;
+    builder.AddListeningPort("localhost:0",
+                             ::grpc::InsecureServerCredentials(), &port);
+    builder.RegisterService(&service_);
+    queue_ = builder.AddCompletionQueue();
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(0, port);
+    stub_ = PredictionService::NewStub(
+        ::grpc::CreateChannel("localhost:" + std::to_string(port),
+                              ::grpc::InsecureChannelCredentials()));
+
+    PredictCall::Spawn(
+        "Predict",
+        [this](::grpc::ServerContext* context, PredictRequest* request,
+               ::grpc::ServerAsyncResponseWriter<PredictResponse>* responder,
+               ::grpc::ServerCompletionQueue* queue, void* tag) {
+          service_.RequestPredict(context, request, responder, queue, queue,
+                                  tag);
+        },
+        [this](const RunOptions& run_options, const PredictRequest& request,
+               PredictResponse* response,
+               std::function<void(const Status&)> done) {
+          handler_(run_options, request, response, std::move(done));
+        },
+        queue_.get(), &in_flight_calls_);
+    polling_thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "polling_thread", [this]() {
+          void* tag;
+          bool ok;
+          while (queue_->Next(&tag, &ok)) {
+            static_cast<AsyncCall*>(tag)->Proceed(ok);
+          }
+        }));
+  }
+
+  void TearDown() override { ShutDown(); }
+
+  // Shuts down the server the way the model server does.
+  void ShutDown() {
+    if (server_ == nullptr) {
+      return;
+    }
+    server_->Shutdown();
+    in_flight_calls_.WaitUntilNoCallsInFlight();
+    queue_->Shutdown();
+    polling_thread_.reset();
+    server_.reset();
+  }
+
+  // Sends a Predict request with 'input' as the value of its only input.
+  ::grpc::Status Predict(const float input, PredictResponse* response) {
+    PredictRequest request;
+    request.mutable_model_spec()->set_name("test_model");
+    (*request.mutable_inputs())["x"].add_float_val(input);
+    ::grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() +
+                         std::chrono::seconds(30));
+    return stub_->Predict(&context, request, response);
+  }
+
+  PredictionService::WithAsyncMethod_Predict<PredictionService::Service>
+      service_;
+  std::unique_ptr<::grpc::ServerCompletionQueue> queue_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::unique_ptr<PredictionService::Stub> stub_;
+  InFlightCallCounter in_flight_calls_;
+  PredictCall::Handler handler_;
+  std::unique_ptr<Thread> polling_thread_;
+};
+
+// Responds with the input, plus one.
+void AddOne(const RunOptions& run_options, const PredictRequest& request,
+            PredictResponse* response,
+            std::function<void(const Status&)> done) {
+  (*response->mutable_outputs())["y"].add_float_val(
+      request.inputs().at("x").float_val(0) + 1);
+  done(Status::OK());
+}
+
+TEST_F(AsyncUnaryCallTest, SendsResponse) {
+  handler_ = AddOne;
+  for (int i = 0; i < 3; ++i) {
+    PredictResponse response;
+    const ::grpc::Status status = Predict(i, &response);
+    ASSERT_TRUE(status.ok()) << status.error_message();
+    EXPECT_EQ(i + 1, response.outputs().at("y").float_val(0));
+  }
+}
+
+TEST_F(AsyncUnaryCallTest, SendsError) {
+  handler_ = [](const RunOptions& run_options, const PredictRequest& request,
+                PredictResponse* response,
+                std::function<void(const Status&)> done) {
+    done(errors::InvalidArgument("bad request"));
+  };
+  PredictResponse response;
+  const ::grpc::Status status = Predict(1, &response);
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  EXPECT_EQ("bad request", status.error_message());
+}
+
+TEST_F(AsyncUnaryCallTest, PassesDeadline) {
+  int64 timeout_in_ms = 0;
+  handler_ = [&timeout_in_ms](const RunOptions& run_options,
+                              const PredictRequest& request,
+                              PredictResponse* response,
+                              std::function<void(const Status&)> done) {
+    timeout_in_ms = run_options.timeout_in_ms();
+    done(Status::OK());
+  };
+  PredictResponse response;
+  ASSERT_TRUE(Predict(1, &response).ok());
+  // gRPC rounds the deadline it sends up.
+  EXPECT_GT(timeout_in_ms, 0);
+  EXPECT_LE(timeout_in_ms, 31 * 1000);
+}
+
+TEST_F(AsyncUnaryCallTest, SendsResponseFromAnotherThread) {
+  Notification handler_called;
+  std::function<void(const Status&)> deferred_done;
+  handler_ = [&handler_called, &deferred_done](
+                 const RunOptions& run_options, const PredictRequest& request,
+                 PredictResponse* response,
+                 std::function<void(const Status&)> done) {
+    (*response->mutable_outputs())["y"].add_float_val(7);
+    deferred_done = std::move(done);
+    handler_called.Notify();
+  };
+  std::unique_ptr<Thread> completing_thread(Env::Default()->StartThread(
+      ThreadOptions(), "completing_thread", [&]() {
+        handler_called.WaitForNotification();
+        deferred_done(Status::OK());
+      }));
+  PredictResponse response;
+  const ::grpc::Status status = Predict(1, &response);
+  ASSERT_TRUE(status.ok()) << status.error_message();
+  EXPECT_EQ(7, response.outputs().at("y").float_val(0));
+}
+
+TEST_F(AsyncUnaryCallTest, ShutdownWaitsForCallsInFlight) {
+  Notification handler_called;
+  std::function<void(const Status&)> deferred_done;
+  handler_ = [&handler_called, &deferred_done](
+                 const RunOptions& run_options, const PredictRequest& request,
+                 PredictResponse* response,
+                 std::function<void(const Status&)> done) {
+    (*response->mutable_outputs())["y"].add_float_val(7);
+    deferred_done = std::move(done);
+    handler_called.Notify();
+  };
+  ::grpc::Status status;
+  PredictResponse response;
+  std::unique_ptr<Thread> client_thread(Env::Default()->StartThread(
+      ThreadOptions(), "client_thread",
+      [this, &status, &response]() { status = Predict(1, &response); }));
+  handler_called.WaitForNotification();
+
+  Notification shut_down;
+  std::unique_ptr<Thread> shutdown_thread(Env::Default()->StartThread(
+      ThreadOptions(), "shutdown_thread", [this, &shut_down]() {
+        ShutDown();
+        shut_down.Notify();
+      }));
+  // The server can't shut down while the call waits for its handler. The
+  // sleep only gives a broken shutdown the chance to get ahead.
+  Env::Default()->SleepForMicroseconds(50 * 1000);
+  EXPECT_FALSE(shut_down.HasBeenNotified());
+
+  deferred_done(Status::OK());
+  shut_down.WaitForNotification();
+  client_thread.reset();
+  ASSERT_TRUE(status.ok()) << status.error_message();
+  EXPECT_EQ(7, response.outputs().at("y").float_val(0));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
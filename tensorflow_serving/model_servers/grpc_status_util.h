@@ -0,0 +1,36 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_MODEL_SERVERS_GRPC_STATUS_UTIL_H_
+#define TENSORFLOW_SERVING_MODEL_SERVERS_GRPC_STATUS_UTIL_H_
+
+#include "grpc++/support/status.h"
+#include "grpc/support/time.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Returns the time left until 'deadline', in milliseconds, e.g. for
+// RunOptions::timeout_in_ms.
+int DeadlineToTimeoutMillis(gpr_timespec deadline);
+
+// Converts 'status' to a grpc::Status, truncating long error messages.
+::grpc::Status ToGRPCStatus(const Status& status);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_MODEL_SERVERS_GRPC_STATUS_UTIL_H_
@@ -42,14 +42,19 @@ limitations under the License.
 // To specify port (default 8500): --port=my_port
 // To enable batching (default disabled): --enable_batching
 // To override the default batching parameters: --batching_parameters_file
+// To serve Predict, Classify and Regress from completion queues rather than
+// one thread per in-flight request: --num_async_polling_threads
 
 #include <unistd.h>
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <functional>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/wrappers.pb.h"
+#include "grpc++/completion_queue.h"
 #include "grpc++/security/server_credentials.h"
 #include "grpc++/server.h"
 #include "grpc++/server_builder.h"
@@ -70,6 +75,8 @@ limitations under the License.
 #include "tensorflow_serving/apis/prediction_service.pb.h"
 #include "tensorflow_serving/config/model_server_config.pb.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
+#include "tensorflow_serving/model_servers/async_unary_call.h"
+#include "tensorflow_serving/model_servers/grpc_status_util.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/model_servers/platform_config_util.h"
 #include "tensorflow_serving/model_servers/server_core.h"
@@ -79,6 +86,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/predict_impl.h"
 #include "tensorflow_serving/servables/tensorflow/regression_service.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
 
 namespace grpc {
 class ServerCompletionQueue;
@@ -87,24 +95,31 @@ class ServerCompletionQueue;
 using tensorflow::string;
 using tensorflow::serving::AspiredVersionPolicy;
 using tensorflow::serving::AspiredVersionsManager;
+using tensorflow::serving::AsyncCall;
+using tensorflow::serving::AsyncUnaryCall;
 using tensorflow::serving::AvailabilityPreservingPolicy;
 using tensorflow::serving::BatchingParameters;
 using tensorflow::serving::EventBus;
 using tensorflow::serving::FileSystemStoragePathSourceConfig;
+using tensorflow::serving::DeadlineToTimeoutMillis;
 using tensorflow::serving::GetModelMetadataImpl;
+using tensorflow::serving::InFlightCallCounter;
 using tensorflow::serving::ModelServerConfig;
 using tensorflow::serving::ServableState;
 using tensorflow::serving::ServerCore;
 using tensorflow::serving::SessionBundleConfig;
 using tensorflow::serving::TensorflowClassificationServiceImpl;
-using tensorflow::serving::TensorflowRegressionServiceImpl;
 using tensorflow::serving::TensorflowPredictor;
 using tensorflow::serving::TensorflowRegressionServiceImpl;
+using tensorflow::serving::ThreadPoolExecutor;
+using tensorflow::serving::ToGRPCStatus;
 using tensorflow::serving::UniquePtrWithDeps;
 
 using grpc::InsecureServerCredentials;
 using grpc::Server;
 using grpc::ServerBuilder;
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
 using tensorflow::serving::ClassificationRequest;
 using tensorflow::serving::ClassificationResponse;
@@ -167,25 +182,6 @@ ProtoType ReadProtoFromFile(const string& file) {
   return proto;
 }
 
-int DeadlineToTimeoutMillis(const gpr_timespec deadline) {
-  return gpr_time_to_millis(
-      gpr_time_sub(gpr_convert_clock_type(deadline, GPR_CLOCK_MONOTONIC),
-                   gpr_now(GPR_CLOCK_MONOTONIC)));
-}
-
-grpc::Status ToGRPCStatus(const tensorflow::Status& status) {
-  const int kErrorMessageLimit = 1024;
-  string error_message;
-  if (status.error_message().length() > kErrorMessageLimit) {
-    error_message =
-        status.error_message().substr(0, kErrorMessageLimit) + "...TRUNCATED";
-  } else {
-    error_message = status.error_message();
-  }
-  return grpc::Status(static_cast<grpc::StatusCode>(status.code()),
-                      error_message);
-}
-
 class PredictionServiceImpl final : public PredictionService::Service {
  public:
   explicit PredictionServiceImpl(std::unique_ptr<ServerCore> core,
@@ -208,6 +204,8 @@ class PredictionServiceImpl final : public PredictionService::Service {
     return status;
   }
 
+  ServerCore* core() const { return core_.get(); }
+
   grpc::Status GetModelMetadata(ServerContext* context,
                                 const GetModelMetadataRequest* request,
                                 GetModelMetadataResponse* response) override {
@@ -278,19 +276,157 @@ class PredictionServiceImpl final : public PredictionService::Service {
   bool use_saved_model_;
 };
 
+using AsyncPredictionServiceBase = PredictionService::WithAsyncMethod_Predict<
+    PredictionService::WithAsyncMethod_Classify<
+        PredictionService::WithAsyncMethod_Regress<
+            PredictionService::Service>>>;
+
+// Serves Predict, Classify and Regress from completion queues (see
+// ServeCalls()), and the other methods synchronously like
+// PredictionServiceImpl. Requests are post-processed and their responses sent
+// on a pool of 'num_threads' threads once their session run completes, rather
+// than on the thread which ran the session, e.g. the batch thread of a
+// BatchingSession.
+class AsyncPredictionServiceImpl final : public AsyncPredictionServiceBase {
+ public:
+  AsyncPredictionServiceImpl(std::unique_ptr<ServerCore> core,
+                             bool use_saved_model, int num_threads)
+      : sync_service_(std::move(core), use_saved_model),
+        predictor_(new TensorflowPredictor(use_saved_model)),
+        executor_(tensorflow::Env::Default(), "async_completion",
+                  num_threads) {}
+
+  grpc::Status GetModelMetadata(ServerContext* context,
+                                const GetModelMetadataRequest* request,
+                                GetModelMetadataResponse* response) override {
+    return sync_service_.GetModelMetadata(context, request, response);
+  }
+
+  grpc::Status MultiInference(ServerContext* context,
+                              const MultiInferenceRequest* request,
+                              MultiInferenceResponse* response) override {
+    return sync_service_.MultiInference(context, request, response);
+  }
+
+  // Serves calls from 'queue' until it is shut down.
+  void ServeCalls(ServerCompletionQueue* queue) {
+    ServerCore* const core = sync_service_.core();
+    ThreadPoolExecutor* const executor = &executor_;
+    AsyncUnaryCall<PredictRequest, PredictResponse>::Spawn(
+        "Predict",
+        [this](ServerContext* context, PredictRequest* request,
+               ServerAsyncResponseWriter<PredictResponse>* responder,
+               ServerCompletionQueue* queue, void* tag) {
+          RequestPredict(context, request, responder, queue, queue, tag);
+        },
+        [this, core, executor](
+            const tensorflow::RunOptions& run_options,
+            const PredictRequest& request, PredictResponse* response,
+            std::function<void(const tensorflow::Status&)> done) {
+          predictor_->PredictAsync(run_options, core, executor, request,
+                                   response, std::move(done));
+        },
+        queue, &in_flight_calls_);
+    AsyncUnaryCall<ClassificationRequest, ClassificationResponse>::Spawn(
+        "Classify",
+        [this](ServerContext* context, ClassificationRequest* request,
+               ServerAsyncResponseWriter<ClassificationResponse>* responder,
+               ServerCompletionQueue* queue, void* tag) {
+          RequestClassify(context, request, responder, queue, queue, tag);
+        },
+        [core, executor](const tensorflow::RunOptions& run_options,
+                         const ClassificationRequest& request,
+                         ClassificationResponse* response,
+                         std::function<void(const tensorflow::Status&)> done) {
+          TensorflowClassificationServiceImpl::ClassifyAsync(
+              run_options, core, executor, request, response, std::move(done));
+        },
+        queue, &in_flight_calls_);
+    AsyncUnaryCall<RegressionRequest, RegressionResponse>::Spawn(
+        "Regress",
+        [this](ServerContext* context, RegressionRequest* request,
+               ServerAsyncResponseWriter<RegressionResponse>* responder,
+               ServerCompletionQueue* queue, void* tag) {
+          RequestRegress(context, request, responder, queue, queue, tag);
+        },
+        [core, executor](const tensorflow::RunOptions& run_options,
+                         const RegressionRequest& request,
+                         RegressionResponse* response,
+                         std::function<void(const tensorflow::Status&)> done) {
+          TensorflowRegressionServiceImpl::RegressAsync(
+              run_options, core, executor, request, response, std::move(done));
+        },
+        queue, &in_flight_calls_);
+
+    void* tag;
+    bool ok;
+    while (queue->Next(&tag, &ok)) {
+      static_cast<AsyncCall*>(tag)->Proceed(ok);
+    }
+  }
+
+  // Blocks until the calls which have arrived have sent their responses. Once
+  // the server is shut down, no more calls arrive, and the completion queues
+  // may then be shut down.
+  void WaitUntilNoCallsInFlight() {
+    in_flight_calls_.WaitUntilNoCallsInFlight();
+  }
+
+ private:
+  PredictionServiceImpl sync_service_;
+  std::unique_ptr<TensorflowPredictor> predictor_;
+  InFlightCallCounter in_flight_calls_;
+  // Declared last, so that the continuations it runs complete before the
+  // members they use are destroyed.
+  ThreadPoolExecutor executor_;
+};
+
 void RunServer(int port, std::unique_ptr<ServerCore> core,
-               bool use_saved_model) {
+               bool use_saved_model, int num_async_polling_threads) {
   // "0.0.0.0" is the way to listen on localhost in gRPC.
   const string server_address = "0.0.0.0:" + std::to_string(port);
-  PredictionServiceImpl service(std::move(core), use_saved_model);
   ServerBuilder builder;
   std::shared_ptr<grpc::ServerCredentials> creds = InsecureServerCredentials();
   builder.AddListeningPort(server_address, creds);
-  builder.RegisterService(&service);
   builder.SetMaxMessageSize(tensorflow::kint32max);
+  if (num_async_polling_threads <= 0) {
+    PredictionServiceImpl service(std::move(core), use_saved_model);
+    builder.RegisterService(&service);
+    std::unique_ptr<Server> server(builder.BuildAndStart());
+    LOG(INFO) << "Running ModelServer at " << server_address << " ...";
+    server->Wait();
+    return;
+  }
+
+  AsyncPredictionServiceImpl service(std::move(core), use_saved_model,
+                                     num_async_polling_threads);
+  builder.RegisterService(&service);
+  // Each polling thread has its own completion queue, so that they don't
+  // contend on one.
+  std::vector<std::unique_ptr<ServerCompletionQueue>> queues;
+  for (int i = 0; i < num_async_polling_threads; ++i) {
+    queues.push_back(builder.AddCompletionQueue());
+  }
   std::unique_ptr<Server> server(builder.BuildAndStart());
-  LOG(INFO) << "Running ModelServer at " << server_address << " ...";
+  std::vector<std::unique_ptr<tensorflow::Thread>> polling_threads;
+  for (const std::unique_ptr<ServerCompletionQueue>& queue : queues) {
+    ServerCompletionQueue* const queue_ptr = queue.get();
+    polling_threads.emplace_back(tensorflow::Env::Default()->StartThread(
+        tensorflow::ThreadOptions(), "async_polling_thread",
+        [&service, queue_ptr]() { service.ServeCalls(queue_ptr); }));
+  }
+  LOG(INFO) << "Running ModelServer at " << server_address << " with "
+            << num_async_polling_threads << " completion queue threads ...";
   server->Wait();
+  server->Shutdown();
+  // Calls still waiting for their session run send their responses through
+  // the queues, so the queues stay up until those are sent.
+  service.WaitUntilNoCallsInFlight();
+  for (const std::unique_ptr<ServerCompletionQueue>& queue : queues) {
+    queue->Shutdown();
+  }
+  // Joins the polling threads, which return once their queues are drained.
+  polling_threads.clear();
 }
 
 // Parses an ascii PlatformConfigMap protobuf from 'file'.
@@ -322,6 +458,15 @@ int main(int argc, char** argv) {
   tensorflow::int32 metric_summary_wait_seconds = 30;
   bool enable_metric_summary = false;
   string target_publishing_metric = "logger";
+  tensorflow::int64 metric_queue_capacity = 4096;
+  bool drop_metrics_on_overflow = false;
+  bool enable_request_phase_metrics = false;
+  tensorflow::int32 num_async_polling_threads = 0;
+  tensorflow::int64 result_cache_capacity_bytes = 0;
+  bool enable_request_coalescing = false;
+  bool cache_serving_map_per_thread = false;
+  tensorflow::int64 max_tracked_versions_per_model = 0;
+  tensorflow::int64 unloaded_version_retention_seconds = 0;
   std::vector<tensorflow::Flag> flag_list = {
       tensorflow::Flag("port", &port, "port to listen on"),
       tensorflow::Flag("enable_batching", &enable_batching, "enable batching"),
@@ -375,11 +520,64 @@ int main(int argc, char** argv) {
                        "Comma-separated set of tags corresponding to the meta "
                        "graph def to load from SavedModel."),
       tensorflow::Flag("metric_implementation", &target_publishing_metric,
-                       "Defines the implementation of the metrics to be used (logger, syslog ...)."),
+                       "Defines the implementation of the metrics to be used: "
+                       "logger, syslog, or line_protocol:<socket path> / "
+                       "binary:<socket path> to send them to a local agent "
+                       "over a Unix datagram socket."),
       tensorflow::Flag("enable_metric_summary", &enable_metric_summary,
                        "Enable summary for metrics, launch an async task."),
       tensorflow::Flag("metric_summary_wait_seconds", &metric_summary_wait_seconds,
-                       "Interval in seconds between each summary of metrics.(Ignored if --enable_metric_summary=false)")};
+                       "Interval in seconds between each summary of metrics.(Ignored if --enable_metric_summary=false)"),
+      tensorflow::Flag("metric_queue_capacity", &metric_queue_capacity,
+                       "Capacity of the queue through which metrics are "
+                       "published off the request threads. Must be a power "
+                       "of two, or 0 to publish metrics synchronously."),
+      tensorflow::Flag("drop_metrics_on_overflow", &drop_metrics_on_overflow,
+                       "If true, metrics are dropped (and the drops logged) "
+                       "when the metric queue is full. If false (the "
+                       "default), requests wait for room in the queue."),
+      tensorflow::Flag("enable_request_phase_metrics",
+                       &enable_request_phase_metrics,
+                       "If true, publish for each request the time spent "
+                       "acquiring the servable handle, decoding the request, "
+                       "waiting in the batching queue, running the session "
+                       "and encoding the response."),
+      tensorflow::Flag("num_async_polling_threads", &num_async_polling_threads,
+                       "If positive, serve Predict, Classify and Regress "
+                       "asynchronously from this many completion queue "
+                       "threads, which don't block while requests wait for "
+                       "their batch, and as many threads which post-process "
+                       "responses once their session run completes. If 0 "
+                       "(the default), every request holds a gRPC thread "
+                       "until it completes."),
+      tensorflow::Flag("result_cache_capacity_bytes",
+                       &result_cache_capacity_bytes,
+                       "Total size in bytes of the Predict and Classify "
+                       "results cached for the models whose config enables "
+                       "result_cache_config. If 0 (the default), no results "
+                       "are cached."),
+      tensorflow::Flag("enable_request_coalescing",
+                       &enable_request_coalescing,
+                       "If true, concurrent Predict, Classify and Regress "
+                       "requests with identical contents for the same model "
+                       "version share a single computation."),
+      tensorflow::Flag("cache_serving_map_per_thread",
+                       &cache_serving_map_per_thread,
+                       "If true, each thread serving requests caches a "
+                       "snapshot of the models which are ready to be served, "
+                       "so that getting a model doesn't contend with the "
+                       "other threads. Worth it with many cores at high "
+                       "request rates."),
+      tensorflow::Flag("max_tracked_versions_per_model",
+                       &max_tracked_versions_per_model,
+                       "Upper bound for the number of versions of each model "
+                       "whose state the server remembers. Beyond it, "
+                       "unloaded versions are forgotten, lowest first. If 0 "
+                       "(the default), there is no bound."),
+      tensorflow::Flag("unloaded_version_retention_seconds",
+                       &unloaded_version_retention_seconds,
+                       "If non-zero, the server forgets the state of model "
+                       "versions this many seconds after they are unloaded.")};
   string usage = tensorflow::Flags::Usage(argv[0], flag_list);
   const bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
   if (!parse_result || (model_base_path.empty() && model_config_file.empty())) {
@@ -447,13 +645,24 @@ int main(int argc, char** argv) {
       std::unique_ptr<AspiredVersionPolicy>(new AvailabilityPreservingPolicy);
   options.file_system_poll_wait_seconds = file_system_poll_wait_seconds;
   options.flush_filesystem_caches = flush_filesystem_caches;
+  options.cache_serving_map_per_thread = cache_serving_map_per_thread;
   options.enable_metric_summary = enable_metric_summary;
   options.metric_summary_wait_seconds = metric_summary_wait_seconds;
   options.target_publishing_metric = target_publishing_metric;
+  options.metric_queue_capacity = metric_queue_capacity;
+  options.drop_metrics_on_overflow = drop_metrics_on_overflow;
+  options.enable_request_phase_metrics = enable_request_phase_metrics;
+  options.result_cache_capacity_bytes = result_cache_capacity_bytes;
+  options.enable_request_coalescing = enable_request_coalescing;
+  options.servable_state_monitor_options.max_count_versions_per_servable =
+      std::max<tensorflow::int64>(max_tracked_versions_per_model, 0);
+  options.servable_state_monitor_options.max_end_state_retention_micros =
+      std::max<tensorflow::int64>(unloaded_version_retention_seconds, 0) *
+      1000000;
 
   std::unique_ptr<ServerCore> core;
   TF_CHECK_OK(ServerCore::Create(std::move(options), &core));
-  RunServer(port, std::move(core), use_saved_model);
+  RunServer(port, std::move(core), use_saved_model, num_async_polling_threads);
 
   return 0;
 }
@@ -223,10 +223,12 @@ Status UpdateModelConfigListRelativePaths(
 Status ServerCore::Create(Options options,
                           std::unique_ptr<ServerCore>* server_core) {
   if (options.servable_state_monitor_creator == nullptr) {
-    options.servable_state_monitor_creator = [](
+    const ServableStateMonitor::Options monitor_options =
+        options.servable_state_monitor_options;
+    options.servable_state_monitor_creator = [monitor_options](
         EventBus<ServableState>* event_bus,
         std::unique_ptr<ServableStateMonitor>* monitor) {
-      monitor->reset(new ServableStateMonitor(event_bus));
+      monitor->reset(new ServableStateMonitor(event_bus, monitor_options));
       return Status::OK();
     };
   }
@@ -241,6 +243,8 @@ Status ServerCore::Create(Options options,
         MetricsManager::Create(options.target_publishing_metric,
                               options.enable_metric_summary,
                               options.metric_summary_wait_seconds,
+                              options.metric_queue_capacity,
+                              options.drop_metrics_on_overflow,
                               &options.metrics_manager));
   }
 
@@ -256,47 +260,44 @@ Status ServerCore::Create(Options options,
 }
 
 void ServerCore::GetModelNameAndVersion(const ModelSpec& model_spec,
-                                        string& model_name,
-                                        int64& model_version) {
-  model_name = model_spec.name();
-  if (model_spec.has_version()) {
-    model_version = model_spec.version().value();
+                                        const RequestContext& context,
+                                        string* const model_name,
+                                        int64* const model_version) {
+  *model_name = model_spec.name();
+  if (context.model_version()) {
+    *model_version = *context.model_version();
+  } else if (model_spec.has_version()) {
+    *model_version = model_spec.version().value();
   } else {
-    ServableHandle<SessionBundle> bundle;
-    ServerCore::GetServableHandle(model_spec, &bundle);
-    model_version = bundle.id().version;
+    *model_version = -1;
   }
 }
 
-Status ServerCore::CreateMetricEvent(const string& event_name,
-                               const int64& event_version,
-                               const ServableState::ManagerState& event_state,
-                               const uint64& elapsed_predict_time,
-                               const Status& result_status,
-                               const ModelSpec& model_spec) {
-
+void ServerCore::RecordPredictMetric(const ModelSpec& model_spec,
+                                     const RequestContext& context,
+                                     const uint64 elapsed_predict_time_micros,
+                                     const Status& result_status) {
+  string model_name;
+  int64 model_version;
+  GetModelNameAndVersion(model_spec, context, &model_name, &model_version);
+  metrics_manager_->RecordPredict(model_name, model_version,
+                                  elapsed_predict_time_micros, result_status);
+}
 
-  //Create an event on servable_event_bus.
-  ServableState event_servable_state = {
-      ServableId { event_name, event_version }, event_state, Status::OK() };
+void ServerCore::RecordRequestPhases(const string& method_name,
+                                     const ModelSpec& model_spec,
+                                     const RequestContext& context,
+                                     const uint64 elapsed_time_micros,
+                                     const Status& result_status) {
+  if (!options_.enable_request_phase_metrics) {
+    return;
+  }
   string model_name;
   int64 model_version;
-  ServerCore::GetModelNameAndVersion(model_spec, model_name, model_version);
-
-  // Monitoring the event
-  ServableStateMonitor::ServableStateNotifierFn notifier_fn = metrics_manager_.get()
-      ->CreateNotifier(elapsed_predict_time, result_status, model_name,
-                      model_version);
-  std::vector<ServableRequest> servables;
-  const ServableId specific_goal_state_id = { event_name, event_version };
-  servables.push_back(ServableRequest::FromId(specific_goal_state_id));
-  servable_state_monitor_.get()->NotifyWhenServablesReachState(servables,
-                                                               event_state,
-                                                               notifier_fn);
-
-  // Publish the event
-  servable_event_bus_.get()->Publish(event_servable_state);
-  return Status::OK();
+  GetModelNameAndVersion(model_spec, context, &model_name, &model_version);
+  metrics_manager_->RecordRequestPhases(method_name, model_name, model_version,
+                                        elapsed_time_micros, context.timing(),
+                                        result_status);
 }
 
 // ************************************************************************
@@ -305,7 +306,8 @@ Status ServerCore::CreateMetricEvent(const string& event_name,
 
 ServerCore::ServerCore(Options options)
     : options_(std::move(options)),
-      servable_event_bus_(EventBus<ServableState>::CreateEventBus()) {
+      servable_event_bus_(EventBus<ServableState>::CreateEventBus()),
+      metrics_manager_(std::move(options_.metrics_manager)) {
   // Number the platforms. (The proto map iteration order is nondeterministic,
   // but we don't care since the numbering is arbitrary.)
   int port_num = 0;
@@ -313,6 +315,25 @@ ServerCore::ServerCore(Options options)
     const string& platform = entry.first;
     platform_to_router_port_[platform] = port_num++;
   }
+
+  if (options_.enable_request_coalescing) {
+    request_coalescer_.reset(new RequestCoalescer);
+  }
+  if (options_.result_cache_capacity_bytes > 0) {
+    InferenceResultCache::Options cache_options;
+    cache_options.capacity_bytes = options_.result_cache_capacity_bytes;
+    inference_result_cache_.reset(new InferenceResultCache(cache_options));
+    // A version may be loaded again later, possibly from different files, so
+    // its results can't outlive it.
+    inference_result_cache_subscription_ = servable_event_bus_->Subscribe(
+        [this](const EventBus<ServableState>::EventAndTime& event_and_time) {
+          const ServableState& state = event_and_time.event;
+          if (state.manager_state == ServableState::ManagerState::kUnloading ||
+              state.manager_state == ServableState::ManagerState::kEnd) {
+            inference_result_cache_->InvalidateVersion(state.id);
+          }
+        });
+  }
 }
 
 Status ServerCore::Initialize(std::unique_ptr<AspiredVersionPolicy> policy) {
@@ -461,6 +482,22 @@ Status ServerCore::MaybeUpdateServerRequestLogger(
   return Status::OK();
 }
 
+void ServerCore::MaybeUpdateInferenceResultCache(
+    const ModelServerConfig::ConfigCase config_case) {
+  if (inference_result_cache_ == nullptr ||
+      config_case != ModelServerConfig::kModelConfigList) {
+    return;
+  }
+  std::map<string, ResultCacheConfig> result_cache_config_map;
+  for (const auto& model_config : config_.model_config_list().config()) {
+    if (model_config.has_result_cache_config()) {
+      result_cache_config_map.insert(
+          {model_config.name(), model_config.result_cache_config()});
+    }
+  }
+  inference_result_cache_->UpdateModelConfigs(result_cache_config_map);
+}
+
 Status ServerCore::ReloadConfig(const ModelServerConfig& new_config) {
   mutex_lock l(config_mu_);
 
@@ -515,6 +552,7 @@ Status ServerCore::ReloadConfig(const ModelServerConfig& new_config) {
       return errors::InvalidArgument("Invalid ServerModelConfig");
   }
   TF_RETURN_IF_ERROR(MaybeUpdateServerRequestLogger(config_.config_case()));
+  MaybeUpdateInferenceResultCache(config_.config_case());
 
   if (options_.flush_filesystem_caches) {
     return Env::Default()->FlushFileSystemCaches();
@@ -694,6 +732,8 @@ Status ServerCore::CreateAspiredVersionsManager(
   manager_options.max_num_load_retries = options_.max_num_load_retries;
   manager_options.pre_load_hook = std::move(options_.pre_load_hook);
   manager_options.flush_filesystem_caches = options_.flush_filesystem_caches;
+  manager_options.cache_serving_map_per_thread =
+      options_.cache_serving_map_per_thread;
   const tensorflow::Status status =
       AspiredVersionsManager::Create(std::move(manager_options), manager);
   if (!status.ok()) {
@@ -33,12 +33,15 @@ limitations under the License.
 #include "tensorflow_serving/config/platform_config.pb.h"
 #include "tensorflow_serving/core/aspired_versions_manager.h"
 #include "tensorflow_serving/core/dynamic_source_router.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
 #include "tensorflow_serving/core/servable_state_monitor.h"
 #include "tensorflow_serving/core/server_request_logger.h"
 #include "tensorflow_serving/core/source.h"
 #include "tensorflow_serving/core/source_adapter.h"
 #include "tensorflow_serving/core/storage_path.h"
 #include "tensorflow_serving/core/metrics_manager.h"
+#include "tensorflow_serving/core/request_coalescer.h"
+#include "tensorflow_serving/core/request_context.h"
 #include "tensorflow_serving/sources/storage_path/file_system_storage_path_source.h"
 #include "tensorflow_serving/util/event_bus.h"
 #include "tensorflow_serving/util/optional.h"
@@ -129,6 +132,12 @@ class ServerCore : public Manager {
     // the initial load, and after every subsequent load of every model version.
     bool flush_filesystem_caches = false;
 
+    // If true, each thread serving requests caches a snapshot of the models
+    // which are ready to be served, so that getting a servable handle doesn't
+    // contend with the other threads (see
+    // BasicManager::Options::cache_serving_map_per_thread).
+    bool cache_serving_map_per_thread = false;
+
     // Configuration for the supported platforms.
     PlatformConfigMap platform_config_map;
 
@@ -136,6 +145,11 @@ class ServerCore : public Manager {
     // creator that creates ServableStateMonitor will be used.
     ServableStateMonitorCreator servable_state_monitor_creator;
 
+    // Options of the ServableStateMonitor created by the default creator
+    // above, e.g. for how long it remembers unloaded versions. Ignored if
+    // 'servable_state_monitor_creator' is set.
+    ServableStateMonitor::Options servable_state_monitor_options;
+
     // A function for instantiating and connecting custom sources and source
     // adapters to the manager.
     CustomModelConfigLoader custom_model_config_loader;
@@ -156,11 +170,34 @@ class ServerCore : public Manager {
     // Time interval between between each summary of metrics in seconds
     int32 metric_summary_wait_seconds = 30;
 
-    // Define the target for publishing metrics.
-    string target_publishing_metric;
+    // Define the target for publishing metrics, as a type registered with
+    // REGISTER_METRIC_COLLECTOR optionally followed by ":<argument>" (logger,
+    // syslog, line_protocol:<socket path>, binary:<socket path>).
+    string target_publishing_metric = "logger";
+
+    // Capacity of the queue through which metrics are published
+    // asynchronously, off the request threads. Must be a power of two, or 0 to
+    // publish metrics synchronously.
+    int64 metric_queue_capacity = 4096;
+
+    // Whether metrics are dropped when the queue above is full, rather than
+    // making the request threads wait. Dropped metrics are counted and logged.
+    bool drop_metrics_on_overflow = false;
+
+    // Publish the time spent in each phase of every inference request (see
+    // RecordRequestPhases()).
+    bool enable_request_phase_metrics = false;
 
     // Manager used for managing metrics.
     std::unique_ptr<MetricsManager> metrics_manager;
+
+    // Total size, in bytes, of the results cached for the models with
+    // ModelConfig::result_cache_config enabled. 0 disables result caching.
+    int64 result_cache_capacity_bytes = 0;
+
+    // Whether concurrent identical Predict, Classify and Regress requests to
+    // the same model version share a single computation.
+    bool enable_request_coalescing = false;
   };
 
   virtual ~ServerCore() = default;
@@ -227,16 +264,34 @@ class ServerCore : public Manager {
     return options_.server_request_logger->Log(request, response, log_metadata);
   }
 
-  void GetModelNameAndVersion(const ModelSpec& model_spec, string& model_name,
-                              int64& model_version) ;
-
-  // Create a metric event and publish it on the bus.
-  Status CreateMetricEvent(const string& event_name,
-                     const int64& event_number,
-                     const ServableState::ManagerState& event_state,
-                     const uint64& elapsed_predict_time, const Status& result_status,
-                     const ModelSpec& model_spec);
+  /// Records the outcome of a predict call on the model of 'model_spec' with
+  /// the metrics manager. This does not go through the servable state
+  /// machinery, so it never contends with servable load/unload events.
+  void RecordPredictMetric(const ModelSpec& model_spec,
+                           const RequestContext& context,
+                           uint64 elapsed_predict_time_micros,
+                           const Status& result_status);
+
+  /// Records the time spent in each phase of a 'method_name' request (e.g.
+  /// "Classify") on the model of 'model_spec' with the metrics manager, if
+  /// enabled with Options::enable_request_phase_metrics.
+  void RecordRequestPhases(const string& method_name,
+                           const ModelSpec& model_spec,
+                           const RequestContext& context,
+                           uint64 elapsed_time_micros,
+                           const Status& result_status);
+
+  /// Returns the cache of inference results, or nullptr if result caching is
+  /// disabled (see Options::result_cache_capacity_bytes).
+  InferenceResultCache* inference_result_cache() const {
+    return inference_result_cache_.get();
+  }
 
+  /// Returns the coalescer of identical requests in flight, or nullptr if
+  /// disabled (see Options::enable_request_coalescing).
+  RequestCoalescer* request_coalescer() const {
+    return request_coalescer_.get();
+  }
 
  protected:
   ServerCore(Options options);
@@ -244,6 +299,14 @@ class ServerCore : public Manager {
  private:
   friend class test_util::ServerCoreTestAccess;
 
+  // Returns the name and version of the model a request was served by. The
+  // version is the one the request's handle resolved to, as recorded in
+  // 'context', so that no other handle needs to be acquired; it is -1 if the
+  // request failed before resolving it and 'model_spec' has no version.
+  static void GetModelNameAndVersion(const ModelSpec& model_spec,
+                                     const RequestContext& context,
+                                     string* model_name, int64* model_version);
+
   // ************************************************************************
   // Server Setup and Initialization.
   // ************************************************************************
@@ -340,6 +403,12 @@ class ServerCore : public Manager {
       ModelServerConfig::ConfigCase config_case)
       EXCLUSIVE_LOCKS_REQUIRED(config_mu_);
 
+  // Updates which models have their results cached based on the
+  // ModelConfigList.
+  void MaybeUpdateInferenceResultCache(
+      ModelServerConfig::ConfigCase config_case)
+      EXCLUSIVE_LOCKS_REQUIRED(config_mu_);
+
   // ************************************************************************
   // Request Processing.
   // ************************************************************************
@@ -372,6 +441,16 @@ class ServerCore : public Manager {
   std::shared_ptr<MetricsManager> metrics_manager_;
   UniquePtrWithDeps<AspiredVersionsManager> manager_;
 
+  // Null if request coalescing is disabled.
+  std::unique_ptr<RequestCoalescer> request_coalescer_;
+
+  // Null if result caching is disabled. The subscription drops the results of
+  // the versions which stop serving; declared last so that it is unsubscribed
+  // before the cache is destroyed.
+  std::unique_ptr<InferenceResultCache> inference_result_cache_;
+  std::unique_ptr<EventBus<ServableState>::Subscription>
+      inference_result_cache_subscription_;
+
   // The most recent config supplied to ReloadConfig().
   ModelServerConfig config_ GUARDED_BY(config_mu_);
 
@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow_serving/apis/model.pb.h"
 #include "tensorflow_serving/apis/predict.pb.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
 #include "tensorflow_serving/core/servable_handle.h"
 #include "tensorflow_serving/core/servable_state.h"
 #include "tensorflow_serving/core/test_util/availability_test_util.h"
@@ -570,6 +571,78 @@ TEST_P(ServerCoreTest, IllegalToChangeModelPlatform) {
               ::testing::HasSubstr("Illegal to change a model's platform"));
 }
 
+TEST_P(ServerCoreTest, ResultCacheOffByDefault) {
+  std::unique_ptr<ServerCore> server_core;
+  TF_ASSERT_OK(CreateServerCore(GetTestModelServerConfigForFakePlatform(),
+                                &server_core));
+  EXPECT_EQ(nullptr, server_core->inference_result_cache());
+}
+
+TEST_P(ServerCoreTest, ResultCacheDropsResultsOfUnloadedVersions) {
+  ServerCore::Options options = GetDefaultOptions();
+  options.result_cache_capacity_bytes = 1 << 20;
+  ModelServerConfig config = GetTestModelServerConfigForFakePlatform();
+  config.mutable_model_config_list()
+      ->mutable_config(0)
+      ->mutable_result_cache_config()
+      ->set_enabled(true);
+  std::unique_ptr<ServerCore> server_core;
+  TF_ASSERT_OK(CreateServerCore(config, std::move(options), &server_core));
+  InferenceResultCache* const cache = server_core->inference_result_cache();
+  ASSERT_NE(nullptr, cache);
+
+  const ServableId servable_id = {test_util::kTestModelName,
+                                  test_util::kTestModelVersion};
+  PredictResponse response;
+  optional<InferenceResultCache::Key> cache_key;
+  EXPECT_FALSE(cache->Lookup("Predict", servable_id, PredictRequest(),
+                             &response, &cache_key));
+  ASSERT_TRUE(cache_key);
+  cache->Insert(*cache_key, response);
+  EXPECT_EQ(1, cache->num_entries());
+
+  ModelServerConfig empty_config;
+  empty_config.mutable_model_config_list();
+  TF_ASSERT_OK(server_core->ReloadConfig(empty_config));
+  test_util::WaitUntilServableManagerStateIsOneOf(
+      *server_core->servable_state_monitor(), servable_id,
+      {ServableState::ManagerState::kEnd});
+  EXPECT_EQ(0, cache->num_entries());
+}
+
+TEST_P(ServerCoreTest, ServableStateMonitorForgetsUnloadedVersions) {
+  ServerCore::Options options = GetDefaultOptions();
+  options.servable_state_monitor_options.max_end_state_retention_micros = 1;
+  ModelServerConfig config = GetTestModelServerConfigForFakePlatform();
+  ModelConfig* other_model_config =
+      config.mutable_model_config_list()->add_config();
+  *other_model_config = config.model_config_list().config(0);
+  other_model_config->set_name("other_model");
+  std::unique_ptr<ServerCore> server_core;
+  TF_ASSERT_OK(CreateServerCore(config, std::move(options), &server_core));
+  const ServableStateMonitor& monitor = *server_core->servable_state_monitor();
+
+  const ServableId servable_id = {test_util::kTestModelName,
+                                  test_util::kTestModelVersion};
+  ModelServerConfig other_model_only_config;
+  *other_model_only_config.mutable_model_config_list()->add_config() =
+      *other_model_config;
+  TF_ASSERT_OK(server_core->ReloadConfig(other_model_only_config));
+  test_util::WaitUntilServableManagerStateIsOneOf(
+      monitor, servable_id, {ServableState::ManagerState::kEnd});
+
+  // The unloaded version is forgotten upon the next event, i.e. the unload of
+  // the other model.
+  const ServableId other_servable_id = {"other_model",
+                                        test_util::kTestModelVersion};
+  ModelServerConfig empty_config;
+  empty_config.mutable_model_config_list();
+  TF_ASSERT_OK(server_core->ReloadConfig(empty_config));
+  test_util::WaitUntilServableManagerStateIsOneOf(
+      monitor, other_servable_id, {ServableState::ManagerState::kEnd});
+  EXPECT_FALSE(monitor.GetState(servable_id));
+}
+
 TEST_P(ServerCoreTest, RequestLoggingOff) {
   // Create a ServerCore with deprecated config.
   std::unique_ptr<ServerCore> server_core;
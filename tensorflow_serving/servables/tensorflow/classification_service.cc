@@ -20,13 +20,86 @@ limitations under the License.
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
 #include "tensorflow/contrib/session_bundle/signature.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow_serving/apis/classifier.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
+#include "tensorflow_serving/core/request_context.h"
 #include "tensorflow_serving/core/servable_handle.h"
 #include "tensorflow_serving/servables/tensorflow/classifier.h"
+#include "tensorflow_serving/servables/tensorflow/coalesced_inference.h"
+#include "tensorflow_serving/servables/tensorflow/one_shot_inference.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 
 namespace tensorflow {
 namespace serving {
+namespace {
+
+// Looks up the response to 'request' served by 'servable_id' in the result
+// cache of 'core', if it has one. Returns true on a hit. On a miss, sets
+// 'cache_key' if the response should be cached once computed.
+bool LookupCachedClassification(
+    ServerCore* core, const ServableId& servable_id,
+    const ClassificationRequest& request, ClassificationResponse* response,
+    optional<InferenceResultCache::Key>* cache_key) {
+  InferenceResultCache* const cache = core->inference_result_cache();
+  return cache != nullptr &&
+         cache->Lookup("Classify", servable_id, request, response, cache_key);
+}
+
+// Serves a Classify request whose ModelSpec has been validated.
+Status ClassifyWithServerCore(const RunOptions& run_options, ServerCore* core,
+                              const ClassificationRequest& request,
+                              ClassificationResponse* response,
+                              RequestContext* context) {
+  ServableHandle<SavedModelBundle> saved_model_bundle;
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(
+        core->GetServableHandle(request.model_spec(), &saved_model_bundle));
+  }
+  context->set_model_version(saved_model_bundle.id().version);
+  optional<InferenceResultCache::Key> cache_key;
+  if (LookupCachedClassification(core, saved_model_bundle.id(), request,
+                                 response, &cache_key)) {
+    return Status::OK();
+  }
+  SignatureDef signature;
+  TF_RETURN_IF_ERROR(GetClassificationSignatureDef(
+      request.model_spec(), saved_model_bundle->meta_graph_def, &signature));
+
+  std::unique_ptr<ClassifierInterface> classifier_interface;
+  TF_RETURN_IF_ERROR(CreateFlyweightTensorFlowClassifier(
+      run_options, saved_model_bundle->session.get(), &signature,
+      &classifier_interface));
+  // Run classification, unless an identical request is already running.
+  return RunCoalescedInference(
+      core, "Classify", saved_model_bundle.id(), request, cache_key, response,
+      [&]() {
+        return classifier_interface->Classify(request,
+                                              response->mutable_result());
+      });
+}
+
+// Fills 'response' from the outputs of the session run of
+// RunOneShotInferenceAsync().
+Status PostProcessClassificationResponse(
+    const SignatureDef& signature, int num_examples,
+    const std::vector<string>& output_tensor_names,
+    const std::vector<Tensor>& output_tensors,
+    const ClassificationRequest& request, ClassificationResponse* response) {
+  TRACELITERAL("ConvertToClassificationResult");
+  return PostProcessClassificationResult(
+      signature, num_examples, output_tensor_names, output_tensors,
+      request.top_k(), response->mutable_result());
+}
+
+const OneShotInferenceMethod<ClassificationRequest, ClassificationResponse>
+    kClassifyMethod = {"Classify", true /* use_result_cache */,
+                       GetClassificationSignatureDef, PreProcessClassification,
+                       PostProcessClassificationResponse};
+
+}  // namespace
 
 Status TensorflowClassificationServiceImpl::Classify(
     const RunOptions& run_options, ServerCore* core,
@@ -38,19 +111,30 @@ Status TensorflowClassificationServiceImpl::Classify(
                               "Missing ModelSpec");
   }
 
-  ServableHandle<SavedModelBundle> saved_model_bundle;
-  TF_RETURN_IF_ERROR(
-      core->GetServableHandle(request.model_spec(), &saved_model_bundle));
-  SignatureDef signature;
-  TF_RETURN_IF_ERROR(GetClassificationSignatureDef(
-      request.model_spec(), saved_model_bundle->meta_graph_def, &signature));
+  RequestContext context;
+  RequestTiming::ScopedCurrent scoped_timing(context.mutable_timing());
+  const uint64 start_time = Env::Default()->NowMicros();
+  const Status status =
+      ClassifyWithServerCore(run_options, core, request, response, &context);
+  const uint64 end_time = Env::Default()->NowMicros();
+  core->RecordRequestPhases("Classify", request.model_spec(), context,
+                            end_time > start_time ? end_time - start_time : 0,
+                            status);
+  return status;
+}
 
-  std::unique_ptr<ClassifierInterface> classifier_interface;
-  TF_RETURN_IF_ERROR(CreateFlyweightTensorFlowClassifier(
-      run_options, saved_model_bundle->session.get(), &signature,
-      &classifier_interface));
-  // Run classification.
-  return classifier_interface->Classify(request, response->mutable_result());
+void TensorflowClassificationServiceImpl::ClassifyAsync(
+    const RunOptions& run_options, ServerCore* core, Executor* executor,
+    const ClassificationRequest& request, ClassificationResponse* response,
+    std::function<void(const Status&)> done) {
+  TRACELITERAL("TensorflowClassificationServiceImpl::ClassifyAsync");
+  const Status status = ValidateClassificationRequest(request);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  RunOneShotInferenceAsync(kClassifyMethod, run_options, core, executor,
+                           request, response, std::move(done));
 }
 
 }  // namespace serving
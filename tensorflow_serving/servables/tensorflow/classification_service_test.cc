@@ -0,0 +1,199 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/classification_service.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow_serving/apis/classification.pb.h"
+#include "tensorflow_serving/config/model_server_config.pb.h"
+#include "tensorflow_serving/core/availability_preserving_policy.h"
+#include "tensorflow_serving/model_servers/model_platform_types.h"
+#include "tensorflow_serving/model_servers/platform_config_util.h"
+#include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
+#include "tensorflow_serving/test_util/test_util.h"
+#include "tensorflow_serving/util/test_util/counting_executor.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using test_util::CountingExecutor;
+using test_util::EqualsProto;
+
+constexpr char kTestModelName[] = "test_model";
+
+// Parameterized on whether the model is served with batching.
+class ClassificationServiceTest : public ::testing::TestWithParam<bool> {
+ public:
+  static void SetUpTestCase() {
+    TF_ASSERT_OK(CreateServerCore(false, &server_core_));
+    TF_ASSERT_OK(CreateServerCore(true, &batching_server_core_));
+  }
+
+  static void TearDownTestCase() {
+    server_core_.reset();
+    batching_server_core_.reset();
+  }
+
+ protected:
+  static Status CreateServerCore(bool enable_batching,
+                                 std::unique_ptr<ServerCore>* server_core) {
+    ModelServerConfig config;
+    auto model_config = config.mutable_model_config_list()->add_config();
+    model_config->set_name(kTestModelName);
+    model_config->set_base_path(test_util::TensorflowTestSrcDirPath(
+        "cc/saved_model/testdata/half_plus_two"));
+    model_config->set_model_platform(kTensorFlowModelPlatform);
+
+    SessionBundleConfig session_bundle_config;
+    if (enable_batching) {
+      BatchingParameters* batching_parameters =
+          session_bundle_config.mutable_batching_parameters();
+      batching_parameters->mutable_max_batch_size()->set_value(4);
+      batching_parameters->mutable_batch_timeout_micros()->set_value(1000);
+    }
+    ServerCore::Options options;
+    options.model_server_config = config;
+    options.platform_config_map = CreateTensorFlowPlatformConfigMap(
+        session_bundle_config, true /* use_saved_model */);
+    // Reduce the number of initial load threads to be num_load_threads to avoid
+    // timing out in tests.
+    options.num_initial_load_threads = options.num_load_threads;
+    options.aspired_version_policy =
+        std::unique_ptr<AspiredVersionPolicy>(new AvailabilityPreservingPolicy);
+    return ServerCore::Create(std::move(options), server_core);
+  }
+
+  ServerCore* GetServerCore() {
+    return GetParam() ? batching_server_core_.get() : server_core_.get();
+  }
+
+  // Runs ClassifyAsync() and waits for it to complete.
+  Status ClassifyAsync(const ClassificationRequest& request,
+                       ClassificationResponse* response) {
+    Notification done;
+    Status status;
+    TensorflowClassificationServiceImpl::ClassifyAsync(
+        RunOptions(), GetServerCore(), &executor_, request, response,
+        [&done, &status](const Status& classify_status) {
+          status = classify_status;
+          done.Notify();
+        });
+    done.WaitForNotification();
+    return status;
+  }
+
+  CountingExecutor executor_;
+
+ private:
+  static std::unique_ptr<ServerCore> server_core_;
+  static std::unique_ptr<ServerCore> batching_server_core_;
+};
+
+std::unique_ptr<ServerCore> ClassificationServiceTest::server_core_;
+std::unique_ptr<ServerCore> ClassificationServiceTest::batching_server_core_;
+
+ClassificationRequest CreateRequest(float x) {
+  ClassificationRequest request;
+  request.mutable_model_spec()->set_name(kTestModelName);
+  request.mutable_model_spec()->set_signature_name("classify_x_to_y");
+  Feature feature;
+  feature.mutable_float_list()->add_value(x);
+  (*request.mutable_input()
+        ->mutable_example_list()
+        ->add_examples()
+        ->mutable_features()
+        ->mutable_feature())["x"] = feature;
+  return request;
+}
+
+TEST_P(ClassificationServiceTest, ClassifyAsyncMatchesClassify) {
+  // classify_x_to_y scores y = 0.5x + 2.
+  const ClassificationRequest request = CreateRequest(2.0);
+  ClassificationResponse expected_response;
+  expected_response.mutable_result()
+      ->add_classifications()
+      ->add_classes()
+      ->set_score(3.0);
+
+  ClassificationResponse response;
+  TF_ASSERT_OK(TensorflowClassificationServiceImpl::Classify(
+      RunOptions(), GetServerCore(), request, &response));
+  EXPECT_THAT(response, EqualsProto(expected_response));
+
+  ClassificationResponse async_response;
+  TF_ASSERT_OK(ClassifyAsync(request, &async_response));
+  EXPECT_THAT(async_response, EqualsProto(expected_response));
+  // The response was converted on the executor, not by the session.
+  EXPECT_EQ(1, executor_.num_scheduled());
+}
+
+TEST_P(ClassificationServiceTest, ClassifyAsyncConcurrentRequests) {
+  const int kNumRequests = 8;
+  std::vector<ClassificationRequest> requests;
+  std::vector<ClassificationResponse> responses(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    requests.push_back(CreateRequest(2.0 * i));
+  }
+  std::vector<Notification> done(kNumRequests);
+  std::vector<Status> statuses(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    TensorflowClassificationServiceImpl::ClassifyAsync(
+        RunOptions(), GetServerCore(), &executor_, requests[i], &responses[i],
+        [&done, &statuses, i](const Status& status) {
+          statuses[i] = status;
+          done[i].Notify();
+        });
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    done[i].WaitForNotification();
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    TF_ASSERT_OK(statuses[i]);
+    ASSERT_EQ(1, responses[i].result().classifications_size());
+    EXPECT_EQ(i + 2.0,
+              responses[i].result().classifications(0).classes(0).score());
+  }
+}
+
+TEST_P(ClassificationServiceTest, ClassifyAsyncMissingModelSpec) {
+  ClassificationRequest request = CreateRequest(2.0);
+  request.clear_model_spec();
+  ClassificationResponse response;
+  EXPECT_EQ(error::INVALID_ARGUMENT, ClassifyAsync(request, &response).code());
+}
+
+TEST_P(ClassificationServiceTest, ClassifyAsyncMissingSignature) {
+  ClassificationRequest request = CreateRequest(2.0);
+  request.mutable_model_spec()->set_signature_name("no_such_signature");
+  ClassificationResponse response;
+  const Status status = ClassifyAsync(request, &response);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+  EXPECT_THAT(status.error_message(),
+              ::testing::HasSubstr("No signature was found"));
+}
+
+INSTANTIATE_TEST_CASE_P(Batching, ClassificationServiceTest, ::testing::Bool());
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
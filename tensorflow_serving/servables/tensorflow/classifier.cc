@@ -17,8 +17,10 @@ limitations under the License.
 
 #include <stddef.h>
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <vector>
 
@@ -35,12 +37,88 @@ limitations under the License.
 #include "tensorflow_serving/apis/classifier.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
+#include "tensorflow_serving/core/request_timing.h"
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
 namespace tensorflow {
 namespace serving {
 namespace {
 
+// Checks that 'top_k' is a valid ClassificationRequest::top_k.
+Status ValidateTopK(const int top_k) {
+  if (top_k < 0) {
+    return errors::InvalidArgument("top_k must not be negative. Got: ", top_k);
+  }
+  return Status::OK();
+}
+
+// Writes the classes and/or scores, each of shape [num_examples num_classes],
+// into 'result'. If 'top_k' is positive, keeps only the 'top_k' highest scored
+// classes of each example, from the highest score to the lowest.
+//
+// Reads the tensors' buffers directly and reserves each repeated field up
+// front, since large-vocabulary models produce many classes per example.
+Status WriteClassificationResult(const Tensor* classes, const Tensor* scores,
+                                 const int num_examples, const int num_classes,
+                                 const int top_k,
+                                 ClassificationResult* result) {
+  TF_RETURN_IF_ERROR(ValidateTopK(top_k));
+  if (top_k > 0 && scores == nullptr) {
+    return errors::InvalidArgument(
+        "top_k requires the model to output scores.");
+  }
+  const int num_kept_classes =
+      top_k > 0 ? std::min(top_k, num_classes) : num_classes;
+  const string* const class_data =
+      classes == nullptr ? nullptr : classes->flat<string>().data();
+  const float* const score_data =
+      scores == nullptr ? nullptr : scores->flat<float>().data();
+
+  result->mutable_classifications()->Reserve(
+      result->classifications_size() + num_examples);
+  // The indices of the classes of an example, in the order they are written.
+  std::vector<int> order;
+  for (int i = 0; i < num_examples; ++i) {
+    const string* const example_classes =
+        class_data == nullptr ? nullptr : class_data + i * num_classes;
+    const float* const example_scores =
+        score_data == nullptr ? nullptr : score_data + i * num_classes;
+    if (num_kept_classes < num_classes) {
+      // Select the top classes in linear time, and only sort those.
+      order.resize(num_classes);
+      std::iota(order.begin(), order.end(), 0);
+      // Orders by decreasing score, then by index. NaN scores, which compare
+      // false to anything, go last, so that this is a strict weak ordering.
+      const auto higher_score = [example_scores](const int a, const int b) {
+        const float score_a = example_scores[a];
+        const float score_b = example_scores[b];
+        if (std::isnan(score_a) || std::isnan(score_b)) {
+          return std::isnan(score_b) && (!std::isnan(score_a) || a < b);
+        }
+        return score_a > score_b || (score_a == score_b && a < b);
+      };
+      std::nth_element(order.begin(), order.begin() + num_kept_classes,
+                       order.end(), higher_score);
+      std::sort(order.begin(), order.begin() + num_kept_classes, higher_score);
+    }
+
+    auto* const example_result =
+        result->add_classifications()->mutable_classes();
+    example_result->Reserve(num_kept_classes);
+    for (int k = 0; k < num_kept_classes; ++k) {
+      const int c = num_kept_classes < num_classes ? order[k] : k;
+      serving::Class* cl = example_result->Add();
+      if (example_classes != nullptr) {
+        cl->set_label(example_classes[c]);
+      }
+      if (example_scores != nullptr) {
+        cl->set_score(example_scores[c]);
+      }
+    }
+  }
+  return Status::OK();
+}
+
 // Implementation of the ClassificationService using the legacy SessionBundle
 // ClassificationSignature signature format.
 class TensorFlowClassifier : public ClassifierInterface {
@@ -52,6 +130,7 @@ class TensorFlowClassifier : public ClassifierInterface {
   Status Classify(const ClassificationRequest& request,
                   ClassificationResult* result) override {
     TRACELITERAL("TensorFlowClassifier::Classify");
+    TF_RETURN_IF_ERROR(ValidateClassificationRequest(request));
     TRACELITERAL("ConvertInputTFEXamplesToTensor");
     // Setup the input Tensor to be a vector of string containing the serialized
     // tensorflow.Example.
@@ -76,8 +155,12 @@ class TensorFlowClassifier : public ClassifierInterface {
       scores.reset(new Tensor);
     }
 
-    TF_RETURN_IF_ERROR(RunClassification(*signature_, input_tensor, session_,
-                                         classes.get(), scores.get()));
+    {
+      RequestTiming::ScopedPhase session_run_phase(RequestPhase::kSessionRun);
+      TF_RETURN_IF_ERROR(RunClassification(*signature_, input_tensor,
+                                           session_, classes.get(),
+                                           scores.get()));
+    }
 
     // Validate classes output Tensor.
     if (classes) {
@@ -129,21 +212,10 @@ class TensorFlowClassifier : public ClassifierInterface {
     }
 
     TRACELITERAL("ConvertToClassificationResult");
+    RequestTiming::ScopedPhase encoding_phase(RequestPhase::kResponseEncoding);
     // Convert the output to ClassificationResult format.
-    for (int i = 0; i < num_examples; ++i) {
-      serving::Classifications* classifications = result->add_classifications();
-      for (int c = 0; c < num_classes; ++c) {
-        serving::Class* cl = classifications->add_classes();
-        if (classes) {
-          cl->set_label((classes->matrix<string>())(i, c));
-        }
-        if (scores) {
-          cl->set_score((scores->matrix<float>())(i, c));
-        }
-      }
-    }
-
-    return Status::OK();
+    return WriteClassificationResult(classes.get(), scores.get(), num_examples,
+                                     num_classes, request.top_k(), result);
   }
 
  private:
@@ -166,6 +238,7 @@ class SavedModelTensorFlowClassifier : public ClassifierInterface {
   Status Classify(const ClassificationRequest& request,
                   ClassificationResult* result) override {
     TRACELITERAL("TensorFlowClassifier::Classify");
+    TF_RETURN_IF_ERROR(ValidateClassificationRequest(request));
 
     string input_tensor_name;
     std::vector<string> output_tensor_names;
@@ -175,12 +248,14 @@ class SavedModelTensorFlowClassifier : public ClassifierInterface {
     std::vector<Tensor> outputs;
     int num_examples;
     TF_RETURN_IF_ERROR(PerformOneShotTensorComputation(
-        run_options_, request.input(), input_tensor_name, output_tensor_names,
-        session_, &outputs, &num_examples));
+        run_options_, request.input(), input_tensor_name,
+        GetSharedContextTensorName(*signature_), output_tensor_names, session_,
+        &outputs, &num_examples));
 
     TRACELITERAL("ConvertToClassificationResult");
-    return PostProcessClassificationResult(
-        *signature_, num_examples, output_tensor_names, outputs, result);
+    return PostProcessClassificationResult(*signature_, num_examples,
+                                           output_tensor_names, outputs,
+                                           request.top_k(), result);
   }
 
  private:
@@ -280,6 +355,10 @@ Status CreateFlyweightTensorFlowClassifier(
   return Status::OK();
 }
 
+Status ValidateClassificationRequest(const ClassificationRequest& request) {
+  return ValidateTopK(request.top_k());
+}
+
 Status GetClassificationSignatureDef(const ModelSpec& model_spec,
                                      const MetaGraphDef& meta_graph_def,
                                      SignatureDef* signature) {
@@ -308,7 +387,10 @@ Status PreProcessClassification(const SignatureDef& signature,
         "Expected classification signature method_name to be ",
         kClassifyMethodName, ". Was: ", signature.method_name()));
   }
-  if (signature.inputs().size() != 1) {
+  // Besides the examples, the signature may take the shared context.
+  if (signature.inputs().size() -
+          signature.inputs().count(kSharedContextInputs) !=
+      1) {
     return errors::InvalidArgument(
         strings::StrCat("Expected one input Tensor."));
   }
@@ -347,7 +429,9 @@ Status PreProcessClassification(const SignatureDef& signature,
 Status PostProcessClassificationResult(
     const SignatureDef& signature, int num_examples,
     const std::vector<string>& output_tensor_names,
-    const std::vector<Tensor>& output_tensors, ClassificationResult* result) {
+    const std::vector<Tensor>& output_tensors, const int top_k,
+    ClassificationResult* result) {
+  RequestTiming::ScopedPhase encoding_phase(RequestPhase::kResponseEncoding);
   if (output_tensors.size() != output_tensor_names.size()) {
     return errors::InvalidArgument(
         strings::StrCat("Expected ", output_tensor_names.size(),
@@ -429,19 +513,8 @@ Status PostProcessClassificationResult(
   }
 
   // Convert the output to ClassificationResult format.
-  for (int i = 0; i < num_examples; ++i) {
-    serving::Classifications* classifications = result->add_classifications();
-    for (int c = 0; c < num_classes; ++c) {
-      serving::Class* cl = classifications->add_classes();
-      if (classes) {
-        cl->set_label((classes->matrix<string>())(i, c));
-      }
-      if (scores) {
-        cl->set_score((scores->matrix<float>())(i, c));
-      }
-    }
-  }
-  return Status::OK();
+  return WriteClassificationResult(classes, scores, num_examples, num_classes,
+                                   top_k, result);
 }
 
 }  // namespace serving
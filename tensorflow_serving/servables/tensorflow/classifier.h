@@ -60,6 +60,10 @@ Status CreateFlyweightTensorFlowClassifier(
     const SignatureDef* signature,
     std::unique_ptr<ClassifierInterface>* service);
 
+// Validates the parts of 'request' which don't depend on the model, such as
+// its top_k, so that a bad request fails before the session runs.
+Status ValidateClassificationRequest(const ClassificationRequest& request);
+
 // Get a classification signature from the meta_graph_def that's either:
 // 1) The signature that model_spec explicitly specifies to use.
 // 2) The default serving signature.
@@ -78,11 +82,14 @@ Status PreProcessClassification(const SignatureDef& signature,
                                 string* input_tensor_name,
                                 std::vector<string>* output_tensor_names);
 
-// Validate all results and populate a ClassificationResult.
+// Validate all results and populate a ClassificationResult. If 'top_k' is
+// positive, only the 'top_k' highest scored classes of each example are kept
+// (see ClassificationRequest::top_k).
 Status PostProcessClassificationResult(
     const SignatureDef& signature, int num_examples,
     const std::vector<string>& output_tensor_names,
-    const std::vector<Tensor>& output_tensors, ClassificationResult* result);
+    const std::vector<Tensor>& output_tensors, int top_k,
+    ClassificationResult* result);
 
 }  // namespace serving
 }  // namespace tensorflow
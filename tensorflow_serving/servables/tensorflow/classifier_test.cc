@@ -16,12 +16,15 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/classifier.h"
 
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/map.h"
+#include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/contrib/batching/basic_batch_scheduler.h"
 #include "tensorflow/contrib/session_bundle/bundle_shim.h"
 #include "tensorflow/contrib/session_bundle/manifest.pb.h"
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
@@ -36,7 +39,9 @@ limitations under the License.
 #include "tensorflow_serving/apis/classification.pb.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
+#include "tensorflow_serving/batching/batching_session.h"
 #include "tensorflow_serving/core/test_util/mock_session.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/test_util/test_util.h"
 #include "tensorflow_serving/util/optional.h"
 
@@ -49,6 +54,7 @@ using test_util::EqualsProto;
 using test_util::MockSession;
 
 const char kInputTensor[] = "input:0";
+const char kContextTensor[] = "context:0";
 const char kClassTensor[] = "output:0";
 const char kOutputPlusOneClassTensor[] = "outputPlusOne:0";
 const char kClassFeature[] = "class";
@@ -104,13 +110,23 @@ class FakeSession : public tensorflow::Session {
     if (expected_timeout_) {
       CHECK_EQ(*expected_timeout_, run_options.timeout_in_ms());
     }
-    if (inputs.size() != 1 || inputs[0].first != kInputTensor) {
+    const Tensor* input = nullptr;
+    string context;
+    for (const auto& entry : inputs) {
+      if (entry.first == kInputTensor) {
+        input = &entry.second;
+      } else if (entry.first == kContextTensor) {
+        context = entry.second.scalar<string>()();
+      } else {
+        return errors::Internal("Unexpected input Tensor: ", entry.first);
+      }
+    }
+    if (input == nullptr) {
       return errors::Internal("Expected one input Tensor.");
     }
 
-    const Tensor& input = inputs[0].second;
     std::vector<Example> examples;
-    TF_RETURN_IF_ERROR(GetExamples(input, &examples));
+    TF_RETURN_IF_ERROR(GetExamples(*input, context, &examples));
     Tensor classes;
     Tensor scores;
     TF_RETURN_IF_ERROR(
@@ -132,15 +148,17 @@ class FakeSession : public tensorflow::Session {
     return Status::OK();
   }
 
-  // Parses TensorFlow Examples from a string Tensor.
-  static Status GetExamples(const Tensor& input,
+  // Parses TensorFlow Examples from a string Tensor, each merged into the
+  // serialized shared 'context', with the example's features taking
+  // precedence.
+  static Status GetExamples(const Tensor& input, const string& context,
                             std::vector<Example>* examples) {
     examples->clear();
     const int batch_size = input.dim_size(0);
     const auto& flat_input = input.flat<string>();
     for (int i = 0; i < batch_size; ++i) {
       Example example;
-      if (!example.ParseFromString(flat_input(i))) {
+      if (!example.ParseFromString(context + flat_input(i))) {
         return errors::Internal("failed to parse example");
       }
       examples->push_back(example);
@@ -214,6 +232,29 @@ class FakeSession : public tensorflow::Session {
   const optional<int64> expected_timeout_;
 };
 
+// The result of classifying the examples of AddSharedContextExamples().
+const char kSharedContextResult[] =
+    " classifications { "
+    "   classes { "
+    "     label: 'dos' "
+    "     score: 2 "
+    "   } "
+    "   classes { "
+    "     label: 'uno' "
+    "     score: 1 "
+    "   } "
+    " } "
+    " classifications { "
+    "   classes { "
+    "     label: 'cuatro' "
+    "     score: 4 "
+    "   } "
+    "   classes { "
+    "     label: 'tres' "
+    "     score: 3 "
+    "   } "
+    " } ";
+
 // Add a named signature to the mutable signatures* parameter.
 // If is_classification is false, will add a regression signature, which is
 // invalid in classification requests.
@@ -314,6 +355,41 @@ class ClassifierTest : public ::testing::TestWithParam<bool> {
     }
   }
 
+  // Like Create() with a SavedModel, whose default signature also takes the
+  // shared context of the examples (see kSharedContextInputs). Runs the
+  // session through a BatchingSession if 'batching' is set.
+  Status CreateWithSharedContext(bool batching) {
+    std::unique_ptr<SavedModelBundle> saved_model(new SavedModelBundle);
+    TF_CHECK_OK(internal::ConvertSessionBundleToSavedModelBundle(
+        *bundle_, saved_model.get()));
+    SignatureDef& signature =
+        (*saved_model->meta_graph_def.mutable_signature_def())
+            [kDefaultServingSignatureDefKey];
+    (*signature.mutable_inputs())[kSharedContextInputs].set_name(
+        kContextTensor);
+    if (batching) {
+      BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+      schedule_options.num_batch_threads = 1;
+      TF_RETURN_IF_ERROR(CreateBasicBatchingSession(
+          schedule_options, BatchingSessionOptions(),
+          TensorSignatureFromSignatureDef(signature),
+          std::move(saved_model->session), &saved_model->session));
+    }
+    return CreateClassifierFromSavedModelBundle(
+        GetRunOptions(), std::move(saved_model), &classifier_);
+  }
+
+  // Adds a context and two examples to 'request_': an empty one, and one
+  // whose features take precedence over the context's. See
+  // kSharedContextResult.
+  void AddSharedContextExamples() {
+    auto* list_and_context =
+        request_.mutable_input()->mutable_example_list_with_context();
+    *list_and_context->mutable_context() = example({{"dos", 2}, {"uno", 1}});
+    list_and_context->add_examples();
+    *list_and_context->add_examples() = example({{"cuatro", 4}, {"tres", 3}});
+  }
+
   // Variables used to create the classifier.
   tensorflow::MetaGraphDef* meta_graph_def_;
   FakeSession* fake_session_;
@@ -429,6 +505,28 @@ TEST_P(ClassifierTest, ExampleListWithContext_DuplicateFeatures) {
                                    " } "));
 }
 
+TEST_P(ClassifierTest, SharedContextInput) {
+  if (!UseSavedModel()) {
+    // SessionBundle signatures don't take a shared context.
+    return;
+  }
+  TF_ASSERT_OK(CreateWithSharedContext(false /* batching */));
+  AddSharedContextExamples();
+  TF_ASSERT_OK(classifier_->Classify(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(kSharedContextResult));
+}
+
+TEST_P(ClassifierTest, SharedContextInputWithBatching) {
+  if (!UseSavedModel()) {
+    // SessionBundle signatures don't take a shared context.
+    return;
+  }
+  TF_ASSERT_OK(CreateWithSharedContext(true /* batching */));
+  AddSharedContextExamples();
+  TF_ASSERT_OK(classifier_->Classify(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(kSharedContextResult));
+}
+
 TEST_P(ClassifierTest, ClassesOnly) {
   tensorflow::serving::Signatures signatures;
   auto signature = signatures.mutable_default_signature()
@@ -518,6 +616,113 @@ TEST_P(ClassifierTest, ZeroScoresArePresent) {
   }
 }
 
+TEST_P(ClassifierTest, TopK) {
+  TF_ASSERT_OK(Create());
+  request_.set_top_k(2);
+  auto* examples =
+      request_.mutable_input()->mutable_example_list()->mutable_examples();
+  *examples->Add() = example({{"uno", 1}, {"tres", 3}, {"dos", 2}});
+  *examples->Add() = example({{"seis", 6}, {"cinco", 5}, {"siete", 7}});
+  TF_ASSERT_OK(classifier_->Classify(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(" classifications { "
+                                   "   classes { "
+                                   "     label: 'tres' "
+                                   "     score: 3 "
+                                   "   } "
+                                   "   classes { "
+                                   "     label: 'dos' "
+                                   "     score: 2 "
+                                   "   } "
+                                   " } "
+                                   " classifications { "
+                                   "   classes { "
+                                   "     label: 'siete' "
+                                   "     score: 7 "
+                                   "   } "
+                                   "   classes { "
+                                   "     label: 'seis' "
+                                   "     score: 6 "
+                                   "   } "
+                                   " } "));
+}
+
+TEST_P(ClassifierTest, TopKLargerThanNumClasses) {
+  TF_ASSERT_OK(Create());
+  request_.set_top_k(3);
+  auto* examples =
+      request_.mutable_input()->mutable_example_list()->mutable_examples();
+  *examples->Add() = example({{"uno", 1}, {"dos", 2}});
+  TF_ASSERT_OK(classifier_->Classify(request_, &result_));
+  // All classes are kept, in the order the model returned them.
+  EXPECT_THAT(result_, EqualsProto(" classifications { "
+                                   "   classes { "
+                                   "     label: 'uno' "
+                                   "     score: 1 "
+                                   "   } "
+                                   "   classes { "
+                                   "     label: 'dos' "
+                                   "     score: 2 "
+                                   "   } "
+                                   " } "));
+}
+
+TEST_P(ClassifierTest, TopKOrdersNaNScoresLast) {
+  TF_ASSERT_OK(Create());
+  request_.set_top_k(3);
+  auto* examples =
+      request_.mutable_input()->mutable_example_list()->mutable_examples();
+  *examples->Add() =
+      example({{"nan", std::numeric_limits<float>::quiet_NaN()},
+               {"uno", 1},
+               {"tres", 3},
+               {"dos", 2}});
+  TF_ASSERT_OK(classifier_->Classify(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(" classifications { "
+                                   "   classes { "
+                                   "     label: 'tres' "
+                                   "     score: 3 "
+                                   "   } "
+                                   "   classes { "
+                                   "     label: 'dos' "
+                                   "     score: 2 "
+                                   "   } "
+                                   "   classes { "
+                                   "     label: 'uno' "
+                                   "     score: 1 "
+                                   "   } "
+                                   " } "));
+}
+
+TEST_P(ClassifierTest, NegativeTopKFailsBeforeRun) {
+  TF_ASSERT_OK(Create());
+  request_.set_top_k(-1);
+  // Running the session would fail on the empty input.
+  request_.mutable_input()->mutable_example_list();
+  const Status status = classifier_->Classify(request_, &result_);
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(::tensorflow::error::INVALID_ARGUMENT, status.code()) << status;
+  EXPECT_THAT(status.ToString(),
+              ::testing::HasSubstr("top_k must not be negative"));
+}
+
+TEST_P(ClassifierTest, TopKRequiresScores) {
+  tensorflow::serving::Signatures signatures;
+  auto signature = signatures.mutable_default_signature()
+                       ->mutable_classification_signature();
+  signature->mutable_input()->set_tensor_name(kInputTensor);
+  signature->mutable_classes()->set_tensor_name(kClassTensor);
+  // No scores Tensor.
+  TF_ASSERT_OK(tensorflow::serving::SetSignatures(signatures, meta_graph_def_));
+  TF_ASSERT_OK(Create());
+  request_.set_top_k(1);
+  auto* examples =
+      request_.mutable_input()->mutable_example_list()->mutable_examples();
+  *examples->Add() = example({{"dos", 2}, {"uno", 1}});
+  const Status status = classifier_->Classify(request_, &result_);
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(::tensorflow::error::INVALID_ARGUMENT, status.code()) << status;
+}
+
 TEST_P(ClassifierTest, ValidNamedSignature) {
   TF_ASSERT_OK(Create());
   request_.mutable_model_spec()->set_signature_name(kOutputPlusOneSignature);
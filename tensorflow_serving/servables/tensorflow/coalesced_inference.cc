@@ -0,0 +1,84 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/coalesced_inference.h"
+
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow_serving/core/inference_request_key.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Returns the key of 'request' for coalescing, reusing 'cache_key' if it is
+// set.
+InferenceRequestKey GetCoalescingKey(
+    const string& method_name, const ServableId& servable_id,
+    const google::protobuf::Message& request,
+    const optional<InferenceResultCache::Key>& cache_key) {
+  return cache_key ? *cache_key
+                   : InferenceRequestKey::Create(method_name, servable_id,
+                                                 request);
+}
+
+}  // namespace
+
+Status RunCoalescedInference(
+    ServerCore* core, const string& method_name,
+    const ServableId& servable_id, const google::protobuf::Message& request,
+    const optional<InferenceResultCache::Key>& cache_key,
+    google::protobuf::Message* response,
+    const std::function<Status()>& compute) {
+  RequestCoalescer* const coalescer = core->request_coalescer();
+  TF_RETURN_IF_ERROR(
+      coalescer == nullptr
+          ? compute()
+          : coalescer->Run(
+                GetCoalescingKey(method_name, servable_id, request, cache_key),
+                response, compute));
+  if (cache_key) {
+    core->inference_result_cache()->Insert(*cache_key, *response);
+  }
+  return Status::OK();
+}
+
+void RunCoalescedInferenceAsync(
+    ServerCore* core, const string& method_name,
+    const ServableId& servable_id, const google::protobuf::Message& request,
+    const optional<InferenceResultCache::Key>& cache_key,
+    google::protobuf::Message* response,
+    const RequestCoalescer::Computation& compute,
+    std::function<void(const Status&)> done) {
+  // Caches the response, and then reports the outcome.
+  auto complete = [core, cache_key, response, done](const Status& status) {
+    if (status.ok() && cache_key) {
+      core->inference_result_cache()->Insert(*cache_key, *response);
+    }
+    done(status);
+  };
+  RequestCoalescer* const coalescer = core->request_coalescer();
+  if (coalescer == nullptr) {
+    compute(std::move(complete));
+    return;
+  }
+  coalescer->RunAsync(
+      GetCoalescingKey(method_name, servable_id, request, cache_key), response,
+      compute, std::move(complete));
+}
+
+}  // namespace serving
+}  // namespace tensorflow
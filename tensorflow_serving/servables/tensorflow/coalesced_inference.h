@@ -0,0 +1,59 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_COALESCED_INFERENCE_H_
+#define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_COALESCED_INFERENCE_H_
+
+#include <functional>
+
+#include "google/protobuf/message.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
+#include "tensorflow_serving/core/request_coalescer.h"
+#include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/util/optional.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Fills 'response' to 'request', a 'method_name' (e.g. "Predict") request
+// served by 'servable_id', by running 'compute', or by sharing the
+// computation of an identical request in flight if 'core' coalesces requests.
+// Then, if 'cache_key' is set (see InferenceResultCache::Lookup()), inserts
+// the response into the result cache of 'core'.
+Status RunCoalescedInference(
+    ServerCore* core, const string& method_name,
+    const ServableId& servable_id, const google::protobuf::Message& request,
+    const optional<InferenceResultCache::Key>& cache_key,
+    google::protobuf::Message* response,
+    const std::function<Status()>& compute);
+
+// Like RunCoalescedInference(), but 'compute' reports its outcome to a
+// callback, possibly from another thread, and so does this function to
+// 'done'. 'response' must stay valid until then.
+void RunCoalescedInferenceAsync(
+    ServerCore* core, const string& method_name,
+    const ServableId& servable_id, const google::protobuf::Message& request,
+    const optional<InferenceResultCache::Key>& cache_key,
+    google::protobuf::Message* response,
+    const RequestCoalescer::Computation& compute,
+    std::function<void(const Status&)> done);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_COALESCED_INFERENCE_H_
@@ -17,9 +17,11 @@ limitations under the License.
 
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
+#include "tensorflow_serving/core/request_context.h"
 #include "tensorflow_serving/servables/tensorflow/classifier.h"
 #include "tensorflow_serving/servables/tensorflow/regressor.h"
 #include "tensorflow_serving/servables/tensorflow/util.h"
@@ -34,6 +36,7 @@ Status TensorFlowMultiInferenceRunner::Infer(
 
   string model_name = "";
   string input_tensor_name = "";
+  string context_tensor_name = "";
   std::set<string> signature_names;
   std::set<string> output_tensor_name_set;
   for (const auto& task : request.tasks()) {
@@ -79,7 +82,10 @@ Status TensorFlowMultiInferenceRunner::Infer(
     }
     if (input_tensor_name.empty()) {
       input_tensor_name = input_name;
-    } else if (input_tensor_name != input_name) {
+      context_tensor_name = GetSharedContextTensorName(iter->second);
+    } else if (input_tensor_name != input_name ||
+               context_tensor_name !=
+                   GetSharedContextTensorName(iter->second)) {
       return errors::InvalidArgument(
           "Input tensor must be the same for all Signatures.");
     }
@@ -95,8 +101,8 @@ Status TensorFlowMultiInferenceRunner::Infer(
   std::vector<Tensor> outputs;
   int num_examples;
   TF_RETURN_IF_ERROR(PerformOneShotTensorComputation(
-      run_options, request.input(), input_tensor_name, output_tensor_names,
-      session_, &outputs, &num_examples));
+      run_options, request.input(), input_tensor_name, context_tensor_name,
+      output_tensor_names, session_, &outputs, &num_examples));
   RecordRequestExampleCount(model_name, num_examples);
 
   TRACELITERAL("PostProcessResults");
@@ -112,6 +118,7 @@ Status TensorFlowMultiInferenceRunner::Infer(
     if (task.method_name() == kClassifyMethodName) {
       TF_RETURN_IF_ERROR(PostProcessClassificationResult(
           iter->second, num_examples, output_tensor_names, outputs,
+          0 /* top_k */,
           response->add_results()->mutable_classification_result()));
     } else if (task.method_name() == kRegressMethodName) {
       TF_RETURN_IF_ERROR(PostProcessRegressionResult(
@@ -134,19 +141,41 @@ const ModelSpec& GetModelSpecFromRequest(const MultiInferenceRequest& request) {
   return ModelSpec::default_instance();
 }
 
+Status RunMultiInferenceWithServerCore(const RunOptions& run_options,
+                                       ServerCore* core,
+                                       const MultiInferenceRequest& request,
+                                       MultiInferenceResponse* response,
+                                       RequestContext* context) {
+  ServableHandle<SavedModelBundle> bundle;
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(
+        core->GetServableHandle(GetModelSpecFromRequest(request), &bundle));
+  }
+  context->set_model_version(bundle.id().version);
+
+  TensorFlowMultiInferenceRunner inference_runner(bundle->session.get(),
+                                                  &bundle->meta_graph_def);
+  return inference_runner.Infer(run_options, request, response);
+}
+
 }  // namespace
 
 Status RunMultiInference(const RunOptions& run_options, ServerCore* core,
                          const MultiInferenceRequest& request,
                          MultiInferenceResponse* response) {
   TRACELITERAL("RunMultiInference");
-  ServableHandle<SavedModelBundle> bundle;
-  TF_RETURN_IF_ERROR(
-      core->GetServableHandle(GetModelSpecFromRequest(request), &bundle));
-
-  TensorFlowMultiInferenceRunner inference_runner(bundle->session.get(),
-                                                  &bundle->meta_graph_def);
-  return inference_runner.Infer(run_options, request, response);
+  RequestContext context;
+  RequestTiming::ScopedCurrent scoped_timing(context.mutable_timing());
+  const uint64 start_time = Env::Default()->NowMicros();
+  const Status status = RunMultiInferenceWithServerCore(
+      run_options, core, request, response, &context);
+  const uint64 end_time = Env::Default()->NowMicros();
+  core->RecordRequestPhases("MultiInference", GetModelSpecFromRequest(request),
+                            context,
+                            end_time > start_time ? end_time - start_time : 0,
+                            status);
+  return status;
 }
 
 }  // namespace serving
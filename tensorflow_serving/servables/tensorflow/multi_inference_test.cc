@@ -19,23 +19,31 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/contrib/batching/basic_batch_scheduler.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/regression.pb.h"
 #include "tensorflow_serving/apis/classification.pb.h"
+#include "tensorflow_serving/batching/batching_session.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
+#include "tensorflow_serving/core/test_util/mock_session.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/model_servers/platform_config_util.h"
 #include "tensorflow_serving/model_servers/server_core.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/test_util/test_util.h"
 
 namespace tensorflow {
 namespace serving {
 namespace {
 
+using ::testing::_;
+
 constexpr char kTestModelName[] = "test_model";
 constexpr int kTestModelVersion = 123;
 
@@ -279,6 +287,122 @@ TEST_F(MultiInferenceTest, RegressAndClassifySignaturesTest) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_response));
 }
 
+// Stands in for the graph of a model whose signatures take the shared context
+// separately (see kSharedContextInputs): parses each of the "examples:0" merged
+// into the "context:0", and outputs their "x" feature both as "scores:0" and as
+// "outputs:0".
+Status RunSharedContextGraph(
+    const RunOptions& run_options,
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const std::vector<string>& output_names,
+    const std::vector<string>& target_nodes, std::vector<Tensor>* outputs,
+    RunMetadata* run_metadata) {
+  const Tensor* examples = nullptr;
+  const Tensor* context = nullptr;
+  for (const auto& entry : inputs) {
+    if (entry.first == "examples:0") {
+      examples = &entry.second;
+    } else if (entry.first == "context:0") {
+      context = &entry.second;
+    }
+  }
+  if (examples == nullptr || context == nullptr || context->dims() != 0) {
+    return errors::InvalidArgument("Expected examples and a scalar context");
+  }
+  const int num_examples = examples->NumElements();
+  Tensor x(DT_FLOAT, TensorShape({num_examples}));
+  for (int i = 0; i < num_examples; ++i) {
+    Example example;
+    if (!example.ParseFromString(context->scalar<string>()() +
+                                 examples->flat<string>()(i))) {
+      return errors::InvalidArgument("Failed to parse example");
+    }
+    x.flat<float>()(i) =
+        example.features().feature().at("x").float_list().value(0);
+  }
+  Tensor scores;
+  CHECK(scores.CopyFrom(x, TensorShape({num_examples, 1})));
+  for (const string& output_name : output_names) {
+    outputs->push_back(output_name == "scores:0" ? scores : x);
+  }
+  return Status::OK();
+}
+
+// Parameter is 'bool batching'.
+class MultiInferenceSharedContextTest : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override {
+    SignatureDef& classify_signature =
+        (*meta_graph_def_.mutable_signature_def())["classify_x"];
+    classify_signature.set_method_name(kClassifyMethodName);
+    (*classify_signature.mutable_inputs())[kClassifyInputs].set_name(
+        "examples:0");
+    (*classify_signature.mutable_inputs())[kSharedContextInputs].set_name(
+        "context:0");
+    (*classify_signature.mutable_outputs())[kClassifyOutputScores].set_name(
+        "scores:0");
+    SignatureDef& regress_signature =
+        (*meta_graph_def_.mutable_signature_def())["regress_x"];
+    regress_signature.set_method_name(kRegressMethodName);
+    (*regress_signature.mutable_inputs())[kRegressInputs].set_name(
+        "examples:0");
+    (*regress_signature.mutable_inputs())[kSharedContextInputs].set_name(
+        "context:0");
+    (*regress_signature.mutable_outputs())[kRegressOutputs].set_name(
+        "outputs:0");
+
+    auto* mock_session = new ::testing::NiceMock<test_util::MockSession>;
+    ON_CALL(*mock_session, Run(_, _, _, _, _, _))
+        .WillByDefault(::testing::Invoke(RunSharedContextGraph));
+    session_.reset(mock_session);
+    if (GetParam()) {
+      BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+      schedule_options.num_batch_threads = 1;
+      TF_ASSERT_OK(CreateBasicBatchingSession(
+          schedule_options, BatchingSessionOptions(),
+          TensorSignatureFromSignatureDefs(
+              {classify_signature, regress_signature}),
+          std::move(session_), &session_));
+    }
+  }
+
+  MetaGraphDef meta_graph_def_;
+  std::unique_ptr<Session> session_;
+};
+
+TEST_P(MultiInferenceSharedContextTest, ClassifyAndRegress) {
+  MultiInferenceRequest request;
+  auto* list_and_context =
+      request.mutable_input()->mutable_example_list_with_context();
+  (*list_and_context->mutable_context()->mutable_features()->mutable_feature())
+      ["x"].mutable_float_list()->add_value(1);
+  list_and_context->add_examples();
+  // The features of the example take precedence over the context's.
+  (*list_and_context->add_examples()->mutable_features()->mutable_feature())
+      ["x"].mutable_float_list()->add_value(3);
+  PopulateTask("classify_x", kClassifyMethodName, request.add_tasks());
+  PopulateTask("regress_x", kRegressMethodName, request.add_tasks());
+
+  MultiInferenceResponse expected_response;
+  auto* classification_result =
+      expected_response.add_results()->mutable_classification_result();
+  classification_result->add_classifications()->add_classes()->set_score(1);
+  classification_result->add_classifications()->add_classes()->set_score(3);
+  auto* regression_result =
+      expected_response.add_results()->mutable_regression_result();
+  regression_result->add_regressions()->set_value(1);
+  regression_result->add_regressions()->set_value(3);
+
+  TensorFlowMultiInferenceRunner inference_runner(session_.get(),
+                                                  &meta_graph_def_);
+  MultiInferenceResponse response;
+  TF_ASSERT_OK(inference_runner.Infer(RunOptions(), request, &response));
+  EXPECT_THAT(response, test_util::EqualsProto(expected_response));
+}
+
+INSTANTIATE_TEST_CASE_P(Batching, MultiInferenceSharedContextTest,
+                        ::testing::Bool());
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
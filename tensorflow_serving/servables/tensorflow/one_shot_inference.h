@@ -0,0 +1,212 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_ONE_SHOT_INFERENCE_H_
+#define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_ONE_SHOT_INFERENCE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/cc/saved_model/loader.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow_serving/apis/model.pb.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
+#include "tensorflow_serving/core/request_coalescer.h"
+#include "tensorflow_serving/core/request_context.h"
+#include "tensorflow_serving/core/request_timing.h"
+#include "tensorflow_serving/core/servable_handle.h"
+#include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/servables/tensorflow/coalesced_inference.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
+#include "tensorflow_serving/util/executor.h"
+#include "tensorflow_serving/util/optional.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Describes a method which runs one signature over the tf.Examples of the
+// Input of a request, i.e. Classify or Regress, for
+// RunOneShotInferenceAsync().
+template <typename Request, typename Response>
+struct OneShotInferenceMethod {
+  // The name of the method, e.g. "Classify", under which its requests are
+  // recorded, cached and coalesced.
+  const char* name;
+
+  // Whether responses go through the result cache of the ServerCore, if it
+  // has one.
+  bool use_result_cache;
+
+  // Looks up the signature 'model_spec' asks for in 'meta_graph_def'.
+  Status (*get_signature_def)(const ModelSpec& model_spec,
+                              const MetaGraphDef& meta_graph_def,
+                              SignatureDef* signature);
+
+  // Validates 'signature', and returns the names of its input and output
+  // tensors.
+  Status (*pre_process)(const SignatureDef& signature,
+                        string* input_tensor_name,
+                        std::vector<string>* output_tensor_names);
+
+  // Fills 'response' from the outputs of the session run.
+  Status (*post_process)(const SignatureDef& signature, int num_examples,
+                         const std::vector<string>& output_tensor_names,
+                         const std::vector<Tensor>& output_tensors,
+                         const Request& request, Response* response);
+};
+
+// Serves 'request' to the method described by 'method' with the SavedModel
+// the request names in 'core', and calls 'done' with the outcome, possibly
+// from another thread once the session run completes (see
+// ServingSession::RunAsync()). The rest of the request after the session run,
+// including 'done', runs on 'executor'. 'request' and 'response' must outlive
+// the call to 'done'.
+template <typename Request, typename Response>
+void RunOneShotInferenceAsync(
+    const OneShotInferenceMethod<Request, Response>& method,
+    const RunOptions& run_options, ServerCore* core, Executor* executor,
+    const Request& request, Response* response,
+    std::function<void(const Status&)> done);
+
+//////////
+// Implementation details follow. API users need not read.
+
+namespace internal {
+
+// The state of a request served by RunOneShotInferenceAsync(), which lives
+// until the session run completes.
+struct OneShotInferenceCall {
+  RequestContext context;
+  uint64 start_time_micros;
+  // Copied, since the computation may run again after the caller's returned
+  // (see RequestCoalescer).
+  RunOptions run_options;
+  ServableHandle<SavedModelBundle> saved_model_bundle;
+  SignatureDef signature;
+  string input_tensor_name;
+  string context_tensor_name;
+  std::vector<string> output_tensor_names;
+  std::vector<Tensor> outputs;
+  int num_examples = 0;
+  // Set if the response is to be cached once the session run completes.
+  optional<InferenceResultCache::Key> cache_key;
+};
+
+// Acquires the servable of 'model_spec' and prepares the session run of
+// 'call'. Sets 'cache_hit' if 'response' was filled from the result cache
+// instead, in which case there is nothing to run.
+template <typename Request, typename Response>
+Status PrepareOneShotInferenceCall(
+    const OneShotInferenceMethod<Request, Response>& method, ServerCore* core,
+    const Request& request, Response* response, OneShotInferenceCall* call,
+    bool* cache_hit) {
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(),
+                                               &call->saved_model_bundle));
+  }
+  call->context.set_model_version(call->saved_model_bundle.id().version);
+  InferenceResultCache* const cache =
+      method.use_result_cache ? core->inference_result_cache() : nullptr;
+  *cache_hit = cache != nullptr &&
+               cache->Lookup(method.name, call->saved_model_bundle.id(),
+                             request, response, &call->cache_key);
+  if (*cache_hit) {
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(method.get_signature_def(
+      request.model_spec(), call->saved_model_bundle->meta_graph_def,
+      &call->signature));
+  call->context_tensor_name = GetSharedContextTensorName(call->signature);
+  return method.pre_process(call->signature, &call->input_tensor_name,
+                            &call->output_tensor_names);
+}
+
+}  // namespace internal
+
+template <typename Request, typename Response>
+void RunOneShotInferenceAsync(
+    const OneShotInferenceMethod<Request, Response>& method,
+    const RunOptions& run_options, ServerCore* core, Executor* executor,
+    const Request& request, Response* response,
+    std::function<void(const Status&)> done) {
+  if (!request.has_model_spec()) {
+    done(errors::InvalidArgument("Missing ModelSpec"));
+    return;
+  }
+
+  std::shared_ptr<internal::OneShotInferenceCall> call(
+      new internal::OneShotInferenceCall);
+  call->start_time_micros = Env::Default()->NowMicros();
+  call->run_options = run_options;
+  // Records the phases of the request, and reports its outcome.
+  const char* const method_name = method.name;
+  auto finish = [call, core, method_name, &request,
+                 done](const Status& status) {
+    const uint64 end_time = Env::Default()->NowMicros();
+    core->RecordRequestPhases(method_name, request.model_spec(), call->context,
+                              end_time > call->start_time_micros
+                                  ? end_time - call->start_time_micros
+                                  : 0,
+                              status);
+    done(status);
+  };
+
+  RequestTiming::ScopedCurrent scoped_timing(call->context.mutable_timing());
+  bool cache_hit = false;
+  const Status status = internal::PrepareOneShotInferenceCall(
+      method, core, request, response, call.get(), &cache_hit);
+  if (!status.ok() || cache_hit) {
+    finish(status);
+    return;
+  }
+  // Runs the session, and then calls 'computed' with the outcome.
+  const auto post_process = method.post_process;
+  auto compute = [call, &request, response, post_process,
+                  executor](RequestCoalescer::DoneCallback computed) {
+    PerformOneShotTensorComputationAsync(
+        call->run_options, request.input(), call->input_tensor_name,
+        call->context_tensor_name, call->output_tensor_names,
+        call->saved_model_bundle->session.get(), &call->outputs,
+        &call->num_examples,
+        ContinueOnExecutor(executor, [call, &request, response, post_process,
+                                      computed](const Status& run_status) {
+          RequestTiming::ScopedCurrent scoped_timing(
+              call->context.mutable_timing());
+          Status status = run_status;
+          if (status.ok()) {
+            status = post_process(call->signature, call->num_examples,
+                                  call->output_tensor_names, call->outputs,
+                                  request, response);
+          }
+          computed(status);
+        }));
+  };
+  RunCoalescedInferenceAsync(core, method.name,
+                             call->saved_model_bundle.id(), request,
+                             call->cache_key, response, compute, finish);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_ONE_SHOT_INFERENCE_H_
@@ -15,36 +15,65 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/predict_impl.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
-#include <chrono>
 
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
 #include "tensorflow/contrib/session_bundle/signature.h"
 #include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/protobuf/named_tensor.pb.h"
+#include "tensorflow_serving/core/inference_result_cache.h"
+#include "tensorflow_serving/core/request_coalescer.h"
+#include "tensorflow_serving/core/request_context.h"
 #include "tensorflow_serving/core/servable_handle.h"
+#include "tensorflow_serving/servables/tensorflow/coalesced_inference.h"
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
+#include "tensorflow_serving/servables/tensorflow/serving_session.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 
 namespace tensorflow {
 namespace serving {
 namespace {
 
-// Implementation of Predict using the legacy SessionBundle GenericSignature.
-Status SessionBundlePredict(const RunOptions& run_options, ServerCore* core,
-                            const PredictRequest& request,
-                            PredictResponse* response) {
-  // Validate signatures.
-  ServableHandle<SessionBundle> bundle;
-  TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(), &bundle));
+// Encodes an output tensor of a Predict request into 'proto', in
+// tensor_content if 'request' asks for it and the type allows.
+void EncodeOutputTensor(const PredictRequest& request, const Tensor& tensor,
+                        TensorProto* proto) {
+  if (request.output_tensor_content() && DataTypeCanUseMemcpy(tensor.dtype())) {
+    tensor.AsProtoTensorContent(proto);
+  } else {
+    tensor.AsProtoField(proto);
+  }
+}
+
+// Returns the plan of the generic signatures of a SessionBundle, precomputed
+// when the bundle was loaded if possible, and otherwise built into
+// 'built_plan'.
+Status GetSessionBundlePredictPlan(
+    const SessionBundle& bundle,
+    std::unique_ptr<PredictSignaturePlan>* built_plan,
+    const PredictSignaturePlan** plan) {
+  const PredictSignaturePlans* plans =
+      PredictSignaturePlanTable::Global()->Find(&bundle);
+  if (plans != nullptr) {
+    *plan = plans->Find(PredictSignaturePlans::kSessionBundlePredictSignature);
+    if (*plan != nullptr) {
+      return Status::OK();
+    }
+  }
+
   Signature signature;
   TF_RETURN_IF_ERROR(
-      GetNamedSignature("inputs", bundle->meta_graph_def, &signature));
+      GetNamedSignature("inputs", bundle.meta_graph_def, &signature));
   if (!signature.has_generic_signature()) {
     return tensorflow::Status(
         tensorflow::error::INVALID_ARGUMENT,
@@ -52,260 +81,385 @@ Status SessionBundlePredict(const RunOptions& run_options, ServerCore* core,
   }
   GenericSignature input_signature = signature.generic_signature();
   TF_RETURN_IF_ERROR(
-      GetNamedSignature("outputs", bundle->meta_graph_def, &signature));
+      GetNamedSignature("outputs", bundle.meta_graph_def, &signature));
   if (!signature.has_generic_signature()) {
     return tensorflow::Status(
         tensorflow::error::INVALID_ARGUMENT,
         "'outputs' named signature is not a generic signature");
   }
-  GenericSignature output_signature = signature.generic_signature();
-
-  // Verify and prepare input.
-  if (request.inputs().size() != input_signature.map().size()) {
-    return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
-                              "input size does not match signature");
-  }
-  std::vector<std::pair<string, Tensor>> inputs;
-  for (auto& input : request.inputs()) {
-    const string& alias = input.first;
-    auto iter = input_signature.map().find(alias);
-    if (iter == input_signature.map().end()) {
-      return tensorflow::Status(
-          tensorflow::error::INVALID_ARGUMENT,
-          "input tensor alias not found in signature: " + alias);
-    }
-    Tensor tensor;
-    if (!tensor.FromProto(input.second)) {
-      return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
-                                "tensor parsing error: " + alias);
-    }
-    inputs.emplace_back(std::make_pair(iter->second.tensor_name(), tensor));
-  }
+  TF_RETURN_IF_ERROR(PredictSignaturePlan::FromGenericSignatures(
+      input_signature, signature.generic_signature(), built_plan));
+  *plan = built_plan->get();
+  return Status::OK();
+}
 
-  // Prepare run target.
-  std::set<string> seen_outputs;
-  std::vector<string> output_filter(request.output_filter().begin(),
-                                    request.output_filter().end());
-  std::vector<string> output_tensor_names;
-  std::vector<string> output_aliases;
-  for (auto& alias : output_filter) {
-    auto iter = output_signature.map().find(alias);
-    if (iter == output_signature.map().end()) {
-      return tensorflow::Status(
-          tensorflow::error::INVALID_ARGUMENT,
-          "output tensor alias not found in signature: " + alias);
-    }
-    if (seen_outputs.find(alias) != seen_outputs.end()) {
-      return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
-                                "duplicate output tensor alias: " + alias);
-    }
-    seen_outputs.insert(alias);
-    output_tensor_names.emplace_back(iter->second.tensor_name());
-    output_aliases.emplace_back(alias);
-  }
-  // When no output is specified, fetch all output tensors specified in
-  // the signature.
-  if (output_tensor_names.empty()) {
-    for (auto& iter : output_signature.map()) {
-      output_tensor_names.emplace_back(iter.second.tensor_name());
-      output_aliases.emplace_back(iter.first);
+// Returns the plan of the SignatureDef named in the ModelSpec of 'request', or
+// of the default serving SignatureDef if none is named, precomputed when the
+// bundle was loaded if possible, and otherwise built into 'built_plan'.
+Status GetSavedModelPredictPlan(
+    const SavedModelBundle& bundle, const PredictRequest& request,
+    std::unique_ptr<PredictSignaturePlan>* built_plan,
+    const PredictSignaturePlan** plan) {
+  const string signature_name = request.model_spec().signature_name().empty()
+                                    ? kDefaultServingSignatureDefKey
+                                    : request.model_spec().signature_name();
+  const PredictSignaturePlans* plans =
+      PredictSignaturePlanTable::Global()->Find(&bundle);
+  if (plans != nullptr) {
+    *plan = plans->Find(signature_name);
+    if (*plan != nullptr) {
+      return Status::OK();
     }
   }
 
-  // Run session.
-  std::vector<Tensor> outputs;
-  RunMetadata run_metadata;
-  TF_RETURN_IF_ERROR(bundle->session->Run(
-      run_options, inputs, output_tensor_names, {}, &outputs, &run_metadata));
-
-  // Validate and return output.
-  if (outputs.size() != output_tensor_names.size()) {
-    return tensorflow::Status(tensorflow::error::UNKNOWN,
-                              "Predict internal error");
-  }
-  for (int i = 0; i < outputs.size(); i++) {
-    outputs[i].AsProtoField(
-        &((*response->mutable_outputs())[output_aliases[i]]));
+  // Either the bundle has no plans, or the signature can't serve Predict, in
+  // which case building its plan reports why.
+  auto iter = bundle.meta_graph_def.signature_def().find(signature_name);
+  if (iter == bundle.meta_graph_def.signature_def().end()) {
+    return errors::FailedPrecondition(strings::StrCat(
+        "Serving signature key \"", signature_name, "\" not found."));
   }
-
+  TF_RETURN_IF_ERROR(
+      PredictSignaturePlan::FromSignatureDef(iter->second, built_plan));
+  *plan = built_plan->get();
   return Status::OK();
 }
 
-// Returns the keys in the map as a comma delimited string. Useful for debugging
-// or when returning error messages.
-// e.g. returns "key1, key2, key3".
-string MapKeysToString(const google::protobuf::Map<string, tensorflow::TensorInfo>& map) {
-  string result = "";
-  for (const auto& i : map) {
-    if (result.empty()) {
-      result += i.first;
-    } else {
-      result += ", " + i.first;
-    }
-  }
-  return result;
-}
+// The outputs a Predict request fetches: those of its plan when the request
+// has no output filter, and otherwise the filtered ones.
+struct PredictOutputs {
+  std::vector<string> filtered_tensor_names;
+  std::vector<string> filtered_tensor_aliases;
+  // Point either into the plan, or to the filtered vectors above.
+  const std::vector<string>* tensor_names = nullptr;
+  const std::vector<string>* tensor_aliases = nullptr;
+};
 
-// Validate a SignatureDef to make sure it's compatible with prediction, and
-// if so, populate the input and output tensor names.
-Status PreProcessPrediction(const SignatureDef& signature,
+// Decodes and validates the inputs of 'request', and resolves the outputs to
+// fetch, by following 'plan', which must outlive 'outputs'.
+Status PreProcessPrediction(const PredictSignaturePlan& plan,
                             const PredictRequest& request,
                             std::vector<std::pair<string, Tensor>>* inputs,
-                            std::vector<string>* output_tensor_names,
-                            std::vector<string>* output_tensor_aliases) {
-  if (signature.method_name() != kPredictMethodName &&
-      signature.method_name() != kClassifyMethodName &&
-      signature.method_name() != kRegressMethodName) {
-    return errors::Internal(strings::StrCat(
-        "Expected prediction signature method_name to be one of {",
-        kPredictMethodName, ", ", kClassifyMethodName, ", ", kRegressMethodName,
-        "}. Was: ", signature.method_name()));
-  }
-  if (signature.inputs().empty()) {
-    return errors::Internal(strings::StrCat(
-        "Expected at least one input Tensor in prediction signature."));
-  }
-  if (signature.outputs().empty()) {
-    return errors::Internal(strings::StrCat(
-        "Expected at least one output Tensor in prediction signature."));
-  }
-
+                            PredictOutputs* outputs) {
   // Verify and prepare input.
-  if (request.inputs().size() != signature.inputs().size()) {
+  if (request.inputs().size() != plan.num_inputs()) {
     return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
                               "input size does not match signature");
   }
+  inputs->reserve(request.inputs().size());
   for (auto& input : request.inputs()) {
     const string& alias = input.first;
-    auto iter = signature.inputs().find(alias);
-    if (iter == signature.inputs().end()) {
+    const PredictSignaturePlan::Input* plan_input = plan.FindInput(alias);
+    if (plan_input == nullptr) {
       return tensorflow::Status(
           tensorflow::error::INVALID_ARGUMENT,
           strings::StrCat("input tensor alias not found in signature: ", alias,
                           ". Inputs expected to be in the set {",
-                          MapKeysToString(signature.inputs()), "}."));
+                          plan.input_aliases(), "}."));
     }
     Tensor tensor;
-    if (!tensor.FromProto(input.second)) {
-      return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
-                                "tensor parsing error: " + alias);
+    {
+      RequestTiming::ScopedPhase decoding_phase(
+          RequestPhase::kRequestDecoding);
+      const bool parsed =
+          plan.alias_input_content()
+              ? TensorFromProtoAliasingContent(input.second, &tensor)
+              : tensor.FromProto(input.second);
+      if (!parsed) {
+        return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
+                                  "tensor parsing error: " + alias);
+      }
     }
-    inputs->emplace_back(std::make_pair(iter->second.name(), tensor));
+    TF_RETURN_IF_ERROR(
+        PredictSignaturePlan::CheckInputTensor(alias, *plan_input, tensor));
+    inputs->emplace_back(plan_input->tensor_name, std::move(tensor));
   }
 
-  // Prepare run target.
-  std::set<string> seen_outputs;
-  std::vector<string> output_filter(request.output_filter().begin(),
-                                    request.output_filter().end());
-  for (auto& alias : output_filter) {
-    auto iter = signature.outputs().find(alias);
-    if (iter == signature.outputs().end()) {
+  // Prepare run target. When no output is specified, fetch all output tensors
+  // specified in the signature.
+  if (request.output_filter().empty()) {
+    outputs->tensor_names = &plan.output_tensor_names();
+    outputs->tensor_aliases = &plan.output_alias_list();
+    return Status::OK();
+  }
+  std::vector<string>* const output_tensor_names =
+      &outputs->filtered_tensor_names;
+  std::vector<string>* const output_tensor_aliases =
+      &outputs->filtered_tensor_aliases;
+  for (const string& alias : request.output_filter()) {
+    const PredictSignaturePlan::Output* output = plan.FindOutput(alias);
+    if (output == nullptr) {
       return tensorflow::Status(
           tensorflow::error::INVALID_ARGUMENT,
           strings::StrCat("output tensor alias not found in signature: ", alias,
                           " Outputs expected to be in the set {",
-                          MapKeysToString(signature.outputs()), "}."));
+                          plan.output_aliases(), "}."));
     }
-    if (seen_outputs.find(alias) != seen_outputs.end()) {
+    // Output filters are short, so a linear scan beats building a set.
+    if (std::find(output_tensor_aliases->begin(), output_tensor_aliases->end(),
+                  alias) != output_tensor_aliases->end()) {
       return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
                                 "duplicate output tensor alias: " + alias);
     }
-    seen_outputs.insert(alias);
-    output_tensor_names->emplace_back(iter->second.name());
-    output_tensor_aliases->emplace_back(alias);
-  }
-  // When no output is specified, fetch all output tensors specified in
-  // the signature.
-  if (output_tensor_names->empty()) {
-    for (auto& iter : signature.outputs()) {
-      output_tensor_names->emplace_back(iter.second.name());
-      output_tensor_aliases->emplace_back(iter.first);
-    }
+    output_tensor_names->push_back(output->tensor_name);
+    output_tensor_aliases->push_back(alias);
   }
+  outputs->tensor_names = output_tensor_names;
+  outputs->tensor_aliases = output_tensor_aliases;
   return Status::OK();
 }
 
 // Validate results and populate a PredictResponse.
 Status PostProcessPredictionResult(
-    const SignatureDef& signature,
+    const PredictRequest& request,
     const std::vector<string>& output_tensor_aliases,
     const std::vector<Tensor>& output_tensors, PredictResponse* response) {
+  RequestTiming::ScopedPhase encoding_phase(RequestPhase::kResponseEncoding);
   // Validate and return output.
   if (output_tensors.size() != output_tensor_aliases.size()) {
     return tensorflow::Status(tensorflow::error::UNKNOWN,
                               "Predict internal error");
   }
   for (int i = 0; i < output_tensors.size(); i++) {
-    output_tensors[i].AsProtoField(
+    EncodeOutputTensor(
+        request, output_tensors[i],
         &((*response->mutable_outputs())[output_tensor_aliases[i]]));
   }
   return Status::OK();
 }
 
+// Runs a Predict request on 'session' by following 'plan'.
+Status RunPredictPlan(const RunOptions& run_options,
+                      const PredictSignaturePlan& plan, Session* session,
+                      const PredictRequest& request,
+                      PredictResponse* response) {
+  std::vector<std::pair<string, Tensor>> input_tensors;
+  PredictOutputs output_names;
+  TF_RETURN_IF_ERROR(
+      PreProcessPrediction(plan, request, &input_tensors, &output_names));
+  std::vector<Tensor> outputs;
+  RunMetadata run_metadata;
+  {
+    RequestTiming::ScopedPhase session_run_phase(RequestPhase::kSessionRun);
+    TF_RETURN_IF_ERROR(session->Run(run_options, input_tensors,
+                                    *output_names.tensor_names, {}, &outputs,
+                                    &run_metadata));
+  }
+
+  return PostProcessPredictionResult(request, *output_names.tensor_aliases,
+                                     outputs, response);
+}
+
+// Looks up the response to 'request' served by 'servable_id' in the result
+// cache of 'core', if it has one. Returns true on a hit. On a miss, sets
+// 'cache_key' if the response should be cached once computed.
+bool LookupCachedPrediction(ServerCore* core, const ServableId& servable_id,
+                            const PredictRequest& request,
+                            PredictResponse* response,
+                            optional<InferenceResultCache::Key>* cache_key) {
+  InferenceResultCache* const cache = core->inference_result_cache();
+  return cache != nullptr &&
+         cache->Lookup("Predict", servable_id, request, response, cache_key);
+}
+
+// Implementation of Predict using the legacy SessionBundle GenericSignature.
+Status SessionBundlePredict(const RunOptions& run_options, ServerCore* core,
+                            const PredictRequest& request,
+                            PredictResponse* response,
+                            RequestContext* context) {
+  ServableHandle<SessionBundle> bundle;
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(), &bundle));
+  }
+  context->set_model_version(bundle.id().version);
+  optional<InferenceResultCache::Key> cache_key;
+  if (LookupCachedPrediction(core, bundle.id(), request, response,
+                             &cache_key)) {
+    return Status::OK();
+  }
+
+  std::unique_ptr<PredictSignaturePlan> built_plan;
+  const PredictSignaturePlan* plan;
+  TF_RETURN_IF_ERROR(GetSessionBundlePredictPlan(*bundle, &built_plan, &plan));
+  return RunCoalescedInference(
+      core, "Predict", bundle.id(), request, cache_key, response, [&]() {
+        return RunPredictPlan(run_options, *plan, bundle->session.get(),
+                              request, response);
+      });
+}
+
 // Implementation of Predict using the SavedModel SignatureDef format.
 Status SavedModelPredict(const RunOptions& run_options, ServerCore* core,
                          const PredictRequest& request,
-                         PredictResponse* response) {
-  // Validate signatures.
+                         PredictResponse* response, RequestContext* context) {
   ServableHandle<SavedModelBundle> bundle;
-  TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(), &bundle));
-
-  const string signature_name = request.model_spec().signature_name().empty()
-                                    ? kDefaultServingSignatureDefKey
-                                    : request.model_spec().signature_name();
-  auto iter = bundle->meta_graph_def.signature_def().find(signature_name);
-  if (iter == bundle->meta_graph_def.signature_def().end()) {
-    return errors::FailedPrecondition(strings::StrCat(
-        "Serving signature key \"", signature_name, "\" not found."));
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(), &bundle));
+  }
+  context->set_model_version(bundle.id().version);
+  optional<InferenceResultCache::Key> cache_key;
+  if (LookupCachedPrediction(core, bundle.id(), request, response,
+                             &cache_key)) {
+    return Status::OK();
   }
-  SignatureDef signature = iter->second;
 
+  std::unique_ptr<PredictSignaturePlan> built_plan;
+  const PredictSignaturePlan* plan;
+  TF_RETURN_IF_ERROR(
+      GetSavedModelPredictPlan(*bundle, request, &built_plan, &plan));
+  return RunCoalescedInference(
+      core, "Predict", bundle.id(), request, cache_key, response, [&]() {
+        return RunPredictPlan(run_options, *plan, bundle->session.get(),
+                              request, response);
+      });
+}
+
+// The state of a Predict request served by PredictAsync() with a SavedModel,
+// which lives until the session run completes.
+struct AsyncPredictCall {
+  RequestContext context;
+  uint64 start_time_micros;
+  // Copied, since the computation may run again after the caller's returned
+  // (see RequestCoalescer).
+  RunOptions run_options;
+  ServableHandle<SavedModelBundle> bundle;
+  // The plan, if it had to be built for this call rather than found with the
+  // bundle; 'output_names' may point into it.
+  std::unique_ptr<PredictSignaturePlan> built_plan;
   std::vector<std::pair<string, Tensor>> input_tensors;
-  std::vector<string> output_tensor_names;
-  std::vector<string> output_tensor_aliases;
-  TF_RETURN_IF_ERROR(PreProcessPrediction(signature, request, &input_tensors,
-                                          &output_tensor_names,
-                                          &output_tensor_aliases));
+  PredictOutputs output_names;
   std::vector<Tensor> outputs;
   RunMetadata run_metadata;
-  TF_RETURN_IF_ERROR(bundle->session->Run(run_options, input_tensors,
-                                          output_tensor_names, {}, &outputs,
-                                          &run_metadata));
+  // Set if the response is to be cached once the session run completes.
+  optional<InferenceResultCache::Key> cache_key;
+};
 
-  return PostProcessPredictionResult(signature, output_tensor_aliases, outputs,
-                                     response);
+// Acquires the servable of 'request' and prepares the session run of 'call'.
+// Sets 'cache_hit' if 'response' was filled from the result cache instead, in
+// which case there is nothing to run.
+Status PrepareSavedModelPredictCall(ServerCore* core,
+                                    const PredictRequest& request,
+                                    PredictResponse* response,
+                                    AsyncPredictCall* call, bool* cache_hit) {
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(
+        core->GetServableHandle(request.model_spec(), &call->bundle));
+  }
+  call->context.set_model_version(call->bundle.id().version);
+  *cache_hit = LookupCachedPrediction(core, call->bundle.id(), request,
+                                      response, &call->cache_key);
+  if (*cache_hit) {
+    return Status::OK();
+  }
+  const PredictSignaturePlan* plan;
+  TF_RETURN_IF_ERROR(GetSavedModelPredictPlan(*call->bundle, request,
+                                              &call->built_plan, &plan));
+  return PreProcessPrediction(*plan, request, &call->input_tensors,
+                              &call->output_names);
 }
 
 }  // namespace
-std::atomic<long> predictionCount;
+
 Status TensorflowPredictor::Predict(const RunOptions& run_options,
                                     ServerCore* core,
                                     const PredictRequest& request,
                                     PredictResponse* response) {
-  tensorflow::Status status;
-  const tensorflow::uint64 predict_start_time = tensorflow::Env::Default()->NowMicros();
-
   if (!request.has_model_spec()) {
     return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
-                                "Missing ModelSpec");
+                              "Missing ModelSpec");
+  }
+  RequestContext context;
+  RequestTiming::ScopedCurrent scoped_timing(context.mutable_timing());
+  const uint64 predict_start_time = Env::Default()->NowMicros();
+  tensorflow::Status status;
+  if (use_saved_model_) {
+    status = SavedModelPredict(run_options, core, request, response, &context);
   } else {
-    if (use_saved_model_) {
-      status = SavedModelPredict(run_options, core, request, response);
-    } else {
-      status = SessionBundlePredict(run_options, core, request, response);
-    }
+    status =
+        SessionBundlePredict(run_options, core, request, response, &context);
   }
-  const tensorflow::uint64 predict_end_time = tensorflow::Env::Default()
-      ->NowMicros();
-  tensorflow::uint64 elapsed_time = 0;
-  if (predict_end_time > predict_start_time) {
-    elapsed_time = predict_end_time - predict_start_time;
+  const uint64 predict_end_time = Env::Default()->NowMicros();
+  const uint64 elapsed_time = predict_end_time > predict_start_time
+                                  ? predict_end_time - predict_start_time
+                                  : 0;
+  core->RecordPredictMetric(request.model_spec(), context, elapsed_time,
+                            status);
+  core->RecordRequestPhases("Predict", request.model_spec(), context,
+                            elapsed_time, status);
+  return status;
+}
 
+void TensorflowPredictor::PredictAsync(
+    const RunOptions& run_options, ServerCore* core, Executor* executor,
+    const PredictRequest& request, PredictResponse* response,
+    std::function<void(const Status&)> done) {
+  if (!use_saved_model_) {
+    // SessionBundles are legacy; serve them synchronously.
+    done(Predict(run_options, core, request, response));
+    return;
   }
-  core->CreateMetricEvent("PredictMetric", predictionCount++,
-                          ServableState::ManagerState::kEnd, elapsed_time,
-                          status, request.model_spec());
-  return status;
+  if (!request.has_model_spec()) {
+    done(tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
+                            "Missing ModelSpec"));
+    return;
+  }
+
+  std::shared_ptr<AsyncPredictCall> call(new AsyncPredictCall);
+  call->start_time_micros = Env::Default()->NowMicros();
+  call->run_options = run_options;
+  // Records the metrics of the request, and reports its outcome.
+  auto finish = [call, core, &request, done](const Status& status) {
+    const uint64 end_time = Env::Default()->NowMicros();
+    const uint64 elapsed_time = end_time > call->start_time_micros
+                                    ? end_time - call->start_time_micros
+                                    : 0;
+    core->RecordPredictMetric(request.model_spec(), call->context,
+                              elapsed_time, status);
+    core->RecordRequestPhases("Predict", request.model_spec(), call->context,
+                              elapsed_time, status);
+    done(status);
+  };
+
+  RequestTiming::ScopedCurrent scoped_timing(call->context.mutable_timing());
+  bool cache_hit = false;
+  const Status status =
+      PrepareSavedModelPredictCall(core, request, response, call.get(),
+                                   &cache_hit);
+  if (!status.ok() || cache_hit) {
+    finish(status);
+    return;
+  }
+  // Runs the session, and then calls 'computed' with the outcome.
+  auto compute = [call, &request, response,
+                  executor](RequestCoalescer::DoneCallback computed) {
+    const uint64 run_start_time = Env::Default()->NowMicros();
+    auto continuation = ContinueOnExecutor(
+        executor, [call, &request, response, computed](const Status& status) {
+          RequestTiming::ScopedCurrent scoped_timing(
+              call->context.mutable_timing());
+          computed(status.ok()
+                       ? PostProcessPredictionResult(
+                             request, *call->output_names.tensor_aliases,
+                             call->outputs, response)
+                       : status);
+        });
+    RunSessionAsync(
+        call->bundle->session.get(), call->run_options, call->input_tensors,
+        *call->output_names.tensor_names, &call->outputs, &call->run_metadata,
+        [call, continuation, run_start_time](const Status& run_status) {
+          const uint64 run_end_time = Env::Default()->NowMicros();
+          if (run_end_time > run_start_time) {
+            call->context.mutable_timing()->Add(RequestPhase::kSessionRun,
+                                                run_end_time - run_start_time);
+          }
+          continuation(run_status);
+        });
+  };
+  RunCoalescedInferenceAsync(core, "Predict", call->bundle.id(), request,
+                             call->cache_key, response, compute, finish);
 }
 
 }  // namespace serving
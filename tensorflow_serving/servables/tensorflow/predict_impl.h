@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_IMPL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_IMPL_H_
 
+#include <functional>
+
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow_serving/apis/predict.pb.h"
 #include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/util/executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -33,6 +36,16 @@ class TensorflowPredictor {
   Status Predict(const RunOptions& run_options, ServerCore* core,
                  const PredictRequest& request, PredictResponse* response);
 
+  // Like Predict(), but calls 'done' with the outcome rather than returning
+  // it, possibly from another thread once the session run completes (see
+  // ServingSession::RunAsync()). The rest of the request after the session
+  // run, including 'done', runs on 'executor'. 'request' and 'response' must
+  // outlive the call to 'done'.
+  void PredictAsync(const RunOptions& run_options, ServerCore* core,
+                    Executor* executor, const PredictRequest& request,
+                    PredictResponse* response,
+                    std::function<void(const Status&)> done);
+
  private:
   // If use_saved_model_ is true, a SavedModelBundle handle will be retrieved
   // from the ServerCore and the new SavedModel SignatureDef format will be
@@ -19,8 +19,13 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
+#include "tensorflow_serving/core/inference_request_key.h"
+#include "tensorflow_serving/core/request_coalescer.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/model_servers/platform_config_util.h"
 #include "tensorflow_serving/model_servers/server_core.h"
@@ -28,6 +33,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_source_adapter.pb.h"
 #include "tensorflow_serving/test_util/test_util.h"
+#include "tensorflow_serving/util/inline_executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -68,7 +74,8 @@ class PredictImplTest : public ::testing::TestWithParam<bool> {
 
  protected:
   static Status CreateServerCore(const string& model_path, bool use_saved_model,
-                                 std::unique_ptr<ServerCore>* server_core) {
+                                 std::unique_ptr<ServerCore>* server_core,
+                                 bool enable_request_coalescing = false) {
     ModelServerConfig config;
     auto model_config = config.mutable_model_config_list()->add_config();
     model_config->set_name(kTestModelName);
@@ -86,6 +93,7 @@ class PredictImplTest : public ::testing::TestWithParam<bool> {
     // Reduce the number of initial load threads to be num_load_threads to avoid
     // timing out in tests.
     options.num_initial_load_threads = options.num_load_threads;
+    options.enable_request_coalescing = enable_request_coalescing;
     return ServerCore::Create(std::move(options), server_core);
   }
 
@@ -283,6 +291,159 @@ TEST_P(PredictImplTest, PredictionSuccess) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_response));
 }
 
+// Runs PredictAsync() and waits for it to complete.
+Status PredictAsync(TensorflowPredictor* predictor,
+                    const RunOptions& run_options, ServerCore* core,
+                    const PredictRequest& request, PredictResponse* response) {
+  InlineExecutor executor;
+  Notification done;
+  Status status;
+  predictor->PredictAsync(run_options, core, &executor, request, response,
+                          [&done, &status](const Status& predict_status) {
+                            status = predict_status;
+                            done.Notify();
+                          });
+  done.WaitForNotification();
+  return status;
+}
+
+TEST_P(PredictImplTest, PredictAsyncSuccess) {
+  PredictRequest request;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+
+  TensorflowPredictor predictor(GetParam());
+  PredictResponse expected_response;
+  TF_ASSERT_OK(predictor.Predict(GetRunOptions(), GetServerCore(), request,
+                                 &expected_response));
+  PredictResponse response;
+  TF_EXPECT_OK(PredictAsync(&predictor, GetRunOptions(), GetServerCore(),
+                            request, &response));
+  EXPECT_THAT(response, test_util::EqualsProto(expected_response));
+}
+
+// Tests that a request which waited for an identical one computes in turn once
+// that one times out, after the RunOptions it was called with are gone.
+TEST_P(PredictImplTest, PredictAsyncRecomputesAfterCoalescedRequestTimesOut) {
+  if (!GetParam()) {
+    // SessionBundles are served synchronously.
+    return;
+  }
+  std::unique_ptr<ServerCore> core;
+  TF_ASSERT_OK(CreateServerCore(test_util::TensorflowTestSrcDirPath(
+                                    "cc/saved_model/testdata/half_plus_two"),
+                                true, &core, true /* coalescing */));
+
+  PredictRequest request;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+
+  TensorflowPredictor predictor(true);
+  PredictResponse expected_response;
+  TF_ASSERT_OK(predictor.Predict(GetRunOptions(), core.get(), request,
+                                 &expected_response));
+
+  // An identical request, whose computation is held until it times out.
+  RequestCoalescer::DoneCallback leader_computed;
+  PredictResponse leader_response;
+  Notification leader_done;
+  core->request_coalescer()->RunAsync(
+      InferenceRequestKey::Create("Predict",
+                                  {kTestModelName, kTestModelVersion}, request),
+      &leader_response,
+      [&leader_computed](RequestCoalescer::DoneCallback computed) {
+        leader_computed = std::move(computed);
+      },
+      [&leader_done](const Status& status) {
+        EXPECT_EQ(error::DEADLINE_EXCEEDED, status.code());
+        leader_done.Notify();
+      });
+
+  InlineExecutor executor;
+  PredictResponse response;
+  Notification done;
+  Status status;
+  {
+    RunOptions run_options;
+    run_options.set_timeout_in_ms(60 * 1000);
+    predictor.PredictAsync(run_options, core.get(), &executor, request,
+                           &response,
+                           [&done, &status](const Status& predict_status) {
+                             status = predict_status;
+                             done.Notify();
+                           });
+  }
+  EXPECT_FALSE(done.HasBeenNotified());
+
+  leader_computed(errors::DeadlineExceeded("Timed out"));
+  leader_done.WaitForNotification();
+  done.WaitForNotification();
+  TF_EXPECT_OK(status);
+  EXPECT_THAT(response, test_util::EqualsProto(expected_response));
+}
+
+TEST_P(PredictImplTest, PredictAsyncErrors) {
+  PredictRequest request;
+  PredictResponse response;
+  TensorflowPredictor predictor(GetParam());
+
+  // Empty request is invalid.
+  EXPECT_EQ(tensorflow::error::INVALID_ARGUMENT,
+            PredictAsync(&predictor, GetRunOptions(), GetServerCore(), request,
+                         &response)
+                .code());
+
+  // Model name is wrong, not found.
+  request.mutable_model_spec()->set_name("test");
+  EXPECT_EQ(tensorflow::error::NOT_FOUND,
+            PredictAsync(&predictor, GetRunOptions(), GetServerCore(), request,
+                         &response)
+                .code());
+
+  // The input is empty.
+  request.mutable_model_spec()->set_name(kTestModelName);
+  EXPECT_EQ(tensorflow::error::INVALID_ARGUMENT,
+            PredictAsync(&predictor, GetRunOptions(), GetServerCore(), request,
+                         &response)
+                .code());
+}
+
+TEST_P(PredictImplTest, PredictionSuccessWithTensorContent) {
+  PredictRequest request;
+  PredictResponse response;
+
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+  request.set_output_tensor_content(true);
+
+  TensorflowPredictor predictor(GetParam());
+  TF_EXPECT_OK(
+      predictor.Predict(GetRunOptions(), GetServerCore(), request, &response));
+  TensorProto output_tensor_proto;
+  test::AsScalar<float>(3).AsProtoTensorContent(&output_tensor_proto);
+  PredictResponse expected_response;
+  (*expected_response.mutable_outputs())[kOutputTensorKey] =
+      output_tensor_proto;
+  EXPECT_THAT(response, test_util::EqualsProto(expected_response));
+  EXPECT_TRUE(response.outputs().at(kOutputTensorKey).float_val().empty());
+}
+
 // Test querying a model with a named regression signature (not default). This
 // will work with SavedModel but not supported in the legacy SessionBundle.
 TEST_P(PredictImplTest, PredictionWithNamedRegressionSignature) {
@@ -0,0 +1,207 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
+
+#include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/contrib/session_bundle/signature.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Appends 'alias' to a comma-delimited list of aliases.
+void AppendAlias(const string& alias, string* aliases) {
+  if (!aliases->empty()) {
+    strings::StrAppend(aliases, ", ");
+  }
+  strings::StrAppend(aliases, alias);
+}
+
+}  // namespace
+
+Status PredictSignaturePlan::FromSignatureDef(
+    const SignatureDef& signature,
+    std::unique_ptr<PredictSignaturePlan>* plan) {
+  if (signature.method_name() != kPredictMethodName &&
+      signature.method_name() != kClassifyMethodName &&
+      signature.method_name() != kRegressMethodName) {
+    return errors::Internal(strings::StrCat(
+        "Expected prediction signature method_name to be one of {",
+        kPredictMethodName, ", ", kClassifyMethodName, ", ", kRegressMethodName,
+        "}. Was: ", signature.method_name()));
+  }
+  if (signature.inputs().empty()) {
+    return errors::Internal(strings::StrCat(
+        "Expected at least one input Tensor in prediction signature."));
+  }
+  if (signature.outputs().empty()) {
+    return errors::Internal(strings::StrCat(
+        "Expected at least one output Tensor in prediction signature."));
+  }
+
+  plan->reset(new PredictSignaturePlan);
+  for (const auto& input : signature.inputs()) {
+    Input plan_input;
+    plan_input.tensor_name = input.second.name();
+    plan_input.dtype = input.second.dtype();
+    if (input.second.has_tensor_shape()) {
+      plan_input.shape = PartialTensorShape(input.second.tensor_shape());
+    }
+    (*plan)->AddInput(input.first, std::move(plan_input));
+  }
+  for (const auto& output : signature.outputs()) {
+    (*plan)->AddOutput(output.first, output.second.name());
+  }
+  return Status::OK();
+}
+
+Status PredictSignaturePlan::FromGenericSignatures(
+    const GenericSignature& input_signature,
+    const GenericSignature& output_signature,
+    std::unique_ptr<PredictSignaturePlan>* plan) {
+  plan->reset(new PredictSignaturePlan);
+  for (const auto& input : input_signature.map()) {
+    Input plan_input;
+    plan_input.tensor_name = input.second.tensor_name();
+    (*plan)->AddInput(input.first, std::move(plan_input));
+  }
+  for (const auto& output : output_signature.map()) {
+    (*plan)->AddOutput(output.first, output.second.tensor_name());
+  }
+  return Status::OK();
+}
+
+const PredictSignaturePlan::Input* PredictSignaturePlan::FindInput(
+    const string& alias) const {
+  auto it = inputs_.find(alias);
+  return it == inputs_.end() ? nullptr : &it->second;
+}
+
+Status PredictSignaturePlan::CheckInputTensor(const string& alias,
+                                              const Input& input,
+                                              const Tensor& tensor) {
+  if (input.dtype != DT_INVALID && tensor.dtype() != input.dtype) {
+    return errors::InvalidArgument(
+        "input tensor ", alias, " has type ", DataTypeString(tensor.dtype()),
+        ", but the signature expects ", DataTypeString(input.dtype));
+  }
+  if (!input.shape.IsCompatibleWith(tensor.shape())) {
+    return errors::InvalidArgument(
+        "input tensor ", alias, " has shape ", tensor.shape().DebugString(),
+        ", but the signature expects ", input.shape.DebugString());
+  }
+  return Status::OK();
+}
+
+const PredictSignaturePlan::Output* PredictSignaturePlan::FindOutput(
+    const string& alias) const {
+  auto it = output_indices_.find(alias);
+  return it == output_indices_.end() ? nullptr : &outputs_[it->second];
+}
+
+void PredictSignaturePlan::AddInput(const string& alias, Input input) {
+  inputs_[alias] = std::move(input);
+  AppendAlias(alias, &input_aliases_);
+}
+
+void PredictSignaturePlan::AddOutput(const string& alias,
+                                     const string& tensor_name) {
+  output_indices_[alias] = outputs_.size();
+  outputs_.push_back({alias, tensor_name});
+  output_tensor_names_.push_back(tensor_name);
+  output_alias_list_.push_back(alias);
+  AppendAlias(alias, &output_aliases_);
+}
+
+void PredictSignaturePlan::CheckInputAliasing(const GraphDef& graph_def) {
+  alias_input_content_ = !RunMayRetainInputs(graph_def, output_tensor_names_);
+}
+
+constexpr char PredictSignaturePlans::kSessionBundlePredictSignature[];
+
+std::unique_ptr<PredictSignaturePlans> PredictSignaturePlans::FromSavedModel(
+    const MetaGraphDef& meta_graph_def) {
+  std::unique_ptr<PredictSignaturePlans> plans(new PredictSignaturePlans);
+  for (const auto& entry : meta_graph_def.signature_def()) {
+    std::unique_ptr<PredictSignaturePlan> plan;
+    if (PredictSignaturePlan::FromSignatureDef(entry.second, &plan).ok()) {
+      plan->CheckInputAliasing(meta_graph_def.graph_def());
+      plans->plans_[entry.first] = std::move(plan);
+    }
+  }
+  return plans;
+}
+
+std::unique_ptr<PredictSignaturePlans>
+PredictSignaturePlans::FromSessionBundle(const MetaGraphDef& meta_graph_def) {
+  std::unique_ptr<PredictSignaturePlans> plans(new PredictSignaturePlans);
+  Signature input_signature;
+  Signature output_signature;
+  if (GetNamedSignature("inputs", meta_graph_def, &input_signature).ok() &&
+      input_signature.has_generic_signature() &&
+      GetNamedSignature("outputs", meta_graph_def, &output_signature).ok() &&
+      output_signature.has_generic_signature()) {
+    std::unique_ptr<PredictSignaturePlan> plan;
+    if (PredictSignaturePlan::FromGenericSignatures(
+            input_signature.generic_signature(),
+            output_signature.generic_signature(), &plan)
+            .ok()) {
+      plan->CheckInputAliasing(meta_graph_def.graph_def());
+      plans->plans_[kSessionBundlePredictSignature] = std::move(plan);
+    }
+  }
+  return plans;
+}
+
+const PredictSignaturePlan* PredictSignaturePlans::Find(
+    const string& signature_name) const {
+  auto it = plans_.find(signature_name);
+  return it == plans_.end() ? nullptr : it->second.get();
+}
+
+PredictSignaturePlanTable* PredictSignaturePlanTable::Global() {
+  static PredictSignaturePlanTable* const table = new PredictSignaturePlanTable;
+  return table;
+}
+
+void PredictSignaturePlanTable::Add(const void* bundle,
+                                    const PredictSignaturePlans* plans) {
+  mutex_lock l(update_mu_);
+  std::unique_ptr<PlanMap> new_plans(new PlanMap(*plans_.get()));
+  (*new_plans)[bundle] = plans;
+  plans_.Update(std::move(new_plans));
+}
+
+void PredictSignaturePlanTable::Remove(const void* bundle) {
+  mutex_lock l(update_mu_);
+  std::unique_ptr<PlanMap> new_plans(new PlanMap(*plans_.get()));
+  new_plans->erase(bundle);
+  plans_.Update(std::move(new_plans));
+}
+
+const PredictSignaturePlans* PredictSignaturePlanTable::Find(
+    const void* bundle) const {
+  const RcuDynamicPtr<PlanMap>::ReadPtr plans = plans_.get();
+  auto it = plans->find(bundle);
+  return it == plans->end() ? nullptr : it->second;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,255 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_SIGNATURE_PLAN_H_
+#define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_SIGNATURE_PLAN_H_
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/contrib/session_bundle/manifest.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow_serving/core/loader.h"
+#include "tensorflow_serving/resources/resources.pb.h"
+#include "tensorflow_serving/util/any_ptr.h"
+#include "tensorflow_serving/util/rcu_dynamic_ptr.h"
+
+namespace tensorflow {
+namespace serving {
+
+// How Predict requests for one signature of a servable map onto a
+// Session::Run() call: the tensor names behind the input and output aliases,
+// the dtype and shape each input must have, and the tensors to fetch when the
+// request has no output filter.
+//
+// Plans are built once when the servable is loaded (see
+// PredictSignaturePlanLoader), so that requests validate and route their
+// tensors with hash lookups rather than by copying and walking the signature
+// protos.
+class PredictSignaturePlan {
+ public:
+  struct Input {
+    string tensor_name;
+    // DT_INVALID if the signature doesn't constrain the dtype, as generic
+    // signatures don't.
+    DataType dtype = DT_INVALID;
+    // Of unknown rank if the signature doesn't constrain the shape.
+    PartialTensorShape shape;
+  };
+
+  struct Output {
+    string alias;
+    string tensor_name;
+  };
+
+  // Builds the plan of a SavedModel SignatureDef. Fails if the signature can't
+  // serve Predict requests.
+  static Status FromSignatureDef(const SignatureDef& signature,
+                                 std::unique_ptr<PredictSignaturePlan>* plan);
+
+  // Builds the plan of the "inputs" and "outputs" generic signatures of a
+  // SessionBundle.
+  static Status FromGenericSignatures(
+      const GenericSignature& input_signature,
+      const GenericSignature& output_signature,
+      std::unique_ptr<PredictSignaturePlan>* plan);
+
+  // Returns the input with 'alias', or nullptr if the signature has no such
+  // input.
+  const Input* FindInput(const string& alias) const;
+
+  // Checks that 'tensor', fed as input 'input', has the dtype and shape the
+  // signature declares.
+  static Status CheckInputTensor(const string& alias, const Input& input,
+                                 const Tensor& tensor);
+
+  // Returns the output with 'alias', or nullptr if the signature has no such
+  // output.
+  const Output* FindOutput(const string& alias) const;
+
+  int num_inputs() const { return inputs_.size(); }
+
+  // All the outputs of the signature, in the order they are fetched when the
+  // request has no output filter.
+  const std::vector<Output>& outputs() const { return outputs_; }
+
+  // The tensor names and aliases of outputs(), as passed to Session::Run()
+  // and used to fill the response when the request has no output filter.
+  const std::vector<string>& output_tensor_names() const {
+    return output_tensor_names_;
+  }
+  const std::vector<string>& output_alias_list() const {
+    return output_alias_list_;
+  }
+
+  // The input and output aliases as comma-delimited lists, for error
+  // messages.
+  const string& input_aliases() const { return input_aliases_; }
+  const string& output_aliases() const { return output_aliases_; }
+
+  // Whether the inputs of a request may alias its tensor_content (see
+  // TensorFromProtoAliasingContent()), which is only the case if the plan was
+  // built along with the servable's graph, and fetching the outputs is known
+  // not to keep the inputs (see RunMayRetainInputs()).
+  bool alias_input_content() const { return alias_input_content_; }
+
+ private:
+  friend class PredictSignaturePlans;
+
+  PredictSignaturePlan() = default;
+
+  // Sets 'alias_input_content_' from the graph the plan runs.
+  void CheckInputAliasing(const GraphDef& graph_def);
+
+  void AddInput(const string& alias, Input input);
+  void AddOutput(const string& alias, const string& tensor_name);
+
+  std::unordered_map<string, Input> inputs_;
+  std::vector<Output> outputs_;
+  std::vector<string> output_tensor_names_;
+  std::vector<string> output_alias_list_;
+  // The index in 'outputs_' of each output alias.
+  std::unordered_map<string, int> output_indices_;
+  string input_aliases_;
+  string output_aliases_;
+  bool alias_input_content_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictSignaturePlan);
+};
+
+// The PredictSignaturePlans of a servable, by signature name. A SessionBundle
+// has a single plan, named "" (see kSessionBundlePredictSignature).
+class PredictSignaturePlans {
+ public:
+  // The name of the plan of a SessionBundle.
+  static constexpr char kSessionBundlePredictSignature[] = "";
+
+  // Builds the plans of the signatures of 'meta_graph_def' which can serve
+  // Predict requests. Other signatures are left out.
+  static std::unique_ptr<PredictSignaturePlans> FromSavedModel(
+      const MetaGraphDef& meta_graph_def);
+
+  // Builds the plan of a SessionBundle, if its generic signatures allow.
+  static std::unique_ptr<PredictSignaturePlans> FromSessionBundle(
+      const MetaGraphDef& meta_graph_def);
+
+  // Returns the plan of 'signature_name', or nullptr.
+  const PredictSignaturePlan* Find(const string& signature_name) const;
+
+ private:
+  PredictSignaturePlans() = default;
+
+  std::unordered_map<string, std::unique_ptr<const PredictSignaturePlan>>
+      plans_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictSignaturePlans);
+};
+
+// The PredictSignaturePlans of the loaded servables, by the address of their
+// bundle (a SavedModelBundle or SessionBundle), where Predict finds them from
+// a servable handle. Plans are added when a bundle is loaded and removed when
+// it is unloaded, by PredictSignaturePlanLoader.
+//
+// The plans live beside the bundles rather than in them, since handles to the
+// bundles are typed as the plain SavedModelBundle and SessionBundle throughout
+// the servers and their clients. Find() is read on every Predict, so it is
+// lock-free; Add() and Remove() only happen as servables load and unload.
+class PredictSignaturePlanTable {
+ public:
+  PredictSignaturePlanTable() = default;
+
+  // The table the servables of the process register their plans in.
+  static PredictSignaturePlanTable* Global();
+
+  // Adds the plans of 'bundle', which must outlive their entry.
+  void Add(const void* bundle, const PredictSignaturePlans* plans);
+
+  void Remove(const void* bundle);
+
+  // Returns the plans of 'bundle', or nullptr. They stay valid as long as the
+  // caller holds a handle to 'bundle', which keeps it from being unloaded.
+  const PredictSignaturePlans* Find(const void* bundle) const;
+
+ private:
+  using PlanMap =
+      std::unordered_map<const void*, const PredictSignaturePlans*>;
+
+  // Serializes Add() and Remove().
+  mutex update_mu_;
+  RcuDynamicPtr<PlanMap> plans_{std::unique_ptr<PlanMap>(new PlanMap)};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictSignaturePlanTable);
+};
+
+// A Loader which loads a bundle (a SavedModelBundle or SessionBundle) with
+// another Loader, and keeps the PredictSignaturePlans of the bundle in
+// PredictSignaturePlanTable::Global() while it is loaded, so that they are
+// built once per servable.
+template <typename BundleType>
+class PredictSignaturePlanLoader : public Loader {
+ public:
+  // Builds the plans of a bundle, e.g. PredictSignaturePlans::FromSavedModel.
+  using PlanBuilder =
+      std::unique_ptr<PredictSignaturePlans> (*)(const MetaGraphDef&);
+
+  PredictSignaturePlanLoader(std::unique_ptr<Loader> bundle_loader,
+                             PlanBuilder build_plans)
+      : bundle_loader_(std::move(bundle_loader)), build_plans_(build_plans) {}
+
+  ~PredictSignaturePlanLoader() override = default;
+
+  Status EstimateResources(ResourceAllocation* estimate) const override {
+    return bundle_loader_->EstimateResources(estimate);
+  }
+
+  Status Load() override {
+    TF_RETURN_IF_ERROR(bundle_loader_->Load());
+    const BundleType* bundle = bundle_loader_->servable().get<BundleType>();
+    plans_ = build_plans_(bundle->meta_graph_def);
+    PredictSignaturePlanTable::Global()->Add(bundle, plans_.get());
+    return Status::OK();
+  }
+
+  void Unload() override {
+    PredictSignaturePlanTable::Global()->Remove(
+        bundle_loader_->servable().get<BundleType>());
+    bundle_loader_->Unload();
+    plans_.reset();
+  }
+
+  AnyPtr servable() override { return bundle_loader_->servable(); }
+
+ private:
+  const std::unique_ptr<Loader> bundle_loader_;
+  const PlanBuilder build_plans_;
+  std::unique_ptr<PredictSignaturePlans> plans_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictSignaturePlanLoader);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_SIGNATURE_PLAN_H_
@@ -0,0 +1,277 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/contrib/session_bundle/signature.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow_serving/core/test_util/mock_loader.h"
+#include "tensorflow_serving/test_util/test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+// Returns a SignatureDef with 'method_name', mapping each alias "<name>" to
+// the tensor "<name>:0".
+SignatureDef CreateSignatureDef(const string& method_name,
+                                const std::vector<string>& input_aliases,
+                                const std::vector<string>& output_aliases) {
+  SignatureDef signature;
+  signature.set_method_name(method_name);
+  for (const string& alias : input_aliases) {
+    (*signature.mutable_inputs())[alias].set_name(alias + ":0");
+  }
+  for (const string& alias : output_aliases) {
+    (*signature.mutable_outputs())[alias].set_name(alias + ":0");
+  }
+  return signature;
+}
+
+TEST(PredictSignaturePlanTest, FromSignatureDef) {
+  std::unique_ptr<PredictSignaturePlan> plan;
+  TF_ASSERT_OK(PredictSignaturePlan::FromSignatureDef(
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"}), &plan));
+
+  EXPECT_EQ(1, plan->num_inputs());
+  ASSERT_NE(nullptr, plan->FindInput("x"));
+  EXPECT_EQ("x:0", plan->FindInput("x")->tensor_name);
+  EXPECT_EQ(nullptr, plan->FindInput("y"));
+  ASSERT_NE(nullptr, plan->FindOutput("y"));
+  EXPECT_EQ("y:0", plan->FindOutput("y")->tensor_name);
+  EXPECT_EQ(nullptr, plan->FindOutput("x"));
+  EXPECT_THAT(plan->outputs(),
+              ElementsAre(Field(&PredictSignaturePlan::Output::alias, "y")));
+  EXPECT_THAT(plan->output_tensor_names(), ElementsAre("y:0"));
+  EXPECT_THAT(plan->output_alias_list(), ElementsAre("y"));
+  EXPECT_EQ("x", plan->input_aliases());
+  EXPECT_EQ("y", plan->output_aliases());
+}
+
+TEST(PredictSignaturePlanTest, ChecksInputDtypeAndShape) {
+  SignatureDef signature = CreateSignatureDef(kPredictMethodName, {"x"}, {"y"});
+  TensorInfo* x_info = &(*signature.mutable_inputs())["x"];
+  x_info->set_dtype(DT_FLOAT);
+  x_info->mutable_tensor_shape()->add_dim()->set_size(-1);
+  x_info->mutable_tensor_shape()->add_dim()->set_size(2);
+  std::unique_ptr<PredictSignaturePlan> plan;
+  TF_ASSERT_OK(PredictSignaturePlan::FromSignatureDef(signature, &plan));
+  const PredictSignaturePlan::Input* x = plan->FindInput("x");
+  ASSERT_NE(nullptr, x);
+  EXPECT_EQ(DT_FLOAT, x->dtype);
+
+  TF_EXPECT_OK(PredictSignaturePlan::CheckInputTensor(
+      "x", *x, Tensor(DT_FLOAT, TensorShape({3, 2}))));
+  const Status wrong_dtype = PredictSignaturePlan::CheckInputTensor(
+      "x", *x, Tensor(DT_INT32, TensorShape({3, 2})));
+  EXPECT_EQ(error::INVALID_ARGUMENT, wrong_dtype.code());
+  EXPECT_THAT(wrong_dtype.error_message(), HasSubstr("int32"));
+  const Status wrong_shape = PredictSignaturePlan::CheckInputTensor(
+      "x", *x, Tensor(DT_FLOAT, TensorShape({3, 3})));
+  EXPECT_EQ(error::INVALID_ARGUMENT, wrong_shape.code());
+  EXPECT_THAT(wrong_shape.error_message(), HasSubstr("[3,3]"));
+}
+
+TEST(PredictSignaturePlanTest, UnconstrainedInputAcceptsAnyTensor) {
+  std::unique_ptr<PredictSignaturePlan> plan;
+  TF_ASSERT_OK(PredictSignaturePlan::FromSignatureDef(
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"}), &plan));
+  const PredictSignaturePlan::Input* x = plan->FindInput("x");
+  ASSERT_NE(nullptr, x);
+  TF_EXPECT_OK(PredictSignaturePlan::CheckInputTensor(
+      "x", *x, Tensor(DT_STRING, TensorShape({4, 5, 6}))));
+}
+
+TEST(PredictSignaturePlanTest, FromSignatureDefWithWrongMethodName) {
+  std::unique_ptr<PredictSignaturePlan> plan;
+  const Status status = PredictSignaturePlan::FromSignatureDef(
+      CreateSignatureDef("foo", {"x"}, {"y"}), &plan);
+  ASSERT_FALSE(status.ok());
+  EXPECT_THAT(status.error_message(), HasSubstr("method_name"));
+}
+
+TEST(PredictSignaturePlanTest, FromSignatureDefWithoutOutputs) {
+  std::unique_ptr<PredictSignaturePlan> plan;
+  EXPECT_FALSE(PredictSignaturePlan::FromSignatureDef(
+                   CreateSignatureDef(kPredictMethodName, {"x"}, {}), &plan)
+                   .ok());
+}
+
+TEST(PredictSignaturePlanTest, FromGenericSignatures) {
+  GenericSignature input_signature;
+  (*input_signature.mutable_map())["x"].set_tensor_name("x:0");
+  GenericSignature output_signature;
+  (*output_signature.mutable_map())["y"].set_tensor_name("y:0");
+  (*output_signature.mutable_map())["z"].set_tensor_name("z:0");
+
+  std::unique_ptr<PredictSignaturePlan> plan;
+  TF_ASSERT_OK(PredictSignaturePlan::FromGenericSignatures(
+      input_signature, output_signature, &plan));
+  EXPECT_EQ(1, plan->num_inputs());
+  EXPECT_EQ("x:0", plan->FindInput("x")->tensor_name);
+  EXPECT_EQ(DT_INVALID, plan->FindInput("x")->dtype);
+  EXPECT_EQ("z:0", plan->FindOutput("z")->tensor_name);
+  EXPECT_EQ(2, plan->outputs().size());
+  EXPECT_EQ(2, plan->output_tensor_names().size());
+}
+
+TEST(PredictSignaturePlansTest, FromSavedModelSkipsIncompatibleSignatures) {
+  MetaGraphDef meta_graph_def;
+  (*meta_graph_def.mutable_signature_def())["predict"] =
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"});
+  (*meta_graph_def.mutable_signature_def())["broken"] =
+      CreateSignatureDef("foo", {"x"}, {"y"});
+
+  std::unique_ptr<PredictSignaturePlans> plans =
+      PredictSignaturePlans::FromSavedModel(meta_graph_def);
+  EXPECT_NE(nullptr, plans->Find("predict"));
+  EXPECT_EQ(nullptr, plans->Find("broken"));
+  EXPECT_EQ(nullptr, plans->Find("missing"));
+}
+
+TEST(PredictSignaturePlansTest, FromSavedModelChecksInputAliasing) {
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = test_util::CreateProto<GraphDef>(
+      "node { name: 'x' op: 'Placeholder' attr { key: 'dtype' "
+      "                                          value { type: DT_FLOAT } } } "
+      "node { name: 'y' op: 'Identity' input: 'x' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } "
+      "node { name: 'v' op: 'VariableV2' "
+      "       attr { key: 'dtype' value { type: DT_FLOAT } } "
+      "       attr { key: 'shape' value { shape { } } } } "
+      "node { name: 'z' op: 'Assign' input: 'v' input: 'x' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } ");
+  (*meta_graph_def.mutable_signature_def())["stateless"] =
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"});
+  (*meta_graph_def.mutable_signature_def())["assigning"] =
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"z"});
+
+  std::unique_ptr<PredictSignaturePlans> plans =
+      PredictSignaturePlans::FromSavedModel(meta_graph_def);
+  ASSERT_NE(nullptr, plans->Find("stateless"));
+  EXPECT_TRUE(plans->Find("stateless")->alias_input_content());
+  ASSERT_NE(nullptr, plans->Find("assigning"));
+  EXPECT_FALSE(plans->Find("assigning")->alias_input_content());
+
+  // Without the graph, nothing is known about the run.
+  std::unique_ptr<PredictSignaturePlan> plan;
+  TF_ASSERT_OK(PredictSignaturePlan::FromSignatureDef(
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"}), &plan));
+  EXPECT_FALSE(plan->alias_input_content());
+}
+
+TEST(PredictSignaturePlansTest, FromSessionBundle) {
+  Signatures signatures;
+  (*(*signatures.mutable_named_signatures())["inputs"]
+        .mutable_generic_signature()
+        ->mutable_map())["x"]
+      .set_tensor_name("x:0");
+  (*(*signatures.mutable_named_signatures())["outputs"]
+        .mutable_generic_signature()
+        ->mutable_map())["y"]
+      .set_tensor_name("y:0");
+  MetaGraphDef meta_graph_def;
+  TF_ASSERT_OK(SetSignatures(signatures, &meta_graph_def));
+
+  std::unique_ptr<PredictSignaturePlans> plans =
+      PredictSignaturePlans::FromSessionBundle(meta_graph_def);
+  const PredictSignaturePlan* plan =
+      plans->Find(PredictSignaturePlans::kSessionBundlePredictSignature);
+  ASSERT_NE(nullptr, plan);
+  EXPECT_EQ("x:0", plan->FindInput("x")->tensor_name);
+  EXPECT_EQ("y:0", plan->FindOutput("y")->tensor_name);
+}
+
+TEST(PredictSignaturePlansTest, FromSessionBundleWithoutGenericSignatures) {
+  std::unique_ptr<PredictSignaturePlans> plans =
+      PredictSignaturePlans::FromSessionBundle(MetaGraphDef());
+  EXPECT_EQ(nullptr,
+            plans->Find(PredictSignaturePlans::kSessionBundlePredictSignature));
+}
+
+TEST(PredictSignaturePlanTableTest, AddFindRemove) {
+  MetaGraphDef meta_graph_def;
+  (*meta_graph_def.mutable_signature_def())["predict"] =
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"});
+  std::unique_ptr<PredictSignaturePlans> plans =
+      PredictSignaturePlans::FromSavedModel(meta_graph_def);
+  const int bundle = 0;
+  const int other_bundle = 0;
+
+  PredictSignaturePlanTable table;
+  EXPECT_EQ(nullptr, table.Find(&bundle));
+  table.Add(&bundle, plans.get());
+  EXPECT_EQ(plans.get(), table.Find(&bundle));
+  EXPECT_EQ(nullptr, table.Find(&other_bundle));
+  table.Remove(&bundle);
+  EXPECT_EQ(nullptr, table.Find(&bundle));
+}
+
+// Stands in for a SavedModelBundle or SessionBundle.
+struct FakeBundle {
+  MetaGraphDef meta_graph_def;
+};
+
+TEST(PredictSignaturePlanLoaderTest, KeepsPlansWhileLoaded) {
+  FakeBundle bundle;
+  (*bundle.meta_graph_def.mutable_signature_def())["predict"] =
+      CreateSignatureDef(kPredictMethodName, {"x"}, {"y"});
+  test_util::MockLoader* bundle_loader = new NiceMock<test_util::MockLoader>;
+  ON_CALL(*bundle_loader, servable()).WillByDefault(Return(AnyPtr(&bundle)));
+  PredictSignaturePlanLoader<FakeBundle> loader(
+      std::unique_ptr<Loader>(bundle_loader),
+      PredictSignaturePlans::FromSavedModel);
+
+  EXPECT_CALL(*bundle_loader, Load()).WillOnce(Return(Status::OK()));
+  TF_ASSERT_OK(loader.Load());
+  const PredictSignaturePlans* plans =
+      PredictSignaturePlanTable::Global()->Find(&bundle);
+  ASSERT_NE(nullptr, plans);
+  EXPECT_NE(nullptr, plans->Find("predict"));
+  EXPECT_EQ(&bundle, loader.servable().get<FakeBundle>());
+
+  EXPECT_CALL(*bundle_loader, Unload());
+  loader.Unload();
+  EXPECT_EQ(nullptr, PredictSignaturePlanTable::Global()->Find(&bundle));
+}
+
+TEST(PredictSignaturePlanLoaderTest, LoadError) {
+  FakeBundle bundle;
+  test_util::MockLoader* bundle_loader = new NiceMock<test_util::MockLoader>;
+  ON_CALL(*bundle_loader, servable()).WillByDefault(Return(AnyPtr(&bundle)));
+  PredictSignaturePlanLoader<FakeBundle> loader(
+      std::unique_ptr<Loader>(bundle_loader),
+      PredictSignaturePlans::FromSavedModel);
+
+  EXPECT_CALL(*bundle_loader, Load())
+      .WillOnce(Return(errors::Unknown("load failed")));
+  EXPECT_FALSE(loader.Load().ok());
+  EXPECT_EQ(nullptr, PredictSignaturePlanTable::Global()->Find(&bundle));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -15,16 +15,74 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/regression_service.h"
 
+#include <memory>
+
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
 #include "tensorflow/contrib/session_bundle/signature.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow_serving/apis/regressor.h"
+#include "tensorflow_serving/core/request_context.h"
 #include "tensorflow_serving/core/servable_handle.h"
+#include "tensorflow_serving/servables/tensorflow/coalesced_inference.h"
+#include "tensorflow_serving/servables/tensorflow/one_shot_inference.h"
 #include "tensorflow_serving/servables/tensorflow/regressor.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
+#include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
 namespace serving {
+namespace {
+
+// Serves a Regress request whose ModelSpec has been validated.
+Status RegressWithServerCore(const RunOptions& run_options, ServerCore* core,
+                             const RegressionRequest& request,
+                             RegressionResponse* response,
+                             RequestContext* context) {
+  ServableHandle<SavedModelBundle> saved_model_bundle;
+  {
+    RequestTiming::ScopedPhase handle_phase(RequestPhase::kHandleAcquisition);
+    TF_RETURN_IF_ERROR(
+        core->GetServableHandle(request.model_spec(), &saved_model_bundle));
+  }
+  context->set_model_version(saved_model_bundle.id().version);
+  SignatureDef signature;
+  TF_RETURN_IF_ERROR(GetRegressionSignatureDef(
+      request.model_spec(), saved_model_bundle->meta_graph_def, &signature));
+
+  std::unique_ptr<RegressorInterface> regressor_interface;
+  TF_RETURN_IF_ERROR(CreateFlyweightTensorFlowRegressor(
+      run_options, saved_model_bundle->session.get(), &signature,
+      &regressor_interface));
+  // Run regression, unless an identical request is already running.
+  return RunCoalescedInference(
+      core, "Regress", saved_model_bundle.id(), request,
+      nullopt /* cache_key */, response, [&]() {
+        return regressor_interface->Regress(request,
+                                            response->mutable_result());
+      });
+}
+
+// Fills 'response' from the outputs of the session run of
+// RunOneShotInferenceAsync().
+Status PostProcessRegressionResponse(
+    const SignatureDef& signature, int num_examples,
+    const std::vector<string>& output_tensor_names,
+    const std::vector<Tensor>& output_tensors,
+    const RegressionRequest& request, RegressionResponse* response) {
+  TRACELITERAL("ConvertToRegressionResult");
+  return PostProcessRegressionResult(signature, num_examples,
+                                     output_tensor_names, output_tensors,
+                                     response->mutable_result());
+}
+
+const OneShotInferenceMethod<RegressionRequest, RegressionResponse>
+    kRegressMethod = {"Regress", false /* use_result_cache */,
+                      GetRegressionSignatureDef, PreProcessRegression,
+                      PostProcessRegressionResponse};
+
+}  // namespace
 
 Status TensorflowRegressionServiceImpl::Regress(
     const RunOptions& run_options, ServerCore* core,
@@ -36,19 +94,25 @@ Status TensorflowRegressionServiceImpl::Regress(
                               "Missing ModelSpec");
   }
 
-  ServableHandle<SavedModelBundle> saved_model_bundle;
-  TF_RETURN_IF_ERROR(
-      core->GetServableHandle(request.model_spec(), &saved_model_bundle));
-  SignatureDef signature;
-  TF_RETURN_IF_ERROR(GetRegressionSignatureDef(
-      request.model_spec(), saved_model_bundle->meta_graph_def, &signature));
+  RequestContext context;
+  RequestTiming::ScopedCurrent scoped_timing(context.mutable_timing());
+  const uint64 start_time = Env::Default()->NowMicros();
+  const Status status =
+      RegressWithServerCore(run_options, core, request, response, &context);
+  const uint64 end_time = Env::Default()->NowMicros();
+  core->RecordRequestPhases("Regress", request.model_spec(), context,
+                            end_time > start_time ? end_time - start_time : 0,
+                            status);
+  return status;
+}
 
-  std::unique_ptr<RegressorInterface> regressor_interface;
-  TF_RETURN_IF_ERROR(CreateFlyweightTensorFlowRegressor(
-      run_options, saved_model_bundle->session.get(), &signature,
-      &regressor_interface));
-  // Run regression
-  return regressor_interface->Regress(request, response->mutable_result());
+void TensorflowRegressionServiceImpl::RegressAsync(
+    const RunOptions& run_options, ServerCore* core, Executor* executor,
+    const RegressionRequest& request, RegressionResponse* response,
+    std::function<void(const Status&)> done) {
+  TRACELITERAL("TensorflowRegressionServiceImpl::RegressAsync");
+  RunOneShotInferenceAsync(kRegressMethod, run_options, core, executor,
+                           request, response, std::move(done));
 }
 
 }  // namespace serving
@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_REGRESSION_SERVICE_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_REGRESSION_SERVICE_H_
 
+#include <functional>
+
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow_serving/apis/regression.pb.h"
 #include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/util/executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -31,6 +34,17 @@ class TensorflowRegressionServiceImpl final {
   static Status Regress(const RunOptions& run_options, ServerCore* core,
                         const RegressionRequest& request,
                         RegressionResponse* response);
+
+  // Like Regress(), but calls 'done' with the outcome rather than returning it,
+  // possibly from another thread once the session run completes (see
+  // ServingSession::RunAsync()). The rest of the request after the session
+  // run, including 'done', runs on 'executor'. 'request' and 'response' must
+  // outlive the call to 'done'.
+  static void RegressAsync(const RunOptions& run_options, ServerCore* core,
+                           Executor* executor,
+                           const RegressionRequest& request,
+                           RegressionResponse* response,
+                           std::function<void(const Status&)> done);
 };
 
 }  // namespace serving
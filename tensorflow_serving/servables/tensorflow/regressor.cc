@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow_serving/apis/model.pb.h"
 #include "tensorflow_serving/apis/regression.pb.h"
 #include "tensorflow_serving/apis/regressor.h"
+#include "tensorflow_serving/core/request_timing.h"
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
 namespace tensorflow {
@@ -69,8 +70,11 @@ class TensorFlowRegressor : public RegressorInterface {
 
     TRACELITERAL("RunRegression");
     Tensor output;
-    TF_RETURN_IF_ERROR(
-        RunRegression(*signature_, input_tensor, session_, &output));
+    {
+      RequestTiming::ScopedPhase session_run_phase(RequestPhase::kSessionRun);
+      TF_RETURN_IF_ERROR(
+          RunRegression(*signature_, input_tensor, session_, &output));
+    }
 
     if (output.dtype() != DT_FLOAT) {
       return errors::Internal("Expected output Tensor of DT_FLOAT.  Got: ",
@@ -83,6 +87,7 @@ class TensorFlowRegressor : public RegressorInterface {
     }
 
     TRACELITERAL("ConvertToRegressionResult");
+    RequestTiming::ScopedPhase encoding_phase(RequestPhase::kResponseEncoding);
     for (int i = 0; i < num_examples; ++i) {
       result->add_regressions()->set_value(output.flat<float>()(i));
     }
@@ -118,8 +123,9 @@ class SavedModelTensorFlowRegressor : public RegressorInterface {
     std::vector<Tensor> outputs;
     int num_examples;
     TF_RETURN_IF_ERROR(PerformOneShotTensorComputation(
-        run_options_, request.input(), input_tensor_name, output_tensor_names,
-        session_, &outputs, &num_examples));
+        run_options_, request.input(), input_tensor_name,
+        GetSharedContextTensorName(*signature_), output_tensor_names, session_,
+        &outputs, &num_examples));
 
     TRACELITERAL("ConvertToRegressionResult");
     return PostProcessRegressionResult(*signature_, num_examples,
@@ -242,7 +248,10 @@ Status PreProcessRegression(const SignatureDef& signature,
         "Expected regression signature method_name to be ", kRegressMethodName,
         ". Was: ", signature.method_name()));
   }
-  if (signature.inputs().size() != 1) {
+  // Besides the examples, the signature may take the shared context.
+  if (signature.inputs().size() -
+          signature.inputs().count(kSharedContextInputs) !=
+      1) {
     return errors::InvalidArgument(
         strings::StrCat("Expected one input Tensor."));
   }
@@ -273,6 +282,7 @@ Status PostProcessRegressionResult(
     const SignatureDef& signature, int num_examples,
     const std::vector<string>& output_tensor_names,
     const std::vector<Tensor>& output_tensors, RegressionResult* result) {
+  RequestTiming::ScopedPhase encoding_phase(RequestPhase::kResponseEncoding);
   if (output_tensors.size() != output_tensor_names.size()) {
     return errors::InvalidArgument(
         "Expected output_tensors and output_tensor_names to have the same "
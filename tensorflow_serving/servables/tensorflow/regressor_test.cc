@@ -21,6 +21,8 @@ limitations under the License.
 #include <vector>
 
 #include "google/protobuf/map.h"
+#include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/contrib/batching/basic_batch_scheduler.h"
 #include "tensorflow/contrib/session_bundle/bundle_shim.h"
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
 #include "tensorflow/core/example/example.pb.h"
@@ -34,7 +36,9 @@ limitations under the License.
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
 #include "tensorflow_serving/apis/regression.pb.h"
+#include "tensorflow_serving/batching/batching_session.h"
 #include "tensorflow_serving/core/test_util/mock_session.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/test_util/test_util.h"
 #include "tensorflow_serving/util/optional.h"
 
@@ -47,6 +51,7 @@ using test_util::EqualsProto;
 using test_util::MockSession;
 
 const char kInputTensor[] = "input:0";
+const char kContextTensor[] = "context:0";
 const char kOutputTensor[] = "output:0";
 const char kOutputPlusOneTensor[] = "outputPlusOne:0";
 const char kImproperlySizedOutputTensor[] = "ImproperlySizedOutput:0";
@@ -99,27 +104,39 @@ class FakeSession : public tensorflow::Session {
     if (expected_timeout_) {
       CHECK_EQ(*expected_timeout_, run_options.timeout_in_ms());
     }
-    if (inputs.size() != 1 || inputs[0].first != kInputTensor) {
+    const Tensor* input = nullptr;
+    string context;
+    for (const auto& entry : inputs) {
+      if (entry.first == kInputTensor) {
+        input = &entry.second;
+      } else if (entry.first == kContextTensor) {
+        context = entry.second.scalar<string>()();
+      } else {
+        return errors::Internal("Unexpected input Tensor: ", entry.first);
+      }
+    }
+    if (input == nullptr) {
       return errors::Internal("Expected one input Tensor.");
     }
-    const Tensor& input = inputs[0].second;
     std::vector<Example> examples;
-    TF_RETURN_IF_ERROR(GetExamples(input, &examples));
+    TF_RETURN_IF_ERROR(GetExamples(*input, context, &examples));
     Tensor output;
     TF_RETURN_IF_ERROR(GetOutputTensor(examples, output_names[0], &output));
     outputs->push_back(output);
     return Status::OK();
   }
 
-  // Parses TensorFlow Examples from a string Tensor.
-  static Status GetExamples(const Tensor& input,
+  // Parses TensorFlow Examples from a string Tensor, each merged into the
+  // serialized shared 'context', with the example's features taking
+  // precedence.
+  static Status GetExamples(const Tensor& input, const string& context,
                             std::vector<Example>* examples) {
     examples->clear();
     const int batch_size = input.dim_size(0);
     const auto& flat_input = input.flat<string>();
     for (int i = 0; i < batch_size; ++i) {
       Example example;
-      if (!example.ParseFromString(flat_input(i))) {
+      if (!example.ParseFromString(context + flat_input(i))) {
         return errors::Internal("failed to parse example");
       }
       examples->push_back(example);
@@ -261,6 +278,40 @@ class RegressorTest : public ::testing::TestWithParam<bool> {
     }
   }
 
+  // Like Create() with a SavedModel, whose default signature also takes the
+  // shared context of the examples (see kSharedContextInputs). Runs the
+  // session through a BatchingSession if 'batching' is set.
+  Status CreateWithSharedContext(bool batching) {
+    std::unique_ptr<SavedModelBundle> saved_model(new SavedModelBundle);
+    TF_CHECK_OK(internal::ConvertSessionBundleToSavedModelBundle(
+        *bundle_, saved_model.get()));
+    SignatureDef& signature =
+        (*saved_model->meta_graph_def.mutable_signature_def())
+            [kDefaultServingSignatureDefKey];
+    (*signature.mutable_inputs())[kSharedContextInputs].set_name(
+        kContextTensor);
+    if (batching) {
+      BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+      schedule_options.num_batch_threads = 1;
+      TF_RETURN_IF_ERROR(CreateBasicBatchingSession(
+          schedule_options, BatchingSessionOptions(),
+          TensorSignatureFromSignatureDef(signature),
+          std::move(saved_model->session), &saved_model->session));
+    }
+    return CreateRegressorFromSavedModelBundle(
+        GetRunOptions(), std::move(saved_model), &regressor_);
+  }
+
+  // Adds a context with output 3 and two examples to 'request_': an empty
+  // one, and one with output 5, which takes precedence over the context's.
+  void AddSharedContextExamples() {
+    auto* list_with_context =
+        request_.mutable_input()->mutable_example_list_with_context();
+    *list_with_context->mutable_context() = example_with_output(3.0);
+    list_with_context->add_examples();
+    *list_with_context->add_examples() = example_with_output(5.0);
+  }
+
   // Variables used to create the regression model
   tensorflow::MetaGraphDef* meta_graph_def_;
   FakeSession* fake_session_;
@@ -314,6 +365,38 @@ TEST_P(RegressorTest, BasicExampleListWithContext) {
                                    " } "));
 }
 
+TEST_P(RegressorTest, SharedContextInput) {
+  if (!GetParam()) {
+    // SessionBundle signatures don't take a shared context.
+    return;
+  }
+  TF_ASSERT_OK(CreateWithSharedContext(false /* batching */));
+  AddSharedContextExamples();
+  TF_ASSERT_OK(regressor_->Regress(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(" regressions { "
+                                   "   value: 3.0 "
+                                   " } "
+                                   " regressions { "
+                                   "   value: 5.0 "
+                                   " } "));
+}
+
+TEST_P(RegressorTest, SharedContextInputWithBatching) {
+  if (!GetParam()) {
+    // SessionBundle signatures don't take a shared context.
+    return;
+  }
+  TF_ASSERT_OK(CreateWithSharedContext(true /* batching */));
+  AddSharedContextExamples();
+  TF_ASSERT_OK(regressor_->Regress(request_, &result_));
+  EXPECT_THAT(result_, EqualsProto(" regressions { "
+                                   "   value: 3.0 "
+                                   " } "
+                                   " regressions { "
+                                   "   value: 5.0 "
+                                   " } "));
+}
+
 TEST_P(RegressorTest, ValidNamedSignature) {
   TF_ASSERT_OK(Create());
   request_.mutable_model_spec()->set_signature_name(kOutputPlusOneSignature);
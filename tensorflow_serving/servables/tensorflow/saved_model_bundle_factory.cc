@@ -105,11 +105,13 @@ Status SavedModelBundleFactory::CreateSavedModelBundle(
     // Note that in the future, the plan is to enable explicit configuration of
     // the one or many SignatureDefs to enable.
     const std::vector<SignatureDef> signatures = GetSignatureDefs(**bundle);
-    return WrapSessionForBatching(config_.batching_parameters(),
-                                  batch_scheduler_, signatures,
-                                  &(*bundle)->session);
+    TF_RETURN_IF_ERROR(WrapSessionForBatching(config_.batching_parameters(),
+                                              batch_scheduler_, signatures,
+                                              &(*bundle)->session));
+  } else {
+    TF_RETURN_IF_ERROR(WrapSession(&(*bundle)->session));
   }
-  return WrapSession(&(*bundle)->session);
+  return Status::OK();
 }
 
 SavedModelBundleFactory::SavedModelBundleFactory(
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/types.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow_serving/resources/resource_util.h"
 #include "tensorflow_serving/resources/resource_values.h"
 #include "tensorflow_serving/resources/resources.pb.h"
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
 #include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
@@ -79,8 +81,10 @@ Status SavedModelBundleSourceAdapter::Convert(const StoragePath& path,
                                        path](ResourceAllocation* estimate) {
     return bundle_factory->EstimateResourceRequirement(path, estimate);
   };
-  loader->reset(new SimpleLoader<SavedModelBundle>(
+  std::unique_ptr<Loader> bundle_loader(new SimpleLoader<SavedModelBundle>(
       servable_creator, resource_estimator, post_load_resource_estimator));
+  loader->reset(new PredictSignaturePlanLoader<SavedModelBundle>(
+      std::move(bundle_loader), PredictSignaturePlans::FromSavedModel));
   return Status::OK();
 }
 
@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow_serving/resources/resource_values.h"
 #include "tensorflow_serving/resources/resources.pb.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_source_adapter.pb.h"
 #include "tensorflow_serving/test_util/test_util.h"
@@ -98,7 +99,11 @@ class SavedModelBundleSourceAdapterTest : public ::testing::Test {
     const SavedModelBundle* bundle = loader->servable().get<SavedModelBundle>();
     test_util::TestSingleRequest(bundle->session.get());
 
+    // The Predict plans of the bundle are kept while it is loaded.
+    EXPECT_NE(nullptr, PredictSignaturePlanTable::Global()->Find(bundle));
+
     loader->Unload();
+    EXPECT_EQ(nullptr, PredictSignaturePlanTable::Global()->Find(bundle));
   }
 
   std::unique_ptr<ResourceUtil> resource_util_;
@@ -34,5 +34,30 @@ Status ServingSession::Close() {
   return errors::PermissionDenied("State changes denied via ServingSession");
 }
 
+void ServingSession::RunAsync(
+    const RunOptions& run_options,
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const std::vector<string>& output_tensor_names,
+    std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+    std::function<void(const Status&)> done) {
+  done(Run(run_options, inputs, output_tensor_names, {}, outputs,
+           run_metadata));
+}
+
+void RunSessionAsync(Session* session, const RunOptions& run_options,
+                     const std::vector<std::pair<string, Tensor>>& inputs,
+                     const std::vector<string>& output_tensor_names,
+                     std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                     std::function<void(const Status&)> done) {
+  ServingSession* serving_session = dynamic_cast<ServingSession*>(session);
+  if (serving_session != nullptr) {
+    serving_session->RunAsync(run_options, inputs, output_tensor_names,
+                              outputs, run_metadata, std::move(done));
+    return;
+  }
+  done(session->Run(run_options, inputs, output_tensor_names, {}, outputs,
+                    run_metadata));
+}
+
 }  // namespace serving
 }  // namespace tensorflow
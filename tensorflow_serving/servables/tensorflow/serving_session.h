@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SERVING_SESSION_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SERVING_SESSION_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -40,9 +41,31 @@ class ServingSession : public Session {
   Status Extend(const GraphDef& graph) final;
   Status Close() final;
 
+  /// Like Run() without target nodes, but calls 'done' with the outcome rather
+  /// than returning it, possibly from another thread after RunAsync() has
+  /// returned. This lets sessions which wait for something before running
+  /// (e.g. batching) do so without blocking the calling thread. 'inputs',
+  /// 'output_tensor_names', 'outputs' and 'run_metadata' must outlive the call
+  /// to 'done'.
+  ///
+  /// The default implementation calls Run(), and then 'done'.
+  virtual void RunAsync(const RunOptions& run_options,
+                        const std::vector<std::pair<string, Tensor>>& inputs,
+                        const std::vector<string>& output_tensor_names,
+                        std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                        std::function<void(const Status&)> done);
+
   // (Subclasses just implement Run().)
 };
 
+/// Calls RunAsync() if 'session' is a ServingSession, and otherwise Run()
+/// followed by 'done'.
+void RunSessionAsync(Session* session, const RunOptions& run_options,
+                     const std::vector<std::pair<string, Tensor>>& inputs,
+                     const std::vector<string>& output_tensor_names,
+                     std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                     std::function<void(const Status&)> done);
+
 /// A ServingSession that wraps a given Session, and blocks all calls other than
 /// Run().
 class ServingSessionWrapper : public ServingSession {
@@ -70,6 +93,16 @@ class ServingSessionWrapper : public ServingSession {
     return wrapped_->Run(run_options, inputs, output_tensor_names,
                          target_node_names, outputs, run_metadata);
   }
+
+  void RunAsync(const RunOptions& run_options,
+                const std::vector<std::pair<string, Tensor>>& inputs,
+                const std::vector<string>& output_tensor_names,
+                std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                std::function<void(const Status&)> done) override {
+    RunSessionAsync(wrapped_.get(), run_options, inputs, output_tensor_names,
+                    outputs, run_metadata, std::move(done));
+  }
+
   Status ListDevices(std::vector<DeviceAttributes>* response) override {
     return wrapped_->ListDevices(response);
   }
@@ -86,11 +86,13 @@ Status SessionBundleFactory::CreateSessionBundle(
     }
     std::vector<SignatureDef> signatures;
     TF_RETURN_IF_ERROR(GetSignatureDefs(**bundle, &signatures));
-    return WrapSessionForBatching(config_.batching_parameters(),
-                                  batch_scheduler_, signatures,
-                                  &(*bundle)->session);
+    TF_RETURN_IF_ERROR(WrapSessionForBatching(config_.batching_parameters(),
+                                              batch_scheduler_, signatures,
+                                              &(*bundle)->session));
+  } else {
+    TF_RETURN_IF_ERROR(WrapSession(&(*bundle)->session));
   }
-  return WrapSession(&(*bundle)->session);
+  return Status::OK();
 }
 
 SessionBundleFactory::SessionBundleFactory(
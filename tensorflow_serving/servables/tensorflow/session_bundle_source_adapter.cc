@@ -17,9 +17,11 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow_serving/core/simple_loader.h"
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
 #include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
@@ -52,8 +54,10 @@ Status SessionBundleSourceAdapter::Convert(const StoragePath& path,
                              path](ResourceAllocation* estimate) {
     return bundle_factory->EstimateResourceRequirement(path, estimate);
   };
-  loader->reset(
+  std::unique_ptr<Loader> bundle_loader(
       new SimpleLoader<SessionBundle>(servable_creator, resource_estimator));
+  loader->reset(new PredictSignaturePlanLoader<SessionBundle>(
+      std::move(bundle_loader), PredictSignaturePlans::FromSessionBundle));
   return Status::OK();
 }
 
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow_serving/core/servable_data.h"
 #include "tensorflow_serving/resources/resources.pb.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
+#include "tensorflow_serving/servables/tensorflow/predict_signature_plan.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_source_adapter.pb.h"
 #include "tensorflow_serving/test_util/test_util.h"
@@ -77,7 +78,15 @@ class SessionBundleSourceAdapterTest : public ::testing::Test {
     const SessionBundle* bundle = loader->servable().get<SessionBundle>();
     test_util::TestSingleRequest(bundle->session.get());
 
+    // The Predict plan of the bundle is kept while it is loaded.
+    const PredictSignaturePlans* plans =
+        PredictSignaturePlanTable::Global()->Find(bundle);
+    ASSERT_NE(nullptr, plans);
+    EXPECT_NE(nullptr,
+              plans->Find(PredictSignaturePlans::kSessionBundlePredictSignature));
+
     loader->Unload();
+    EXPECT_EQ(nullptr, PredictSignaturePlanTable::Global()->Find(bundle));
   }
 };
 
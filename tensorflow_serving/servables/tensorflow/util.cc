@@ -15,13 +15,26 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow_serving/apis/input.pb.h"
-#include "tensorflow_serving/apis/internal/serialized_input.pb.h"
+#include "tensorflow_serving/core/request_timing.h"
+#include "tensorflow_serving/servables/tensorflow/serving_session.h"
 
 namespace tensorflow {
 namespace serving {
@@ -34,8 +47,73 @@ auto* example_counts = monitoring::Sampler<1>::New(
     // so the limits are [1, 2, 4, 8, ..., 16 * 1024, DBL_MAX].
     monitoring::Buckets::Exponential(1, 2, 15));
 
+// An Allocator which hands out an existing array once, for a Tensor to alias
+// it, and deletes itself when the Tensor releases the array.
+class AliasingAllocator : public Allocator {
+ public:
+  AliasingAllocator(const void* data, size_t num_bytes)
+      : data_(data), num_bytes_(num_bytes) {}
+
+  string Name() override { return "aliasing"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    DCHECK_EQ(num_bytes, num_bytes_);
+    // Kernels only write into an input buffer they hold the sole reference to,
+    // and the caller of the session run holds another one.
+    return const_cast<void*>(data_);
+  }
+
+  void DeallocateRaw(void* ptr) override { delete this; }
+
+ private:
+  ~AliasingAllocator() override = default;
+
+  const void* const data_;
+  const size_t num_bytes_;
+};
+
+// Returns whether a node running 'node_def' may keep one of its inputs, or
+// its buffer, beyond the run: i.e. whether it writes an input into a variable
+// or other resource (e.g. Assign, QueueEnqueueV2), into state of its own (e.g.
+// Stage, MapStage), or stores it in the session (GetSessionHandle). Errs on the side of true for functions and unknown ops.
+bool NodeMayRetainInputs(const NodeDef& node_def,
+                         const FunctionDefLibrary& library) {
+  if (node_def.op() == "GetSessionHandle" ||
+      node_def.op() == "GetSessionHandleV2") {
+    return true;
+  }
+  for (const FunctionDef& function : library.function()) {
+    if (function.signature().name() == node_def.op()) {
+      return true;
+    }
+  }
+  for (const auto& attr : node_def.attr()) {
+    if (attr.second.has_func() || attr.second.list().func_size() > 0) {
+      return true;
+    }
+  }
+  const OpDef* op_def;
+  if (!OpRegistry::Global()->LookUpOpDef(node_def.op(), &op_def).ok()) {
+    return true;
+  }
+  // An op can only keep a tensor if it takes it as input, and either a
+  // reference to where it goes, e.g. Assign(ref, value), or has state of its
+  // own to put it in, e.g. Stage(values) and the other staging areas, which
+  // look up their container by name rather than taking it as input.
+  bool has_state_input = false;
+  bool has_data_input = false;
+  for (const OpDef::ArgDef& arg : op_def->input_arg()) {
+    if (arg.is_ref() || arg.type() == DT_RESOURCE) {
+      has_state_input = true;
+    } else {
+      has_data_input = true;
+    }
+  }
+  return has_data_input && (has_state_input || op_def->is_stateful());
+}
+
 // Returns the number of examples in the Input.
-int NumInputExamples(const internal::SerializedInput& input) {
+int NumInputExamples(const Input& input) {
   switch (input.kind_case()) {
     case Input::KindCase::kExampleList:
       return input.example_list().examples_size();
@@ -47,76 +125,240 @@ int NumInputExamples(const internal::SerializedInput& input) {
   return 0;
 }
 
-}  // namespace
-
-namespace internal {
-
-monitoring::Sampler<1>* GetExampleCounts() { return example_counts; }
-
-}  // namespace internal
-
-void RecordRequestExampleCount(const string& model_name, size_t count) {
-  example_counts->GetCell(model_name)->Add(count);
+// Sets 'serialized' to 'prefix' followed by the serialization of 'example',
+// which is written in place rather than through a temporary string.
+void SerializeExampleAfter(const string& prefix, const Example& example,
+                           string* serialized) {
+  const size_t example_size = example.ByteSizeLong();
+  serialized->resize(prefix.size() + example_size);
+  char* const data = &(*serialized)[0];
+  std::copy(prefix.begin(), prefix.end(), data);
+  example.SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8*>(data + prefix.size()));
 }
 
-Status InputToSerializedExampleTensor(const Input& input, Tensor* examples) {
-  const string serialized_input_str = input.SerializeAsString();
-  internal::SerializedInput serialized_input;
-  if (!serialized_input.ParseFromString(serialized_input_str)) {
-    return errors::Internal("Error parsing serialized input.");
-  }
-  const int64 num_examples = NumInputExamples(serialized_input);
+// Populates 'examples' like InputToSerializedExampleTensor(), but leaves the
+// context out of the examples unless 'merge_context' is set.
+Status InputToSerializedExamples(const Input& input, const bool merge_context,
+                                 Tensor* examples) {
+  const int64 num_examples = NumInputExamples(input);
   if (num_examples == 0) {
     return errors::InvalidArgument("Input is empty.");
   }
   *examples = Tensor(DT_STRING, TensorShape({num_examples}));
-  switch (serialized_input.kind_case()) {
+  // Each example is serialized straight into its tensor element, rather than
+  // by serializing the whole Input and parsing it back into serialized
+  // examples.
+  switch (input.kind_case()) {
     case Input::KindCase::KIND_NOT_SET:
       break;
 
     case Input::KindCase::kExampleList: {
       auto input_vec = examples->vec<string>();
       int input_vec_index = 0;
-      for (const auto& entry : serialized_input.example_list().examples()) {
-        input_vec(input_vec_index++) = entry;
+      for (const Example& example : input.example_list().examples()) {
+        SerializeExampleAfter("", example, &input_vec(input_vec_index++));
       }
       break;
     }
 
     case Input::KindCase::kExampleListWithContext: {
-      const string& context =
-          serialized_input.example_list_with_context().context();
+      const string context =
+          merge_context
+              ? input.example_list_with_context().context().SerializeAsString()
+              : "";
       auto input_vec = examples->vec<string>();
       int input_vec_index = 0;
-      for (const auto& entry :
-           serialized_input.example_list_with_context().examples()) {
+      for (const Example& example :
+           input.example_list_with_context().examples()) {
         // Avoid the need for repeated serialization of context by simply
         // appending the Example serialization to the pre-serialized context.
-        input_vec(input_vec_index++) = strings::StrCat(context, entry);
+        SerializeExampleAfter(context, example, &input_vec(input_vec_index++));
       }
     } break;
 
     default:
-      return errors::Unimplemented(
-          "Input with kind ", serialized_input.kind_case(), " not supported.");
+      return errors::Unimplemented("Input with kind ", input.kind_case(),
+                                   " not supported.");
+  }
+  return Status::OK();
+}
+
+// Populates the tensors a one-shot computation on 'input' feeds to the inputs
+// 'input_tensor_name' and, if not empty, 'context_tensor_name'.
+Status CreateOneShotInputTensors(
+    const Input& input, const string& input_tensor_name,
+    const string& context_tensor_name,
+    std::vector<std::pair<string, Tensor>>* input_tensors,
+    int* num_input_examples) {
+  Tensor examples;
+  if (context_tensor_name.empty()) {
+    TF_RETURN_IF_ERROR(InputToSerializedExampleTensor(input, &examples));
+  } else {
+    Tensor context;
+    TF_RETURN_IF_ERROR(
+        InputToSerializedExampleAndContextTensors(input, &examples, &context));
+    input_tensors->emplace_back(context_tensor_name, context);
+  }
+  *num_input_examples = examples.dim_size(0);
+  input_tensors->emplace_back(input_tensor_name, examples);
+  return Status::OK();
+}
+
+}  // namespace
+
+namespace internal {
+
+monitoring::Sampler<1>* GetExampleCounts() { return example_counts; }
+
+}  // namespace internal
+
+void RecordRequestExampleCount(const string& model_name, size_t count) {
+  example_counts->GetCell(model_name)->Add(count);
+}
+
+const char kSharedContextInputs[] = "context";
+
+string GetSharedContextTensorName(const SignatureDef& signature) {
+  auto iter = signature.inputs().find(kSharedContextInputs);
+  return iter == signature.inputs().end() ? "" : iter->second.name();
+}
+
+Status InputToSerializedExampleTensor(const Input& input, Tensor* examples) {
+  RequestTiming::ScopedPhase decoding_phase(RequestPhase::kRequestDecoding);
+  return InputToSerializedExamples(input, true /* merge_context */, examples);
+}
+
+Status InputToSerializedExampleAndContextTensors(const Input& input,
+                                                 Tensor* examples,
+                                                 Tensor* context) {
+  RequestTiming::ScopedPhase decoding_phase(RequestPhase::kRequestDecoding);
+  TF_RETURN_IF_ERROR(
+      InputToSerializedExamples(input, false /* merge_context */, examples));
+  *context = Tensor(DT_STRING, TensorShape({}));
+  if (input.kind_case() == Input::KindCase::kExampleListWithContext) {
+    input.example_list_with_context().context().SerializeToString(
+        &context->scalar<string>()());
   }
   return Status::OK();
 }
 
 Status PerformOneShotTensorComputation(
     const RunOptions& run_options, const Input& input,
-    const string& input_tensor_name,
+    const string& input_tensor_name, const string& context_tensor_name,
     const std::vector<string>& output_tensor_names, Session* session,
     std::vector<Tensor>* outputs, int* num_input_examples) {
   // Setup the input Tensor to be a vector of string containing the serialized
   // tensorflow.Example.
-  Tensor input_tensor;
-  TF_RETURN_IF_ERROR(InputToSerializedExampleTensor(input, &input_tensor));
-  *num_input_examples = input_tensor.dim_size(0);
+  std::vector<std::pair<string, Tensor>> input_tensors;
+  TF_RETURN_IF_ERROR(CreateOneShotInputTensors(input, input_tensor_name,
+                                               context_tensor_name,
+                                               &input_tensors,
+                                               num_input_examples));
 
+  RequestTiming::ScopedPhase session_run_phase(RequestPhase::kSessionRun);
   RunMetadata run_metadata;
-  return session->Run(run_options, {{input_tensor_name, input_tensor}},
-                      output_tensor_names, {}, outputs, &run_metadata);
+  return session->Run(run_options, input_tensors, output_tensor_names, {},
+                      outputs, &run_metadata);
+}
+
+void PerformOneShotTensorComputationAsync(
+    const RunOptions& run_options, const Input& input,
+    const string& input_tensor_name, const string& context_tensor_name,
+    const std::vector<string>& output_tensor_names, Session* session,
+    std::vector<Tensor>* outputs, int* num_input_examples,
+    std::function<void(const Status&)> done) {
+  // The arguments of the Run() call, which must outlive it.
+  struct RunArgs {
+    std::vector<std::pair<string, Tensor>> inputs;
+    std::vector<string> output_tensor_names;
+    RunMetadata run_metadata;
+  };
+  std::shared_ptr<RunArgs> run_args(new RunArgs);
+  const Status input_status =
+      CreateOneShotInputTensors(input, input_tensor_name, context_tensor_name,
+                                &run_args->inputs, num_input_examples);
+  if (!input_status.ok()) {
+    done(input_status);
+    return;
+  }
+  run_args->output_tensor_names = output_tensor_names;
+
+  RequestTiming* const timing = RequestTiming::Current();
+  const uint64 start_micros =
+      timing == nullptr ? 0 : Env::Default()->NowMicros();
+  RunSessionAsync(
+      session, run_options, run_args->inputs, run_args->output_tensor_names,
+      outputs, &run_args->run_metadata,
+      [run_args, timing, start_micros, done](const Status& run_status) {
+        if (timing != nullptr) {
+          const uint64 end_micros = Env::Default()->NowMicros();
+          if (end_micros > start_micros) {
+            timing->Add(RequestPhase::kSessionRun, end_micros - start_micros);
+          }
+        }
+        done(run_status);
+      });
+}
+
+std::function<void(const Status&)> ContinueOnExecutor(
+    Executor* executor, std::function<void(const Status&)> done) {
+  return [executor, done](const Status& status) {
+    executor->Schedule([done, status]() { done(status); });
+  };
+}
+
+bool RunMayRetainInputs(const GraphDef& graph_def,
+                        const std::vector<string>& output_tensor_names) {
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node_def : graph_def.node()) {
+    nodes[node_def.name()] = &node_def;
+  }
+  // Walks the nodes the outputs depend on, which are the only ones which run.
+  std::vector<string> nodes_to_visit;
+  std::unordered_set<string> visited_nodes;
+  for (const string& tensor_name : output_tensor_names) {
+    nodes_to_visit.push_back(ParseTensorName(tensor_name).first.ToString());
+  }
+  while (!nodes_to_visit.empty()) {
+    const string node_name = std::move(nodes_to_visit.back());
+    nodes_to_visit.pop_back();
+    if (!visited_nodes.insert(node_name).second) {
+      continue;
+    }
+    auto it = nodes.find(node_name);
+    if (it == nodes.end() ||
+        NodeMayRetainInputs(*it->second, graph_def.library())) {
+      return true;
+    }
+    for (const string& input : it->second->input()) {
+      // Covers control inputs ("^node") too.
+      nodes_to_visit.push_back(ParseTensorName(input).first.ToString());
+    }
+  }
+  return false;
+}
+
+bool TensorFromProtoAliasingContent(const TensorProto& proto, Tensor* tensor) {
+  const DataType dtype = proto.dtype();
+  if (!DataTypeCanUseMemcpy(dtype) || proto.tensor_content().empty() ||
+      !TensorShape::IsValid(proto.tensor_shape())) {
+    return tensor->FromProto(proto);
+  }
+  const TensorShape shape(proto.tensor_shape());
+  const string& content = proto.tensor_content();
+  if (content.size() !=
+      static_cast<size_t>(shape.num_elements()) * DataTypeSize(dtype)) {
+    // Let FromProto() report the mismatch.
+    return tensor->FromProto(proto);
+  }
+  Tensor aliasing_tensor(new AliasingAllocator(content.data(), content.size()),
+                         dtype, shape);
+  if (!aliasing_tensor.IsAligned()) {
+    return tensor->FromProto(proto);
+  }
+  *tensor = std::move(aliasing_tensor);
+  return true;
 }
 
 }  // namespace serving
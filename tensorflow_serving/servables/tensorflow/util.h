@@ -16,11 +16,18 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow_serving/apis/input.pb.h"
+#include "tensorflow_serving/util/executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -51,14 +58,78 @@ void RecordRequestExampleCount(const string& model_name, size_t count);
 // empty it will return a Tensor of shape {0}).
 Status InputToSerializedExampleTensor(const Input& input, Tensor* examples);
 
+// The key of the optional input of classification and regression signatures
+// which takes the context of Input::example_list_with_context separately from
+// the examples (see InputToSerializedExampleAndContextTensors()).
+extern const char kSharedContextInputs[];
+
+// Returns the name of the tensor 'signature' takes the shared context in, or
+// the empty string if it has no kSharedContextInputs input.
+string GetSharedContextTensorName(const SignatureDef& signature);
+
+// Like InputToSerializedExampleTensor(), but doesn't merge the context of an
+// Input::example_list_with_context into each example. Instead, 'context' is a
+// scalar string Tensor with the serialized context, or the empty string for
+// inputs without one. This lets a graph which takes the context as an input
+// of its own parse it once per request, rather than once per example; merging
+// it with the examples (with the examples' features taking precedence) is up
+// to the graph.
+Status InputToSerializedExampleAndContextTensors(const Input& input,
+                                                 Tensor* examples,
+                                                 Tensor* context);
+
 // Issues a single Session::Run() call with 'input' to produce 'outputs'.
 // Equivalent to InputToSerializedExampleTensor() followed by Session::Run().
+// If 'context_tensor_name' is not empty, it is fed the shared context of
+// 'input' instead (see InputToSerializedExampleAndContextTensors()).
 Status PerformOneShotTensorComputation(
     const RunOptions& run_options, const Input& input,
-    const string& input_tensor_name,
+    const string& input_tensor_name, const string& context_tensor_name,
     const std::vector<string>& output_tensor_names, Session* session,
     std::vector<Tensor>* outputs, int* num_input_examples);
 
+// Like PerformOneShotTensorComputation(), but issues the Session::Run() call
+// with RunSessionAsync(), and calls 'done' with its outcome once 'outputs' and
+// 'num_input_examples' are populated, possibly from another thread. 'outputs'
+// and 'num_input_examples', as well as the RequestTiming current on entry, if
+// any, must outlive the call to 'done'.
+void PerformOneShotTensorComputationAsync(
+    const RunOptions& run_options, const Input& input,
+    const string& input_tensor_name, const string& context_tensor_name,
+    const std::vector<string>& output_tensor_names, Session* session,
+    std::vector<Tensor>* outputs, int* num_input_examples,
+    std::function<void(const Status&)> done);
+
+// Returns a callback which schedules 'done' on 'executor' with the outcome it
+// is called with. Passed to an asynchronous session run, it keeps the thread
+// which completes the run (e.g. a batch thread of a BatchingSession, which
+// completes all the runs of a batch in turn) from also running the rest of
+// each request.
+std::function<void(const Status&)> ContinueOnExecutor(
+    Executor* executor, std::function<void(const Status&)> done);
+
+// Returns whether running 'graph_def' to fetch 'output_tensor_names' may keep
+// a fed input tensor, or its buffer, beyond the run: e.g. by assigning it to a
+// variable, enqueueing or staging it, or storing it as a session tensor. Only
+// the nodes the outputs depend on are considered, since no other node runs.
+// Errs on the side of true, e.g. for functions, ops it doesn't know, or any
+// stateful op taking data inputs.
+bool RunMayRetainInputs(const GraphDef& graph_def,
+                        const std::vector<string>& output_tensor_names);
+
+// Like Tensor::FromProto(), but when 'proto' carries its values in
+// tensor_content, 'tensor' aliases those bytes rather than copying them, which
+// avoids a copy of the (possibly large) inputs of each request. The bytes are
+// only copied if they are not aligned as Tensor requires, or if the type can't
+// be memcpy'd (e.g. DT_STRING). Returns false if 'proto' is invalid.
+//
+// An aliasing 'tensor' must not be read after 'proto' is destroyed or mutated;
+// it may be destroyed at any time. So it may only be fed to a run which is
+// known not to keep it (see RunMayRetainInputs()), and any output of the run,
+// which may be the input itself (e.g. through Identity), must be consumed
+// before 'proto' goes away.
+bool TensorFromProtoAliasingContent(const TensorProto& proto, Tensor* tensor);
+
 }  // namespace serving
 }  // namespace tensorflow
 
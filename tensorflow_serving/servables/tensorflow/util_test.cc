@@ -15,11 +15,16 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
 #include "tensorflow_serving/test_util/test_util.h"
 
@@ -127,6 +132,59 @@ TEST_F(InputUtilTest, ExampleListWithContext) {
   }
 }
 
+// Each element is the serialized context followed by the serialized example,
+// which parses as the example merged into the context.
+TEST_F(InputUtilTest, ExampleListWithContext_ContextBytesPrefixEachExample) {
+  auto* examples =
+      input_.mutable_example_list_with_context()->mutable_examples();
+  *examples->Add() = example_A();
+  *examples->Add() = Example();
+  *input_.mutable_example_list_with_context()->mutable_context() = example_C();
+
+  TF_ASSERT_OK(InputToSerializedExampleTensor(input_, &tensor_));
+  const auto vec = tensor_.flat<string>();
+  ASSERT_EQ(vec.size(), 2);
+  const string context = example_C().SerializeAsString();
+  EXPECT_EQ(context + example_A().SerializeAsString(), vec(0));
+  EXPECT_EQ(context, vec(1));
+}
+
+TEST_F(InputUtilTest, ExampleListWithSharedContext) {
+  auto* examples =
+      input_.mutable_example_list_with_context()->mutable_examples();
+  *examples->Add() = example_A();
+  *examples->Add() = example_B();
+  *input_.mutable_example_list_with_context()->mutable_context() = example_C();
+
+  Tensor context;
+  TF_ASSERT_OK(
+      InputToSerializedExampleAndContextTensors(input_, &tensor_, &context));
+  const auto vec = tensor_.flat<string>();
+  ASSERT_EQ(vec.size(), 2);
+  EXPECT_EQ(example_A().SerializeAsString(), vec(0));
+  EXPECT_EQ(example_B().SerializeAsString(), vec(1));
+  ASSERT_EQ(0, context.dims());
+  EXPECT_EQ(example_C().SerializeAsString(), context.scalar<string>()());
+}
+
+TEST_F(InputUtilTest, ExampleListWithoutSharedContext) {
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_A();
+
+  Tensor context;
+  TF_ASSERT_OK(
+      InputToSerializedExampleAndContextTensors(input_, &tensor_, &context));
+  EXPECT_EQ(1, tensor_.NumElements());
+  EXPECT_EQ("", context.scalar<string>()());
+}
+
+TEST(GetSharedContextTensorNameTest, Simple) {
+  SignatureDef signature;
+  (*signature.mutable_inputs())["inputs"].set_name("examples:0");
+  EXPECT_EQ("", GetSharedContextTensorName(signature));
+  (*signature.mutable_inputs())[kSharedContextInputs].set_name("context:0");
+  EXPECT_EQ("context:0", GetSharedContextTensorName(signature));
+}
+
 // Tests whether individual examples do override the context.
 TEST_F(InputUtilTest, ExampleListWithOverridingContext) {
   auto* examples =
@@ -216,6 +274,165 @@ TEST(ExampleCountsTest, Simple) {
   EXPECT_EQ(1, after_histogram.bucket(2) - before_histogram.bucket(2));
 }
 
+// Sets the tensor_content of 'proto' to 'content', in a buffer aligned as
+// Tensor requires. A string doesn't let us choose its buffer, so this makes new
+// ones until the allocator hands out an aligned one, keeping the others alive
+// so that their buffers aren't handed out again.
+void SetAlignedTensorContent(const string& content, TensorProto* proto) {
+  std::vector<std::unique_ptr<string>> misaligned_contents;
+  for (int i = 0; i < 1000; ++i) {
+    std::unique_ptr<string> aligned_content(new string(content));
+    if (reinterpret_cast<intptr_t>(aligned_content->data()) %
+            EIGEN_MAX_ALIGN_BYTES ==
+        0) {
+      proto->set_allocated_tensor_content(aligned_content.release());
+      return;
+    }
+    misaligned_contents.push_back(std::move(aligned_content));
+  }
+  FAIL() << "Found no aligned buffer";
+}
+
+TEST(TensorFromProtoAliasingContentTest, AliasesTensorContent) {
+  const Tensor expected = test::AsTensor<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+  TensorProto proto;
+  expected.AsProtoTensorContent(&proto);
+  ASSERT_NO_FATAL_FAILURE(
+      SetAlignedTensorContent(proto.tensor_content(), &proto));
+
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoAliasingContent(proto, &tensor));
+  test::ExpectTensorEqual<float>(expected, tensor);
+  EXPECT_EQ(proto.tensor_content().data(), tensor.tensor_data().data());
+}
+
+TEST(TensorFromProtoAliasingContentTest, CopiesRepeatedFields) {
+  const Tensor expected = test::AsTensor<int32>({7, 8, 9}, {3});
+  TensorProto proto;
+  expected.AsProtoField(&proto);
+
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoAliasingContent(proto, &tensor));
+  test::ExpectTensorEqual<int32>(expected, tensor);
+}
+
+TEST(TensorFromProtoAliasingContentTest, CopiesStrings) {
+  const Tensor expected = test::AsTensor<string>({"a", "bc"}, {2});
+  TensorProto proto;
+  expected.AsProtoTensorContent(&proto);
+
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoAliasingContent(proto, &tensor));
+  test::ExpectTensorEqual<string>(expected, tensor);
+}
+
+TEST(TensorFromProtoAliasingContentTest, ContentSizeMismatch) {
+  TensorProto proto;
+  proto.set_dtype(DT_FLOAT);
+  proto.mutable_tensor_shape()->add_dim()->set_size(3);
+  proto.set_tensor_content(string(2 * sizeof(float), '\0'));
+
+  Tensor tensor;
+  EXPECT_FALSE(TensorFromProtoAliasingContent(proto, &tensor));
+}
+
+TEST(RunMayRetainInputsTest, StatelessGraph) {
+  const GraphDef graph_def = test_util::CreateProto<GraphDef>(
+      "node { name: 'x' op: 'Placeholder' attr { key: 'dtype' "
+      "                                          value { type: DT_FLOAT } } } "
+      "node { name: 'y' op: 'Identity' input: 'x' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } ");
+  EXPECT_FALSE(RunMayRetainInputs(graph_def, {"y:0"}));
+  EXPECT_FALSE(RunMayRetainInputs(graph_def, {"y"}));
+}
+
+TEST(RunMayRetainInputsTest, AssignToVariable) {
+  const GraphDef graph_def = test_util::CreateProto<GraphDef>(
+      "node { name: 'x' op: 'Placeholder' attr { key: 'dtype' "
+      "                                          value { type: DT_FLOAT } } } "
+      "node { name: 'v' op: 'VariableV2' "
+      "       attr { key: 'dtype' value { type: DT_FLOAT } } "
+      "       attr { key: 'shape' value { shape { } } } } "
+      "node { name: 'v/read' op: 'Identity' input: 'v' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } "
+      "node { name: 'assign' op: 'Assign' input: 'v' input: 'x' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } "
+      "node { name: 'y' op: 'Identity' input: 'v/read' input: '^assign' "
+      "       attr { key: 'T' value { type: DT_FLOAT } } } ");
+  // Reading the variable doesn't keep anything, but 'y' depends on the
+  // assignment through its control input.
+  EXPECT_FALSE(RunMayRetainInputs(graph_def, {"v/read:0"}));
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"y:0"}));
+}
+
+TEST(RunMayRetainInputsTest, EnqueueIntoQueue) {
+  const GraphDef graph_def = test_util::CreateProto<GraphDef>(
+      "node { name: 'x' op: 'Placeholder' attr { key: 'dtype' "
+      "                                          value { type: DT_FLOAT } } } "
+      "node { name: 'queue' op: 'FIFOQueueV2' "
+      "       attr { key: 'component_types' "
+      "              value { list { type: DT_FLOAT } } } } "
+      "node { name: 'enqueue' op: 'QueueEnqueueV2' input: 'queue' input: 'x' "
+      "       attr { key: 'Tcomponents' "
+      "              value { list { type: DT_FLOAT } } } } ");
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"enqueue"}));
+}
+
+TEST(RunMayRetainInputsTest, StageIntoStagingArea) {
+  const GraphDef graph_def = test_util::CreateProto<GraphDef>(
+      "node { name: 'x' op: 'Placeholder' attr { key: 'dtype' "
+      "                                          value { type: DT_FLOAT } } } "
+      "node { name: 'stage' op: 'Stage' input: 'x' "
+      "       attr { key: 'dtypes' value { list { type: DT_FLOAT } } } } "
+      "node { name: 'unstage' op: 'Unstage' input: '^stage' "
+      "       attr { key: 'dtypes' value { list { type: DT_FLOAT } } } } ");
+  // The staging area isn't an input of Stage, which keeps 'x' all the same.
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"stage"}));
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"unstage:0"}));
+}
+
+TEST(RunMayRetainInputsTest, UnknownOrMissingNode) {
+  const GraphDef graph_def = test_util::CreateProto<GraphDef>(
+      "node { name: 'y' op: 'NoSuchOp' } ");
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"y:0"}));
+  EXPECT_TRUE(RunMayRetainInputs(graph_def, {"z:0"}));
+}
+
+// An executor which runs the closures scheduled on it when told to.
+class DeferringExecutor : public Executor {
+ public:
+  void Schedule(std::function<void()> fn) override {
+    closures_.push_back(std::move(fn));
+  }
+
+  void RunAll() {
+    for (const std::function<void()>& fn : closures_) {
+      fn();
+    }
+    closures_.clear();
+  }
+
+ private:
+  std::vector<std::function<void()>> closures_;
+};
+
+TEST(ContinueOnExecutorTest, SchedulesCallback) {
+  DeferringExecutor executor;
+  Status done_status;
+  int num_done_calls = 0;
+  auto callback = ContinueOnExecutor(
+      &executor, [&done_status, &num_done_calls](const Status& status) {
+        done_status = status;
+        ++num_done_calls;
+      });
+
+  callback(errors::Internal("run failed"));
+  EXPECT_EQ(0, num_done_calls);
+  executor.RunAll();
+  EXPECT_EQ(1, num_done_calls);
+  EXPECT_EQ(error::INTERNAL, done_status.code());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
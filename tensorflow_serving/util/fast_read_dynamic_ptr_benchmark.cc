@@ -16,7 +16,8 @@ limitations under the License.
 // Benchmarks for read performance of the FastReadDynamicPtr class both with
 // and without concurrent updates to the pointer being read. These simulate the
 // common expected access pattern of FastReadDynamicPtr for systems with high
-// read rates and low update rates.
+// read rates and low update rates. The BM_Rcu_* benchmarks run the same access
+// patterns against RcuDynamicPtr, for comparison.
 //
 // The main difference between this benchmark's and expected access patterns is
 // that the reads simply repeat as quickly as possible with no time spent
@@ -47,20 +48,25 @@ limitations under the License.
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow_serving/util/fast_read_dynamic_ptr.h"
+#include "tensorflow_serving/util/rcu_dynamic_ptr.h"
 
 namespace tensorflow {
 namespace serving {
 
 typedef FastReadDynamicPtr<int> FastReadIntPtr;
+typedef RcuDynamicPtr<int> RcuIntPtr;
 
 // This class maintains all state for a benchmark and handles the concurrency
-// concerns around the concurrent read and update threads.
+// concerns around the concurrent read and update threads. DynamicPtr is the
+// type of the pointer being benchmarked, i.e. FastReadIntPtr or RcuIntPtr.
 //
 // Example:
-//    BenchmarkState state(0 /* no updates */, false /* Don't do any work */);
+//    BenchmarkState<FastReadIntPtr> state(0 /* no updates */,
+//                                         false /* Don't do any work */);
 //    state.Setup();
 //    state.RunBenchmarkReadIterations(5 /* num_threads */, 42 /* iters */);
 //    state.Teardown();
+template <typename DynamicPtr>
 class BenchmarkState {
  public:
   BenchmarkState(const int update_micros, const bool do_work)
@@ -92,8 +98,8 @@ class BenchmarkState {
   // destruct state after it has exited.
   std::unique_ptr<PeriodicFunction> update_thread_;
 
-  // The FastReadIntPtr being benchmarked primarily for read performance.
-  FastReadIntPtr fast_ptr_;
+  // The pointer being benchmarked primarily for read performance.
+  DynamicPtr fast_ptr_;
 
   // The update interval in microseconds.
   int64 update_micros_;
@@ -103,17 +109,19 @@ class BenchmarkState {
   bool do_work_;
 };
 
-void BenchmarkState::RunUpdateThread() {
+template <typename DynamicPtr>
+void BenchmarkState<DynamicPtr>::RunUpdateThread() {
   int current_value;
   {
-    std::shared_ptr<const int> current = fast_ptr_.get();
+    auto current = fast_ptr_.get();
     current_value = *current;
   }
   std::unique_ptr<int> tmp(new int(current_value + 1));
   fast_ptr_.Update(std::move(tmp));
 }
 
-void BenchmarkState::Setup() {
+template <typename DynamicPtr>
+void BenchmarkState<DynamicPtr>::Setup() {
   testing::StopTiming();
 
   // setup fast read int ptr:
@@ -131,7 +139,8 @@ void BenchmarkState::Setup() {
   testing::StartTiming();
 }
 
-void BenchmarkState::Teardown() {
+template <typename DynamicPtr>
+void BenchmarkState<DynamicPtr>::Teardown() {
   testing::StopTiming();
 
   // Destruct the update thread which blocks until it exits.
@@ -140,12 +149,13 @@ void BenchmarkState::Teardown() {
   testing::StartTiming();
 }
 
-void BenchmarkState::RunBenchmarkReads(int iters) {
+template <typename DynamicPtr>
+void BenchmarkState<DynamicPtr>::RunBenchmarkReads(int iters) {
   // Wait until all_read_threads_scheduled_ has been notified.
   all_read_threads_scheduled_.WaitForNotification();
 
   for (int i = 0; i < iters; i++) {
-    std::shared_ptr<const int> current = fast_ptr_.get();
+    auto current = fast_ptr_.get();
     if (do_work_) {
       // Let's do some work, so that we are not just measuring contention in the
       // mutex.
@@ -160,7 +170,9 @@ void BenchmarkState::RunBenchmarkReads(int iters) {
   }
 }
 
-void BenchmarkState::RunBenchmarkReadIterations(int num_threads, int iters) {
+template <typename DynamicPtr>
+void BenchmarkState<DynamicPtr>::RunBenchmarkReadIterations(int num_threads,
+                                                             int iters) {
   testing::StopTiming();
 
   // The benchmarking system by default uses cpu time to calculate items per
@@ -188,9 +200,10 @@ void BenchmarkState::RunBenchmarkReadIterations(int num_threads, int iters) {
   // num_threads) and includes time scheduling work on the threads.
 }
 
+template <typename DynamicPtr>
 static void BenchmarkReadsAndUpdates(int update_micros, bool do_work, int iters,
                                      int num_threads) {
-  BenchmarkState state(update_micros, do_work);
+  BenchmarkState<DynamicPtr> state(update_micros, do_work);
   state.Setup();
   state.RunBenchmarkReadIterations(num_threads, iters);
   state.Teardown();
@@ -198,22 +211,22 @@ static void BenchmarkReadsAndUpdates(int update_micros, bool do_work, int iters,
 
 static void BM_Work_NoUpdates_Reads(int iters, int num_threads) {
   // No updates. 0 update_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(0, true, iters, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(0, true, iters, num_threads);
 }
 
 static void BM_Work_FrequentUpdates_Reads(int iters, int num_threads) {
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(1000, true, iters, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(1000, true, iters, num_threads);
 }
 
 static void BM_NoWork_NoUpdates_Reads(int iters, int num_threads) {
   // No updates. 0 update_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(0, false, iters, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(0, false, iters, num_threads);
 }
 
 static void BM_NoWork_FrequentUpdates_Reads(int iters, int num_threads) {
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(1000, false, iters, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(1000, false, iters, num_threads);
 }
 
 BENCHMARK(BM_Work_NoUpdates_Reads)
@@ -252,6 +265,62 @@ BENCHMARK(BM_NoWork_FrequentUpdates_Reads)
     ->Arg(32)
     ->Arg(64);
 
+static void BM_Rcu_Work_NoUpdates_Reads(int iters, int num_threads) {
+  // No updates. 0 update_micros signals not to update at all.
+  BenchmarkReadsAndUpdates<RcuIntPtr>(0, true, iters, num_threads);
+}
+
+static void BM_Rcu_Work_FrequentUpdates_Reads(int iters, int num_threads) {
+  // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
+  BenchmarkReadsAndUpdates<RcuIntPtr>(1000, true, iters, num_threads);
+}
+
+static void BM_Rcu_NoWork_NoUpdates_Reads(int iters, int num_threads) {
+  // No updates. 0 update_micros signals not to update at all.
+  BenchmarkReadsAndUpdates<RcuIntPtr>(0, false, iters, num_threads);
+}
+
+static void BM_Rcu_NoWork_FrequentUpdates_Reads(int iters, int num_threads) {
+  // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
+  BenchmarkReadsAndUpdates<RcuIntPtr>(1000, false, iters, num_threads);
+}
+
+BENCHMARK(BM_Rcu_Work_NoUpdates_Reads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
+BENCHMARK(BM_Rcu_Work_FrequentUpdates_Reads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
+BENCHMARK(BM_Rcu_NoWork_NoUpdates_Reads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
+BENCHMARK(BM_Rcu_NoWork_FrequentUpdates_Reads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
 }  // namespace serving
 }  // namespace tensorflow
 
@@ -0,0 +1,140 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_MPSC_RING_BUFFER_H_
+#define TENSORFLOW_SERVING_UTIL_MPSC_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A bounded, lock-free, multi-producer single-consumer FIFO queue.
+//
+// Based on Dmitry Vyukov's bounded MPMC queue: every cell carries a sequence
+// number telling whether it is ready to be written (for a given lap around the
+// ring) or to be read, so producers only contend on a single atomic position
+// counter, and never wait on each other nor on the consumer.
+//
+// TryPush() may be called concurrently from any number of threads. TryPop()
+// must only be called from one thread at a time.
+//
+// Example use:
+//   MpscRingBuffer<std::unique_ptr<Item>> ring_buffer(1024);
+//   // Producers:
+//   if (!ring_buffer.TryPush(std::move(item))) { ...full, drop item... }
+//   // Consumer:
+//   std::unique_ptr<Item> item;
+//   while (ring_buffer.TryPop(&item)) { ...process item... }
+template <typename T>
+class MpscRingBuffer {
+ public:
+  // 'capacity' must be a power of two.
+  explicit MpscRingBuffer(size_t capacity);
+  ~MpscRingBuffer() = default;
+
+  // Appends 'value' to the queue, unless the queue is full in which case
+  // 'value' is left untouched and false is returned.
+  bool TryPush(T&& value);
+
+  // Removes the oldest value of the queue into 'value', unless the queue is
+  // empty in which case false is returned.
+  bool TryPop(T* value);
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // Kept on separate cache lines, since producers and consumer update them
+  // independently.
+  alignas(64) std::atomic<size_t> enqueue_position_{0};
+  alignas(64) size_t dequeue_position_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MpscRingBuffer);
+};
+
+//////////
+// Implementation details follow. API users need not read.
+
+template <typename T>
+MpscRingBuffer<T>::MpscRingBuffer(const size_t capacity)
+    : mask_(capacity - 1), cells_(new Cell[capacity]) {
+  CHECK(capacity >= 1 && (capacity & (capacity - 1)) == 0)
+      << "Capacity must be a power of two; got " << capacity;
+  for (size_t i = 0; i < capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool MpscRingBuffer<T>::TryPush(T&& value) {
+  Cell* cell;
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  for (;;) {
+    cell = &cells_[position & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      // The cell is free for this lap; try to claim it.
+      if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The cell still holds the value from the previous lap: full.
+      return false;
+    } else {
+      // Another producer claimed the cell first.
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->value = std::move(value);
+  cell->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool MpscRingBuffer<T>::TryPop(T* const value) {
+  Cell* const cell = &cells_[dequeue_position_ & mask_];
+  const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+  if (sequence != dequeue_position_ + 1) {
+    // Empty, or the producer which claimed the cell hasn't filled it yet.
+    return false;
+  }
+  *value = std::move(cell->value);
+  cell->sequence.store(dequeue_position_ + mask_ + 1,
+                       std::memory_order_release);
+  ++dequeue_position_;
+  return true;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_MPSC_RING_BUFFER_H_
@@ -0,0 +1,91 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/mpsc_ring_buffer.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(MpscRingBufferTest, PushPopInOrder) {
+  MpscRingBuffer<std::unique_ptr<int>> ring_buffer(4);
+  EXPECT_EQ(4, ring_buffer.capacity());
+  std::unique_ptr<int> value;
+  EXPECT_FALSE(ring_buffer.TryPop(&value));
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring_buffer.TryPush(std::unique_ptr<int>(new int(i))));
+  }
+  // Full: the value is left untouched.
+  std::unique_ptr<int> extra(new int(4));
+  EXPECT_FALSE(ring_buffer.TryPush(std::move(extra)));
+  ASSERT_NE(nullptr, extra);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ring_buffer.TryPop(&value));
+    EXPECT_EQ(i, *value);
+  }
+  EXPECT_FALSE(ring_buffer.TryPop(&value));
+
+  // Wrap around.
+  EXPECT_TRUE(ring_buffer.TryPush(std::move(extra)));
+  ASSERT_TRUE(ring_buffer.TryPop(&value));
+  EXPECT_EQ(4, *value);
+}
+
+TEST(MpscRingBufferTest, ConcurrentProducers) {
+  const int kNumProducers = 8;
+  const int kNumValuesPerProducer = 10000;
+  MpscRingBuffer<int> ring_buffer(64);
+  std::vector<int> popped_count(kNumProducers, 0);
+  int64 num_popped = 0;
+  {
+    thread::ThreadPool pool(Env::Default(), "producers", kNumProducers);
+    for (int i = 0; i < kNumProducers; ++i) {
+      pool.Schedule([&ring_buffer, i]() {
+        for (int j = 0; j < kNumValuesPerProducer; ++j) {
+          int value = i;
+          while (!ring_buffer.TryPush(std::move(value))) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    while (num_popped < kNumProducers * kNumValuesPerProducer) {
+      int value;
+      if (ring_buffer.TryPop(&value)) {
+        ++popped_count[value];
+        ++num_popped;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+  for (int i = 0; i < kNumProducers; ++i) {
+    EXPECT_EQ(kNumValuesPerProducer, popped_count[i]);
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,54 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/rcu_dynamic_ptr.h"
+
+#include <thread>
+
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace internal {
+
+int GetRcuReaderStripe() {
+  static std::atomic<int> next_stripe{0};
+  static thread_local const int stripe =
+      next_stripe.fetch_add(1, std::memory_order_relaxed) %
+      kNumRcuReaderStripes;
+  return stripe;
+}
+
+void WaitForRcuReaders(const RcuReaderStripe* stripes, const int phase) {
+  for (int i = 0; i < kNumRcuReaderStripes; ++i) {
+    for (int num_polls = 0;; ++num_polls) {
+      // Sequentially consistent, like the readers' increment and the swap of
+      // the object, so that a reader this misses loads the new object.
+      if (stripes[i].num_readers[phase].load() == 0) {
+        break;
+      }
+      // Readers are expected to leave shortly; back off if they don't.
+      if (num_polls < 100) {
+        std::this_thread::yield();
+      } else {
+        Env::Default()->SleepForMicroseconds(100);
+      }
+    }
+  }
+}
+
+}  // namespace internal
+}  // namespace serving
+}  // namespace tensorflow
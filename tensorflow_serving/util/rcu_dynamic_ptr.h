@@ -0,0 +1,178 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_RCU_DYNAMIC_PTR_H_
+#define TENSORFLOW_SERVING_UTIL_RCU_DYNAMIC_PTR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Implementation details; please don't depend on these.
+namespace internal {
+
+// The number of reader counts of each RcuDynamicPtr. Threads are spread over
+// them, so that readers on different threads rarely write to the same cache
+// line.
+constexpr int kNumRcuReaderStripes = 16;
+
+// The number of readers of an RcuDynamicPtr on a set of threads, in each of the
+// two phases of its epoch. Aligned to a cache line.
+struct alignas(64) RcuReaderStripe {
+  std::atomic<int64> num_readers[2] = {{0}, {0}};
+};
+
+// Returns the stripe of the calling thread, in [0, kNumRcuReaderStripes).
+int GetRcuReaderStripe();
+
+// Waits until the 'phase' count of each of the 'stripes' has been zero once.
+void WaitForRcuReaders(const RcuReaderStripe* stripes, int phase);
+
+}  // namespace internal
+
+// RcuDynamicPtr<> is an alternative to FastReadDynamicPtr<> for objects read on
+// every request, built on userspace read-copy-update. It has the same
+// semantics and interface, except for the type of the pointers get() returns.
+//
+// Where FastReadDynamicPtr::get() takes a mutex and bumps a reference count,
+// both on cache lines all readers share, RcuDynamicPtr::get() is lock-free: it
+// counts the reader in the current phase of the RcuDynamicPtr's epoch, on a
+// cache line of the calling thread's stripe, and loads the pointer. Update()
+// swaps the pointer, and then waits for a grace period, until each reader
+// which might have seen the old object has left, before returning the old
+// object. Readers which start during the grace period are counted in the next
+// phase, so a steady stream of them doesn't hold it up.
+//
+// Grace periods are per instance: a ReadPtr only keeps Update() of the
+// RcuDynamicPtr it came from waiting. As with FastReadDynamicPtr, calling
+// Update() from a thread holding a ReadPtr of the same RcuDynamicPtr
+// deadlocks.
+template <typename T>
+class RcuDynamicPtr {
+ public:
+  // Used when an object is owned.
+  using OwnedPtr = std::unique_ptr<T>;
+
+  // A read-only pointer to the object which was current when it was got. Like
+  // a shared_ptr<const T> which can't be copied.
+  class ReadPtr {
+   public:
+    ReadPtr(ReadPtr&& other)
+        : object_(other.object_), num_readers_(other.num_readers_) {
+      other.num_readers_ = nullptr;
+    }
+    ~ReadPtr();
+
+    const T* get() const { return object_; }
+    const T& operator*() const { return *object_; }
+    const T* operator->() const { return object_; }
+    explicit operator bool() const { return object_ != nullptr; }
+    bool operator==(std::nullptr_t) const { return object_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return object_ != nullptr; }
+
+   private:
+    friend class RcuDynamicPtr;
+
+    explicit ReadPtr(const RcuDynamicPtr& ptr);
+
+    const T* object_;
+
+    // The count this reader is counted in, or null if moved from.
+    std::atomic<int64>* num_readers_;
+
+    TF_DISALLOW_COPY_AND_ASSIGN(ReadPtr);
+  };
+
+  // Initially contains a null pointer by default.
+  explicit RcuDynamicPtr(OwnedPtr object = nullptr)
+      : object_(object.release()) {}
+
+  ~RcuDynamicPtr() { delete object_.load(); }
+
+  // Updates the current object with a new one, returning the old object. Blocks
+  // until no ReadPtr to the old object remains. This method may be called with
+  // a null pointer.
+  OwnedPtr Update(OwnedPtr new_object);
+
+  // Returns a read-only pointer to the current object, which stays valid as
+  // long as the ReadPtr lives. May be null.
+  ReadPtr get() const { return ReadPtr(*this); }
+
+ private:
+  // Serializes Update() calls.
+  mutex update_mu_;
+
+  std::atomic<T*> object_;
+
+  // New readers are counted in phase 'epoch_ % 2'. Advanced by Update().
+  std::atomic<uint64> epoch_{0};
+
+  // Mutable, since get() counts readers in them.
+  mutable internal::RcuReaderStripe stripes_[internal::kNumRcuReaderStripes];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RcuDynamicPtr);
+};
+
+//
+// Implementation details follow.
+//
+
+template <typename T>
+RcuDynamicPtr<T>::ReadPtr::ReadPtr(const RcuDynamicPtr& ptr) {
+  // Counting the reader in a stale phase is safe, since Update() waits for
+  // both; the epoch only keeps it from waiting for readers which start after
+  // it.
+  const int phase = ptr.epoch_.load(std::memory_order_relaxed) % 2;
+  num_readers_ = &ptr.stripes_[internal::GetRcuReaderStripe()]
+                      .num_readers[phase];
+  // The increment must be ordered before the load of the object (hence
+  // seq_cst), so that an Update() which doesn't see this reader has already
+  // swapped in the object loaded below.
+  num_readers_->fetch_add(1);
+  object_ = ptr.object_.load();
+}
+
+template <typename T>
+RcuDynamicPtr<T>::ReadPtr::~ReadPtr() {
+  if (num_readers_ != nullptr) {
+    num_readers_->fetch_sub(1, std::memory_order_release);
+  }
+}
+
+template <typename T>
+std::unique_ptr<T> RcuDynamicPtr<T>::Update(std::unique_ptr<T> new_object) {
+  mutex_lock l(update_mu_);
+  OwnedPtr old_object(object_.exchange(new_object.release()));
+  // A reader may have read the epoch before an earlier Update() advanced it,
+  // and so be counted in either phase. Move new readers off the current phase
+  // and drain it, and then do the same for the other one.
+  for (int i = 0; i < 2; ++i) {
+    const int phase = epoch_.fetch_add(1) % 2;
+    internal::WaitForRcuReaders(stripes_, phase);
+  }
+  return old_object;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_RCU_DYNAMIC_PTR_H_
@@ -0,0 +1,147 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/rcu_dynamic_ptr.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+typedef RcuDynamicPtr<int> RcuIntPtr;
+
+TEST(RcuDynamicPtrTest, SingleThreaded) {
+  RcuIntPtr rcu_int;
+
+  {
+    // Initially the object should be null.
+    RcuIntPtr::ReadPtr pointer = rcu_int.get();
+    EXPECT_EQ(pointer, nullptr);
+  }
+
+  // Swap in an actual value.
+  std::unique_ptr<int> i(new int(1));
+  EXPECT_EQ(nullptr, rcu_int.Update(std::move(i)));
+  EXPECT_EQ(nullptr, i);
+
+  {
+    RcuIntPtr::ReadPtr pointer = rcu_int.get();
+    EXPECT_EQ(*pointer, 1);
+    // Nested reads see the same object.
+    RcuIntPtr::ReadPtr nested_pointer = rcu_int.get();
+    EXPECT_EQ(pointer.get(), nested_pointer.get());
+  }
+
+  std::unique_ptr<int> old_value =
+      rcu_int.Update(std::unique_ptr<int>(new int(2)));
+  EXPECT_EQ(1, *old_value);
+  EXPECT_EQ(2, *rcu_int.get());
+}
+
+TEST(RcuDynamicPtrTest, UpdateWaitsForReaders) {
+  RcuIntPtr rcu_int(std::unique_ptr<int>(new int(1)));
+
+  Notification read;
+  Notification release_read;
+  std::atomic<bool> read_released{false};
+  std::unique_ptr<Thread> reader(
+      Env::Default()->StartThread({}, "Reader", [&]() {
+        RcuIntPtr::ReadPtr pointer = rcu_int.get();
+        read.Notify();
+        release_read.WaitForNotification();
+        EXPECT_EQ(1, *pointer);
+        read_released = true;
+      }));
+  read.WaitForNotification();
+
+  std::unique_ptr<Thread> updater(
+      Env::Default()->StartThread({}, "Updater", [&]() {
+        std::unique_ptr<int> old_value =
+            rcu_int.Update(std::unique_ptr<int>(new int(2)));
+        // The old object can't be returned while the reader holds on to it.
+        EXPECT_TRUE(read_released);
+        EXPECT_EQ(1, *old_value);
+      }));
+
+  // New readers see the new object as soon as it is swapped in, while the
+  // updater is still waiting for the reader.
+  while (*rcu_int.get() != 2) {
+    Env::Default()->SleepForMicroseconds(1000 /* 1 ms */);
+  }
+  release_read.Notify();
+}
+
+TEST(RcuDynamicPtrTest, UpdateOnlyWaitsForReadersOfTheSameInstance) {
+  RcuIntPtr rcu_int(std::unique_ptr<int>(new int(1)));
+  RcuIntPtr other_rcu_int(std::unique_ptr<int>(new int(10)));
+
+  // Holding a reader of one instance, even on the updating thread, doesn't
+  // block updates of another.
+  RcuIntPtr::ReadPtr pointer = rcu_int.get();
+  std::unique_ptr<int> old_value =
+      other_rcu_int.Update(std::unique_ptr<int>(new int(20)));
+  EXPECT_EQ(10, *old_value);
+  EXPECT_EQ(20, *other_rcu_int.get());
+  EXPECT_EQ(1, *pointer);
+}
+
+TEST(RcuDynamicPtrTest, MultiThreaded) {
+  const int kNumThreads = 4;
+
+  RcuIntPtr rcu_int;
+
+  {
+    std::unique_ptr<int> tmp(new int(0));
+    EXPECT_EQ(nullptr, rcu_int.Update(std::move(tmp)));
+  }
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int thread_index = 0; thread_index < kNumThreads; ++thread_index) {
+    // Spawn a new thread.
+    threads.emplace_back(Env::Default()->StartThread(
+        {}, "Increment", [thread_index, &rcu_int]() {
+          const int kMaxValue = 1000;
+          int last_value = -1;
+          // Loops until 'rcu_int' becomes 'max_value'.
+          for (;;) {
+            int value = -1;
+            {
+              RcuIntPtr::ReadPtr pointer = rcu_int.get();
+              value = *pointer;
+            }
+
+            EXPECT_GE(value, last_value);
+            last_value = value;
+            if (value == kMaxValue) {
+              return;
+            }
+            if (value % kNumThreads == thread_index) {
+              std::unique_ptr<int> tmp(new int(value + 1));
+              rcu_int.Update(std::move(tmp));
+            }
+          }
+        }));
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,52 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_TEST_UTIL_COUNTING_EXECUTOR_H_
+#define TENSORFLOW_SERVING_UTIL_TEST_UTIL_COUNTING_EXECUTOR_H_
+
+#include <atomic>
+#include <functional>
+#include <utility>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow_serving/util/executor.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
+
+namespace tensorflow {
+namespace serving {
+namespace test_util {
+
+// An executor which counts the closures it runs on a pool of threads.
+class CountingExecutor : public Executor {
+ public:
+  CountingExecutor() : executor_(Env::Default(), "continuations", 2) {}
+
+  void Schedule(std::function<void()> fn) override {
+    ++num_scheduled_;
+    executor_.Schedule(std::move(fn));
+  }
+
+  int num_scheduled() const { return num_scheduled_; }
+
+ private:
+  std::atomic<int> num_scheduled_{0};
+  ThreadPoolExecutor executor_;
+};
+
+}  // namespace test_util
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_TEST_UTIL_COUNTING_EXECUTOR_H_